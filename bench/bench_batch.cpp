@@ -0,0 +1,64 @@
+/**
+ * Latency versus actual batch size.
+ * Runs a task with 1..bchw[0] images, prints mean latency of run() and checks
+ * every post process returns results only for images supplied. Set
+ * `backend: "host"` in task yaml to check partial batch path without GPU.
+ * Usage: ./bench_batch <cls/semseg/fcos/yolo/fairmot/f_track> <task yaml> [runs]
+ * 2021/02/22
+ */
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+
+using namespace std;
+using namespace cv;
+
+template <typename T>
+static bool benchTask(YAML::Node cfg, int runs) {
+    cfg["misc"]["show_time"] = false;
+    T task(cfg);
+    int max_batch = cfg["engine"]["bchw"].as<vector<int>>()[0];
+    Mat img = benchImage(cfg);
+    bool ok = true;
+
+    cout << "batch\tlatency(ms)\tper image(ms)\timages/s" << endl;
+    for (int batch = 1; batch <= max_batch; ++batch) {
+        vector<Mat> imgs;
+        for (int b = 0; b < batch; ++b) {
+            imgs.emplace_back(img.clone());
+        }
+        for (int i = 0; i < 5; ++i) {  // warm up
+            task.run(imgs);
+        }
+        size_t count = 0;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < runs; ++i) {
+            count = resultCount(task.run(imgs));
+        }
+        auto end = chrono::steady_clock::now();
+        double latency = chrono::duration<double, milli>(end - start).count() / runs;
+        cout << batch << "\t" << latency << "\t\t" << latency / batch << "\t\t" << 1000. * batch / latency << endl;
+        if (count != static_cast<size_t>(batch)) {
+            cerr << "Results of batch " << batch << " has " << count << " images!" << endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <cls/semseg/fcos/yolo/fairmot/f_track> <task yaml> [runs]" << endl;
+        return -1;
+    }
+    string name = argv[1];
+    YAML::Node cfg = YAML::LoadFile(argv[2]);
+    int runs = argc > 3 ? stoi(argv[3]) : 100;
+
+    return runBench(name, [&](auto tag) {
+        return benchTask<typename decltype(tag)::type>(cfg, runs);
+    });
+}
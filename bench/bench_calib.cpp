@@ -0,0 +1,103 @@
+/**
+ * INT8 calibration batch stream and cache, without GPU.
+ * Streams calibration images of a directory with 1..8 decode threads, prints
+ * images/s, checks batches of every thread count are same as of one thread,
+ * and checks cache file round trip and rejection of mismatched key/algorithm or
+ * truncated file.
+ * Usage: ./bench_calib <task yaml> <image dir> [batches]
+ * 2021/03/22
+ */
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "calibrator.h"
+#include "tasks.h"
+#include "yaml-cpp/yaml.h"
+
+using namespace std;
+using namespace cv;
+
+static ImageFormat parseFormat(int format) {
+    switch (format) {
+        case (1): return ImageFormat::kRGB255;
+        case (2): return ImageFormat::kBGR;
+        case (3): return ImageFormat::kBGR255;
+        default: return ImageFormat::kRGB;
+    }
+}
+
+static bool checkCache() {
+    const string file = "bench_calib.cache";
+    const string table = "TRT-7103-EntropyCalibration2\ninput: 3c010a14\n";
+    vector<char> read;
+    bool ok = writeCalibCache(file, 42, CalibAlgorithm::kEntropy, table.data(), table.size())
+              && readCalibCache(file, 42, CalibAlgorithm::kEntropy, read)
+              && string(read.begin(), read.end()) == table;
+    if (!ok) cerr << "Cache round trip failed!" << endl;
+    if (readCalibCache(file, 43, CalibAlgorithm::kEntropy, read) || !read.empty()) {
+        cerr << "Cache of other key is accepted!" << endl;
+        ok = false;
+    }
+    if (readCalibCache(file, 42, CalibAlgorithm::kMinMax, read)) {
+        cerr << "Cache of other algorithm is accepted!" << endl;
+        ok = false;
+    }
+    FILE* fp = fopen(file.c_str(), "wb");
+    fwrite(table.data(), 1, 4, fp);
+    fclose(fp);
+    if (readCalibCache(file, 42, CalibAlgorithm::kEntropy, read)) {
+        cerr << "Truncated cache is accepted!" << endl;
+        ok = false;
+    }
+    remove(file.c_str());
+    cout << "cache: " << (ok ? "ok" : "failed") << endl;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <task yaml> <image dir> [batches]" << endl;
+        return -1;
+    }
+    YAML::Node cfg = YAML::LoadFile(argv[1]);
+    string image_dir = argv[2];
+    int batches = argc > 3 ? stoi(argv[3]) : 0;
+    vector<int> bchw = cfg["engine"]["bchw"].as<vector<int>>();
+    vector<float> means = cfg["params"]["means"].as<vector<float>>();
+    vector<float> stds = cfg["params"]["stds"].as<vector<float>>();
+    ImageFormat format = parseFormat(cfg["params"]["image_format"].as<int>());
+    bool padding = cfg["params"]["padding"] && cfg["params"]["padding"].as<bool>();
+    auto resize = [&](const Mat& img) { return Task::resizeImage(img, bchw[3], bchw[2], padding); };
+
+    bool ok = checkCache();
+    vector<float> reference;
+    for (int threads : {1, 2, 4, 8}) {
+        CalibBatchStream stream(image_dir, bchw, means, stds, format, resize, batches, threads);
+        if (stream.NbBatches() == 0) return 1;
+        vector<float> batch(stream.Volume());
+        vector<float> all;
+        int count = 0;
+        auto start = chrono::steady_clock::now();
+        while (stream.Next(batch.data())) {
+            all.insert(all.end(), batch.begin(), batch.end());
+            count++;
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "threads: " << threads << ", batches: " << count << ", "
+             << 1000. * count * bchw[0] / ms << " images/s" << endl;
+        if (count != stream.NbBatches()) {
+            cerr << "Streamed " << count << " of " << stream.NbBatches() << " batches!" << endl;
+            ok = false;
+        }
+        if (reference.empty()) {
+            reference = all;
+        } else if (all != reference) {
+            cerr << "Batches of " << threads << " threads differ from 1 thread!" << endl;
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
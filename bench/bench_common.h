@@ -0,0 +1,81 @@
+/**
+ * Scaffold of benches running any task by name: count of images in results of
+ * every task type, input image of task yaml, and dispatch of task name to its
+ * class. A bench keeps only its measured loop, as a benchTask<T> template.
+ * 2021/03/01
+ */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cls.h"
+#include "semseg.h"
+#include "fcos.h"
+#include "yolov5.h"
+#include "f_track.h"
+#include "fairmot.h"
+#include "yaml-cpp/yaml.h"
+
+static inline size_t resultCount(const std::vector<int>& results) { return results.size(); }
+static inline size_t resultCount(const std::vector<cv::Mat>& results) { return results.size(); }
+static inline size_t resultCount(const BatchBox& results) { return results.size(); }
+static inline size_t resultCount(const TrackRes& results) { return results.first.size(); }
+
+/**
+ * `inputs: img_path` of yaml, or random pixels if it's missing, at `inputs:
+ * width, height`(input size of `bchw` by default).
+ */
+static inline cv::Mat benchImage(const YAML::Node& cfg) {
+    std::vector<int> bchw = cfg["engine"]["bchw"].as<std::vector<int>>();
+    const YAML::Node inputs = cfg["inputs"];
+    int im_w = inputs && inputs["width"] ? inputs["width"].as<int>() : bchw[3];
+    int im_h = inputs && inputs["height"] ? inputs["height"].as<int>() : bchw[2];
+    cv::Mat img;
+    if (inputs && inputs["img_path"]) {
+        img = cv::imread(inputs["img_path"].as<std::string>());
+    }
+    if (img.empty()) {
+        img = cv::Mat(im_h, im_w, CV_8UC3);
+        cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(255));
+    }
+    cv::resize(img, img, cv::Size(im_w, im_h));
+    return img;
+}
+
+template <typename T>
+struct TaskTag {
+    typedef T type;
+};
+
+/**
+ * Call bench(TaskTag<T>()) with class T of task name, bench returns false if
+ * a check failed. return: exit code of bench, -1 for unknown task.
+ * e.g. runBench(name, [&](auto tag) { return benchTask<typename decltype(tag)::type>(cfg); })
+ */
+template <typename Bench>
+int runBench(const std::string& name, const Bench& bench) {
+    bool ok = false;
+    if (name == "cls") {
+        ok = bench(TaskTag<CLS>());
+    } else if (name == "semseg") {
+        ok = bench(TaskTag<SEMSEG>());
+    } else if (name == "fcos") {
+        ok = bench(TaskTag<FCOS>());
+    } else if (name == "yolo") {
+        ok = bench(TaskTag<YOLOV5>());
+    } else if (name == "fairmot") {
+        ok = bench(TaskTag<FairMOT>());
+    } else if (name == "f_track") {
+        ok = bench(TaskTag<FTrack>());
+    } else {
+        std::cerr << "Unknown task: " << name << std::endl;
+        return -1;
+    }
+    return ok ? 0 : 1;
+}
+
+#endif  // BENCH_COMMON_H
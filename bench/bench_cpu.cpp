@@ -0,0 +1,192 @@
+/**
+ * CPU backend against TensorRT for a small classification model.
+ * Checks gemm, im2col conv and depthwise conv kernels against naive loops,
+ * then runs onnx_file of task yaml on cpu backend with 1..cpu_threads threads,
+ * and on TensorRT(with input/output copies, as tasks run it) if a GPU is
+ * found. Prints latency of every run and max diff of outputs, run TensorRT
+ * with `mode: 32` for a meaningful diff.
+ * Usage: ./bench_cpu <task yaml> [runs]
+ * 2021/04/12
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cpu_engine.h"
+#include "cpu_kernels.h"
+#ifndef CPU_ONLY
+#include "engine.h"
+#endif
+#include "yaml-cpp/yaml.h"
+
+using namespace std;
+
+static vector<float> randomData(size_t size, mt19937& rng) {
+    uniform_real_distribution<float> dist(-1.f, 1.f);
+    vector<float> data(size);
+    for (auto& v : data) {
+        v = dist(rng);
+    }
+    return data;
+}
+
+static float maxDiff(const vector<float>& a, const vector<float>& b) {
+    float diff = 0.f;
+    for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+        diff = max(diff, fabs(a[i] - b[i]));
+    }
+    return diff;
+}
+
+// naive grouped convolution of one image, weight is [O, C / group, kh, kw]
+static vector<float> naiveConv(const vector<float>& x, const vector<float>& w, int C, int H, int W, int O, int k,
+                               int stride, int pad, int dilation, int group, int out_h, int out_w) {
+    vector<float> y(static_cast<size_t>(O) * out_h * out_w, 0.f);
+    int cg = C / group, og = O / group;
+    for (int o = 0; o < O; ++o) {
+        for (int oy = 0; oy < out_h; ++oy) {
+            for (int ox = 0; ox < out_w; ++ox) {
+                float sum = 0.f;
+                for (int c = 0; c < cg; ++c) {
+                    for (int ky = 0; ky < k; ++ky) {
+                        for (int kx = 0; kx < k; ++kx) {
+                            int iy = oy * stride - pad + ky * dilation;
+                            int ix = ox * stride - pad + kx * dilation;
+                            if (iy < 0 || iy >= H || ix < 0 || ix >= W) continue;
+                            sum += x[((o / og * cg + c) * H + iy) * W + ix] * w[((o * cg + c) * k + ky) * k + kx];
+                        }
+                    }
+                }
+                y[(o * out_h + oy) * out_w + ox] = sum;
+            }
+        }
+    }
+    return y;
+}
+
+static bool checkKernels() {
+    mt19937 rng(7);
+    bool ok = true;
+    // gemm with full tiles and both edges
+    for (auto mnk : vector<vector<int>>{{4, 16, 9}, {13, 37, 27}, {64, 196, 72}, {3, 5, 1}}) {
+        int M = mnk[0], N = mnk[1], K = mnk[2];
+        vector<float> A = randomData(M * K, rng), B = randomData(K * N, rng), C(M * N), ref(M * N, 0.f);
+        cpuGemm(M, N, K, A.data(), K, B.data(), N, C.data(), N);
+        for (int i = 0; i < M; ++i) {
+            for (int k = 0; k < K; ++k) {
+                for (int j = 0; j < N; ++j) {
+                    ref[i * N + j] += A[i * K + k] * B[k * N + j];
+                }
+            }
+        }
+        float diff = maxDiff(C, ref);
+        cout << "gemm " << M << "x" << N << "x" << K << ", max diff: " << diff << endl;
+        ok = ok && diff < 1e-4f;
+    }
+    // im2col + gemm and depthwise conv: {C, H, W, O, k, stride, pad, dilation, group}
+    for (auto p : vector<vector<int>>{{3, 17, 15, 8, 3, 2, 1, 1, 1}, {8, 9, 9, 8, 3, 1, 2, 2, 2},
+                                      {16, 14, 14, 16, 3, 1, 1, 1, 16}, {8, 15, 13, 8, 5, 2, 2, 1, 8}}) {
+        int C = p[0], H = p[1], W = p[2], O = p[3], k = p[4], s = p[5], pad = p[6], d = p[7], g = p[8];
+        int out_h = (H + 2 * pad - d * (k - 1) - 1) / s + 1;
+        int out_w = (W + 2 * pad - d * (k - 1) - 1) / s + 1;
+        vector<float> x = randomData(C * H * W, rng), w = randomData(O * (C / g) * k * k, rng);
+        vector<float> y(O * out_h * out_w);
+        bool depthwise = g == C && O == C;
+        if (depthwise) {
+            cpuDepthwiseConv(x.data(), w.data(), nullptr, C, H, W, k, k, s, s, pad, pad, d, d, out_h, out_w, y.data());
+        } else {
+            int cg = C / g, og = O / g, kk = cg * k * k, spatial = out_h * out_w;
+            vector<float> cols(static_cast<size_t>(kk) * spatial);
+            for (int i = 0; i < g; ++i) {
+                cpuIm2col(x.data() + i * cg * H * W, cg, H, W, k, k, s, s, pad, pad, d, d, out_h, out_w, cols.data());
+                cpuGemm(og, spatial, kk, w.data() + i * og * kk, kk, cols.data(), spatial, y.data() + i * og * spatial, spatial);
+            }
+        }
+        float diff = maxDiff(y, naiveConv(x, w, C, H, W, O, k, s, pad, d, g, out_h, out_w));
+        cout << (depthwise ? "depthwise" : "im2col") << " conv " << C << "x" << H << "x" << W << " k" << k << " s" << s
+             << " p" << pad << " d" << d << " g" << g << ", max diff: " << diff << endl;
+        ok = ok && diff < 1e-4f;
+    }
+    return ok;
+}
+
+// ms per forward, copies of bindings included for device engine
+static double benchEngine(InferBackend& net, const vector<float>& input, vector<float>& output, int runs) {
+    int out_index = net.GetNbBindings() - 1;
+    output.assign(net.GetBindingSize(out_index) / sizeof(float), 0.f);
+    auto forward = [&]() {
+        net.CopyFromHostToDevice(input, 0);
+        net.Forward();
+        net.CopyFromDeviceToHost(output, out_index);
+    };
+    forward();  // warm up
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        forward();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <task yaml> [runs]" << endl;
+        return -1;
+    }
+    YAML::Node cfg = YAML::LoadFile(argv[1]);
+    int runs = argc > 2 ? stoi(argv[2]) : 100;
+    bool ok = checkKernels();
+    cout << "kernels(" << cpuKernelIsa() << "): " << (ok ? "PASS" : "FAIL") << endl;
+
+    const YAML::Node& engine = cfg["engine"];
+    vector<int> bchw = engine["bchw"].as<vector<int>>();
+    string onnx = engine["onnx_file"].as<string>();
+    int max_threads = engine["cpu_threads"] ? max(engine["cpu_threads"].as<int>(), 1) : 1;
+    mt19937 rng(11);
+    vector<float> input = randomData(static_cast<size_t>(bchw[0]) * bchw[1] * bchw[2] * bchw[3], rng);
+
+    vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.emplace_back(threads);
+    }
+    thread_counts.emplace_back(max_threads);
+    vector<float> cpu_output;
+    for (int threads : thread_counts) {
+        CpuEngine net;
+        net.SetInputShape(bchw);
+        net.SetThreads(threads);
+        net.CreateEngine(onnx, "", {}, bchw[0], RunMode::kFP32, 0);
+        if (net.GetNbBindings() == 0) {
+            cerr << "cpu backend can't run " << onnx << endl;
+            return -1;
+        }
+        double ms = benchEngine(net, input, cpu_output, runs);
+        cout << "cpu backend, threads: " << threads << ", " << ms << " ms/run, " << 1000. * bchw[0] / ms << " images/s" << endl;
+    }
+
+#ifdef CPU_ONLY
+    cout << "built with BUILD_CPU_ONLY, skip TensorRT" << endl;
+    return ok ? 0 : -1;
+#else
+    int devices = 0;
+    if (cudaGetDeviceCount(&devices) != cudaSuccess || devices == 0) {
+        cout << "no GPU, skip TensorRT" << endl;
+        return ok ? 0 : -1;
+    }
+    int mode = engine["mode"].as<int>();
+    RTEngine net;
+    net.SetArtifactSpec(bchw, engine["cache_dir"] ? engine["cache_dir"].as<string>() : "");
+    net.SetDevice(engine["gpu_id"].as<int>());
+    net.CreateEngine(onnx, engine["engine_file"].as<string>(), {}, bchw[0],
+                     mode == 16 ? RunMode::kFP16 : mode == 8 ? RunMode::kINT8 : RunMode::kFP32,
+                     engine["workspace"].as<int>());
+    vector<float> trt_output;
+    double ms = benchEngine(net, input, trt_output, runs);
+    cout << "tensorrt(mode " << mode << "), " << ms << " ms/run, " << 1000. * bchw[0] / ms << " images/s" << endl;
+    cout << "max diff of last output, cpu vs tensorrt: " << maxDiff(cpu_output, trt_output) << endl;
+    return ok ? 0 : -1;
+#endif
+}
@@ -0,0 +1,148 @@
+/**
+ * Decode + resize throughput of jpeg images to input sizes of tasks: imread of
+ * full resolution then cv::resize(what main did before ImageLoader) versus
+ * ImageLoader decoding at reduced DCT scale into its staging buffer and a
+ * residual resize. Checks scale and decoded size of every image, that staging
+ * is not reallocated once it holds the largest image, and that loader output
+ * is not farther from INTER_AREA resize of full image than imread + resize is.
+ * Usage: ./bench_decode [runs] [image dir]
+ * 2021/06/28
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <dirent.h>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "image_loader.h"
+
+using namespace std;
+using namespace cv;
+
+struct Target {
+    const char* task;
+    int width;
+    int height;
+};
+
+// inputs of cfgs/tasks
+static const Target kTargets[] = {{"cls", 96, 96},        {"fcos", 512, 512},      {"yolov5", 640, 640},
+                                  {"semseg", 1024, 1024}, {"fairmot", 1152, 384}, {"f_track", 1632, 480}};
+
+static vector<string> jpegFiles(const string& dir) {
+    vector<string> files;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) return files;
+    string prefix = dir.back() == '/' ? dir : dir + "/";
+    for (struct dirent* entry = readdir(d); entry != nullptr; entry = readdir(d)) {
+        string name = entry->d_name;
+        int w, h;
+        if (ImageLoader::JpegSize(prefix + name, &w, &h)) files.emplace_back(prefix + name);
+    }
+    closedir(d);
+    sort(files.begin(), files.end());
+    return files;
+}
+
+static double meanAbsDiff(const Mat& a, const Mat& b) {
+    double sum = 0.0;
+    for (int y = 0; y < a.rows; ++y) {
+        const uint8_t* pa = a.data + y * a.step[0];
+        const uint8_t* pb = b.data + y * b.step[0];
+        for (int x = 0; x < a.cols * 3; ++x) {
+            sum += abs(pa[x] - pb[x]);
+        }
+    }
+    return sum / (static_cast<double>(a.rows) * a.cols * 3);
+}
+
+static double timeMs(const function<void()>& run, int runs) {
+    run();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        run();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+}
+
+// false if scale, decoded size or output of loader is off
+static bool checkImage(ImageLoader& loader, const string& file, const Target& target) {
+    int src_w = 0, src_h = 0;
+    ImageLoader::JpegSize(file, &src_w, &src_h);
+    int denom = ImageLoader::ScaleDenom(src_w, src_h, target.width, target.height);
+    Mat decoded = loader.Decode(file, target.width, target.height);
+    bool ok = loader.LastDenom() == denom && decoded.cols == (src_w + denom - 1) / denom &&
+              decoded.rows == (src_h + denom - 1) / denom && decoded.cols >= min(src_w, target.width) &&
+              decoded.rows >= min(src_h, target.height);
+    if (!ok) cerr << file << " to " << target.task << ": decoded " << decoded.cols << "x" << decoded.rows
+                  << " at 1/" << loader.LastDenom() << ", expected 1/" << denom << endl;
+
+    Mat full = imread(file);
+    Mat reference, resized, loaded;
+    resize(full, reference, Size(target.width, target.height), 0, 0, INTER_AREA);
+    resize(full, resized, Size(target.width, target.height));
+    ok = loader.Load(file, loaded, target.width, target.height) && ok;
+    ok = loaded.cols == target.width && loaded.rows == target.height && ok;
+    if (!ok) return false;
+    // scaled idct averages blocks, so it aliases less than linear taps of a large downscale
+    double old_error = meanAbsDiff(resized, reference);
+    double error = meanAbsDiff(loaded, reference);
+    if (error > old_error + 1.0) {
+        cerr << file << " to " << target.task << ": loader differs from area resize by " << error
+             << ", imread + resize by " << old_error << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int runs   = argc > 1 ? stoi(argv[1]) : 20;
+    string dir = argc > 2 ? argv[2] : "../data/sample_data";
+
+    vector<string> files = jpegFiles(dir);
+    if (files.empty()) {
+        cerr << "No jpeg in " << dir << endl;
+        return 1;
+    }
+    ImageLoader loader;
+    bool ok = true;
+    for (const auto& file : files) {
+        for (const auto& target : kTargets) {
+            ok = checkImage(loader, file, target) && ok;
+        }
+    }
+    // every image decoded once, staging holds the largest of them from now on
+    size_t staging = loader.StagingBytes();
+
+    cout << files.size() << " jpeg in " << dir << ", " << runs << " runs" << endl;
+    cout << "task\tinput\t\tscale\timread+resize ms\tloader ms\tspeedup\timages/s" << endl;
+    for (const auto& target : kTargets) {
+        double old_ms = 0.0, loader_ms = 0.0;
+        int denom = 0;
+        Mat dst;
+        for (const auto& file : files) {
+            old_ms += timeMs([&]() {
+                Mat frame = imread(file);
+                resize(frame, frame, Size(target.width, target.height));
+            }, runs);
+            loader_ms += timeMs([&]() { loader.Load(file, dst, target.width, target.height); }, runs);
+            denom = max(denom, loader.LastDenom());
+        }
+        cout << target.task << "\t" << target.width << "x" << target.height << (target.width < 1000 ? "\t\t" : "\t")
+             << "1/" << denom << "\t" << old_ms / files.size() << "\t\t\t" << loader_ms / files.size() << "\t\t"
+             << old_ms / loader_ms << "\t" << 1000.0 * files.size() / loader_ms << endl;
+    }
+    if (loader.StagingBytes() != staging) {
+        cerr << "Staging of loader grew from " << staging << " to " << loader.StagingBytes() << " bytes" << endl;
+        ok = false;
+    }
+    if (!ok) cerr << "Image loader mismatch!" << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+/**
+ * Tasks of one camera frame sharing preprocessing through FrameCache: f_track
+ * and fcos at 1632x480 with same normalization, yolov5 letterbox(fused path),
+ * semseg and cls, all on host backend running pre process only. Checks inputs
+ * with cache(pyramid off) are bit exact with inputs without it, that tasks
+ * running again on a frame hit their inputs, and that cls resizes from the
+ * pyramid level yolov5 built. Then times all tasks per frame without cache,
+ * with cache and with cache + pyramid, and prints hit rates and time saved.
+ * Usage: ./bench_framecache [runs] [frame width] [frame height]
+ * 2021/07/12
+ */
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "frame_cache.h"
+#include "tasks.h"
+#include "yaml-cpp/yaml.h"
+
+using namespace std;
+using namespace cv;
+
+struct Spec {
+    const char* name;
+    int width;
+    int height;
+    bool padding;
+    int image_format;  // as `params: image_format`
+    vector<float> means;
+    vector<float> stds;
+    bool fused;  // prepareFused as yolov5, else prepareViews
+};
+
+// task of pre process only, forward keeps float input of last run for checks
+class PrepareTask : public ClassificationTask {
+public:
+    PrepareTask(const YAML::Node& cfg, bool fused) : ClassificationTask(cfg), mFused(fused) {
+        setHostForward([this](HostEngine& engine) {
+            if (!mKeep) return;
+            const float* input = static_cast<const float*>(engine.GetBindingPtr(0));
+            mInput.assign(input, input + engine.GetBindingSize(0) / sizeof(float));
+        });
+    }
+
+    void keepInput(bool keep) {
+        mKeep = keep;
+    }
+
+    const vector<float>& input() const {
+        return mInput;
+    }
+
+protected:
+    bool prepareViews(ExecState& state, const vector<ImageView>& views) override {
+        return mFused ? prepareFused(state, views) : Task::prepareViews(state, views);
+    }
+
+    vector<int> processOutputs(ExecState&) override {
+        return {};
+    }
+
+private:
+    bool mFused;
+    bool mKeep = true;
+    vector<float> mInput;
+};
+
+static YAML::Node taskCfg(const Spec& spec) {
+    YAML::Node cfg = YAML::Load(
+            "engine: {gpu_id: 0, nx: false, backend: host, mode: 32, workspace: 1, onnx_file: '', engine_file: '',"
+            " warmup_runs: 0}\n"
+            "misc: {show_time: false}\n");
+    cfg["engine"]["bchw"] = vector<int>{1, 3, spec.height, spec.width};
+    YAML::Node input, output;
+    input["name"] = "input";
+    input["dims"] = vector<int>{1, 3, spec.height, spec.width};
+    input["input"] = true;
+    output["name"] = "output";
+    output["dims"] = vector<int>{1, 1};
+    cfg["engine"]["host_bindings"].push_back(input);
+    cfg["engine"]["host_bindings"].push_back(output);
+    cfg["params"]["image_format"] = spec.image_format;
+    cfg["params"]["means"] = spec.means;
+    cfg["params"]["stds"] = spec.stds;
+    cfg["params"]["padding"] = spec.padding;
+    return cfg;
+}
+
+// smooth gradients with noise, as camera frames rather than uniform random bytes
+static Mat makeFrame(int width, int height, int seed) {
+    mt19937 rng(seed);
+    Mat frame(height, width, CV_8UC3);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = frame.data + y * frame.step[0];
+        for (int x = 0; x < width * 3; ++x) {
+            row[x] = static_cast<uint8_t>((y * 3 + x * 5 + seed * 17) % 256 ^ (rng() & 31));
+        }
+    }
+    return frame;
+}
+
+static ImageView frameView(const Mat& frame, uint64_t frame_id) {
+    ImageView view(frame.data, static_cast<int>(frame.step[0]), frame.cols, frame.rows);
+    view.frame_id = frame_id;
+    return view;
+}
+
+static double meanAbsDiff(const vector<float>& a, const vector<float>& b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        sum += fabs(a[i] - b[i]);
+    }
+    return a.empty() ? 0.0 : sum / a.size();
+}
+
+// all tasks on frames frame_id .. frame_id + runs - 1, ms per frame
+static double runFrames(vector<unique_ptr<PrepareTask>>& tasks, const vector<Mat>& frames, uint64_t frame_id,
+                        int runs) {
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < runs; ++r) {
+        ImageView view = frameView(frames[r % frames.size()], frame_id + r);
+        for (auto& task : tasks) {
+            task->run(vector<ImageView>{view});
+        }
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+}
+
+int main(int argc, char** argv) {
+    int runs   = argc > 1 ? stoi(argv[1]) : 20;
+    int width  = argc > 2 ? stoi(argv[2]) : 1920;
+    int height = argc > 3 ? stoi(argv[3]) : 1080;
+
+    const vector<float> fcos_means = {103.52f, 116.28f, 123.675f}, fcos_stds = {57.375f, 57.12f, 58.395f};
+    const vector<float> imagenet_means = {0.485f, 0.456f, 0.406f}, imagenet_stds = {0.229f, 0.224f, 0.225f};
+    const vector<Spec> specs = {
+            {"f_track", 1632, 480, false, 3, fcos_means, fcos_stds, false},
+            {"fcos", 1632, 480, false, 3, fcos_means, fcos_stds, false},
+            {"yolov5", 640, 640, true, 0, {0.f, 0.f, 0.f}, {1.f, 1.f, 1.f}, true},
+            {"semseg", 1024, 1024, false, 0, imagenet_means, imagenet_stds, false},
+            {"cls", 224, 224, false, 0, imagenet_means, imagenet_stds, false},
+    };
+    vector<unique_ptr<PrepareTask>> tasks;
+    for (const auto& spec : specs) {
+        tasks.emplace_back(new PrepareTask(taskCfg(spec), spec.fused));
+    }
+    vector<Mat> frames;
+    for (int i = 0; i < 4; ++i) {
+        frames.emplace_back(makeFrame(width, height, i));
+    }
+
+    // inputs without cache, frame id 0 is never cached
+    vector<vector<float>> expected;
+    for (auto& task : tasks) {
+        task->run(vector<ImageView>{frameView(frames[0], 0)});
+        expected.push_back(task->input());
+    }
+    bool ok = true;
+    FrameCache exact(2, false);
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t t = 0; t < tasks.size(); ++t) {
+            tasks[t]->setFrameCache(&exact);
+            tasks[t]->run(vector<ImageView>{frameView(frames[0], 1)});
+            if (tasks[t]->input() != expected[t]) {
+                cerr << specs[t].name << " input with cache differs, pass " << pass << endl;
+                ok = false;
+            }
+        }
+    }
+    // fcos reads input of f_track, every task its own input at second pass
+    long expected_hits = 1 + static_cast<long>(tasks.size());
+    bool hits = exact.Hits(FrameCache::kInput) == expected_hits;
+    cout << "inputs with cache " << (ok ? "match" : "MISMATCH") << " inputs without it, " << exact.Hits(FrameCache::kInput)
+         << " input hits of " << expected_hits << endl;
+    ok = ok && hits;
+
+    FrameCache pyramid(2, true);
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        tasks[t]->setFrameCache(&pyramid);
+        tasks[t]->run(vector<ImageView>{frameView(frames[0], 1)});
+        cout << specs[t].name << " from pyramid differs from full resize by " << meanAbsDiff(tasks[t]->input(), expected[t])
+             << " on average" << endl;
+    }
+    if (width >= 4 * 224 && height >= 4 * 224 && pyramid.Hits(FrameCache::kLevel) == 0) {
+        cerr << "cls did not resize from pyramid level of yolov5" << endl;
+        ok = false;
+    }
+
+    for (auto& task : tasks) {
+        task->keepInput(false);
+        task->setFrameCache(nullptr);
+    }
+    double none_ms = runFrames(tasks, frames, 0, runs);
+    FrameCache shared(2, false), shared_pyramid(2, true);
+    for (auto& task : tasks) {
+        task->setFrameCache(&shared);
+    }
+    double shared_ms = runFrames(tasks, frames, 100, runs);
+    for (auto& task : tasks) {
+        task->setFrameCache(&shared_pyramid);
+    }
+    double pyramid_ms = runFrames(tasks, frames, 100, runs);
+
+    cout << tasks.size() << " tasks per " << width << "x" << height << " frame, " << runs << " frames" << endl;
+    cout << "cache\t\tms/frame\tspeedup" << endl;
+    cout << "none\t\t" << none_ms << endl;
+    cout << "inputs\t\t" << shared_ms << "\t\t" << none_ms / shared_ms << endl;
+    cout << "+ pyramid\t" << pyramid_ms << "\t\t" << none_ms / pyramid_ms << endl;
+    shared.Report();
+    shared_pyramid.Report();
+    if (!ok) cerr << "Frame cache mismatch!" << endl;
+    return ok ? 0 : 1;
+}
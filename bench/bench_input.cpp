@@ -0,0 +1,195 @@
+/**
+ * Input bindings of float, half and int8.
+ * Checks NHWC2NCHW_lut and letterboxNormalize_cpu write every data type bit
+ * exact(half by floatToHalf of float tables, int8 by rounding normalized values
+ * divided by stds x scale), then times conversion on host and bytes written
+ * per data type, and upload of the converted input and on device conversion
+ * from the uint8 staging buffer if a GPU is found.
+ * Usage: ./bench_input [runs] [batch] [threads]
+ * 2021/06/21
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "binding_convert.h"
+#include "letterbox_cpu.h"
+#include "nhwc2nchw.h"
+#include "nhwc2nchw_cpu.h"
+#include "utils.h"
+
+using namespace std;
+
+static const nvinfer1::DataType kTypes[] = {nvinfer1::DataType::kFLOAT, nvinfer1::DataType::kHALF,
+                                            nvinfer1::DataType::kINT8};
+
+static const char* typeName(nvinfer1::DataType dtype) {
+    switch (dtype) {
+        case nvinfer1::DataType::kHALF: return "half";
+        case nvinfer1::DataType::kINT8: return "int8";
+        default: return "float";
+    }
+}
+
+static vector<uint8_t> randomBytes(size_t count, int seed) {
+    mt19937 rng(seed);
+    vector<uint8_t> bytes(count);
+    for (auto& b : bytes) {
+        b = static_cast<uint8_t>(rng());
+    }
+    return bytes;
+}
+
+// element i of output is byte v of channel c, by float table, floatToHalf of it or rounding to nearest even
+static bool sameEntry(const uint8_t* out, size_t i, int c, uint8_t v, const NormalizeLut& lut) {
+    float value = lut.values[c][v];
+    switch (lut.dtype) {
+        case nvinfer1::DataType::kHALF: {
+            uint16_t half;
+            floatToHalf(&value, &half, 1);
+            return reinterpret_cast<const uint16_t*>(out)[i] == half;
+        }
+        case nvinfer1::DataType::kINT8: {
+            float q = nearbyintf(fmaf(static_cast<float>(v), lut.scale, -lut.means[c]) / (lut.stds[c] * lut.qscale));
+            return reinterpret_cast<const int8_t*>(out)[i] == static_cast<int8_t>(min(max(q, -128.f), 127.f));
+        }
+        default: return memcmp(reinterpret_cast<const float*>(out) + i, &value, sizeof(float)) == 0;
+    }
+}
+
+static bool checkConversions() {
+    bool ok = true;
+    // width is not a multiple of vector width so tails run too
+    const int n = 2, h = 37, w = 53;
+    size_t plane = static_cast<size_t>(h) * w;
+    vector<uint8_t> image = randomBytes(n * plane * 3, 3);
+    const ImageFormat formats[] = {ImageFormat::kRGB, ImageFormat::kRGB255, ImageFormat::kBGR, ImageFormat::kBGR255};
+    for (auto dtype : kTypes) {
+        int mismatch = 0;
+        for (auto format : formats) {
+            NormalizeLut lut;
+            makeNormalizeLut(lut, 0.485f, 0.456f, 0.406f, 0.229f, 0.224f, 0.225f, format);
+            // scale clips the largest values, so saturation is checked too
+            setLutOutput(lut, dtype, 2.f / 127.f);
+            vector<uint8_t> out(n * plane * 3 * getElementSize(dtype));
+            NHWC2NCHW_lut(image.data(), out.data(), n, h, w, lut, 3);
+            for (int b = 0; b < n; ++b) {
+                for (int c = 0; c < 3; ++c) {
+                    for (size_t p = 0; p < plane; ++p) {
+                        uint8_t v = image[(b * plane + p) * 3 + lut.source[c]];
+                        if (!sameEntry(out.data(), (b * 3 + c) * plane + p, c, v, lut)) ++mismatch;
+                    }
+                }
+            }
+        }
+        cout << "NHWC2NCHW_lut " << typeName(dtype) << ": " << mismatch << " mismatch" << endl;
+        ok = ok && mismatch == 0;
+    }
+
+    // letterbox of every type is its float output converted, bytes are found back by float tables
+    vector<uint8_t> src = randomBytes(101 * 67 * 3, 5);
+    ImageTransform t = letterboxTransform(101, 67, 64, 48, true);
+    NormalizeLut lut;
+    makeNormalizeLut(lut, 0.485f, 0.456f, 0.406f, 0.229f, 0.224f, 0.225f, ImageFormat::kRGB);
+    vector<float> floats(3 * 64 * 48);
+    letterboxNormalize_cpu(src.data(), 101 * 3, t, floats.data(), lut, 114, 2);
+    for (auto dtype : kTypes) {
+        setLutOutput(lut, dtype, 2.f / 127.f);
+        vector<uint8_t> out(floats.size() * getElementSize(dtype));
+        letterboxNormalize_cpu(src.data(), 101 * 3, t, out.data(), lut, 114, 2);
+        int mismatch = 0;
+        for (size_t i = 0; i < floats.size(); ++i) {
+            int c = static_cast<int>(i / (64 * 48));
+            const float* table = lut.values[c];
+            int v = static_cast<int>(find(table, table + 256, floats[i]) - table);
+            if (v == 256 || !sameEntry(out.data(), i, c, static_cast<uint8_t>(v), lut)) ++mismatch;
+        }
+        cout << "letterboxNormalize_cpu " << typeName(dtype) << ": " << mismatch << " mismatch" << endl;
+        ok = ok && mismatch == 0;
+    }
+    return ok;
+}
+
+static double timeMs(const function<void()>& run, int runs) {
+    run();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        run();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+}
+
+// false if device conversion differs from host one
+static bool benchInput(int batch, int height, int width, int runs, int threads, bool on_device) {
+    bool ok = true;
+    size_t pixels = static_cast<size_t>(batch) * height * width;
+    vector<uint8_t> staging = randomBytes(pixels * 3, 7);
+    cout << batch << " x " << width << "x" << height << endl;
+    cout << "type\tbytes\t\thost ms\t\tGB/s written";
+    if (on_device) cout << "\tupload ms\tdevice ms";
+    cout << endl;
+    for (auto dtype : kTypes) {
+        NormalizeLut lut;
+        makeNormalizeLut(lut, 0.485f, 0.456f, 0.406f, 0.229f, 0.224f, 0.225f, ImageFormat::kRGB);
+        setLutOutput(lut, dtype, 3.f / 127.f);
+        size_t bytes = pixels * 3 * getElementSize(dtype);
+        vector<uint8_t> input(bytes);
+        double host_ms = timeMs([&]() { NHWC2NCHW_lut(staging.data(), input.data(), batch, height, width, lut, threads); }, runs);
+        cout << typeName(dtype) << "\t" << bytes << "\t\t" << host_ms << "\t\t" << bytes / host_ms / 1e6;
+        if (on_device) {
+            // host backends convert on host and device ones upload it, or upload uint8 and convert there
+            uint8_t* pinned = nullptr;
+            uint8_t* device_input = nullptr;
+            uint8_t* device_staging = nullptr;
+            CUDA_CHECK(cudaMallocHost((void**)&pinned, bytes));
+            CUDA_CHECK(cudaMalloc((void**)&device_input, bytes));
+            CUDA_CHECK(cudaMalloc((void**)&device_staging, pixels * 3));
+            memcpy(pinned, input.data(), bytes);
+            CUDA_CHECK(cudaMemcpy(device_staging, staging.data(), pixels * 3, cudaMemcpyHostToDevice));
+            double upload_ms = timeMs([&]() {
+                CUDA_CHECK(cudaMemcpy(device_input, pinned, bytes, cudaMemcpyHostToDevice));
+            }, runs);
+            double device_ms = timeMs([&]() {
+                NHWC2NCHW_binding(device_staging, device_input, batch, height, width, lut);
+                CUDA_CHECK(cudaDeviceSynchronize());
+            }, runs);
+            // device kernel writes same values as host tables
+            vector<uint8_t> back(bytes);
+            CUDA_CHECK(cudaMemcpy(back.data(), device_input, bytes, cudaMemcpyDeviceToHost));
+            bool same = back == input;
+            ok = ok && same;
+            cout << "\t" << upload_ms << "\t\t" << device_ms << (same ? "" : "\tMISMATCH host");
+            CUDA_CHECK(cudaFreeHost(pinned));
+            CUDA_CHECK(cudaFree(device_input));
+            CUDA_CHECK(cudaFree(device_staging));
+        }
+        cout << endl;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int runs    = argc > 1 ? stoi(argv[1]) : 20;
+    int batch   = argc > 2 ? stoi(argv[2]) : 1;
+    int threads = argc > 3 ? stoi(argv[3]) : 1;
+
+    cout << "conversion built with: " << nhwc2nchwIsa() << ", " << bindingConvertIsa() << endl;
+    bool ok = checkConversions();
+    bool on_device = false;
+#ifndef CPU_ONLY
+    int devices = 0;
+    on_device = cudaGetDeviceCount(&devices) == cudaSuccess && devices > 0;
+    if (!on_device) cout << "No GPU found, skip upload and device conversion." << endl;
+#endif
+    // yolov5 640x640, f_track/fcos 1632x480
+    ok = benchInput(batch, 640, 640, runs, threads, on_device) && ok;
+    ok = benchInput(batch, 480, 1632, runs, threads, on_device) && ok;
+    if (!ok) cerr << "Input conversions mismatch!" << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+/**
+ * Fused letterbox preprocessing versus cv::resize + copyMakeBorder + NHWC2NCHW.
+ * Checks letterboxNormalize_cpu(and letterboxNormalize if a GPU is found) is
+ * within one level of the resize path for stretch and letterbox of odd sizes,
+ * transforms match Task::resizeImage, then times both paths from camera sizes
+ * to yolov5 input, on host and on device.
+ * Usage: ./bench_letterbox [runs] [input width] [input height] [threads]
+ * 2021/05/31
+ */
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "letterbox.h"
+#include "nhwc2nchw.h"
+#include "tasks.h"
+
+using namespace std;
+using namespace cv;
+
+static const float kMeans[3] = {0.f, 0.f, 0.f};
+static const float kStds[3]  = {1.f, 1.f, 1.f};
+
+static Mat randomImage(int width, int height, int seed) {
+    // smooth gradients with noise, so resize weights matter
+    mt19937 rng(seed);
+    uniform_int_distribution<int> noise(0, 40);
+    Mat img(height, width, CV_8UC3);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            uint8_t* p = img.data + (y * width + x) * 3;
+            p[0] = static_cast<uint8_t>((x * 200 / width) + noise(rng));
+            p[1] = static_cast<uint8_t>((y * 200 / height) + noise(rng));
+            p[2] = static_cast<uint8_t>(((x + y) * 100 / (width + height)) * 2 + noise(rng));
+        }
+    }
+    return img;
+}
+
+// resize path of Task::prepareInputs on host
+static void resizePath(const Mat& img, int width, int height, bool padding, const NormalizeLut& lut, float* dst,
+                       ImageTransform* transform) {
+    Mat resized = Task::resizeImage(img, width, height, padding, transform);
+    NHWC2NCHW_lut(resized.data, dst, 1, height, width, lut);
+}
+
+// largest difference in uint8 levels, with unit stds and 255 formats a level is 1
+static float maxLevelDiff(const vector<float>& a, const vector<float>& b) {
+    float diff = 0.f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        diff = std::isnan(a[i]) ? INFINITY : max(diff, fabsf(a[i] - b[i]));
+    }
+    return diff;
+}
+
+static bool sameTransform(const ImageTransform& a, const ImageTransform& b) {
+    return a.src_w == b.src_w && a.src_h == b.src_h && a.dst_w == b.dst_w && a.dst_h == b.dst_h &&
+           a.scale_x == b.scale_x && a.scale_y == b.scale_y && a.pad_x == b.pad_x && a.pad_y == b.pad_y &&
+           a.resized_w == b.resized_w && a.resized_h == b.resized_h;
+}
+
+static bool checkFused(bool on_device) {
+    NormalizeLut lut;
+    makeNormalizeLut(lut, kMeans[0], kMeans[1], kMeans[2], kStds[0], kStds[1], kStds[2], ImageFormat::kRGB255);
+    const int cases[][4] = {{1920, 1080, 640, 640}, {1280, 720, 640, 384}, {37, 53, 64, 64}, {333, 201, 96, 160},
+                            {320, 240, 640, 640}, {640, 640, 640, 640}, {1000, 20, 128, 128}};
+    bool ok = true;
+    for (const auto& c : cases) {
+        Mat img = randomImage(c[0], c[1], c[0] + c[1]);
+        for (bool padding : {true, false}) {
+            size_t count = static_cast<size_t>(3) * c[2] * c[3];
+            vector<float> expected(count), actual(count, NAN);
+            ImageTransform t_expected;
+            resizePath(img, c[2], c[3], padding, lut, expected.data(), &t_expected);
+            ImageTransform t = letterboxTransform(c[0], c[1], c[2], c[3], padding);
+            if (!on_device) {
+                letterboxNormalize_cpu(img.data, c[0] * 3, t, actual.data(), lut, 114, 3);
+            } else {
+#ifndef CPU_ONLY
+                uint8_t* src = nullptr;
+                float* dst = nullptr;
+                CUDA_CHECK(cudaMalloc((void**)&src, img.cols * img.rows * 3));
+                CUDA_CHECK(cudaMalloc((void**)&dst, count * sizeof(float)));
+                CUDA_CHECK(cudaMemcpy(src, img.data, img.cols * img.rows * 3, cudaMemcpyHostToDevice));
+                letterboxNormalize(src, c[0] * 3, t, dst, lut);
+                CUDA_CHECK(cudaMemcpy(actual.data(), dst, count * sizeof(float), cudaMemcpyDeviceToHost));
+                CUDA_CHECK(cudaFree(src));
+                CUDA_CHECK(cudaFree(dst));
+#endif
+            }
+            float diff = maxLevelDiff(actual, expected);
+            bool same = diff <= 1.f && sameTransform(t, t_expected);
+            if (!same) {
+                cerr << (on_device ? "device " : "host ") << c[0] << "x" << c[1] << " to " << c[2] << "x" << c[3]
+                     << (padding ? " letterbox" : " stretch") << ": max diff " << diff << " levels" << endl;
+            }
+            ok = ok && same;
+        }
+    }
+    cout << (on_device ? "device" : "host") << " fused preprocessing " << (ok ? "matches" : "MISMATCHES")
+         << " resize path within one level" << endl;
+    return ok;
+}
+
+static double timeMs(const function<void()>& run, int runs) {
+    run();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        run();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+}
+
+static void benchPaths(int runs, int width, int height, int threads, bool on_device) {
+    NormalizeLut lut;
+    makeNormalizeLut(lut, 0.f, 0.f, 0.f, 1.f, 1.f, 1.f, ImageFormat::kRGB);
+    const int sizes[][2] = {{1920, 1080}, {1280, 720}, {640, 480}};
+    cout << (on_device ? "device" : "host") << " input " << width << "x" << height << endl;
+    cout << "source\t\tresize path ms\tfused ms\tspeedup" << endl;
+    vector<float> host_dst(static_cast<size_t>(3) * width * height);
+    for (const auto& size : sizes) {
+        Mat img = randomImage(size[0], size[1], 3);
+        double resize_ms, fused_ms;
+        if (!on_device) {
+            resize_ms = timeMs([&]() {
+                Mat resized = Task::resizeImage(img, width, height, true);
+                NHWC2NCHW_lut(resized.data, host_dst.data(), 1, height, width, lut, threads);
+            }, runs);
+            fused_ms = timeMs([&]() {
+                ImageTransform t = letterboxTransform(img.cols, img.rows, width, height, true);
+                letterboxNormalize_cpu(img.data, img.cols * 3, t, host_dst.data(), lut, 114, threads);
+            }, runs);
+        } else {
+#ifndef CPU_ONLY
+            uint8_t* staging = nullptr;
+            uint8_t* src = nullptr;
+            float* dst = nullptr;
+            CUDA_CHECK(cudaMalloc((void**)&staging, 3 * width * height));
+            CUDA_CHECK(cudaMalloc((void**)&src, img.cols * img.rows * 3));
+            CUDA_CHECK(cudaMalloc((void**)&dst, host_dst.size() * sizeof(float)));
+            resize_ms = timeMs([&]() {
+                Mat resized = Task::resizeImage(img, width, height, true);
+                CUDA_CHECK(cudaMemcpy(staging, resized.data, 3 * width * height, cudaMemcpyHostToDevice));
+                NHWC2NCHW(staging, dst, 1, height, width, 0.f, 0.f, 0.f, 1.f, 1.f, 1.f, ImageFormat::kRGB);
+                CUDA_CHECK(cudaDeviceSynchronize());
+            }, runs);
+            fused_ms = timeMs([&]() {
+                ImageTransform t = letterboxTransform(img.cols, img.rows, width, height, true);
+                CUDA_CHECK(cudaMemcpy(src, img.data, img.cols * img.rows * 3, cudaMemcpyHostToDevice));
+                letterboxNormalize(src, img.cols * 3, t, dst, lut);
+                CUDA_CHECK(cudaDeviceSynchronize());
+            }, runs);
+            CUDA_CHECK(cudaFree(staging));
+            CUDA_CHECK(cudaFree(src));
+            CUDA_CHECK(cudaFree(dst));
+#endif
+        }
+        cout << size[0] << "x" << size[1] << "\t" << resize_ms << "\t\t" << fused_ms << "\t\t" << resize_ms / fused_ms << endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    int runs    = argc > 1 ? stoi(argv[1]) : 50;
+    int width   = argc > 2 ? stoi(argv[2]) : 640;
+    int height  = argc > 3 ? stoi(argv[3]) : 640;
+    int threads = argc > 4 ? stoi(argv[4]) : 1;
+
+    bool ok = checkFused(false);
+    benchPaths(runs, width, height, threads, false);
+#ifndef CPU_ONLY
+    int devices = 0;
+    if (cudaGetDeviceCount(&devices) == cudaSuccess && devices > 0) {
+        ok = checkFused(true) && ok;
+        benchPaths(runs, width, height, threads, true);
+    } else {
+        cout << "No GPU found, skip device path." << endl;
+    }
+#endif
+    if (!ok) cerr << "Fused preprocessing mismatch!" << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+/**
+ * YOLOv5 on small crops with mosaic packing against one crop per input.
+ * Checks packMosaic places every crop once inside a canvas with gaps between
+ * tiles, splitMosaic maps boxes inside a tile to its image and drops boxes
+ * crossing tiles, and, on host backend, that a detection at center of every
+ * tile of every canvas comes back as one box at center of its crop. Then
+ * prints forwards and images/s of both modes, `forward ms` stands in for
+ * inference of host backend(TensorRT backends run the engine of yaml).
+ * Usage: ./bench_mosaic <yolov5 yaml> [runs] [crop size] [crops] [forward ms]
+ * 2021/07/19
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mosaic.h"
+#include "yolov5.h"
+#include "yaml-cpp/yaml.h"
+
+using namespace std;
+using namespace cv;
+
+static bool checkPacking(int width, int height, int gap) {
+    mt19937 rng(11);
+    uniform_int_distribution<int> side(24, 320);
+    vector<Mat> crops;
+    vector<ImageView> views;
+    for (int i = 0; i < 200; ++i) {
+        crops.emplace_back(side(rng), side(rng), CV_8UC3);
+        views.emplace_back(crops.back().data, static_cast<int>(crops.back().step[0]), crops.back().cols, crops.back().rows);
+    }
+    vector<vector<MosaicTile>> canvases = packMosaic(views, width, height, gap);
+    vector<int> packed(views.size(), 0);
+    long area = 0;
+    bool ok = true;
+    for (const auto& canvas : canvases) {
+        for (size_t a = 0; a < canvas.size(); ++a) {
+            const ImageTransform& t = canvas[a].transform;
+            packed[canvas[a].image]++;
+            area += static_cast<long>(t.resized_w) * t.resized_h;
+            ok = ok && t.pad_x >= 0 && t.pad_y >= 0 && t.pad_x + t.resized_w <= width && t.pad_y + t.resized_h <= height;
+            ok = ok && t.resized_w == views[canvas[a].image].cols() && t.resized_h == views[canvas[a].image].rows();
+            for (size_t b = a + 1; b < canvas.size(); ++b) {
+                const ImageTransform& o = canvas[b].transform;
+                bool apart = t.pad_x + t.resized_w + gap <= o.pad_x || o.pad_x + o.resized_w + gap <= t.pad_x ||
+                             t.pad_y + t.resized_h + gap <= o.pad_y || o.pad_y + o.resized_h + gap <= t.pad_y;
+                ok = ok && apart;
+            }
+        }
+    }
+    ok = ok && all_of(packed.begin(), packed.end(), [](int n) { return n == 1; });
+    cout << views.size() << " crops of 24..320 packed into " << canvases.size() << " canvases, "
+         << 100.0 * area / (static_cast<double>(width) * height * canvases.size()) << "% filled, packing "
+         << (ok ? "valid" : "INVALID") << endl;
+    return ok;
+}
+
+static Bbox makeBox(float x1, float y1, float x2, float y2) {
+    Bbox box = {};
+    box.xmin = x1;
+    box.ymin = y1;
+    box.xmax = x2;
+    box.ymax = y2;
+    box.score = 0.9f;
+    return box;
+}
+
+static bool checkSplit() {
+    // tiles 200x100 and 100x100 on one shelf, second view is a roi at (30, 40)
+    Mat a(100, 200, CV_8UC3), b(300, 300, CV_8UC3);
+    vector<ImageView> views = {ImageView(a.data, static_cast<int>(a.step[0]), a.cols, a.rows),
+                               ImageView(b.data, static_cast<int>(b.step[0]), b.cols, b.rows).crop(30, 40, 100, 100)};
+    vector<MosaicTile> tiles = packMosaic(views, 640, 640, 8)[0];
+    vector<Bbox> boxes = {
+            makeBox(10, 10, 50, 60),     // inside first tile
+            makeBox(190, 20, 240, 60),   // across both tiles, dropped
+            makeBox(220, 10, 250, 50),   // inside second tile, at x 208
+            makeBox(180, 70, 204, 104),  // reaches into gap and below tile, clipped
+            makeBox(400, 10, 420, 30),   // no tile, dropped
+    };
+    vector<vector<Bbox>> split = splitMosaic(boxes, tiles);
+    bool ok = split.size() == 2 && split[0].size() == 2 && split[1].size() == 1;
+    if (ok) {
+        const Bbox& first = split[0][0];
+        const Bbox& clipped = split[0][1];
+        const Bbox& second = split[1][0];
+        ok = first.xmin == 10 && first.ymin == 10 && first.xmax == 50 && first.ymax == 60;
+        ok = ok && clipped.xmin == 180 && clipped.xmax == 200 && clipped.ymax == 100;
+        ok = ok && second.xmin == 30 + 12 && second.ymin == 40 + 10 && second.xmax == 30 + 42 && second.ymax == 40 + 50;
+    }
+    cout << "boxes of canvas " << (ok ? "split" : "MISSPLIT") << " to tiles" << endl;
+    return ok;
+}
+
+// host forward writes one detection at center of every region of every image of batch
+struct CenterForward {
+    int output = 1;  // stride 8 output, anchor 0 of it
+    vector<vector<Rect>> regions;  // of inputs in order of forwards
+    size_t next = 0;
+    double forward_ms = 0.0;
+
+    void operator()(HostEngine& engine) {
+        if (forward_ms > 0) this_thread::sleep_for(chrono::duration<double, milli>(forward_ms));
+        for (int i = 1; i < engine.GetNbBindings(); ++i) {
+            float* out = static_cast<float*>(engine.GetBindingPtr(i));
+            fill(out, out + engine.GetBindingSize(i) / sizeof(float), -10.f);
+        }
+        nvinfer1::Dims dims = engine.GetBindingDims(output);
+        int grid_h = dims.d[2], grid_w = dims.d[3], channels = dims.d[4];
+        size_t image = static_cast<size_t>(dims.d[1]) * grid_h * grid_w * channels;
+        float* out = static_cast<float*>(engine.GetBindingPtr(output));
+        for (int b = 0; b < engine.GetBatchSize() && next < regions.size(); ++b, ++next) {
+            for (const Rect& r : regions[next]) {
+                int gx = (r.x + r.width / 2) / 8;
+                int gy = (r.y + r.height / 2) / 8;
+                // center of cell, 10x13 box of anchor 0
+                float* p = out + b * image + (static_cast<size_t>(gy) * grid_w + gx) * channels;
+                p[0] = p[1] = p[2] = p[3] = 0.f;
+                p[4] = p[5] = 10.f;
+            }
+        }
+    }
+};
+
+// one box per image, centered on crop within a cell of stride 8 and rounding of letterbox
+static bool checkResults(const BatchBox& results, const vector<Mat>& crops, float tolerance) {
+    bool ok = results.size() == crops.size();
+    for (size_t i = 0; ok && i < results.size(); ++i) {
+        ok = results[i].size() == 1;
+        if (!ok) break;
+        float cx = (results[i][0][0] + results[i][0][2]) / 2;
+        float cy = (results[i][0][1] + results[i][0][3]) / 2;
+        ok = fabs(cx - crops[i].cols / 2.f) <= tolerance && fabs(cy - crops[i].rows / 2.f) <= tolerance;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <yolov5 yaml> [runs] [crop size] [crops] [forward ms]" << endl;
+        return -1;
+    }
+    YAML::Node cfg = YAML::LoadFile(argv[1]);
+    int runs = argc > 2 ? stoi(argv[2]) : 20;
+    int crop = argc > 3 ? stoi(argv[3]) : 128;
+    int count = argc > 4 ? stoi(argv[4]) : 64;
+    double forward_ms = argc > 5 ? stod(argv[5]) : 0.0;
+
+    vector<int> bchw = cfg["engine"]["bchw"].as<vector<int>>();
+    int batch = bchw[0], height = bchw[2], width = bchw[3];
+    int gap = cfg["params"]["mosaic_gap"] ? cfg["params"]["mosaic_gap"].as<int>() : 8;
+    bool ok = checkPacking(width, height, gap);
+    ok = checkSplit() && ok;
+
+    cfg["misc"]["show_time"] = false;
+    cfg["params"]["mosaic"] = false;
+    YOLOV5 single(cfg);
+    cfg["params"]["mosaic"] = true;
+    cfg["params"]["mosaic_max_tile"] = max(crop, width / 2);
+    YOLOV5 mosaic(cfg);
+
+    mt19937 rng(5);
+    uniform_int_distribution<int> side(crop / 2, crop);
+    vector<Mat> crops;
+    vector<ImageView> views;
+    for (int i = 0; i < count; ++i) {
+        crops.emplace_back(side(rng), side(rng), CV_8UC3);
+        Mat& img = crops.back();
+        for (int y = 0; y < img.rows; ++y) {
+            for (int x = 0; x < img.cols * 3; ++x) {
+                img.data[y * img.step[0] + x] = static_cast<uint8_t>(rng());
+            }
+        }
+        views.emplace_back(crops.back().data, static_cast<int>(crops.back().step[0]), crops.back().cols, crops.back().rows);
+    }
+    // regions a forward sees, every crop letterboxed to whole input or tiles of canvases
+    vector<Rect> letterboxed;
+    for (const auto& view : views) {
+        ImageTransform t = letterboxTransform(view.cols(), view.rows(), width, height, cfg["params"]["padding"].as<bool>());
+        letterboxed.emplace_back(t.pad_x, t.pad_y, t.resized_w, t.resized_h);
+    }
+    vector<vector<MosaicTile>> canvases = packMosaic(views, width, height, gap);
+    CenterForward single_forward, mosaic_forward;
+    single_forward.output = mosaic_forward.output = cfg["params"]["output_index"] ? cfg["params"]["output_index"][0].as<int>() : 1;
+    single_forward.forward_ms = mosaic_forward.forward_ms = forward_ms;
+    for (const Rect& r : letterboxed) {
+        single_forward.regions.push_back({r});
+    }
+    for (const auto& canvas : canvases) {
+        vector<Rect> regions;
+        for (const auto& tile : canvas) {
+            const ImageTransform& t = tile.transform;
+            regions.emplace_back(t.pad_x, t.pad_y, t.resized_w, t.resized_h);
+        }
+        mosaic_forward.regions.push_back(regions);
+    }
+    bool host = single.setHostForward([&](HostEngine& engine) { single_forward(engine); }) &&
+                mosaic.setHostForward([&](HostEngine& engine) { mosaic_forward(engine); });
+
+    auto runSingle = [&]() {
+        BatchBox results;
+        single_forward.next = 0;
+        for (size_t first = 0; first < views.size(); first += batch) {
+            size_t last = min(first + batch, views.size());
+            BatchBox boxes = single.run(vector<ImageView>(views.begin() + first, views.begin() + last));
+            results.insert(results.end(), boxes.begin(), boxes.end());
+        }
+        return results;
+    };
+    auto runMosaic = [&]() {
+        mosaic_forward.next = 0;
+        return mosaic.run(views);
+    };
+    if (host) {
+        // letterbox scales crops up, cell of stride 8 is up to 8 / scale away in crop
+        float scale = min(static_cast<float>(width) / crop, static_cast<float>(height) / crop);
+        bool same = checkResults(runSingle(), crops, 8.f / scale + 2.f) && checkResults(runMosaic(), crops, 8.f);
+        cout << "one detection per tile " << (same ? "maps" : "DOES NOT map") << " to center of its crop" << endl;
+        ok = ok && same;
+    }
+
+    auto timeRuns = [&](const function<BatchBox()>& run) {
+        run();
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < runs; ++r) {
+            run();
+        }
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+    };
+    double single_ms = timeRuns(runSingle);
+    double mosaic_ms = timeRuns(runMosaic);
+    int single_forwards = (count + batch - 1) / batch;
+    int mosaic_forwards = (static_cast<int>(canvases.size()) + batch - 1) / batch;
+    cout << count << " crops of " << crop / 2 << ".." << crop << " to " << width << "x" << height << ", batch " << batch
+         << ", " << runs << " runs" << endl;
+    cout << "mode\t\tforwards\tms\t\timages/s" << endl;
+    cout << "letterbox\t" << single_forwards << "\t\t" << single_ms << "\t\t" << 1000.0 * count / single_ms << endl;
+    cout << "mosaic\t\t" << mosaic_forwards << "\t\t" << mosaic_ms << "\t\t" << 1000.0 * count / mosaic_ms << endl;
+    cout << "speedup " << single_ms / mosaic_ms << endl;
+    if (!ok) cerr << "Mosaic packing mismatch!" << endl;
+    return ok ? 0 : 1;
+}
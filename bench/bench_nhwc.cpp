@@ -0,0 +1,129 @@
+/**
+ * Host normalization of input images, NHWC uint8 to NCHW float.
+ * Checks NHWC2NCHW_lut is bit exact to its tables and close to the per pixel
+ * subtract and divide loop for all image formats on sizes not a multiple of
+ * vector width, then times both at
+ * 640x640(yolov5), 1632x480(f_track) and 1024x1024(semseg) on 1 thread and on
+ * given threads.
+ * Usage: ./bench_nhwc [runs] [batch] [threads]
+ * 2021/05/24
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nhwc2nchw_cpu.h"
+
+using namespace std;
+
+static float kMeans[3] = {0.485f, 0.456f, 0.406f};
+static float kStds[3]  = {0.229f, 0.224f, 0.225f};
+
+// scalar baseline, NHWC2NCHW_cpu before lookup tables, means and stds are not constants there
+static void referenceNHWC2NCHW(const uint8_t* input, float* output, int n, int h, int w,
+                               const float* means, const float* stds, ImageFormat format) {
+    int stride = h * w;
+    float scale_factor = 1.f;
+    if (format == ImageFormat::kRGB || format == ImageFormat::kBGR) scale_factor = 1.f / 255.f;
+    bool keep_order = format == ImageFormat::kBGR || format == ImageFormat::kBGR255;
+    int c0 = keep_order ? 0 : 2;
+    int c2 = keep_order ? 2 : 0;
+    for (int pn = 0; pn < n; ++pn) {
+        const uint8_t* ip = input + pn * stride * 3;
+        float* op = output + pn * stride * 3;
+        for (int pos = 0; pos < stride; ++pos, ip += 3) {
+            op[pos]              = ((float)ip[c0] * scale_factor - means[0]) / stds[0];
+            op[pos + stride]     = ((float)ip[1] * scale_factor - means[1]) / stds[1];
+            op[pos + 2 * stride] = ((float)ip[c2] * scale_factor - means[2]) / stds[2];
+        }
+    }
+}
+
+static vector<uint8_t> randomImages(int n, int h, int w) {
+    mt19937 rng(5);
+    uniform_int_distribution<int> dist(0, 255);
+    vector<uint8_t> images(static_cast<size_t>(n) * h * w * 3);
+    for (auto& v : images) {
+        v = static_cast<uint8_t>(dist(rng));
+    }
+    return images;
+}
+
+// tables fuse multiply and subtract, so they may differ from the loop by an ulp
+static bool checkFormats() {
+    bool ok = true;
+    const ImageFormat formats[4] = {ImageFormat::kRGB, ImageFormat::kRGB255, ImageFormat::kBGR, ImageFormat::kBGR255};
+    const char* names[4] = {"rgb", "rgb255", "bgr", "bgr255"};
+    for (int f = 0; f < 4; ++f) {
+        float scale = formats[f] == ImageFormat::kRGB255 || formats[f] == ImageFormat::kBGR255 ? 255.f : 1.f;
+        NormalizeLut lut;
+        makeNormalizeLut(lut, kMeans[0], kMeans[1], kMeans[2], kStds[0], kStds[1], kStds[2], formats[f]);
+        int n = 3, h = 37, w = 53;
+        vector<uint8_t> images = randomImages(n, h, w);
+        vector<float> expected(images.size()), actual(images.size(), NAN);
+        referenceNHWC2NCHW(images.data(), expected.data(), n, h, w, kMeans, kStds, formats[f]);
+        for (int threads : {1, 4, 1000}) {
+            NHWC2NCHW_lut(images.data(), actual.data(), n, h, w, lut, threads);
+            float max_diff = 0.f;
+            int off_table = 0;
+            for (size_t i = 0; i < actual.size(); ++i) {
+                float diff = fabsf(actual[i] - expected[i]);
+                max_diff = std::isnan(diff) ? INFINITY : max(max_diff, diff);
+                size_t pixel = i % (h * w), c = i / (h * w) % 3, pn = i / (3 * h * w);
+                uint8_t v = images[(pn * h * w + pixel) * 3 + lut.source[c]];
+                if (memcmp(&actual[i], &lut.values[c][v], sizeof(float)) != 0) ++off_table;
+            }
+            bool same = max_diff <= 1e-6f * scale / kStds[0] && off_table == 0;
+            if (!same) {
+                cerr << names[f] << " on " << threads << " threads: max diff " << max_diff
+                     << ", " << off_table << " values off table" << endl;
+            }
+            ok = ok && same;
+        }
+    }
+    cout << "lookup on all formats " << (ok ? "matches" : "MISMATCHES") << " per pixel loop" << endl;
+    return ok;
+}
+
+static double timeMs(const function<void()>& convert, int runs) {
+    convert();  // warm up, touches output pages
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        convert();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+}
+
+int main(int argc, char** argv) {
+    int runs    = argc > 1 ? stoi(argv[1]) : 50;
+    int batch   = argc > 2 ? stoi(argv[2]) : 1;
+    int threads = argc > 3 ? stoi(argv[3]) : max(1u, thread::hardware_concurrency());
+
+    cout << "lookup built with: " << nhwc2nchwIsa() << endl;
+    bool ok = checkFormats();
+
+    NormalizeLut lut;
+    makeNormalizeLut(lut, kMeans[0], kMeans[1], kMeans[2], kStds[0], kStds[1], kStds[2], ImageFormat::kRGB);
+    const int sizes[3][2] = {{640, 640}, {1632, 480}, {1024, 1024}};
+    cout << "w x h x batch\tloop ms\t\tlut ms\t\tlut " << threads << " threads ms\tspeedup\tMpixel/s" << endl;
+    for (const auto& size : sizes) {
+        int w = size[0], h = size[1];
+        vector<uint8_t> images = randomImages(batch, h, w);
+        vector<float> output(images.size());
+        double loop = timeMs([&]() { referenceNHWC2NCHW(images.data(), output.data(), batch, h, w, kMeans, kStds, ImageFormat::kRGB); }, runs);
+        double single = timeMs([&]() { NHWC2NCHW_lut(images.data(), output.data(), batch, h, w, lut, 1); }, runs);
+        double multi = timeMs([&]() { NHWC2NCHW_lut(images.data(), output.data(), batch, h, w, lut, threads); }, runs);
+        double best = min(single, multi);
+        cout << w << " x " << h << " x " << batch << "\t" << loop << "\t\t" << single << "\t\t" << multi
+             << "\t\t" << loop / best << "\t" << static_cast<double>(batch) * w * h / best / 1e3 << endl;
+    }
+    if (!ok) cerr << "Lookup normalization mismatch!" << endl;
+    return ok ? 0 : 1;
+}
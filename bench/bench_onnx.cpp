@@ -0,0 +1,109 @@
+/**
+ * Onnx reader speed and self check, without GPU.
+ * Encodes a small model(opset, weights listed as inputs, dynamic batch and
+ * outputs) in protobuf wire format and checks what is read back, then reads
+ * given onnx files and prints their inputs, outputs and read time.
+ * Usage: ./bench_onnx [onnx files...]
+ * 2021/03/29
+ */
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "onnx_info.h"
+
+using namespace std;
+
+static string varint(uint64_t value) {
+    string out;
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+    return out;
+}
+
+static string field(uint32_t number, uint64_t value) {
+    return varint(number << 3) + varint(value);
+}
+
+static string field(uint32_t number, const string& bytes) {
+    return varint((number << 3) | 2) + varint(bytes.size()) + bytes;
+}
+
+static string valueInfo(const string& name, const vector<int64_t>& dims) {
+    string shape;
+    for (int64_t d : dims) {
+        shape += field(1, d < 0 ? field(2, string("batch")) : field(1, static_cast<uint64_t>(d)));
+    }
+    string tensor = field(1, static_cast<uint64_t>(1)) + field(2, shape);
+    return field(1, name) + field(2, field(1, tensor));
+}
+
+static bool selfCheck() {
+    string graph = field(1, field(4, string("Conv")))                     // node, skipped
+                   + field(5, field(1, static_cast<uint64_t>(16)) + field(8, string("conv.weight")) + field(9, string(64, '\0')))
+                   + field(11, valueInfo("images", {-1, 3, 640, 640}))
+                   + field(11, valueInfo("conv.weight", {16, 3, 3, 3}))
+                   + field(12, valueInfo("output_8", {-1, 3, 80, 80, 85}))
+                   + field(12, valueInfo("output_16", {-1, 3, 40, 40, 85}))
+                   + field(12, valueInfo("reid", {-1, 128}));
+    string model = field(1, static_cast<uint64_t>(6))
+                   + field(2, string("pytorch"))
+                   + field(7, graph)
+                   + field(8, field(1, string("ai.onnx.ml")) + field(2, static_cast<uint64_t>(2)))
+                   + field(8, field(2, static_cast<uint64_t>(11)));
+    const string file = "bench_onnx.onnx";
+    FILE* fp = fopen(file.c_str(), "wb");
+    fwrite(model.data(), 1, model.size(), fp);
+    fclose(fp);
+
+    OnnxModelInfo info;
+    bool ok = readOnnxInfo(file, info)
+              && info.ir_version == 6 && info.opset == 11
+              && info.inputs.size() == 1 && info.inputs[0].name == "images"
+              && dimsString(info.inputs[0].dims) == "?x3x640x640"
+              && info.outputs.size() == 3 && info.outputs[2].name == "reid"
+              && dimsString(info.outputs[0].dims) == "?x3x80x80x85";
+    vector<string> names;
+    for (const auto& output : info.outputs) {
+        names.emplace_back(output.name);
+    }
+    vector<int> index;
+    ok = ok && matchNames(names, {"reid", "output_*"}, 1, index) && index == vector<int>({3, 1, 2});
+    ok = ok && !matchNames(names, {"output_32"}, 1, index);
+
+    // truncated model is rejected instead of read past end
+    fp = fopen(file.c_str(), "wb");
+    fwrite(model.data(), 1, model.size() / 2, fp);
+    fclose(fp);
+    ok = ok && !readOnnxInfo(file, info);
+    remove(file.c_str());
+    cout << "self check: " << (ok ? "ok" : "failed") << endl;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    bool ok = selfCheck();
+    for (int i = 1; i < argc; ++i) {
+        OnnxModelInfo info;
+        auto start = chrono::steady_clock::now();
+        if (!readOnnxInfo(argv[i], info)) {
+            cerr << "Read onnx failed: " << argv[i] << endl;
+            ok = false;
+            continue;
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << argv[i] << ": ir " << info.ir_version << ", opset " << info.opset << ", read in " << ms << " ms" << endl;
+        for (const auto& input : info.inputs) {
+            cout << "  input  " << input.name << " " << dimsString(input.dims) << endl;
+        }
+        for (size_t o = 0; o < info.outputs.size(); ++o) {
+            cout << "  output " << o + info.inputs.size() << " " << info.outputs[o].name << " " << dimsString(info.outputs[o].dims) << endl;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+/**
+ * Decoding of half and int8 output bindings.
+ * Checks halfToFloat on all 65536 halves against ldexp, floatToHalf round trip
+ * and rounding, and int8ToFloat, then times copyBindingToHost of float, half
+ * and int8 bindings of same element count, in host memory and in device
+ * memory if a GPU is found, as post process reads outputs.
+ * Usage: ./bench_outputs [runs] [elements, default outputs of yolov5s 640x640]
+ * 2021/05/10
+ */
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "binding_convert.h"
+#include "utils.h"
+
+using namespace std;
+
+// IEEE half by its fields, independent of bit tricks in binding_convert.cpp
+static float halfReference(uint16_t h) {
+    int sign = h >> 15;
+    int exp  = (h >> 10) & 0x1f;
+    int mant = h & 0x3ff;
+    float value;
+    if (exp == 0x1f) {
+        value = mant == 0 ? INFINITY : NAN;
+    } else if (exp == 0) {
+        value = ldexpf(static_cast<float>(mant), -24);
+    } else {
+        value = ldexpf(static_cast<float>(mant + 1024), exp - 25);
+    }
+    return sign ? -value : value;
+}
+
+static bool checkConversions() {
+    bool ok = true;
+    // every half, count is not a multiple of vector width so tail runs too
+    vector<uint16_t> halves(65536 + 3);
+    for (size_t i = 0; i < halves.size(); ++i) {
+        halves[i] = static_cast<uint16_t>(i);
+    }
+    vector<float> floats(halves.size());
+    halfToFloat(halves.data(), floats.data(), halves.size());
+    int mismatch = 0;
+    for (size_t i = 0; i < halves.size(); ++i) {
+        float ref = halfReference(halves[i]);
+        bool same = std::isnan(ref) ? std::isnan(floats[i]) : memcmp(&ref, &floats[i], sizeof(float)) == 0;
+        if (!same) ++mismatch;
+    }
+    cout << "halfToFloat: " << mismatch << " of " << halves.size() << " halves mismatch" << endl;
+    ok = ok && mismatch == 0;
+
+    // half -> float -> half is exact for all but nan payloads
+    vector<uint16_t> back(halves.size());
+    floatToHalf(floats.data(), back.data(), floats.size());
+    mismatch = 0;
+    for (size_t i = 0; i < halves.size(); ++i) {
+        bool nan = ((halves[i] >> 10) & 0x1f) == 0x1f && (halves[i] & 0x3ff) != 0;
+        if (nan ? (back[i] & 0x7c00) != 0x7c00 || (back[i] & 0x3ff) == 0 : back[i] != halves[i]) ++mismatch;
+    }
+    cout << "floatToHalf round trip: " << mismatch << " mismatch" << endl;
+    ok = ok && mismatch == 0;
+
+    // random floats round to nearest half: error at most half a unit in last place
+    mt19937 rng(7);
+    uniform_real_distribution<float> dist(-70000.f, 70000.f);
+    vector<float> values(100003);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = dist(rng) * powf(2.f, -static_cast<float>(i % 40));
+    }
+    vector<uint16_t> rounded(values.size());
+    floatToHalf(values.data(), rounded.data(), values.size());
+    vector<float> widened(values.size());
+    halfToFloat(rounded.data(), widened.data(), values.size());
+    mismatch = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        float v = fabsf(values[i]);
+        if (v >= 65520.f) {
+            if (!std::isinf(widened[i])) ++mismatch;
+            continue;
+        }
+        // unit in last place of half: 2^-24 for subnormals, 2^(e-10) for normals
+        int e = v < ldexpf(1.f, -14) ? -14 : ilogbf(v);
+        float ulp = ldexpf(1.f, e - 10);
+        if (fabsf(widened[i] - values[i]) > 0.5f * ulp) ++mismatch;
+    }
+    cout << "floatToHalf rounding: " << mismatch << " of " << values.size() << " values off by more than 0.5 ulp" << endl;
+    ok = ok && mismatch == 0;
+
+    vector<int8_t> quantized(259);
+    for (size_t i = 0; i < quantized.size(); ++i) {
+        quantized[i] = static_cast<int8_t>(static_cast<int>(i) - 128);
+    }
+    vector<float> dequantized(quantized.size());
+    float scale = 6.f / 127.f;
+    int8ToFloat(quantized.data(), dequantized.data(), quantized.size(), scale);
+    mismatch = 0;
+    for (size_t i = 0; i < quantized.size(); ++i) {
+        if (dequantized[i] != static_cast<float>(quantized[i]) * scale) ++mismatch;
+    }
+    cout << "int8ToFloat: " << mismatch << " mismatch" << endl;
+    return ok && mismatch == 0;
+}
+
+static const char* typeName(nvinfer1::DataType dtype) {
+    switch (dtype) {
+        case nvinfer1::DataType::kHALF: return "half";
+        case nvinfer1::DataType::kINT8: return "int8";
+        default: return "float";
+    }
+}
+
+// mean ms of copyBindingToHost of whole binding
+static double timeCopy(const BindingView& binding, size_t count, int runs) {
+    vector<float> dst(count);
+    copyBindingToHost(dst.data(), binding, 0, count);  // warm up, grows staging buffer
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        copyBindingToHost(dst.data(), binding, 0, count);
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+}
+
+static void benchCopies(size_t count, int runs, bool on_device) {
+    mt19937 rng(11);
+    uniform_real_distribution<float> dist(-8.f, 8.f);
+    vector<float> values(count);
+    for (auto& v : values) {
+        v = dist(rng);
+    }
+    vector<uint16_t> halves(count);
+    floatToHalf(values.data(), halves.data(), count);
+    vector<int8_t> quantized(count);
+    for (size_t i = 0; i < count; ++i) {
+        quantized[i] = static_cast<int8_t>(lrintf(values[i] * 127.f / 8.f));
+    }
+    struct Host { nvinfer1::DataType dtype; const void* data; };
+    vector<Host> hosts = {{nvinfer1::DataType::kFLOAT, values.data()},
+                          {nvinfer1::DataType::kHALF, halves.data()},
+                          {nvinfer1::DataType::kINT8, quantized.data()}};
+
+    cout << (on_device ? "device" : "host") << " binding of " << count << " elements" << endl;
+    cout << "type\tbytes\t\tms\t\tGB/s of float" << endl;
+    for (const auto& host : hosts) {
+        size_t bytes = count * getElementSize(host.dtype);
+        BindingView binding;
+        binding.dtype     = host.dtype;
+        binding.scale     = 8.f / 127.f;
+        binding.on_device = on_device;
+        binding.ptr       = host.data;
+#ifndef CPU_ONLY
+        void* device = nullptr;
+        if (on_device) {
+            CUDA_CHECK(cudaMalloc(&device, bytes));
+            CUDA_CHECK(cudaMemcpy(device, host.data, bytes, cudaMemcpyHostToDevice));
+            binding.ptr = device;
+        }
+#endif
+        double ms = timeCopy(binding, count, runs);
+        cout << typeName(host.dtype) << "\t" << bytes << "\t\t" << ms << "\t\t" << count * sizeof(float) / ms / 1e6 << endl;
+#ifndef CPU_ONLY
+        if (device) CUDA_CHECK(cudaFree(device));
+#endif
+    }
+}
+
+int main(int argc, char** argv) {
+    int runs = argc > 1 ? stoi(argv[1]) : 50;
+    // 3 anchors x 85 channels on 80x80, 40x40 and 20x20 grids
+    size_t count = argc > 2 ? stoul(argv[2]) : 3 * 85 * (80 * 80 + 40 * 40 + 20 * 20);
+
+    cout << "conversions built with: " << bindingConvertIsa() << endl;
+    bool ok = checkConversions();
+    benchCopies(count, runs, false);
+#ifndef CPU_ONLY
+    int devices = 0;
+    if (cudaGetDeviceCount(&devices) == cudaSuccess && devices > 0) {
+        benchCopies(count, runs, true);
+    } else {
+        cout << "No GPU found, skip device bindings." << endl;
+    }
+#endif
+    if (!ok) cerr << "Output conversions mismatch!" << endl;
+    return ok ? 0 : 1;
+}
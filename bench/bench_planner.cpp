@@ -0,0 +1,169 @@
+/**
+ * Memory planner of scratch buffers across tasks.
+ * Plans random buffer sets, allocates them from a counting host allocator and
+ * runs their steps in order: every live buffer is filled with its own pattern
+ * and all of them are checked after, so overlapping live buffers show up as
+ * corrupted patterns. Then plans scratch of tasks of main yaml as main.cpp runs
+ * them(one after another, or all at once with multithreading), without
+ * creating engines, and prints planned versus naive peak.
+ * Usage: ./bench_planner [main yaml] [random sets]
+ * 2021/05/17
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "det_post_processor.h"
+#include "memory_planner.h"
+#include "yaml-cpp/yaml.h"
+
+using namespace std;
+
+// run steps of plan on arena of a host allocator, false if a buffer was overwritten by another
+static bool runSteps(MemoryPlanner& planner, int steps) {
+    size_t allocated = 0;
+    int arenas = 0;
+    for (int device : planner.Devices()) {
+        planner.Allocate(device, [&](size_t size) -> void* {
+            allocated += size;
+            ++arenas;
+            return new uint8_t[size];
+        }, [](void* ptr) { delete[] static_cast<uint8_t*>(ptr); });
+    }
+    // devices of empty buffers only get no arena
+    size_t planned = 0;
+    int expected = 0;
+    for (int device : planner.Devices()) {
+        planned += planner.PlannedPeak(device);
+        if (planner.PlannedPeak(device) > 0) ++expected;
+    }
+    if (allocated != planned || arenas != expected) return false;
+
+    for (int step = 0; step < steps; ++step) {
+        vector<int> live;
+        for (int id = 0; id < planner.Size(); ++id) {
+            const ScratchRequest& r = planner.Request(id);
+            if (r.first <= step && step <= r.last) live.emplace_back(id);
+        }
+        for (int id : live) {
+            memset(planner.Ptr(id), id & 0xff, planner.Request(id).size);
+        }
+        for (int id : live) {
+            const uint8_t* data = static_cast<const uint8_t*>(planner.Ptr(id));
+            for (size_t i = 0; i < planner.Request(id).size; ++i) {
+                if (data[i] != (id & 0xff)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool checkRandomPlans(int sets) {
+    mt19937 rng(17);
+    bool ok = true;
+    double saved = 0.;
+    for (int set = 0; set < sets; ++set) {
+        int steps = uniform_int_distribution<int>(1, 8)(rng);
+        int count = uniform_int_distribution<int>(1, 40)(rng);
+        // fewer than 256 buffers, so patterns of live buffers differ
+        MemoryPlanner planner(uniform_int_distribution<int>(0, 1)(rng) ? 256 : 64);
+        for (int i = 0; i < count; ++i) {
+            ScratchRequest r;
+            r.owner  = "t" + to_string(i % 6);
+            r.name   = "b" + to_string(i);
+            r.size   = uniform_int_distribution<int>(0, 4)(rng) == 0 ? 0 : uniform_int_distribution<size_t>(1, 1 << 16)(rng);
+            r.first  = uniform_int_distribution<int>(0, steps - 1)(rng);
+            r.last   = uniform_int_distribution<int>(r.first, steps - 1)(rng);
+            r.device = uniform_int_distribution<int>(0, 3)(rng) == 0 ? 0 : kHostArena;
+            planner.Add(r);
+        }
+        planner.Plan();
+        bool valid = planner.Check();
+        for (int device : planner.Devices()) {
+            // at least the largest set of buffers live in one step, at most all of them
+            size_t bound = 0;
+            for (int step = 0; step < steps; ++step) {
+                size_t live = 0;
+                for (int id = 0; id < planner.Size(); ++id) {
+                    const ScratchRequest& r = planner.Request(id);
+                    if (r.device == device && r.first <= step && step <= r.last) live += r.size;
+                }
+                bound = max(bound, live);
+            }
+            valid = valid && planner.PlannedPeak(device) >= bound && planner.PlannedPeak(device) <= planner.NaivePeak(device);
+            saved += 1. - static_cast<double>(planner.PlannedPeak(device)) / max<size_t>(planner.NaivePeak(device), 1);
+        }
+        valid = valid && runSteps(planner, steps);
+        if (!valid) {
+            cerr << "Random plan " << set << " is invalid:" << endl;
+            planner.Report();
+            ok = false;
+        }
+    }
+    cout << sets << " random plans " << (ok ? "passed" : "FAILED") << ", mean saved " << 100. * saved / sets << "%" << endl;
+    return ok;
+}
+
+// scratch of tasks as Task::declareScratch declares it, from yaml only
+static void planTasks(const string& main_file) {
+    YAML::Node main_cfg = YAML::LoadFile(main_file);
+    bool multithreading = main_cfg["misc"]["multithreading"].as<bool>();
+    string dir = main_file.substr(0, main_file.find_last_of('/') + 1);
+    MemoryPlanner planner;
+    int step = 0;
+    for (const string name : {"cls", "semseg", "fcos", "yolo", "fairmot", "f_track"}) {
+        if (!main_cfg[name]) continue;
+        string cfg_file = main_cfg[name]["cfg_file"].as<string>();
+        YAML::Node cfg;
+        try {
+            cfg = YAML::LoadFile(cfg_file);
+        } catch (const YAML::Exception&) {
+            cfg = YAML::LoadFile(dir + cfg_file);  // relative to main yaml instead of working directory
+        }
+        const YAML::Node& engine = cfg["engine"];
+        vector<int> bchw = engine["bchw"].as<vector<int>>();
+        vector<vector<int>> sizes = {{bchw[2], bchw[3]}};
+        for (const auto& variant : engine["variants"]) {
+            sizes.emplace_back(variant["hw"].as<vector<int>>());
+        }
+        int pool_size = engine["pool_size"] ? engine["pool_size"].as<int>() : 1;
+        bool on_device = !engine["backend"] || engine["backend"].as<string>() == "tensorrt";
+        int s = multithreading ? 0 : step++;
+        for (const auto& hw : sizes) {
+            for (int i = 0; i < pool_size; ++i) {
+                ScratchRequest r;
+                r.owner  = name;
+                r.first  = s;
+                r.last   = s;
+                r.device = on_device ? engine["gpu_id"].as<int>() : kHostArena;
+                string suffix = to_string(hw[1]) + "x" + to_string(hw[0]) + "#" + to_string(i);
+                r.name = "in" + suffix;
+                r.size = static_cast<size_t>(bchw[0]) * 3 * hw[0] * hw[1];
+                planner.Add(r);
+                if (name == "fairmot") {
+                    r.name = "post" + suffix;
+                    r.size = DetPostProcessor::workspaceSize(bchw[0], hw[0] / 4, hw[1] / 4, 512, 32);
+                    planner.Add(r);
+                }
+            }
+        }
+    }
+    auto start = chrono::steady_clock::now();
+    planner.Plan();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Tasks of " << main_file << (multithreading ? ", all running together" : ", one after another")
+         << ", planned in " << ms << " ms" << endl;
+    planner.Report();
+}
+
+int main(int argc, char** argv) {
+    string main_file = argc > 1 ? argv[1] : "../cfgs/main.yaml";
+    int sets = argc > 2 ? stoi(argv[2]) : 500;
+    bool ok = checkRandomPlans(sets);
+    planTasks(main_file);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+/**
+ * Throughput of one task shared by concurrent callers.
+ * Starts threads calling run() of same task, every call checks out one of
+ * `engine: pool_size` execution states. Prints throughput and checks count of
+ * results, with `backend: "host"` it checks pool without GPU.
+ * Usage: ./bench_pool <cls/semseg/fcos/yolo/fairmot/f_track> <task yaml> <threads> [runs per thread]
+ * 2021/03/01
+ */
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+
+using namespace std;
+using namespace cv;
+
+template <typename T>
+static bool benchTask(YAML::Node cfg, int threads, int runs) {
+    cfg["misc"]["show_time"] = false;
+    T task(cfg);
+    vector<int> bchw = cfg["engine"]["bchw"].as<vector<int>>();
+    vector<Mat> imgs(bchw[0], benchImage(cfg));
+
+    atomic<int> failed {0};
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            for (int i = 0; i < runs; ++i) {
+                if (resultCount(task.run(imgs)) != imgs.size()) failed++;
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto end = chrono::steady_clock::now();
+    double ms = chrono::duration<double, milli>(end - start).count();
+    int pool_size = cfg["engine"]["pool_size"] ? cfg["engine"]["pool_size"].as<int>() : 1;
+    cout << "pool size: " << pool_size << ", threads: " << threads
+         << ", runs: " << threads * runs << ", " << ms / (threads * runs) << " ms/run, "
+         << 1000. * threads * runs * bchw[0] / ms << " images/s" << endl;
+    if (failed > 0) {
+        cerr << failed << " runs returned wrong count of results!" << endl;
+    }
+    return failed == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <cls/semseg/fcos/yolo/fairmot/f_track> <task yaml> <threads> [runs per thread]" << endl;
+        return -1;
+    }
+    string name = argv[1];
+    YAML::Node cfg = YAML::LoadFile(argv[2]);
+    int threads = stoi(argv[3]);
+    int runs = argc > 4 ? stoi(argv[4]) : 100;
+
+    return runBench(name, [&](auto tag) {
+        return benchTask<typename decltype(tag)::type>(cfg, threads, runs);
+    });
+}
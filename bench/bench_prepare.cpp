@@ -0,0 +1,154 @@
+/**
+ * Batch preprocessing on preprocess pool versus serial per image path.
+ * Checks every job of concurrent batches runs once, and parallel packing
+ * (resize into slots of one staging buffer, then conversion) gives the same
+ * input as serial resizeImage + memcpy + NHWC2NCHW_lut, then times both with
+ * stages for batches of 1920x1080 images to 1632x480 input(f_track, fcos).
+ * Usage: ./bench_prepare [runs] [batch] [threads]
+ * 2021/06/07
+ */
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nhwc2nchw_cpu.h"
+#include "preprocess_pool.h"
+#include "tasks.h"
+
+using namespace std;
+using namespace cv;
+
+static const int kInputW = 1632;
+static const int kInputH = 480;
+
+static Mat randomImage(int width, int height, int seed) {
+    mt19937 rng(seed);
+    uniform_int_distribution<int> value(0, 255);
+    Mat img(height, width, CV_8UC3);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height * 3; ++i) {
+        img.data[i] = static_cast<uint8_t>(value(rng));
+    }
+    return img;
+}
+
+// batches of callers share the pool, every index of every batch must run exactly once
+static bool checkPool(int threads) {
+    PreprocessPool pool(threads);
+    const int callers = 4, batches = 50, count = 7;
+    vector<atomic<int>> runs(callers * batches * count);
+    for (auto& r : runs) r = 0;
+    vector<thread> workers;
+    for (int c = 0; c < callers; ++c) {
+        workers.emplace_back([&, c]() {
+            for (int b = 0; b < batches; ++b) {
+                pool.Run(count, [&](int i) { runs[(c * batches + b) * count + i]++; });
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    bool ok = true;
+    for (auto& r : runs) {
+        ok = ok && r == 1;
+    }
+    cout << "pool of " << threads << " threads " << (ok ? "runs" : "DOES NOT run") << " every job once" << endl;
+    return ok;
+}
+
+struct Stages {
+    double resize = 0.0;
+    double convert = 0.0;
+};
+
+// resizeImage, memcpy into staging and conversion of the whole batch, one image after another
+static Stages serialPath(const vector<Mat>& imgs, uint8_t* staging, float* input, const NormalizeLut& lut) {
+    size_t stride = 3 * kInputW * kInputH;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < imgs.size(); ++i) {
+        Mat resized = Task::resizeImage(imgs[i], kInputW, kInputH, true);
+        memcpy(staging + i * stride, resized.data, stride);
+    }
+    auto resized = chrono::steady_clock::now();
+    NHWC2NCHW_lut(staging, input, static_cast<int>(imgs.size()), kInputH, kInputW, lut);
+    Stages stages;
+    stages.resize = chrono::duration<double, milli>(resized - start).count();
+    stages.convert = chrono::duration<double, milli>(chrono::steady_clock::now() - resized).count();
+    return stages;
+}
+
+// resizeInto slot of staging and conversion of each image as one job, as Task::prepareInputs on host
+static Stages poolPath(PreprocessPool& pool, const vector<Mat>& imgs, uint8_t* staging, float* input,
+                       const NormalizeLut& lut) {
+    size_t stride = 3 * kInputW * kInputH;
+    vector<double> resize_ms(imgs.size()), convert_ms(imgs.size());
+    pool.Run(static_cast<int>(imgs.size()), [&](int i) {
+        auto start = chrono::steady_clock::now();
+        Mat slot(kInputH, kInputW, CV_8UC3, staging + i * stride);
+        Task::resizeInto(imgs[i], slot, true);
+        auto resized = chrono::steady_clock::now();
+        NHWC2NCHW_lut(slot.data, input + i * stride, 1, kInputH, kInputW, lut);
+        resize_ms[i] = chrono::duration<double, milli>(resized - start).count();
+        convert_ms[i] = chrono::duration<double, milli>(chrono::steady_clock::now() - resized).count();
+    });
+    Stages stages;
+    for (size_t i = 0; i < imgs.size(); ++i) {
+        stages.resize = max(stages.resize, resize_ms[i]);
+        stages.convert = max(stages.convert, convert_ms[i]);
+    }
+    return stages;
+}
+
+int main(int argc, char** argv) {
+    int runs    = argc > 1 ? stoi(argv[1]) : 20;
+    int batch   = argc > 2 ? stoi(argv[2]) : 2;
+    int threads = argc > 3 ? stoi(argv[3]) : batch;
+
+    bool ok = checkPool(threads) && checkPool(1);
+
+    NormalizeLut lut;
+    makeNormalizeLut(lut, 0.485f, 0.456f, 0.406f, 0.229f, 0.224f, 0.225f, ImageFormat::kRGB);
+    vector<Mat> imgs;
+    for (int i = 0; i < batch; ++i) {
+        imgs.emplace_back(randomImage(1920, 1080, i));
+    }
+    size_t count = static_cast<size_t>(3) * kInputW * kInputH * batch;
+    vector<uint8_t> staging(count);
+    vector<float> expected(count), actual(count);
+    PreprocessPool pool(threads);
+    serialPath(imgs, staging.data(), expected.data(), lut);
+    poolPath(pool, imgs, staging.data(), actual.data(), lut);
+    bool same = memcmp(expected.data(), actual.data(), count * sizeof(float)) == 0;
+    cout << "parallel packing " << (same ? "matches" : "MISMATCHES") << " serial path" << endl;
+    ok = ok && same;
+
+    Stages serial, parallel;
+    double serial_ms = 0.0, parallel_ms = 0.0;
+    for (int r = 0; r < runs; ++r) {
+        auto start = chrono::steady_clock::now();
+        Stages s = serialPath(imgs, staging.data(), expected.data(), lut);
+        auto mid = chrono::steady_clock::now();
+        Stages p = poolPath(pool, imgs, staging.data(), actual.data(), lut);
+        auto end = chrono::steady_clock::now();
+        serial_ms += chrono::duration<double, milli>(mid - start).count();
+        parallel_ms += chrono::duration<double, milli>(end - mid).count();
+        serial.resize += s.resize;
+        serial.convert += s.convert;
+        parallel.resize += p.resize;
+        parallel.convert += p.convert;
+    }
+    cout << batch << " x 1920x1080 to " << kInputW << "x" << kInputH << ", " << threads << " threads" << endl;
+    cout << "path\t\ttotal ms\tresize ms\tconvert ms" << endl;
+    cout << "serial\t\t" << serial_ms / runs << "\t\t" << serial.resize / runs << "\t\t" << serial.convert / runs << endl;
+    cout << "pool\t\t" << parallel_ms / runs << "\t\t" << parallel.resize / runs << "\t\t" << parallel.convert / runs
+         << "\t(slowest image)" << endl;
+    cout << "speedup " << serial_ms / parallel_ms << endl;
+    if (!ok) cerr << "Batch preprocessing mismatch!" << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/**
+ * Hot swap of engine under load.
+ * Starts threads calling run() of a task on host backend, while a stand-in
+ * builder sleeps for `build ms` on a background thread and returns a new host
+ * engine, which is swapped into the task. Checks the generation changed and
+ * every run returned results of all images, prints max latency of run() before
+ * and during the swap. Bindings are taken from `host_bindings` or `replay_file`.
+ * Usage: ./bench_swap <cls/semseg/fcos/yolo/fairmot/f_track> <task yaml> [threads] [build ms]
+ * 2021/03/15
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "host_engine.h"
+#include "tensor_record.h"
+
+using namespace std;
+using namespace cv;
+
+template <typename T>
+static bool benchTask(YAML::Node cfg, int threads, int build_ms) {
+    cfg["misc"]["show_time"] = false;
+    cfg["engine"]["backend"] = "host";
+    cfg["engine"]["pool_size"] = threads;
+    // stand-in engine replays same frames as the task, declared first to outlive it
+    TensorReplay replay;
+    vector<HostBinding> bindings = parseHostBindings(cfg["engine"]["host_bindings"]);
+    string replay_file = cfg["engine"]["replay_file"] ? cfg["engine"]["replay_file"].as<string>() : "";
+    if (!replay_file.empty() && replay.Open(replay_file) && bindings.empty()) {
+        bindings = replay.GetBindings();
+    }
+    if (bindings.empty()) {
+        cerr << "Set `host_bindings` or `replay_file` in engine config!" << endl;
+        return false;
+    }
+    T task(cfg);
+    vector<int> bchw = cfg["engine"]["bchw"].as<vector<int>>();
+    vector<Mat> imgs(bchw[0], benchImage(cfg));
+
+    atomic<bool> building {true};
+    atomic<int> failed {0};
+    atomic<int> runs {0};
+    vector<double> max_after(threads, 0.), max_during(threads, 0.);
+    // a swap failing(e.g. bindings mismatch) never bumps generation, give up on it after a while
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(build_ms) + chrono::seconds(10);
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            // keep running until a while after swap, so runs on new engine are checked too
+            int after = 0;
+            while (after < 50 && chrono::steady_clock::now() < deadline) {
+                bool swapping = building;
+                auto start = chrono::steady_clock::now();
+                if (resultCount(task.run(imgs)) != imgs.size()) failed++;
+                double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                double& slot = swapping ? max_during[t] : max_after[t];
+                slot = max(slot, ms);
+                if (task.engineGeneration() > 0) after++;
+                runs++;
+            }
+        });
+    }
+
+    int generation = task.engineGeneration();
+    task.buildInBackground([&]() {
+        this_thread::sleep_for(chrono::milliseconds(build_ms));
+        HostEngine* net = new HostEngine(bindings);
+        if (replay.NbFrames() > 0) net->SetForward(replay.MakeForward());
+        net->CreateEngine("", "", {}, bchw[0], RunMode::kFP32, 0);
+        building = false;
+        return static_cast<InferBackend*>(net);
+    });
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    bool ok = failed == 0 && task.engineGeneration() == generation + 1;
+    cout << "threads: " << threads << ", runs: " << runs << ", generation: " << generation
+         << " -> " << task.engineGeneration() << endl;
+    cout << "max latency while building: " << *max_element(max_during.begin(), max_during.end())
+         << " ms, after swap: " << *max_element(max_after.begin(), max_after.end()) << " ms" << endl;
+    if (failed > 0) {
+        cerr << failed << " runs returned wrong count of results!" << endl;
+    }
+    if (task.engineGeneration() != generation + 1) {
+        cerr << "Engine was not swapped in!" << endl;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <cls/semseg/fcos/yolo/fairmot/f_track> <task yaml> [threads] [build ms]" << endl;
+        return -1;
+    }
+    string name = argv[1];
+    YAML::Node cfg = YAML::LoadFile(argv[2]);
+    int threads = argc > 3 ? stoi(argv[3]) : 4;
+    int build_ms = argc > 4 ? stoi(argv[4]) : 500;
+
+    return runBench(name, [&](auto tag) {
+        return benchTask<typename decltype(tag)::type>(cfg, threads, build_ms);
+    });
+}
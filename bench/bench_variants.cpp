@@ -0,0 +1,96 @@
+/**
+ * Throughput of engine variants on mixed frame sizes.
+ * Runs a task on frames of every size with `engine: variants` of task yaml and
+ * with the `bchw` engine only, prints input size of engine selected, mean
+ * latency of run() of both and checks every run returned results of all images.
+ * Usage: ./bench_variants <cls/semseg/fcos/yolo/fairmot/f_track> <task yaml> [runs] [WxH ...]
+ * 2021/05/03
+ */
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+
+using namespace std;
+using namespace cv;
+
+// mean ms of run() on frames of every size, -1 for a size whose results miss images
+template <typename T>
+static vector<double> benchSizes(T& task, const vector<Size>& sizes, int batch, int runs) {
+    vector<double> latency;
+    for (const auto& size : sizes) {
+        Mat img(size.height, size.width, CV_8UC3);
+        randu(img, Scalar::all(0), Scalar::all(255));
+        vector<Mat> imgs(batch, img);
+        for (int i = 0; i < 5; ++i) {  // warm up
+            task.run(imgs);
+        }
+        size_t count = 0;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < runs; ++i) {
+            count = resultCount(task.run(imgs));
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+        latency.emplace_back(count == imgs.size() ? ms : -1.);
+    }
+    return latency;
+}
+
+template <typename T>
+static bool benchTask(YAML::Node cfg, const vector<Size>& sizes, int runs) {
+    cfg["misc"]["show_time"] = false;
+    int batch = cfg["engine"]["bchw"].as<vector<int>>()[0];
+    vector<double> with_variants;
+    vector<pair<int, int>> selected;
+    {
+        T task(cfg);
+        with_variants = benchSizes(task, sizes, batch, runs);
+        for (const auto& size : sizes) {
+            selected.emplace_back(task.inputSizeFor({Mat(size.height, size.width, CV_8UC3)}));
+        }
+    }
+    cfg["engine"]["variants"] = YAML::Node(YAML::NodeType::Sequence);
+    T single(cfg);
+    vector<double> bchw_only = benchSizes(single, sizes, batch, runs);
+
+    bool ok = true;
+    cout << "frame\t\tengine\t\tvariants(ms)\tbchw only(ms)\tspeedup" << endl;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        cout << sizes[i].width << "x" << sizes[i].height << "\t" << selected[i].first << "x" << selected[i].second
+             << "\t\t" << with_variants[i] << "\t\t" << bchw_only[i] << "\t\t" << bchw_only[i] / with_variants[i] << endl;
+        if (with_variants[i] < 0 || bchw_only[i] < 0) {
+            cerr << "Results of frame " << sizes[i].width << "x" << sizes[i].height << " miss images!" << endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <cls/semseg/fcos/yolo/fairmot/f_track> <task yaml> [runs] [WxH ...]" << endl;
+        return -1;
+    }
+    string name = argv[1];
+    YAML::Node cfg = YAML::LoadFile(argv[2]);
+    int runs = argc > 3 ? stoi(argv[3]) : 50;
+    vector<Size> sizes;
+    for (int i = 4; i < argc; ++i) {
+        string size = argv[i];
+        size_t x = size.find('x');
+        if (x == string::npos) {
+            cerr << "Frame size should be WxH, got: " << size << endl;
+            return -1;
+        }
+        sizes.emplace_back(stoi(size.substr(0, x)), stoi(size.substr(x + 1)));
+    }
+    if (sizes.empty()) {
+        sizes = {Size(320, 240), Size(640, 360), Size(1280, 720), Size(1920, 1080)};
+    }
+
+    return runBench(name, [&](auto tag) {
+        return benchTask<typename decltype(tag)::type>(cfg, sizes, runs);
+    });
+}
@@ -0,0 +1,106 @@
+/**
+ * Input from caller owned buffers: roi of a capture buffer with padded rows,
+ * read in place by Task::resizeView, versus copying roi into a Mat and
+ * resizing that(what callers did before image views). Checks both give the
+ * same staging bytes and transforms for bgr, rgb, bgra and gray buffers.
+ * Usage: ./bench_views [runs] [input width] [input height]
+ * 2021/06/14
+ */
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tasks.h"
+
+using namespace std;
+using namespace cv;
+
+static const int kBufferW = 3840;
+static const int kBufferH = 2160;
+static const int kRowPad  = 256;  // capture buffers align rows
+
+struct Buffer {
+    vector<uint8_t> bytes;
+    ImageView view;
+};
+
+static Buffer makeBuffer(PixelFormat format, int seed) {
+    int channels = pixelChannels(format);
+    int stride = kBufferW * channels + kRowPad;
+    Buffer buffer;
+    buffer.bytes.resize(static_cast<size_t>(stride) * kBufferH);
+    mt19937 rng(seed);
+    for (auto& b : buffer.bytes) {
+        b = static_cast<uint8_t>(rng());
+    }
+    buffer.view = ImageView(buffer.bytes.data(), stride, kBufferW, kBufferH, format);
+    return buffer;
+}
+
+// roi copied into a continuous bgr Mat first, then resized into staging
+static ImageTransform copyPath(const ImageView& view, Mat& dst, bool padding) {
+    Mat roi = Task::viewImage(view).clone();
+    Mat bgr;
+    switch (view.format) {
+        case PixelFormat::kBGR: bgr = roi; break;
+        case PixelFormat::kRGB: cvtColor(roi, bgr, COLOR_RGB2BGR); break;
+        case PixelFormat::kBGRA: cvtColor(roi, bgr, COLOR_BGRA2BGR); break;
+        case PixelFormat::kRGBA: cvtColor(roi, bgr, COLOR_RGBA2BGR); break;
+        case PixelFormat::kGray: cvtColor(roi, bgr, COLOR_GRAY2BGR); break;
+        case PixelFormat::kNV12:
+        case PixelFormat::kI420:
+            // planes of yuv are not in roi Mat, bench_yuv checks them, staging stays zero so check fails
+            cerr << "copy path of yuv views is not supported" << endl;
+            memset(dst.data, 0, static_cast<size_t>(3) * dst.cols * dst.rows);
+            return ImageTransform();
+    }
+    ImageTransform t;
+    Mat resized = Task::resizeImage(bgr, dst.cols, dst.rows, padding, &t);
+    memcpy(dst.data, resized.data, static_cast<size_t>(3) * dst.cols * dst.rows);
+    t.offset_x = view.roi_x;
+    t.offset_y = view.roi_y;
+    return t;
+}
+
+static double timeMs(const function<void()>& run, int runs) {
+    run();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        run();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+}
+
+int main(int argc, char** argv) {
+    int runs   = argc > 1 ? stoi(argv[1]) : 20;
+    int width  = argc > 2 ? stoi(argv[2]) : 640;
+    int height = argc > 3 ? stoi(argv[3]) : 640;
+
+    const pair<PixelFormat, const char*> formats[] = {{PixelFormat::kBGR, "bgr"}, {PixelFormat::kRGB, "rgb"},
+                                                      {PixelFormat::kBGRA, "bgra"}, {PixelFormat::kGray, "gray"}};
+    vector<uint8_t> expected(3 * width * height), actual(3 * width * height);
+    Mat expected_slot(height, width, CV_8UC3, expected.data());
+    Mat actual_slot(height, width, CV_8UC3, actual.data());
+    bool ok = true;
+    cout << "roi 1920x1080 at 960,540 of " << kBufferW << "x" << kBufferH << " buffer to " << width << "x" << height << endl;
+    cout << "format\tcopy ms\t\tin place ms\tspeedup" << endl;
+    for (const auto& format : formats) {
+        Buffer buffer = makeBuffer(format.first, 7);
+        ImageView roi = buffer.view.crop(960, 540, 1920, 1080);
+        ImageTransform t_expected = copyPath(roi, expected_slot, true);
+        ImageTransform t = Task::resizeView(roi, actual_slot, true);
+        bool same = expected == actual && t.offset_x == t_expected.offset_x && t.offset_y == t_expected.offset_y &&
+                    t.scale_x == t_expected.scale_x && t.pad_x == t_expected.pad_x && t.pad_y == t_expected.pad_y;
+        if (!same) cerr << format.second << ": in place input differs from copy path" << endl;
+        ok = ok && same;
+        double copy_ms = timeMs([&]() { copyPath(roi, expected_slot, true); }, runs);
+        double view_ms = timeMs([&]() { Task::resizeView(roi, actual_slot, true); }, runs);
+        cout << format.second << "\t" << copy_ms << "\t\t" << view_ms << "\t\t" << copy_ms / view_ms << endl;
+    }
+    cout << "image views " << (ok ? "match" : "MISMATCH") << " copy path" << endl;
+    return ok ? 0 : 1;
+}
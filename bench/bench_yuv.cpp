@@ -0,0 +1,164 @@
+/**
+ * NV12 and I420 frames to model input. Checks yuv420ToBgr_cpu against
+ * cv::cvtColor and on odd sized rois, fused letterboxNormalizeYuv_cpu against
+ * cvtColor + letterboxNormalize_cpu and Task::resizeView of yuv views against
+ * it, all bit exact. Then times cvtColor + Task::resizeInto + NHWC2NCHW_lut
+ * (four passes, what callers of bgr tasks did), cvtColor + fused letterbox,
+ * and yuv letterbox in one pass.
+ * Usage: ./bench_yuv [runs] [threads]
+ * 2021/07/05
+ */
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tasks.h"
+
+using namespace std;
+using namespace cv;
+
+struct Frame {
+    vector<uint8_t> bytes;  // luma then chroma, rows stride bytes apart, chroma of I420 stride / 2
+    ImageView view;
+    int code;  // cvtColor code of whole buffer
+};
+
+// smooth luma and chroma with noise, as camera frames rather than uniform random bytes
+static Frame makeFrame(PixelFormat format, int width, int height, int stride, int seed) {
+    Frame frame;
+    mt19937 rng(seed);
+    int chroma_h = (height + 1) / 2;
+    frame.bytes.resize(static_cast<size_t>(stride) * (height + chroma_h));
+    for (size_t i = 0; i < frame.bytes.size(); ++i) {
+        int row = static_cast<int>(i / stride);
+        int col = static_cast<int>(i % stride);
+        frame.bytes[i] = static_cast<uint8_t>((row * 3 + col * 5) % 256 ^ (rng() & 31));
+    }
+    if (format == PixelFormat::kNV12) {
+        frame.view = ImageView::nv12(frame.bytes.data(), stride, width, height);
+        frame.code = COLOR_YUV2BGR_NV12;
+    } else {
+        frame.view = ImageView::i420(frame.bytes.data(), stride, width, height);
+        frame.code = COLOR_YUV2BGR_I420;
+    }
+    return frame;
+}
+
+// whole buffer as cvtColor reads it, luma and chroma rows one Mat
+static Mat cvtBgr(const Frame& frame) {
+    Mat yuv(frame.view.height * 3 / 2, frame.view.width, CV_8UC1, const_cast<uint8_t*>(frame.bytes.data()),
+            frame.view.stride);
+    Mat bgr;
+    cvtColor(yuv, bgr, frame.code);
+    return bgr;
+}
+
+static bool sameRegion(const Mat& a, const uint8_t* b, int b_step, int x, int y, int w, int h) {
+    for (int r = 0; r < h; ++r) {
+        if (memcmp(a.data + (y + r) * a.step[0] + x * 3, b + r * b_step, w * 3) != 0) return false;
+    }
+    return true;
+}
+
+static bool checkFormat(PixelFormat format, const char* name) {
+    bool ok = true;
+    // stride of I420 is even so its chroma stride is stride / 2
+    Frame frame = makeFrame(format, 1280, 720, 1280 + 64, 3);
+    Mat bgr = cvtBgr(frame);
+    YuvImage whole = Task::yuvImage(frame.view);
+    vector<uint8_t> out(static_cast<size_t>(1280) * 720 * 3);
+    yuv420ToBgr_cpu(whole, 1280, 0, 720, out.data(), 1280 * 3);
+    bool same = sameRegion(bgr, out.data(), 1280 * 3, 0, 0, 1280, 720);
+    cout << name << " to bgr " << (same ? "matches" : "MISMATCHES") << " cvtColor" << endl;
+    ok = ok && same;
+
+    // odd sized roi at even origin, tails of vector loop and last chroma sample
+    ImageView roi = frame.view.crop(34, 18, 301, 177);
+    vector<uint8_t> roi_out(301 * 177 * 3);
+    yuv420ToBgr_cpu(Task::yuvImage(roi), 301, 0, 177, roi_out.data(), 301 * 3);
+    same = sameRegion(bgr, roi_out.data(), 301 * 3, 34, 18, 301, 177);
+    cout << name << " roi to bgr " << (same ? "matches" : "MISMATCHES") << " cvtColor" << endl;
+    ok = ok && same;
+
+    NormalizeLut lut;
+    makeNormalizeLut(lut, 0.485f, 0.456f, 0.406f, 0.229f, 0.224f, 0.225f, ImageFormat::kRGB);
+    for (bool padding : {true, false}) {
+        for (const ImageView& view : {frame.view, roi}) {
+            ImageTransform t = letterboxTransform(view.cols(), view.rows(), 416, 256, padding);
+            vector<float> expected(3 * 416 * 256), actual(3 * 416 * 256), resized(3 * 416 * 256);
+            const uint8_t* src = bgr.data + view.roi_y * bgr.step[0] + view.roi_x * 3;
+            letterboxNormalize_cpu(src, static_cast<int>(bgr.step[0]), t, expected.data(), lut, 114, 1);
+            letterboxNormalizeYuv_cpu(Task::yuvImage(view), t, actual.data(), lut, 114, 2);
+            // resizeView writes bgr bytes, normalized by lut afterwards
+            Mat slot(256, 416, CV_8UC3);
+            Task::resizeView(view, slot, padding);
+            NHWC2NCHW_lut(slot.data, resized.data(), 1, 256, 416, lut);
+            bool fused = memcmp(expected.data(), actual.data(), expected.size() * sizeof(float)) == 0;
+            bool staged = memcmp(expected.data(), resized.data(), expected.size() * sizeof(float)) == 0;
+            if (!fused || !staged) {
+                cerr << name << (padding ? " letterbox " : " resize ") << view.cols() << "x" << view.rows()
+                     << (fused ? "" : ": fused differs") << (staged ? "" : ": resizeView differs") << endl;
+            }
+            ok = ok && fused && staged;
+        }
+    }
+    cout << name << " fused letterbox " << (ok ? "matches" : "MISMATCHES") << " cvtColor + letterbox" << endl;
+    return ok;
+}
+
+static double timeMs(const function<void()>& run, int runs) {
+    run();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        run();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+}
+
+static void benchFrame(PixelFormat format, const char* name, int width, int height, int input_w, int input_h,
+                       bool padding, int runs, int threads) {
+    Frame frame = makeFrame(format, width, height, width, 5);
+    ImageTransform t = letterboxTransform(width, height, input_w, input_h, padding);
+    NormalizeLut lut;
+    makeNormalizeLut(lut, 0.485f, 0.456f, 0.406f, 0.229f, 0.224f, 0.225f, ImageFormat::kRGB);
+    vector<float> input(3 * input_w * input_h);
+    Mat slot(input_h, input_w, CV_8UC3);
+    double staged_ms = timeMs([&]() {
+        Mat bgr = cvtBgr(frame);
+        Task::resizeInto(bgr, slot, padding);
+        NHWC2NCHW_lut(slot.data, input.data(), 1, input_h, input_w, lut, threads);
+    }, runs);
+    double two_pass_ms = timeMs([&]() {
+        Mat bgr = cvtBgr(frame);
+        letterboxNormalize_cpu(bgr.data, static_cast<int>(bgr.step[0]), t, input.data(), lut, 114, threads);
+    }, runs);
+    double fused_ms = timeMs([&]() {
+        letterboxNormalizeYuv_cpu(Task::yuvImage(frame.view), t, input.data(), lut, 114, threads);
+    }, runs);
+    cout << name << "\t" << width << "x" << height << " to " << input_w << "x" << input_h << (padding ? " lb" : "   ")
+         << "\t" << staged_ms << "\t\t" << two_pass_ms << "\t\t" << fused_ms << "\t\t" << staged_ms / fused_ms << endl;
+}
+
+int main(int argc, char** argv) {
+    int runs    = argc > 1 ? stoi(argv[1]) : 20;
+    int threads = argc > 2 ? stoi(argv[2]) : 1;
+
+    cout << "conversion built with: " << nhwc2nchwIsa() << endl;
+    bool ok = checkFormat(PixelFormat::kNV12, "nv12");
+    ok = checkFormat(PixelFormat::kI420, "i420") && ok;
+
+    cout << "format\tframe to input\t\t\tcvt+resize+lut ms\tcvt+fused ms\tyuv fused ms\tspeedup" << endl;
+    const pair<PixelFormat, const char*> formats[] = {{PixelFormat::kNV12, "nv12"}, {PixelFormat::kI420, "i420"}};
+    for (const auto& format : formats) {
+        // yolov5 letterbox, f_track stretch, 4k camera to yolov5
+        benchFrame(format.first, format.second, 1920, 1080, 640, 640, true, runs, threads);
+        benchFrame(format.first, format.second, 1920, 1080, 1632, 480, false, runs, threads);
+        benchFrame(format.first, format.second, 3840, 2160, 640, 640, true, runs, threads);
+    }
+    if (!ok) cerr << "Yuv input mismatch!" << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/**
+ * Inference backend API. Task talks to the network only through this
+ * interface, so the TensorRT engine can be swapped by a host implementation
+ * or the cpu runtime.
+ * 2021/02/01
+ */
+
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <string>
+#include <vector>
+
+#include "NvInfer.h"
+#include "startup_profile.h"
+#include "utils.h"
+
+class TensorRecorder;
+
+enum class BackendType : int {
+    kTensorRT,
+    kHost,
+    kCPU
+};
+
+/**
+ * Parse backend type from yaml string, "tensorrt"(default), "host" or "cpu".
+ */
+inline BackendType parseBackendType(const std::string& name) {
+    if (name == "host") return BackendType::kHost;
+    if (name == "cpu") return BackendType::kCPU;
+    return BackendType::kTensorRT;
+}
+
+class InferBackend {
+public:
+    virtual ~InferBackend() = default;
+
+    /**
+     * Create engine and allocate bindings.
+     * onnxModel: path to onnx model
+     * engineFile: path to saved engine file will be load or save
+     * maxBatchSize: max batch size for inference.
+     * runMode: mode while running, fp32/fp16/int8
+     * GetNbBindings() is 0 if it failed.
+     */
+    virtual void CreateEngine(const std::string& onnxModel,
+                              const std::string& engineFile,
+                              const std::vector<std::string>& customOutput,
+                              int maxBatchSize,
+                              RunMode runMode,
+                              long workspace_size) = 0;
+
+    /**
+     * New backend sharing loaded engine with this one, it has its own execution
+     * context and bindings, so both could forward concurrently. Caller owns it,
+     * nullptr if engine can't run another context.
+     */
+    virtual InferBackend* Clone() const = 0;
+
+    virtual void Forward() = 0;
+
+    virtual void ForwardAsync(const cudaStream_t& stream) = 0;
+
+    virtual void CopyFromHostToDevice(const std::vector<float>& input, int bindIndex) = 0;
+
+    virtual void CopyFromDeviceToHost(std::vector<float>& output, int bindIndex) = 0;
+
+    virtual void CopyFromHostToDevice(const std::vector<float>& input, int bindIndex, const cudaStream_t& stream) = 0;
+
+    virtual void CopyFromDeviceToHost(std::vector<float>& output, int bindIndex, const cudaStream_t& stream) = 0;
+
+    virtual void SetDevice(int device) { UNUSED(device); }
+
+    virtual BackendType GetBackendType() const = 0;
+
+    /**
+     * Whether pointers from GetBindingPtr point to device memory. Host backend
+     * returns false, post process then reads bindings without cudaMemcpy.
+     */
+    virtual bool IsDeviceMemory() const = 0;
+
+    virtual int GetMaxBatchSize() const = 0;
+
+    /**
+     * Set count of images in next forward, 1 <= batch <= max batch size.
+     * Return true if backend really runs only this batch, false if it always
+     * runs max batch, outputs beyond batch are meaningless in both cases.
+     */
+    virtual bool SetBatchSize(int batch) {
+        mCurBatch = batch;
+        return false;
+    }
+
+    int GetBatchSize() const {
+        return mCurBatch;
+    }
+
+    virtual int GetNbBindings() const {
+        return static_cast<int>(mBindingName.size());
+    }
+
+    virtual void* GetBindingPtr(int bindIndex) const = 0;
+
+    /**
+     * Binding data size in byte.
+     */
+    virtual size_t GetBindingSize(int bindIndex) const = 0;
+
+    virtual nvinfer1::Dims GetBindingDims(int bindIndex) const = 0;
+
+    virtual nvinfer1::DataType GetBindingDataType(int bindIndex) const = 0;
+
+    virtual bool BindingIsInput(int bindIndex) const = 0;
+
+    /**
+     * Scale of int8 binding, value = int8 x scale. 1 for other data types.
+     */
+    virtual float GetBindingScale(int bindIndex) const {
+        UNUSED(bindIndex);
+        return 1.f;
+    }
+
+    /**
+     * Record output bindings after every forward, see tensor_record.h.
+     */
+    void SetRecorder(TensorRecorder* recorder) {
+        mRecorder = recorder;
+    }
+
+    TensorRecorder* GetRecorder() const {
+        return mRecorder;
+    }
+
+    /**
+     * Time of stages in CreateEngine, see startup_profile.h.
+     */
+    const StartupProfile& GetStartupProfile() const {
+        return mStartup;
+    }
+
+    std::vector<std::string> mBindingName;
+
+protected:
+    TensorRecorder* mRecorder = nullptr;
+    StartupProfile mStartup;
+
+    // images in next forward, max batch size after CreateEngine
+    int mCurBatch = 0;
+};
+
+#endif  // BACKEND_H
@@ -0,0 +1,253 @@
+/**
+ * INT8 calibration images stream, calibrators and calibration cache.
+ * 2021/03/22
+ */
+#include "calibrator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <thread>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "engine_artifact.h"
+#include "nhwc2nchw_cpu.h"
+
+static bool isImageFile(const std::string& name) {
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = name.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp";
+}
+
+/* -==================Cache================*/
+bool readCalibCache(const std::string& file, uint64_t key, CalibAlgorithm algorithm, std::vector<char>& table) {
+    FILE* fp = fopen(file.c_str(), "rb");
+    if (fp == nullptr) return false;
+    CalibCacheHeader header;
+    bool ok = fread(&header, 1, sizeof(CalibCacheHeader), fp) == sizeof(CalibCacheHeader)
+              && memcmp(header.magic, CALIB_MAGIC, sizeof(header.magic)) == 0
+              && header.version == CALIB_VERSION
+              && header.algorithm == static_cast<int32_t>(algorithm)
+              && header.key == key;
+    if (ok) {
+        table.resize(header.payload_size);
+        ok = fread(table.data(), 1, table.size(), fp) == table.size();
+    }
+    fclose(fp);
+    if (!ok) table.clear();
+    return ok;
+}
+
+bool writeCalibCache(const std::string& file, uint64_t key, CalibAlgorithm algorithm, const void* table, size_t size) {
+    FILE* fp = fopen(file.c_str(), "wb");
+    if (fp == nullptr) return false;
+    CalibCacheHeader header;
+    memset(&header, 0, sizeof(CalibCacheHeader));
+    memcpy(header.magic, CALIB_MAGIC, sizeof(header.magic));
+    header.version      = CALIB_VERSION;
+    header.algorithm    = static_cast<int32_t>(algorithm);
+    header.key          = key;
+    header.payload_size = size;
+    bool ok = fwrite(&header, 1, sizeof(CalibCacheHeader), fp) == sizeof(CalibCacheHeader)
+              && fwrite(table, 1, size, fp) == size;
+    fclose(fp);
+    return ok;
+}
+
+CalibAlgorithm parseCalibAlgorithm(const std::string& name) {
+    return name == "minmax" ? CalibAlgorithm::kMinMax : CalibAlgorithm::kEntropy;
+}
+
+/* -==================Stream================*/
+CalibBatchStream::CalibBatchStream(const std::string& imageDir,
+                                   const std::vector<int>& bchw,
+                                   const std::vector<float>& means,
+                                   const std::vector<float>& stds,
+                                   ImageFormat format,
+                                   const ResizeFn& resize,
+                                   int maxBatches,
+                                   int threads)
+    : mBCHW(bchw), mMeans(means), mStds(stds), mFormat(format), mResize(resize), mThreads(std::max(threads, 1)) {
+    DIR* dir = opendir(imageDir.c_str());
+    if (dir == nullptr) {
+        mLogger.logger("Open calibration image directory failed: ", imageDir, logger::LEVEL::ERROR);
+        return;
+    }
+    std::string prefix = imageDir.empty() || imageDir.back() == '/' ? imageDir : imageDir + "/";
+    for (struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+        if (isImageFile(entry->d_name)) mFiles.emplace_back(prefix + entry->d_name);
+    }
+    closedir(dir);
+    std::sort(mFiles.begin(), mFiles.end());
+
+    // partial batch is dropped, calibration sees full batches only
+    mNbBatches = static_cast<int>(mFiles.size()) / mBCHW[0];
+    if (maxBatches > 0) mNbBatches = std::min(mNbBatches, maxBatches);
+    mLogger.logger("Calibration images: ", mFiles.size(), ", batches: " + std::to_string(mNbBatches));
+    if (mNbBatches == 0) {
+        mLogger.logger("Calibration images are less than one batch: ", imageDir, logger::LEVEL::ERROR);
+    }
+}
+
+CalibBatchStream::~CalibBatchStream() {
+    if (mPrefetch.valid()) mPrefetch.wait();
+}
+
+bool CalibBatchStream::Next(float* output) {
+    if (mBatch >= mNbBatches) return false;
+    bool ok;
+    if (mPrefetch.valid()) {
+        ok = mPrefetch.get();
+        std::swap(mCurrent, mPrefetched);
+    } else {
+        ok = load(mBatch, mCurrent);
+    }
+    mBatch++;
+    if (mBatch < mNbBatches) {
+        int next = mBatch;
+        mPrefetch = std::async(std::launch::async, [this, next]() { return load(next, mPrefetched); });
+    }
+    if (!ok) return false;
+    NHWC2NCHW_cpu(mCurrent.data(), output, mBCHW[0], mBCHW[2], mBCHW[3],
+                  mMeans[0], mMeans[1], mMeans[2],
+                  mStds[0], mStds[1], mStds[2],
+                  mFormat);
+    return true;
+}
+
+void CalibBatchStream::Reset() {
+    if (mPrefetch.valid()) mPrefetch.get();
+    mBatch = 0;
+}
+
+uint64_t CalibBatchStream::Key() const {
+    uint64_t key = fnv1a64(mBCHW.data(), mBCHW.size() * sizeof(int));
+    key = fnv1a64(mMeans.data(), mMeans.size() * sizeof(float), key);
+    key = fnv1a64(mStds.data(), mStds.size() * sizeof(float), key);
+    key = fnv1a64(&mFormat, sizeof(mFormat), key);
+    key = fnv1a64(&mNbBatches, sizeof(mNbBatches), key);
+    for (int i = 0; i < mNbBatches * mBCHW[0]; ++i) {
+        key = fnv1a64(mFiles[i].data(), mFiles[i].size(), key);
+        // images replaced under same names invalidate cache too
+        struct stat st;
+        int64_t size_mtime[2] = {-1, -1};
+        if (stat(mFiles[i].c_str(), &st) == 0) {
+            size_mtime[0] = static_cast<int64_t>(st.st_size);
+            size_mtime[1] = static_cast<int64_t>(st.st_mtime);
+        }
+        key = fnv1a64(size_mtime, sizeof(size_mtime), key);
+    }
+    return key;
+}
+
+bool CalibBatchStream::load(int batch, std::vector<uint8_t>& nhwc) {
+    int n = mBCHW[0];
+    size_t img_stride = static_cast<size_t>(3) * mBCHW[2] * mBCHW[3];
+    nhwc.assign(n * img_stride, 0);
+    std::vector<char> loaded(n, 0);  // not vector<bool>, written by threads
+    auto decode = [&](int first) {
+        for (int i = first; i < n; i += mThreads) {
+            cv::Mat img = cv::imread(mFiles[batch * n + i]);
+            if (img.empty()) continue;
+            img = mResize(img);
+            if (img.rows != mBCHW[2] || img.cols != mBCHW[3] || img.type() != CV_8UC3) continue;
+            if (!img.isContinuous()) img = img.clone();
+            memcpy(nhwc.data() + i * img_stride, img.data, img_stride);
+            loaded[i] = 1;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < mThreads && t < n; ++t) {
+        workers.emplace_back(decode, t);
+    }
+    decode(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    // a zero image would skew ranges of calibration, stop at this batch instead
+    bool ok = true;
+    for (int i = 0; i < n; ++i) {
+        if (loaded[i]) continue;
+        mLogger.logger("Decode calibration image failed, calibration stops: ", mFiles[batch * n + i], logger::LEVEL::ERROR);
+        ok = false;
+    }
+    return ok;
+}
+
+/* -==================Calibrator================*/
+template <typename Base>
+class Int8Calibrator : public Base {
+public:
+    Int8Calibrator(CalibAlgorithm algorithm,
+                   std::unique_ptr<CalibBatchStream> stream,
+                   const std::string& cacheFile,
+                   uint64_t modelKey)
+        : mAlgorithm(algorithm), mStream(std::move(stream)), mCacheFile(cacheFile) {
+        mKey = fnv1a64(&algorithm, sizeof(algorithm), modelKey);
+        uint64_t streamKey = mStream->Key();
+        mKey = fnv1a64(&streamKey, sizeof(streamKey), mKey);
+        mHost.resize(mStream->Volume());
+    }
+
+    ~Int8Calibrator() {
+        safeCudaFree(mDevice);
+    }
+
+    // explicit batch network, batch is part of input dims
+    int getBatchSize() const override {
+        return 1;
+    }
+
+    bool getBatch(void* bindings[], const char* names[], int nbBindings) override {
+        UNUSED(names);
+        UNUSED(nbBindings);
+        if (!mStream->Next(mHost.data())) return false;
+        if (mDevice == nullptr) CUDA_CHECK(cudaMalloc(&mDevice, mHost.size() * sizeof(float)));
+        CUDA_CHECK(cudaMemcpy(mDevice, mHost.data(), mHost.size() * sizeof(float), cudaMemcpyHostToDevice));
+        bindings[0] = mDevice;
+        mLogger.logger("Calibration batch: ", ++mFed, "/" + std::to_string(mStream->NbBatches()));
+        return true;
+    }
+
+    const void* readCalibrationCache(size_t& length) override {
+        length = 0;
+        if (mCacheFile.empty() || !readCalibCache(mCacheFile, mKey, mAlgorithm, mTable)) return nullptr;
+        mLogger.logger("Read calibration cache, skip calibration: ", mCacheFile);
+        length = mTable.size();
+        return mTable.data();
+    }
+
+    void writeCalibrationCache(const void* cache, size_t length) override {
+        if (mCacheFile.empty()) return;
+        if (writeCalibCache(mCacheFile, mKey, mAlgorithm, cache, length)) {
+            mLogger.logger("Write calibration cache: ", mCacheFile);
+        } else {
+            mLogger.logger("Write calibration cache failed: ", mCacheFile, logger::LEVEL::WARNING);
+        }
+    }
+
+private:
+    logger::Logger mLogger;
+    CalibAlgorithm mAlgorithm;
+    std::unique_ptr<CalibBatchStream> mStream;
+    std::string mCacheFile;
+    uint64_t mKey;
+    std::vector<float> mHost;
+    std::vector<char> mTable;
+    void* mDevice = nullptr;
+    int mFed = 0;
+};
+
+nvinfer1::IInt8Calibrator* createInt8Calibrator(CalibAlgorithm algorithm,
+                                                std::unique_ptr<CalibBatchStream> stream,
+                                                const std::string& cacheFile,
+                                                uint64_t modelKey) {
+    if (algorithm == CalibAlgorithm::kMinMax) {
+        return new Int8Calibrator<nvinfer1::IInt8MinMaxCalibrator>(algorithm, std::move(stream), cacheFile, modelKey);
+    }
+    return new Int8Calibrator<nvinfer1::IInt8EntropyCalibrator2>(algorithm, std::move(stream), cacheFile, modelKey);
+}
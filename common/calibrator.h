@@ -0,0 +1,139 @@
+/**
+ * INT8 calibration: images of a directory are streamed in batches through
+ * same preprocessing of task inputs(resize or letterbox, then NHWC2NCHW with
+ * means, stds and image format), decoded by a few threads while TensorRT
+ * runs previous batch. Calibration table is kept in a cache file keyed by
+ * onnx, images and preprocessing, so rebuilds skip calibration.
+ *   | CalibCacheHeader | calibration table of TensorRT |
+ * 2021/03/22
+ */
+
+#ifndef CALIBRATOR_H
+#define CALIBRATOR_H
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "NvInfer.h"
+#include "logger.h"
+#include "utils.h"
+
+#define CALIB_MAGIC "TRTCAL01"
+#define CALIB_VERSION 1
+
+enum class CalibAlgorithm : int {
+    kEntropy,
+    kMinMax
+};
+
+struct CalibCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    int32_t  algorithm;
+    uint64_t key;           // see Int8Calibrator, table is reused only if key matches
+    uint64_t payload_size;
+};
+
+/**
+ * Read calibration table of cache file, return false if file is missing,
+ * truncated or its key/algorithm mismatch.
+ */
+bool readCalibCache(const std::string& file, uint64_t key, CalibAlgorithm algorithm, std::vector<char>& table);
+
+/**
+ * Write calibration table with header, return false if file can't be written.
+ */
+bool writeCalibCache(const std::string& file, uint64_t key, CalibAlgorithm algorithm, const void* table, size_t size);
+
+/**
+ * Batches of calibration images as NCHW float, on host memory.
+ */
+class CalibBatchStream {
+public:
+    /**
+     * Image of model size from decoded image, e.g. resize or letterbox.
+     */
+    typedef std::function<cv::Mat(const cv::Mat&)> ResizeFn;
+
+    /**
+     * imageDir: jpg/jpeg/png/bmp files in it are used in name order.
+     * maxBatches: batches streamed at most, 0 for all full batches of images.
+     * threads: threads decoding images of one batch.
+     */
+    CalibBatchStream(const std::string& imageDir,
+                     const std::vector<int>& bchw,
+                     const std::vector<float>& means,
+                     const std::vector<float>& stds,
+                     ImageFormat format,
+                     const ResizeFn& resize,
+                     int maxBatches,
+                     int threads);
+    ~CalibBatchStream();
+    CalibBatchStream(const CalibBatchStream&) = delete;
+    CalibBatchStream& operator=(const CalibBatchStream&) = delete;
+
+    /**
+     * Fill next batch into output of Volume() floats, next batch is decoded
+     * in background meanwhile. Return false after last batch, or if an image
+     * of batch can't be decoded or resized to input size.
+     */
+    bool Next(float* output);
+
+    /**
+     * Stream from first batch again.
+     */
+    void Reset();
+
+    int NbBatches() const {
+        return mNbBatches;
+    }
+
+    /**
+     * Floats of one batch.
+     */
+    size_t Volume() const {
+        return static_cast<size_t>(mBCHW[0]) * mBCHW[1] * mBCHW[2] * mBCHW[3];
+    }
+
+    /**
+     * Hash of image names, sizes and mtimes, and preprocessing params.
+     */
+    uint64_t Key() const;
+
+private:
+    bool load(int batch, std::vector<uint8_t>& nhwc);
+
+private:
+    logger::Logger mLogger;
+    std::vector<std::string> mFiles;
+    std::vector<int> mBCHW;
+    std::vector<float> mMeans;
+    std::vector<float> mStds;
+    ImageFormat mFormat;
+    ResizeFn mResize;
+    int mThreads;
+    int mNbBatches = 0;
+    int mBatch = 0;  // index of batch returned by next call
+    std::vector<uint8_t> mCurrent;
+    std::vector<uint8_t> mPrefetched;
+    std::future<bool> mPrefetch;
+};
+
+/**
+ * Calibrator feeding batches of stream to TensorRT, owns stream. Key of cache
+ * is modelKey(e.g. onnx hash) mixed with key of stream and algorithm.
+ * cacheFile: calibration cache, empty for no cache.
+ */
+nvinfer1::IInt8Calibrator* createInt8Calibrator(CalibAlgorithm algorithm,
+                                                std::unique_ptr<CalibBatchStream> stream,
+                                                const std::string& cacheFile,
+                                                uint64_t modelKey);
+
+CalibAlgorithm parseCalibAlgorithm(const std::string& name);
+
+#endif  // CALIBRATOR_H
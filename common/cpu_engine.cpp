@@ -0,0 +1,1006 @@
+/**
+ * CPU inference backend.
+ * 2021/04/12
+ */
+#include "cpu_engine.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <thread>
+
+#include "cpu_kernels.h"
+#include "onnx_info.h"
+#include "tensor_record.h"
+
+/* -==================Model================*/
+enum class CpuOpType : int {
+    kConv,
+    kDepthwiseConv,
+    kFullyConnected,
+    kScale,          // y = x * weight[c] + bias[c], BatchNormalization not folded into conv
+    kActivation,
+    kBinary,
+    kGlobalAvgPool,
+    kPool,
+    kSoftmax,
+    kConcat
+};
+
+enum class CpuBinary : int {
+    kAdd,
+    kSub,
+    kMul,
+    kDiv
+};
+
+struct CpuTensor {
+    std::string name;
+    std::vector<int> dims;   // of one image, batch is excluded
+    size_t volume = 1;
+    int buffer   = -1;       // buffer of engine, views share buffer of their input
+    int constant = -1;       // constant of model if buffer is -1
+};
+
+struct CpuOp {
+    CpuOpType type;
+    std::string name;
+    std::vector<int> inputs;   // index of tensors
+    int output = -1;
+    CpuActParams act;
+    std::vector<float> weight;
+    std::vector<float> bias;
+    // conv and pooling
+    int group    = 1;
+    int kernel_h = 1, kernel_w = 1;
+    int stride_h = 1, stride_w = 1;
+    int pad_h    = 0, pad_w    = 0;
+    int pad_bottom = 0, pad_right = 0;
+    int dilation_h = 1, dilation_w = 1;
+    bool pointwise = false;          // 1x1 conv reads input as columns, no im2col
+    bool max_pool = false;
+    bool count_include_pad = false;
+    CpuBinary binary = CpuBinary::kAdd;
+    // broadcast of binary(second input is repeated outer times and every value of it
+    // inner times), softmax and concat split data as [outer, n, inner]
+    int outer = 1;
+    int inner = 1;
+    int n     = 1;
+};
+
+struct CpuModel {
+    std::vector<CpuTensor> tensors;
+    std::vector<CpuOp> ops;
+    std::vector<std::vector<float>> constants;
+    std::vector<int> bindings;   // tensor of every binding, inputs first
+    int nb_inputs  = 0;
+    int nb_buffers = 0;
+    size_t scratch = 0;          // floats of im2col columns of one image
+};
+
+static size_t dimsVolume(const std::vector<int>& dims) {
+    size_t volume = 1;
+    for (int dim : dims) {
+        volume *= dim;
+    }
+    return volume;
+}
+
+static std::string dimsText(const std::vector<int>& dims) {
+    return dimsString(std::vector<int64_t>(dims.begin(), dims.end()));
+}
+
+/**
+ * Plan of onnx graph for cpu backend.
+ */
+class CpuModelBuilder {
+public:
+    CpuModelBuilder(const OnnxGraph& graph, logger::Logger& logger) : mGraph(graph), mLogger(logger) {}
+
+    std::shared_ptr<CpuModel> Build(const std::vector<int>& inputShape, const std::vector<std::string>& customOutput) {
+        mModel = std::make_shared<CpuModel>();
+        const std::vector<OnnxNode>& nodes = mGraph.nodes;
+        mSkipped.assign(nodes.size(), false);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            for (const auto& name : nodes[i].inputs) {
+                if (!name.empty()) mConsumers[name].emplace_back(i);
+            }
+            for (const auto& name : nodes[i].outputs) {
+                mProducer[name] = i;
+            }
+        }
+        for (const auto& output : mGraph.info.outputs) {
+            mPinned.insert(output.name);
+        }
+        mPinned.insert(customOutput.begin(), customOutput.end());
+        findHardSwish();
+
+        for (const auto& input : mGraph.info.inputs) {
+            std::vector<int> dims;
+            for (size_t d = 1; d < input.dims.size(); ++d) {
+                // symbolic dims of nchw input take bchw
+                int dim = static_cast<int>(input.dims[d]);
+                if (dim < 0 && input.dims.size() == inputShape.size() && mModel->bindings.empty()) dim = inputShape[d];
+                dims.emplace_back(dim);
+            }
+            if (input.elem_type != 1 || input.dims.empty() || std::any_of(dims.begin(), dims.end(), [](int dim) { return dim <= 0; })) {
+                mLogger.logger("CPU backend needs float input of known dims: ", input.name, dimsString(input.dims), logger::LEVEL::ERROR);
+                return nullptr;
+            }
+            mModel->bindings.emplace_back(addTensor(input.name, dims));
+        }
+        mModel->nb_inputs = static_cast<int>(mModel->bindings.size());
+
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (mSkipped[i]) continue;
+            if (!lowerNode(i)) return nullptr;
+        }
+
+        std::vector<std::string> outputs;
+        for (const auto& output : mGraph.info.outputs) {
+            outputs.emplace_back(output.name);
+        }
+        outputs.insert(outputs.end(), customOutput.begin(), customOutput.end());
+        for (const auto& name : outputs) {
+            auto found = mTensors.find(name);
+            if (found == mTensors.end() || mModel->tensors[found->second].buffer < 0) {
+                mLogger.logger("Output is not computed by cpu backend: ", name, logger::LEVEL::ERROR);
+                return nullptr;
+            }
+            if (mModel->tensors[found->second].dims.size() + 1 > static_cast<size_t>(nvinfer1::Dims::MAX_DIMS)) {
+                mLogger.logger("Too many dims of output: ", name, logger::LEVEL::ERROR);
+                return nullptr;
+            }
+            mModel->bindings.emplace_back(found->second);
+        }
+        return mModel;
+    }
+
+private:
+    bool fail(const OnnxNode& node, const std::string& reason) {
+        mLogger.logger("CPU backend can't run node: ", node.name + "(" + node.op_type + ")", ", " + reason, logger::LEVEL::ERROR);
+        return false;
+    }
+
+    int addTensor(const std::string& name, const std::vector<int>& dims) {
+        CpuTensor tensor;
+        tensor.name   = name;
+        tensor.dims   = dims;
+        tensor.volume = dimsVolume(dims);
+        tensor.buffer = mModel->nb_buffers++;
+        mModel->tensors.emplace_back(tensor);
+        mTensors[name] = static_cast<int>(mModel->tensors.size()) - 1;
+        return mTensors[name];
+    }
+
+    /**
+     * Tensor with dims of view op, sharing data of source.
+     */
+    int addView(const std::string& name, int source, const std::vector<int>& dims) {
+        CpuTensor tensor = mModel->tensors[source];
+        tensor.name = name;
+        tensor.dims = dims;
+        mModel->tensors.emplace_back(tensor);
+        mTensors[name] = static_cast<int>(mModel->tensors.size()) - 1;
+        return mTensors[name];
+    }
+
+    const OnnxTensor* initializer(const std::string& name) const {
+        auto found = mGraph.initializers.find(name);
+        return found == mGraph.initializers.end() ? nullptr : &found->second;
+    }
+
+    /**
+     * Index of tensor, initializers are added as constant(dims as onnx) on first
+     * use. -1 if tensor is unknown.
+     */
+    int tensorOf(const std::string& name) {
+        auto found = mTensors.find(name);
+        if (found != mTensors.end()) return found->second;
+        const OnnxTensor* init = initializer(name);
+        if (init == nullptr) return -1;
+        CpuTensor tensor;
+        tensor.name = name;
+        tensor.dims.assign(init->dims.begin(), init->dims.end());
+        tensor.volume = init->floats.size();
+        tensor.constant = static_cast<int>(mModel->constants.size());
+        mModel->constants.emplace_back(init->floats);
+        mModel->tensors.emplace_back(tensor);
+        mTensors[name] = static_cast<int>(mModel->tensors.size()) - 1;
+        return mTensors[name];
+    }
+
+    bool isConstant(int tensor) const {
+        return mModel->tensors[tensor].buffer < 0;
+    }
+
+    /**
+     * Node consuming tensor if it's the only consumer and tensor is not an
+     * output, -1 otherwise.
+     */
+    int singleConsumer(const std::string& name) const {
+        auto found = mConsumers.find(name);
+        if (found == mConsumers.end() || found->second.size() != 1 || mPinned.count(name)) return -1;
+        return static_cast<int>(found->second[0]);
+    }
+
+    // Mul(x, HardSigmoid(x)) of torch hardswish export
+    void findHardSwish() {
+        const std::vector<OnnxNode>& nodes = mGraph.nodes;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const OnnxNode& mul = nodes[i];
+            if (mul.op_type != "Mul" || mul.inputs.size() != 2) continue;
+            for (int k = 0; k < 2; ++k) {
+                auto producer = mProducer.find(mul.inputs[k]);
+                if (producer == mProducer.end()) continue;
+                const OnnxNode& hs = nodes[producer->second];
+                if (hs.op_type != "HardSigmoid" || hs.inputs[0] != mul.inputs[1 - k]
+                    || singleConsumer(mul.inputs[k]) != static_cast<int>(i)) continue;
+                CpuActParams act;
+                act.type = CpuActivation::kHardSwish;
+                act.a = hs.GetFloat("alpha", 0.2f);
+                act.b = hs.GetFloat("beta", 0.5f);
+                mHardSwish[i] = act;
+                mHardSwishInput[i] = hs.inputs[0];
+                mSkipped[producer->second] = true;
+                // x is consumed by Mul only now, so it's fused into conv producing x
+                auto& consumers = mConsumers[hs.inputs[0]];
+                consumers.erase(std::remove(consumers.begin(), consumers.end(), producer->second), consumers.end());
+                break;
+            }
+        }
+    }
+
+    /**
+     * Activation of node, false if it's not a supported activation.
+     */
+    bool activationOf(size_t index, CpuActParams& act) const {
+        const OnnxNode& node = mGraph.nodes[index];
+        auto hard_swish = mHardSwish.find(index);
+        if (hard_swish != mHardSwish.end()) {
+            act = hard_swish->second;
+            return true;
+        }
+        if (node.op_type == "Relu") {
+            act.type = CpuActivation::kRelu;
+        } else if (node.op_type == "Sigmoid") {
+            act.type = CpuActivation::kSigmoid;
+        } else if (node.op_type == "HardSigmoid" || node.op_type == "HardSwish") {
+            bool swish = node.op_type == "HardSwish";
+            act.type = swish ? CpuActivation::kHardSwish : CpuActivation::kHardSigmoid;
+            act.a = swish ? 1.f / 6 : node.GetFloat("alpha", 0.2f);
+            act.b = swish ? 0.5f : node.GetFloat("beta", 0.5f);
+        } else if (node.op_type == "Clip") {
+            // min/max are attributes before opset 11 and optional inputs since
+            act.type = CpuActivation::kClip;
+            act.a = node.GetFloat("min", -FLT_MAX);
+            act.b = node.GetFloat("max", FLT_MAX);
+            for (size_t i = 1; i < node.inputs.size() && i < 3; ++i) {
+                if (node.inputs[i].empty()) continue;
+                const OnnxTensor* limit = initializer(node.inputs[i]);
+                if (limit == nullptr || limit->floats.size() != 1) return false;
+                (i == 1 ? act.a : act.b) = limit->floats[0];
+            }
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Fold BatchNormalization following weights of op into them, then take
+     * activation following them as epilogue. Return output tensor name.
+     */
+    std::string fuseEpilogue(CpuOp& op, const std::string& output, bool foldBatchNorm) {
+        std::string name = output;
+        int next = singleConsumer(name);
+        if (foldBatchNorm && next >= 0 && mGraph.nodes[next].op_type == "BatchNormalization" && mGraph.nodes[next].inputs[0] == name) {
+            const OnnxNode& bn = mGraph.nodes[next];
+            std::vector<float> scale, shift;
+            if (batchNormAffine(bn, static_cast<int>(op.bias.size()), scale, shift)) {
+                size_t per_channel = op.weight.size() / op.bias.size();
+                for (size_t c = 0; c < op.bias.size(); ++c) {
+                    for (size_t k = 0; k < per_channel; ++k) {
+                        op.weight[c * per_channel + k] *= scale[c];
+                    }
+                    op.bias[c] = op.bias[c] * scale[c] + shift[c];
+                }
+                mSkipped[next] = true;
+                name = bn.outputs[0];
+                next = singleConsumer(name);
+            }
+        }
+        if (next >= 0 && !mSkipped[next] && activationInput(next) == name && activationOf(next, op.act)) {
+            mSkipped[next] = true;
+            name = mGraph.nodes[next].outputs[0];
+        }
+        return name;
+    }
+
+    // activation input of node, x of Mul(x, HardSigmoid(x)) for HardSwish
+    std::string activationInput(size_t index) const {
+        auto hard_swish = mHardSwishInput.find(index);
+        if (hard_swish != mHardSwishInput.end()) return hard_swish->second;
+        const OnnxNode& node = mGraph.nodes[index];
+        return node.inputs.empty() ? "" : node.inputs[0];
+    }
+
+    // y = x * scale + shift of BatchNormalization
+    bool batchNormAffine(const OnnxNode& node, int channels, std::vector<float>& scale, std::vector<float>& shift) const {
+        if (node.inputs.size() < 5) return false;
+        const OnnxTensor* gamma = initializer(node.inputs[1]);
+        const OnnxTensor* beta  = initializer(node.inputs[2]);
+        const OnnxTensor* mean  = initializer(node.inputs[3]);
+        const OnnxTensor* var   = initializer(node.inputs[4]);
+        size_t c = static_cast<size_t>(channels);
+        if (!gamma || !beta || !mean || !var || gamma->floats.size() != c || beta->floats.size() != c
+            || mean->floats.size() != c || var->floats.size() != c) {
+            return false;
+        }
+        float eps = node.GetFloat("epsilon", 1e-5f);
+        scale.resize(c);
+        shift.resize(c);
+        for (size_t i = 0; i < c; ++i) {
+            scale[i] = gamma->floats[i] / std::sqrt(var->floats[i] + eps);
+            shift[i] = beta->floats[i] - mean->floats[i] * scale[i];
+        }
+        return true;
+    }
+
+    /**
+     * Input of node as tensor computed before, constant is not accepted.
+     */
+    bool variableInput(const OnnxNode& node, size_t i, int& tensor) {
+        tensor = i < node.inputs.size() ? tensorOf(node.inputs[i]) : -1;
+        return tensor >= 0 && !isConstant(tensor);
+    }
+
+    // onnx axis(batch is 0) of tensor with rank dims(batch excluded) to axis of dims
+    static bool imageAxis(int64_t axis, size_t rank, int& image_axis) {
+        if (axis < 0) axis += static_cast<int64_t>(rank) + 1;
+        image_axis = static_cast<int>(axis) - 1;
+        return image_axis >= 0 && image_axis < static_cast<int>(rank);
+    }
+
+    bool lowerNode(size_t index) {
+        const OnnxNode& node = mGraph.nodes[index];
+        const std::string& type = node.op_type;
+        // weights are not copied as constants, ops read them from initializers
+        for (const auto& name : node.inputs) {
+            bool hard_swish = mHardSwishInput.count(index) && name != mHardSwishInput[index];
+            if (!name.empty() && !hard_swish && !mTensors.count(name) && !initializer(name)) {
+                return fail(node, "input is not computed before: " + name);
+            }
+        }
+        CpuActParams act;
+        if (type == "Conv") return lowerConv(node);
+        if (type == "Gemm" || type == "MatMul") return lowerFullyConnected(node);
+        if (type == "BatchNormalization") return lowerBatchNorm(node);
+        if (type == "Add" || type == "Sub" || type == "Mul" || type == "Div") {
+            if (mHardSwish.count(index)) return lowerActivation(node, activationInput(index), mHardSwish[index]);
+            return lowerBinary(node);
+        }
+        if (activationOf(index, act)) return lowerActivation(node, node.inputs[0], act);
+        if (type == "GlobalAveragePool" || type == "ReduceMean") return lowerGlobalAvgPool(node);
+        if (type == "MaxPool" || type == "AveragePool") return lowerPool(node);
+        if (type == "Softmax") return lowerSoftmax(node);
+        if (type == "Concat") return lowerConcat(node);
+        if (type == "Identity" || type == "Dropout" || type == "Flatten" || type == "Reshape"
+            || type == "Squeeze" || type == "Unsqueeze") {
+            return lowerView(node);
+        }
+        return fail(node, "op is not supported");
+    }
+
+    bool lowerConv(const OnnxNode& node) {
+        int x;
+        const OnnxTensor* w = node.inputs.size() > 1 ? initializer(node.inputs[1]) : nullptr;
+        const OnnxTensor* b = node.inputs.size() > 2 && !node.inputs[2].empty() ? initializer(node.inputs[2]) : nullptr;
+        if (!variableInput(node, 0, x) || mModel->tensors[x].dims.size() != 3) return fail(node, "input is not nchw");
+        if (w == nullptr || w->dims.size() != 4) return fail(node, "weight is not a 4d constant");
+        std::string auto_pad = node.GetString("auto_pad", "NOTSET");
+        if (auto_pad != "NOTSET" && auto_pad != "VALID") return fail(node, "auto_pad " + auto_pad);
+        const std::vector<int>& in = mModel->tensors[x].dims;
+        std::vector<int64_t> strides = node.GetInts("strides");
+        std::vector<int64_t> pads = node.GetInts("pads");
+        std::vector<int64_t> dilations = node.GetInts("dilations");
+        CpuOp op;
+        op.type       = CpuOpType::kConv;
+        op.name       = node.name;
+        op.inputs     = {x};
+        op.group      = static_cast<int>(node.GetInt("group", 1));
+        op.kernel_h   = static_cast<int>(w->dims[2]);
+        op.kernel_w   = static_cast<int>(w->dims[3]);
+        op.stride_h   = strides.size() == 2 ? static_cast<int>(strides[0]) : 1;
+        op.stride_w   = strides.size() == 2 ? static_cast<int>(strides[1]) : 1;
+        op.pad_h      = pads.size() == 4 ? static_cast<int>(pads[0]) : 0;
+        op.pad_w      = pads.size() == 4 ? static_cast<int>(pads[1]) : 0;
+        op.dilation_h = dilations.size() == 2 ? static_cast<int>(dilations[0]) : 1;
+        op.dilation_w = dilations.size() == 2 ? static_cast<int>(dilations[1]) : 1;
+        int pad_bottom = pads.size() == 4 ? static_cast<int>(pads[2]) : 0;
+        int pad_right  = pads.size() == 4 ? static_cast<int>(pads[3]) : 0;
+        int channels = static_cast<int>(w->dims[0]);
+        if (op.group <= 0 || in[0] % op.group != 0 || channels % op.group != 0 || w->dims[1] * op.group != in[0]) {
+            return fail(node, "channels of weight mismatch input " + dimsText(in));
+        }
+        int out_h = (in[1] + op.pad_h + pad_bottom - op.dilation_h * (op.kernel_h - 1) - 1) / op.stride_h + 1;
+        int out_w = (in[2] + op.pad_w + pad_right - op.dilation_w * (op.kernel_w - 1) - 1) / op.stride_w + 1;
+        if (out_h <= 0 || out_w <= 0) return fail(node, "empty output");
+        op.weight = w->floats;
+        op.bias.assign(channels, 0.f);
+        if (b != nullptr && b->floats.size() == op.bias.size()) op.bias = b->floats;
+        if (op.group > 1 && op.group == in[0] && channels == in[0]) {
+            op.type = CpuOpType::kDepthwiseConv;
+        } else {
+            op.pointwise = op.kernel_h == 1 && op.kernel_w == 1 && op.stride_h == 1 && op.stride_w == 1
+                           && op.pad_h == 0 && op.pad_w == 0 && out_h == in[1] && out_w == in[2];
+            if (!op.pointwise) {
+                size_t cols = static_cast<size_t>(in[0] / op.group) * op.kernel_h * op.kernel_w * out_h * out_w;
+                mModel->scratch = std::max(mModel->scratch, cols);
+            }
+        }
+        std::string output = fuseEpilogue(op, node.outputs[0], true);
+        op.output = addTensor(output, {channels, out_h, out_w});
+        mModel->ops.emplace_back(op);
+        return true;
+    }
+
+    // Gemm(x, B, C) and MatMul(x, B) with constant B on flattened image
+    bool lowerFullyConnected(const OnnxNode& node) {
+        int x;
+        if (!variableInput(node, 0, x)) return fail(node, "input is constant");
+        const OnnxTensor* w = initializer(node.inputs[1]);
+        if (w == nullptr || w->dims.size() != 2) return fail(node, "weight is not a 2d constant");
+        bool gemm = node.op_type == "Gemm";
+        if (gemm && node.GetInt("transA", 0) != 0) return fail(node, "transA");
+        if (!gemm && mModel->tensors[x].dims.size() != 1) return fail(node, "input is not 2d");
+        bool trans_b = gemm && node.GetInt("transB", 0) != 0;
+        float alpha = gemm ? node.GetFloat("alpha", 1.f) : 1.f;
+        float beta = gemm ? node.GetFloat("beta", 1.f) : 1.f;
+        int k = static_cast<int>(trans_b ? w->dims[1] : w->dims[0]);
+        int n = static_cast<int>(trans_b ? w->dims[0] : w->dims[1]);
+        if (static_cast<size_t>(k) != mModel->tensors[x].volume) return fail(node, "weight mismatch input " + dimsText(mModel->tensors[x].dims));
+        CpuOp op;
+        op.type   = CpuOpType::kFullyConnected;
+        op.name   = node.name;
+        op.inputs = {x};
+        // weight as [n, k], rows are dot with input
+        op.weight.resize(static_cast<size_t>(n) * k);
+        for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < k; ++j) {
+                op.weight[i * k + j] = alpha * (trans_b ? w->floats[i * k + j] : w->floats[j * n + i]);
+            }
+        }
+        op.bias.assign(n, 0.f);
+        if (gemm && node.inputs.size() > 2 && !node.inputs[2].empty()) {
+            const OnnxTensor* c = initializer(node.inputs[2]);
+            if (c == nullptr || (c->floats.size() != 1 && c->floats.size() != static_cast<size_t>(n))) return fail(node, "bias is not a constant of n");
+            for (int i = 0; i < n; ++i) {
+                op.bias[i] = beta * c->floats[c->floats.size() == 1 ? 0 : i];
+            }
+        }
+        std::string output = fuseEpilogue(op, node.outputs[0], false);
+        op.output = addTensor(output, {n});
+        mModel->ops.emplace_back(op);
+        return true;
+    }
+
+    bool lowerBatchNorm(const OnnxNode& node) {
+        int x;
+        if (!variableInput(node, 0, x) || mModel->tensors[x].dims.empty()) return fail(node, "input is constant");
+        const std::vector<int>& dims = mModel->tensors[x].dims;
+        CpuOp op;
+        op.type   = CpuOpType::kScale;
+        op.name   = node.name;
+        op.inputs = {x};
+        if (!batchNormAffine(node, dims[0], op.weight, op.bias)) return fail(node, "params are not constants of channels");
+        op.output = addTensor(node.outputs[0], dims);
+        mModel->ops.emplace_back(op);
+        return true;
+    }
+
+    bool lowerActivation(const OnnxNode& node, const std::string& input, const CpuActParams& act) {
+        int x = tensorOf(input);
+        if (x < 0 || isConstant(x)) return fail(node, "input is constant");
+        CpuOp op;
+        op.type   = CpuOpType::kActivation;
+        op.name   = node.name;
+        op.inputs = {x};
+        op.act    = act;
+        op.output = addTensor(node.outputs[0], mModel->tensors[x].dims);
+        mModel->ops.emplace_back(op);
+        return true;
+    }
+
+    bool lowerBinary(const OnnxNode& node) {
+        int a = tensorOf(node.inputs[0]);
+        int b = tensorOf(node.inputs[1]);
+        CpuOp op;
+        op.type   = CpuOpType::kBinary;
+        op.name   = node.name;
+        op.binary = node.op_type == "Add" ? CpuBinary::kAdd
+                    : node.op_type == "Sub" ? CpuBinary::kSub
+                    : node.op_type == "Mul" ? CpuBinary::kMul : CpuBinary::kDiv;
+        bool commutative = op.binary == CpuBinary::kAdd || op.binary == CpuBinary::kMul;
+        // first input has dims of output, second one is broadcast
+        bool swap = isConstant(a) || (!isConstant(b) && mModel->tensors[a].volume < mModel->tensors[b].volume);
+        if (swap) {
+            if (!commutative) return fail(node, "first input is broadcast");
+            std::swap(a, b);
+        }
+        if (isConstant(a)) return fail(node, "both inputs are constant");
+        if (mModel->tensors[b].volume == 0) return fail(node, "input is not float");
+        const std::vector<int>& dims = mModel->tensors[a].dims;
+        std::vector<int> broadcast = mModel->tensors[b].dims;
+        // constant of onnx has batch dim if its rank is that of input
+        if (isConstant(b) && broadcast.size() == dims.size() + 1 && broadcast[0] == 1) broadcast.erase(broadcast.begin());
+        if (broadcast.size() > dims.size()) return fail(node, "broadcast " + dimsText(broadcast) + " to " + dimsText(dims));
+        broadcast.insert(broadcast.begin(), dims.size() - broadcast.size(), 1);
+        // dims of broadcast input must be 1, ..., 1, d_i, ..., d_j, 1, ..., 1 with d of input
+        int first = 0, last = static_cast<int>(dims.size()) - 1;
+        while (first <= last && broadcast[first] == 1) first++;
+        while (last >= first && broadcast[last] == 1) last--;
+        for (int i = first; i <= last; ++i) {
+            if (broadcast[i] != dims[i]) return fail(node, "broadcast " + dimsText(broadcast) + " to " + dimsText(dims));
+        }
+        op.inputs = {a, b};
+        op.n = static_cast<int>(mModel->tensors[b].volume);
+        op.inner = 1;
+        for (int i = last + 1; i < static_cast<int>(dims.size()); ++i) {
+            op.inner *= dims[i];
+        }
+        if (first > last) op.inner = static_cast<int>(mModel->tensors[a].volume);  // scalar
+        op.outer = static_cast<int>(mModel->tensors[a].volume / (static_cast<size_t>(op.n) * op.inner));
+        op.output = addTensor(node.outputs[0], dims);
+        mModel->ops.emplace_back(op);
+        return true;
+    }
+
+    bool lowerGlobalAvgPool(const OnnxNode& node) {
+        int x;
+        if (!variableInput(node, 0, x) || mModel->tensors[x].dims.size() != 3) return fail(node, "input is not nchw");
+        const std::vector<int>& dims = mModel->tensors[x].dims;
+        bool keep_dims = true;
+        if (node.op_type == "ReduceMean") {
+            std::vector<int64_t> axes = node.GetInts("axes");
+            for (auto& axis : axes) {
+                if (axis < 0) axis += 4;
+            }
+            std::sort(axes.begin(), axes.end());
+            if (axes != std::vector<int64_t>{2, 3}) return fail(node, "axes other than h, w");
+            keep_dims = node.GetInt("keepdims", 1) != 0;
+        }
+        CpuOp op;
+        op.type   = CpuOpType::kGlobalAvgPool;
+        op.name   = node.name;
+        op.inputs = {x};
+        op.output = addTensor(node.outputs[0], keep_dims ? std::vector<int>{dims[0], 1, 1} : std::vector<int>{dims[0]});
+        mModel->ops.emplace_back(op);
+        return true;
+    }
+
+    bool lowerPool(const OnnxNode& node) {
+        int x;
+        if (!variableInput(node, 0, x) || mModel->tensors[x].dims.size() != 3) return fail(node, "input is not nchw");
+        std::string auto_pad = node.GetString("auto_pad", "NOTSET");
+        std::vector<int64_t> kernel = node.GetInts("kernel_shape");
+        std::vector<int64_t> strides = node.GetInts("strides");
+        std::vector<int64_t> pads = node.GetInts("pads");
+        std::vector<int64_t> dilations = node.GetInts("dilations");
+        if (auto_pad != "NOTSET" && auto_pad != "VALID") return fail(node, "auto_pad " + auto_pad);
+        if (kernel.size() != 2) return fail(node, "kernel is not 2d");
+        for (auto dilation : dilations) {
+            if (dilation != 1) return fail(node, "dilation");
+        }
+        const std::vector<int>& in = mModel->tensors[x].dims;
+        CpuOp op;
+        op.type     = CpuOpType::kPool;
+        op.name     = node.name;
+        op.inputs   = {x};
+        op.max_pool = node.op_type == "MaxPool";
+        op.count_include_pad = node.GetInt("count_include_pad", 0) != 0;
+        op.kernel_h = static_cast<int>(kernel[0]);
+        op.kernel_w = static_cast<int>(kernel[1]);
+        op.stride_h = strides.size() == 2 ? static_cast<int>(strides[0]) : 1;
+        op.stride_w = strides.size() == 2 ? static_cast<int>(strides[1]) : 1;
+        op.pad_h    = pads.size() == 4 ? static_cast<int>(pads[0]) : 0;
+        op.pad_w    = pads.size() == 4 ? static_cast<int>(pads[1]) : 0;
+        op.pad_bottom = pads.size() == 4 ? static_cast<int>(pads[2]) : 0;
+        op.pad_right  = pads.size() == 4 ? static_cast<int>(pads[3]) : 0;
+        bool ceil_mode = node.GetInt("ceil_mode", 0) != 0;
+        auto outSize = [=](int size, int kernel, int stride, int pad, int pad_end) {
+            int span = size + pad + pad_end - kernel;
+            int out = (ceil_mode ? (span + stride - 1) / stride : span / stride) + 1;
+            // last window of ceil mode starts in input or its begin padding
+            if (ceil_mode && (out - 1) * stride >= size + pad) out--;
+            return out;
+        };
+        int out_h = outSize(in[1], op.kernel_h, op.stride_h, op.pad_h, op.pad_bottom);
+        int out_w = outSize(in[2], op.kernel_w, op.stride_w, op.pad_w, op.pad_right);
+        if (out_h <= 0 || out_w <= 0) return fail(node, "empty output");
+        op.output = addTensor(node.outputs[0], {in[0], out_h, out_w});
+        mModel->ops.emplace_back(op);
+        return true;
+    }
+
+    bool lowerSoftmax(const OnnxNode& node) {
+        int x;
+        if (!variableInput(node, 0, x)) return fail(node, "input is constant");
+        const std::vector<int>& dims = mModel->tensors[x].dims;
+        // softmax of opset < 13 runs on input flattened to 2d at axis
+        bool flatten = mGraph.info.opset < 13;
+        int axis;
+        if (!imageAxis(node.GetInt("axis", flatten ? 1 : -1), dims.size(), axis)) return fail(node, "softmax over batch");
+        CpuOp op;
+        op.type   = CpuOpType::kSoftmax;
+        op.name   = node.name;
+        op.inputs = {x};
+        op.outer  = static_cast<int>(dimsVolume(std::vector<int>(dims.begin(), dims.begin() + axis)));
+        op.n      = flatten ? static_cast<int>(dimsVolume(std::vector<int>(dims.begin() + axis, dims.end()))) : dims[axis];
+        op.inner  = flatten ? 1 : static_cast<int>(dimsVolume(std::vector<int>(dims.begin() + axis + 1, dims.end())));
+        op.output = addTensor(node.outputs[0], dims);
+        mModel->ops.emplace_back(op);
+        return true;
+    }
+
+    bool lowerConcat(const OnnxNode& node) {
+        CpuOp op;
+        op.type = CpuOpType::kConcat;
+        op.name = node.name;
+        std::vector<int> dims;
+        int axis = 0;
+        for (size_t i = 0; i < node.inputs.size(); ++i) {
+            int x;
+            if (!variableInput(node, i, x)) return fail(node, "input is constant");
+            const std::vector<int>& in = mModel->tensors[x].dims;
+            if (i == 0) {
+                if (!imageAxis(node.GetInt("axis", 1), in.size(), axis)) return fail(node, "concat over batch");
+                dims = in;
+                dims[axis] = 0;
+            }
+            bool match = in.size() == dims.size();
+            for (size_t d = 0; match && d < in.size(); ++d) {
+                match = static_cast<int>(d) == axis || in[d] == dims[d];
+            }
+            if (!match) return fail(node, "dims of inputs mismatch");
+            dims[axis] += in[axis];
+            op.inputs.emplace_back(x);
+        }
+        op.outer = static_cast<int>(dimsVolume(std::vector<int>(dims.begin(), dims.begin() + axis)));
+        op.inner = static_cast<int>(dimsVolume(std::vector<int>(dims.begin() + axis + 1, dims.end())));
+        op.output = addTensor(node.outputs[0], dims);
+        mModel->ops.emplace_back(op);
+        return true;
+    }
+
+    // ops changing dims only, output shares data of input
+    bool lowerView(const OnnxNode& node) {
+        int x = tensorOf(node.inputs[0]);
+        std::vector<int> in = mModel->tensors[x].dims;
+        std::vector<int> dims;
+        const std::string& type = node.op_type;
+        if (type == "Identity" || type == "Dropout") {
+            dims = in;
+        } else if (type == "Flatten") {
+            // axis of flatten is in [-rank, rank]
+            int64_t onnx_axis = node.GetInt("axis", 1);
+            if (onnx_axis < 0) onnx_axis += static_cast<int64_t>(in.size()) + 1;
+            if (onnx_axis < 1) return fail(node, "flatten with batch");
+            int axis = static_cast<int>(onnx_axis) - 1;
+            dims = {static_cast<int>(dimsVolume(std::vector<int>(in.begin(), in.begin() + axis))),
+                    static_cast<int>(dimsVolume(std::vector<int>(in.begin() + axis, in.end())))};
+            if (axis == 0) dims.erase(dims.begin());
+        } else if (type == "Reshape") {
+            const OnnxTensor* shape = node.inputs.size() > 1 ? initializer(node.inputs[1]) : nullptr;
+            if (shape == nullptr || shape->ints.empty()) return fail(node, "shape is not constant");
+            // first dim is batch(0, -1 or batch of export), rest is shape of image
+            int infer = -1;
+            for (size_t i = 1; i < shape->ints.size(); ++i) {
+                int64_t dim = shape->ints[i];
+                if (dim == 0 && i - 1 < in.size()) dim = in[i - 1];
+                if (dim == -1) infer = static_cast<int>(dims.size());
+                dims.emplace_back(static_cast<int>(dim));
+            }
+            size_t known = 1;
+            for (size_t i = 0; i < dims.size(); ++i) {
+                if (static_cast<int>(i) != infer) known *= dims[i];
+            }
+            if (infer >= 0 && known > 0) dims[infer] = static_cast<int>(mModel->tensors[x].volume / known);
+        } else if (type == "Squeeze" || type == "Unsqueeze") {
+            std::vector<int64_t> axes = node.GetInts("axes");
+            if (node.inputs.size() > 1 && initializer(node.inputs[1])) axes = initializer(node.inputs[1])->ints;
+            bool squeeze = type == "Squeeze";
+            size_t rank = in.size() + 1 + (squeeze ? 0 : axes.size());  // onnx rank of output for unsqueeze
+            std::set<int> image_axes;
+            for (auto axis : axes) {
+                int image_axis;
+                if (!imageAxis(axis, squeeze ? in.size() : rank - 1, image_axis)) return fail(node, "axis of batch");
+                image_axes.insert(image_axis);
+            }
+            if (squeeze) {
+                for (size_t i = 0; i < in.size(); ++i) {
+                    if (image_axes.count(static_cast<int>(i)) || (axes.empty() && in[i] == 1)) continue;
+                    dims.emplace_back(in[i]);
+                }
+            } else {
+                auto next = in.begin();
+                for (size_t i = 0; i + 1 < rank; ++i) {
+                    dims.emplace_back(image_axes.count(static_cast<int>(i)) ? 1 : *next++);
+                }
+            }
+        }
+        if (dimsVolume(dims) != mModel->tensors[x].volume) {
+            return fail(node, "volume of " + dimsText(dims) + " mismatch input " + dimsText(in));
+        }
+        addView(node.outputs[0], x, dims);
+        return true;
+    }
+
+private:
+    const OnnxGraph& mGraph;
+    logger::Logger& mLogger;
+    std::shared_ptr<CpuModel> mModel;
+    std::map<std::string, int> mTensors;
+    std::map<std::string, std::vector<size_t>> mConsumers;
+    std::map<std::string, size_t> mProducer;
+    std::set<std::string> mPinned;               // graph and custom outputs, never fused away
+    std::map<size_t, CpuActParams> mHardSwish;   // Mul nodes of HardSigmoid + Mul
+    std::map<size_t, std::string> mHardSwishInput;
+    std::vector<bool> mSkipped;                  // nodes fused into others
+};
+
+/* -==================Engine================*/
+void CpuEngine::SetInputShape(const std::vector<int>& bchw) {
+    mInputShape = bchw;
+}
+
+void CpuEngine::SetThreads(int threads) {
+    mThreads = std::max(threads, 1);
+}
+
+void CpuEngine::CreateEngine(const std::string& onnxModel,
+                             const std::string& engineFile,
+                             const std::vector<std::string>& customOutput,
+                             int maxBatchSize,
+                             RunMode runMode,
+                             long workspace_size) {
+    UNUSED(engineFile);
+    UNUSED(workspace_size);
+    if (runMode != RunMode::kFP32) {
+        mLogger.logger("CPU backend runs fp32 only, mode is ignored.", logger::LEVEL::WARNING);
+    }
+    OnnxGraph graph;
+    auto start = std::chrono::steady_clock::now();
+    if (!readOnnxGraph(onnxModel, graph)) {
+        mLogger.logger("Read onnx for cpu backend failed: ", onnxModel, logger::LEVEL::ERROR);
+        return;
+    }
+    auto read = std::chrono::steady_clock::now();
+    mStartup.Add(startup::kEngineRead, std::chrono::duration<double, std::milli>(read - start).count());
+    CpuModelBuilder builder(graph, mLogger);
+    mModel = builder.Build(mInputShape, customOutput);
+    if (!mModel) return;
+    mStartup.Add(startup::kBuild, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - read).count());
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    mLogger.logger("Plan cpu engine in ms: ", ms, ", ops: " + std::to_string(mModel->ops.size()) + " of nodes: "
+                   + std::to_string(graph.nodes.size()) + ", isa: " + cpuKernelIsa());
+    allocate(maxBatchSize);
+}
+
+void CpuEngine::allocate(int maxBatchSize) {
+    StartupStage stage(mStartup, startup::kBindings);
+    mBatchSize = maxBatchSize;
+    mCurBatch  = maxBatchSize;
+    mBuffers.assign(mModel->nb_buffers, std::vector<float>());
+    for (const auto& tensor : mModel->tensors) {
+        if (tensor.buffer >= 0 && mBuffers[tensor.buffer].empty()) mBuffers[tensor.buffer].assign(tensor.volume * maxBatchSize, 0.f);
+    }
+    mScratch.assign(mThreads, std::vector<float>(mModel->scratch));
+    mBindingName.clear();
+    for (size_t i = 0; i < mModel->bindings.size(); ++i) {
+        mBindingName.emplace_back(mModel->tensors[mModel->bindings[i]].name);
+        std::cout << "Binding bindIndex: " << i << ", Name: " << mBindingName[i] << ", Size in bytes: " << GetBindingSize(i) << std::endl;
+    }
+}
+
+InferBackend* CpuEngine::Clone() const {
+    CpuEngine* engine = new CpuEngine();
+    engine->mInputShape = mInputShape;
+    engine->mThreads = mThreads;
+    engine->SetRecorder(mRecorder);
+    engine->mModel = mModel;
+    if (mModel) engine->allocate(mBatchSize);
+    return engine;
+}
+
+float* CpuEngine::tensorData(int tensor, int batch) const {
+    const CpuTensor& t = mModel->tensors[tensor];
+    if (t.buffer < 0) return const_cast<float*>(mModel->constants[t.constant].data());
+    return const_cast<float*>(mBuffers[t.buffer].data()) + t.volume * batch;
+}
+
+template <typename Fn>
+static void binaryLoop(const float* a, const float* b, float* y, int outer, int n, int inner, Fn fn) {
+    for (int o = 0; o < outer; ++o) {
+        for (int k = 0; k < n; ++k) {
+            float v = b[k];
+            for (int i = 0; i < inner; ++i) {
+                *y++ = fn(*a++, v);
+            }
+        }
+    }
+}
+
+void CpuEngine::runImage(int batch, std::vector<float>& scratch) {
+    for (const CpuOp& op : mModel->ops) {
+        const CpuTensor& in = mModel->tensors[op.inputs[0]];
+        const CpuTensor& out = mModel->tensors[op.output];
+        const float* x = tensorData(op.inputs[0], batch);
+        float* y = tensorData(op.output, batch);
+        switch (op.type) {
+            case CpuOpType::kConv: {
+                int channels = in.dims[0] / op.group;
+                int outputs  = out.dims[0] / op.group;
+                int spatial  = out.dims[1] * out.dims[2];
+                int k = channels * op.kernel_h * op.kernel_w;
+                for (int g = 0; g < op.group; ++g) {
+                    const float* group_x = x + static_cast<size_t>(g) * channels * in.dims[1] * in.dims[2];
+                    const float* cols = group_x;
+                    if (!op.pointwise) {
+                        cpuIm2col(group_x, channels, in.dims[1], in.dims[2], op.kernel_h, op.kernel_w,
+                                  op.stride_h, op.stride_w, op.pad_h, op.pad_w, op.dilation_h, op.dilation_w,
+                                  out.dims[1], out.dims[2], scratch.data());
+                        cols = scratch.data();
+                    }
+                    cpuGemm(outputs, spatial, k, op.weight.data() + static_cast<size_t>(g) * outputs * k, k,
+                            cols, spatial, y + static_cast<size_t>(g) * outputs * spatial, spatial);
+                }
+                cpuBiasActivate(y, out.dims[0], spatial, op.bias.data(), op.act);
+                break;
+            }
+            case CpuOpType::kDepthwiseConv:
+                cpuDepthwiseConv(x, op.weight.data(), op.bias.data(), in.dims[0], in.dims[1], in.dims[2],
+                                 op.kernel_h, op.kernel_w, op.stride_h, op.stride_w, op.pad_h, op.pad_w,
+                                 op.dilation_h, op.dilation_w, out.dims[1], out.dims[2], y);
+                cpuBiasActivate(y, out.dims[0], out.dims[1] * out.dims[2], nullptr, op.act);
+                break;
+            case CpuOpType::kFullyConnected: {
+                int k = static_cast<int>(in.volume);
+                for (int i = 0; i < out.dims[0]; ++i) {
+                    y[i] = cpuDot(op.weight.data() + static_cast<size_t>(i) * k, x, k);
+                }
+                cpuBiasActivate(y, out.dims[0], 1, op.bias.data(), op.act);
+                break;
+            }
+            case CpuOpType::kScale: {
+                int spatial = static_cast<int>(in.volume / in.dims[0]);
+                binaryLoop(x, op.weight.data(), y, 1, in.dims[0], spatial, [](float a, float b) { return a * b; });
+                cpuBiasActivate(y, in.dims[0], spatial, op.bias.data(), op.act);
+                break;
+            }
+            case CpuOpType::kActivation:
+                memcpy(y, x, in.volume * sizeof(float));
+                cpuBiasActivate(y, 1, static_cast<int>(in.volume), nullptr, op.act);
+                break;
+            case CpuOpType::kBinary: {
+                const float* b = tensorData(op.inputs[1], batch);
+                switch (op.binary) {
+                    case CpuBinary::kAdd: binaryLoop(x, b, y, op.outer, op.n, op.inner, [](float u, float v) { return u + v; }); break;
+                    case CpuBinary::kSub: binaryLoop(x, b, y, op.outer, op.n, op.inner, [](float u, float v) { return u - v; }); break;
+                    case CpuBinary::kMul: binaryLoop(x, b, y, op.outer, op.n, op.inner, [](float u, float v) { return u * v; }); break;
+                    case CpuBinary::kDiv: binaryLoop(x, b, y, op.outer, op.n, op.inner, [](float u, float v) { return u / v; }); break;
+                }
+                break;
+            }
+            case CpuOpType::kGlobalAvgPool:
+                cpuGlobalAvgPool(x, in.dims[0], in.dims[1] * in.dims[2], y);
+                break;
+            case CpuOpType::kPool:
+                cpuPool(x, in.dims[0], in.dims[1], in.dims[2], op.kernel_h, op.kernel_w, op.stride_h, op.stride_w,
+                        op.pad_h, op.pad_w, op.pad_bottom, op.pad_right, out.dims[1], out.dims[2], op.max_pool, op.count_include_pad, y);
+                break;
+            case CpuOpType::kSoftmax:
+                cpuSoftmax(x, op.outer, op.n, op.inner, y);
+                break;
+            case CpuOpType::kConcat:
+                for (int o = 0; o < op.outer; ++o) {
+                    for (int input : op.inputs) {
+                        const CpuTensor& part = mModel->tensors[input];
+                        size_t chunk = part.volume / op.outer;
+                        memcpy(y, tensorData(input, batch) + o * chunk, chunk * sizeof(float));
+                        y += chunk;
+                    }
+                }
+                break;
+        }
+    }
+}
+
+void CpuEngine::Forward() {
+    if (!mModel) return;
+    int batch = mCurBatch;
+    int threads = std::min(static_cast<int>(mScratch.size()), batch);
+    auto work = [this, batch, threads](int first) {
+        for (int b = first; b < batch; b += threads) {
+            runImage(b, mScratch[first]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(work, t);
+    }
+    work(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (mRecorder) mRecorder->Record(*this, mCurBatch, nullptr);
+}
+
+void CpuEngine::ForwardAsync(const cudaStream_t& stream) {
+    UNUSED(stream);
+    Forward();
+}
+
+void CpuEngine::CopyFromHostToDevice(const std::vector<float>& input, int bindIndex) {
+    assert(input.size() * sizeof(float) >= GetBindingSize(bindIndex));
+    memcpy(GetBindingPtr(bindIndex), input.data(), GetBindingSize(bindIndex));
+}
+
+void CpuEngine::CopyFromDeviceToHost(std::vector<float>& output, int bindIndex) {
+    assert(output.size() * sizeof(float) >= GetBindingSize(bindIndex));
+    memcpy(output.data(), GetBindingPtr(bindIndex), GetBindingSize(bindIndex));
+}
+
+void CpuEngine::CopyFromHostToDevice(const std::vector<float>& input, int bindIndex, const cudaStream_t& stream) {
+    UNUSED(stream);
+    CopyFromHostToDevice(input, bindIndex);
+}
+
+void CpuEngine::CopyFromDeviceToHost(std::vector<float>& output, int bindIndex, const cudaStream_t& stream) {
+    UNUSED(stream);
+    CopyFromDeviceToHost(output, bindIndex);
+}
+
+int CpuEngine::GetMaxBatchSize() const {
+    return mBatchSize;
+}
+
+bool CpuEngine::SetBatchSize(int batch) {
+    assert(batch > 0 && batch <= mBatchSize);
+    mCurBatch = batch;
+    return true;
+}
+
+void* CpuEngine::GetBindingPtr(int bindIndex) const {
+    return tensorData(mModel->bindings[bindIndex], 0);
+}
+
+size_t CpuEngine::GetBindingSize(int bindIndex) const {
+    return mModel->tensors[mModel->bindings[bindIndex]].volume * mBatchSize * sizeof(float);
+}
+
+nvinfer1::Dims CpuEngine::GetBindingDims(int bindIndex) const {
+    const std::vector<int>& dims = mModel->tensors[mModel->bindings[bindIndex]].dims;
+    nvinfer1::Dims binding;
+    binding.nbDims = static_cast<int>(dims.size()) + 1;
+    binding.d[0] = mBatchSize;
+    for (size_t i = 0; i < dims.size(); ++i) {
+        binding.d[i + 1] = dims[i];
+    }
+    return binding;
+}
+
+nvinfer1::DataType CpuEngine::GetBindingDataType(int bindIndex) const {
+    UNUSED(bindIndex);
+    return nvinfer1::DataType::kFLOAT;
+}
+
+bool CpuEngine::BindingIsInput(int bindIndex) const {
+    return bindIndex < mModel->nb_inputs;
+}
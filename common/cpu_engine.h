@@ -0,0 +1,121 @@
+/**
+ * CPU inference backend for small classification models(MobileNet/ShuffleNet
+ * like), runs onnx directly without TensorRT or GPU. Graph is planned once at
+ * load: BatchNormalization is folded into Conv, activations(Relu, Clip,
+ * HardSigmoid, HardSwish, Sigmoid) into epilogue of Conv, HardSigmoid + Mul is
+ * HardSwish, and view ops(Reshape, Flatten, ...) share buffer of their input.
+ * Conv runs as im2col(or input itself for 1x1) + gemm, depthwise conv directly.
+ * Images of a batch are split over `cpu_threads` threads. fp32 only.
+ * Supported ops: Conv, BatchNormalization, Relu, Clip, Sigmoid, HardSigmoid,
+ * HardSwish, Add, Sub, Mul, Div, GlobalAveragePool, ReduceMean(h, w), MaxPool,
+ * AveragePool, Gemm, MatMul(constant B), Softmax, Concat, Flatten, Reshape,
+ * Squeeze, Unsqueeze, Identity, Dropout. Model with other ops fails to load.
+ * 2021/04/12
+ */
+
+#ifndef CPU_ENGINE_H
+#define CPU_ENGINE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "NvInfer.h"
+#include "backend.h"
+#include "logger.h"
+#include "utils.h"
+
+struct CpuModel;
+
+class CpuEngine : public InferBackend {
+public:
+    CpuEngine() = default;
+    ~CpuEngine() = default;
+
+    /**
+     * bchw of input, for symbolic dims of onnx input. Call before CreateEngine.
+     */
+    void SetInputShape(const std::vector<int>& bchw);
+
+    /**
+     * Threads splitting images of a batch in forward, 1 by default.
+     */
+    void SetThreads(int threads);
+
+    /**
+     * Load and plan onnx, allocate bindings of maxBatchSize. customOutput are
+     * extra tensors bound as outputs. engineFile and workspace are ignored,
+     * runMode other than fp32 runs fp32 with a warning. Bindings are empty if
+     * model fails to load.
+     */
+    void CreateEngine(const std::string& onnxModel,
+                      const std::string& engineFile,
+                      const std::vector<std::string>& customOutput,
+                      int maxBatchSize,
+                      RunMode runMode,
+                      long workspace_size) override;
+
+    /**
+     * Shares planned model and weights, owns its buffers.
+     */
+    InferBackend* Clone() const override;
+
+    void Forward() override;
+
+    void ForwardAsync(const cudaStream_t& stream) override;
+
+    void CopyFromHostToDevice(const std::vector<float>& input, int bindIndex) override;
+
+    void CopyFromDeviceToHost(std::vector<float>& output, int bindIndex) override;
+
+    void CopyFromHostToDevice(const std::vector<float>& input, int bindIndex, const cudaStream_t& stream) override;
+
+    void CopyFromDeviceToHost(std::vector<float>& output, int bindIndex, const cudaStream_t& stream) override;
+
+    BackendType GetBackendType() const override {
+        return BackendType::kCPU;
+    }
+
+    bool IsDeviceMemory() const override {
+        return false;
+    }
+
+    int GetMaxBatchSize() const override;
+
+    /**
+     * Forward runs only images of batch.
+     */
+    bool SetBatchSize(int batch) override;
+
+    void* GetBindingPtr(int bindIndex) const override;
+
+    size_t GetBindingSize(int bindIndex) const override;
+
+    nvinfer1::Dims GetBindingDims(int bindIndex) const override;
+
+    nvinfer1::DataType GetBindingDataType(int bindIndex) const override;
+
+    bool BindingIsInput(int bindIndex) const override;
+
+private:
+    void allocate(int maxBatchSize);
+    void runImage(int batch, std::vector<float>& scratch);
+    float* tensorData(int tensor, int batch) const;
+
+private:
+    logger::Logger mLogger;
+
+    std::shared_ptr<const CpuModel> mModel;
+
+    std::vector<int> mInputShape;
+
+    int mThreads = 1;
+
+    int mBatchSize = 0;
+
+    std::vector<std::vector<float>> mBuffers;   // one for every planned tensor, max batch of it
+
+    std::vector<std::vector<float>> mScratch;   // im2col columns, one for every thread
+};
+
+#endif  // CPU_ENGINE_H
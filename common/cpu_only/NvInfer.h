@@ -0,0 +1,38 @@
+/**
+ * Types of TensorRT shared by backends for BUILD_CPU_ONLY, this folder is
+ * searched before any other include path. Only plain types used outside of
+ * RTEngine are here, sources needing the real builder or runtime(engine,
+ * engine_registry, calibrator) are not built.
+ * 2021/04/19
+ */
+
+#ifndef CPU_ONLY_NV_INFER_H
+#define CPU_ONLY_NV_INFER_H
+
+#include <cstdint>
+
+// version 0.0.0: engine artifacts written by a TensorRT build never match
+#define NV_TENSORRT_MAJOR 0
+#define NV_TENSORRT_MINOR 0
+#define NV_TENSORRT_PATCH 0
+
+namespace nvinfer1 {
+
+enum class DataType : int32_t {
+    kFLOAT = 0,
+    kHALF = 1,
+    kINT8 = 2,
+    kINT32 = 3,
+    kBOOL = 4
+};
+
+class Dims {
+public:
+    static const int MAX_DIMS = 8;
+    int nbDims;
+    int d[MAX_DIMS];
+};
+
+}  // namespace nvinfer1
+
+#endif  // CPU_ONLY_NV_INFER_H
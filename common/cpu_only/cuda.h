@@ -0,0 +1,11 @@
+/**
+ * Host stand-in of cuda.h for BUILD_CPU_ONLY, see cuda_runtime.h here.
+ * 2021/04/19
+ */
+
+#ifndef CPU_ONLY_CUDA_H
+#define CPU_ONLY_CUDA_H
+
+#include "cuda_runtime.h"
+
+#endif  // CPU_ONLY_CUDA_H
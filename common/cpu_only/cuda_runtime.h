@@ -0,0 +1,152 @@
+/**
+ * Host stand-in of cuda runtime for BUILD_CPU_ONLY, this folder is searched
+ * before any other include path. "Device" memory is host memory, copies are
+ * memcpy and every call is synchronous, streams are null and events read host
+ * clock. Kernel qualifiers expand to nothing so headers declaring kernels
+ * still compile, kernels themselves are not built, see *_cpu.cpp for host
+ * versions of device ops.
+ * 2021/04/19
+ */
+
+#ifndef CPU_ONLY_CUDA_RUNTIME_H
+#define CPU_ONLY_CUDA_RUNTIME_H
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#define __global__
+#define __device__
+#define __host__
+#define __forceinline__ inline
+#define __launch_bounds__(...)
+
+enum cudaError_t {
+    cudaSuccess = 0,
+    cudaErrorMemoryAllocation = 2,
+    cudaErrorNoDevice = 100
+};
+
+enum cudaMemcpyKind {
+    cudaMemcpyHostToHost = 0,
+    cudaMemcpyHostToDevice = 1,
+    cudaMemcpyDeviceToHost = 2,
+    cudaMemcpyDeviceToDevice = 3,
+    cudaMemcpyDefault = 4
+};
+
+struct CUstream_st;
+typedef CUstream_st* cudaStream_t;
+
+struct CUevent_st {
+    std::chrono::steady_clock::time_point time;
+};
+typedef CUevent_st* cudaEvent_t;
+
+inline cudaError_t cudaMalloc(void** ptr, size_t size) {
+    *ptr = malloc(size);
+    return *ptr || size == 0 ? cudaSuccess : cudaErrorMemoryAllocation;
+}
+
+template <class T>
+inline cudaError_t cudaMalloc(T** ptr, size_t size) {
+    return cudaMalloc(reinterpret_cast<void**>(ptr), size);
+}
+
+inline cudaError_t cudaMallocHost(void** ptr, size_t size) {
+    return cudaMalloc(ptr, size);
+}
+
+inline cudaError_t cudaFree(void* ptr) {
+    free(ptr);
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaFreeHost(void* ptr) {
+    return cudaFree(ptr);
+}
+
+inline cudaError_t cudaMemcpy(void* dst, const void* src, size_t size, cudaMemcpyKind) {
+    if (size > 0) memcpy(dst, src, size);
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaMemcpyAsync(void* dst, const void* src, size_t size, cudaMemcpyKind kind, cudaStream_t = nullptr) {
+    return cudaMemcpy(dst, src, size, kind);
+}
+
+inline cudaError_t cudaMemset(void* ptr, int value, size_t size) {
+    memset(ptr, value, size);
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaMemsetAsync(void* ptr, int value, size_t size, cudaStream_t = nullptr) {
+    return cudaMemset(ptr, value, size);
+}
+
+inline cudaError_t cudaStreamCreate(cudaStream_t* stream) {
+    *stream = nullptr;
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaStreamDestroy(cudaStream_t) {
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaStreamSynchronize(cudaStream_t) {
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaDeviceSynchronize() {
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaEventCreate(cudaEvent_t* event) {
+    *event = new CUevent_st();
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaEventDestroy(cudaEvent_t event) {
+    delete event;
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaEventRecord(cudaEvent_t event, cudaStream_t = nullptr) {
+    event->time = std::chrono::steady_clock::now();
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaEventSynchronize(cudaEvent_t) {
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaEventElapsedTime(float* ms, cudaEvent_t start, cudaEvent_t end) {
+    *ms = std::chrono::duration<float, std::milli>(end->time - start->time).count();
+    return cudaSuccess;
+}
+
+// no device, tasks only run host and cpu backends
+inline cudaError_t cudaGetDeviceCount(int* count) {
+    *count = 0;
+    return cudaErrorNoDevice;
+}
+
+inline cudaError_t cudaSetDevice(int) {
+    return cudaSuccess;
+}
+
+inline cudaError_t cudaGetDevice(int* device) {
+    *device = 0;
+    return cudaSuccess;
+}
+
+inline const char* cudaGetErrorString(cudaError_t error) {
+    switch (error) {
+        case cudaSuccess: return "no error";
+        case cudaErrorMemoryAllocation: return "out of memory";
+        case cudaErrorNoDevice: return "no CUDA-capable device is detected";
+        default: return "unknown error";
+    }
+}
+
+#endif  // CPU_ONLY_CUDA_RUNTIME_H
@@ -10,16 +10,28 @@
 #include <cassert>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <cstring>
+#include <sys/stat.h>
 
 #include "NvInfer.h"
 #include "NvCaffeParser.h"
 #include "NvOnnxParser.h"
 #include "NvUffParser.h"
 #include "NvInferPlugin.h"
+#include "engine_artifact.h"
+#include "engine_registry.h"
+#include "tensor_record.h"
 #include "utils.h"
 
 using namespace nvinfer1;
 
+static std::shared_ptr<nvinfer1::ICudaEngine> shareEngine(nvinfer1::ICudaEngine* engine) {
+    return std::shared_ptr<nvinfer1::ICudaEngine>(engine, [](nvinfer1::ICudaEngine* e) {
+        if (e != nullptr) e->destroy();
+    });
+}
+
 RTEngine::~RTEngine() {
     if (mPluginFactory != nullptr) {
         delete mPluginFactory;
@@ -29,10 +41,8 @@ RTEngine::~RTEngine() {
         mContext->destroy();
         mContext = nullptr;
     }
-    if (mEngine != nullptr) {
-        mEngine->destroy();
-        mEngine = nullptr;
-    }
+    if (mProfiles != nullptr && mProfile >= 0) mProfiles->Release(mProfile);
+    mEngine.reset();
     for (size_t i = 0;i < mBinding.size(); ++i) {
         safeCudaFree(mBinding[i]);
     }
@@ -44,22 +54,153 @@ void RTEngine::CreateEngine(const std::string& onnxModel,
                             int maxBatchSize,
                             RunMode runMode,
                             long workspace_size) {
-    if (!DeserializeEngine(engineFile)) {
-        if (!BuildEngine(onnxModel,engineFile,customOutput,maxBatchSize, runMode, workspace_size)) {
+    std::vector<int> bchw = mBCHW;
+    if (bchw.empty()) bchw = {maxBatchSize};
+    mArtifact = makeArtifactHeader(onnxModel, runMode, bchw, workspace_size, false,
+                                   static_cast<int32_t>(mOutputType), mOutputRange,
+                                   static_cast<int32_t>(mInputType), mInputRange, mProfileCount);
+    mOnnxModel = onnxModel;
+    std::string registryKey = EngineRegistry::MakeKey(engineFile.empty() ? onnxModel : engineFile, mArtifact);
+    bool share = true;
+    bool shared = false;
+    if (InitSharedEngine(registryKey, share, shared)) {
+        return;
+    }
+    if (!DeserializeEngine(engineFile, onnxModel)) {
+        // content addressed cache, same onnx and params was built before
+        bool cached = false;
+        if (!mCacheDir.empty() && (mArtifact.key != 0 || hashArtifactKey(onnxModel, mArtifact))) {
+            std::string cacheFile = artifactPath(mCacheDir, mArtifact.key);
+            cached = DeserializeEngine(cacheFile, onnxModel);
+            if (cached && !engineFile.empty() && engineFile != cacheFile) SaveEngine(engineFile);
+        }
+        if (!cached && !BuildEngine(onnxModel,engineFile,customOutput,maxBatchSize, runMode, workspace_size)) {
             mInfoLogger.logger("ERROR: could not deserialize or build engine");
             return;
         }
     }
+    if (share) {
+        mEngine = EngineRegistry::Instance().Add(registryKey, mEngine, mArtifact.payload_size);
+        mProfiles = EngineRegistry::Instance().Profiles(registryKey);
+    }
     mInfoLogger.logger("Create execute context and malloc device memory...");
-    InitEngine();
+    if (!InitEngine()) {
+        mInfoLogger.logger("ERROR: could not init context of engine");
+    }
+}
+
+bool RTEngine::InitSharedEngine(const std::string& registryKey, bool& share, bool& ok) {
+    mEngine = EngineRegistry::Instance().Acquire(registryKey);
+    if (mEngine == nullptr) return false;
+    mInfoLogger.logger("Create execute context on shared engine...");
+    mProfiles = EngineRegistry::Instance().Profiles(registryKey);
+    // other errors than no free profile are logged by InitEngine and fail creating
+    ok = InitEngine();
+    if (ok || mProfile >= 0) return true;
+    mInfoLogger.logger("Contexts of other tasks take all optimization profiles of shared engine, load a copy of it.",
+                       logger::LEVEL::WARNING);
+    mContext->destroy();
+    mContext = nullptr;
+    mProfiles.reset();
+    mEngine.reset();
+    mDynamicBatch = false;
+    share = false;
+    return false;
+}
+
+InferBackend* RTEngine::Clone() const {
+    assert(mEngine != nullptr);
+    RTEngine* engine = new RTEngine();
+    engine->mEngine    = mEngine;
+    engine->mBatchSize = mBatchSize;
+    engine->mFromOnnx  = mFromOnnx;
+    engine->mBCHW      = mBCHW;
+    engine->mCacheDir  = mCacheDir;
+    engine->mOnnxModel = mOnnxModel;
+    engine->mArtifact  = mArtifact;
+    engine->mOutputType  = mOutputType;
+    engine->mOutputRange = mOutputRange;
+    engine->mInputType   = mInputType;
+    engine->mInputRange  = mInputRange;
+    engine->mRecorder  = mRecorder;
+    engine->mProfileCount = mProfileCount;
+    engine->mProfiles  = mProfiles;
+    if (!engine->InitEngine()) {
+        delete engine;
+        return nullptr;
+    }
+    return engine;
+}
+
+void RTEngine::SetArtifactSpec(const std::vector<int>& bchw, const std::string& cacheDir) {
+    mBCHW     = bchw;
+    mCacheDir = cacheDir;
+}
+
+void RTEngine::SetProfileCount(int count) {
+    mProfileCount = std::max(count, 1);
+}
+
+void RTEngine::SetOutputType(nvinfer1::DataType type, float range) {
+    mOutputType  = type;
+    mOutputRange = range;
+}
+
+void RTEngine::SetInputType(nvinfer1::DataType type, float range) {
+    mInputType  = type;
+    mInputRange = range;
+}
+
+void RTEngine::SetInt8Calibrator(const CalibratorFactory& factory) {
+    mCalibratorFactory = factory;
+}
+
+bool RTEngine::LoadEngine(const std::string& engineFile) {
+    // expect what the file says, so its header always validates
+    EngineArtifactHeader header;
+    if (readArtifactHeader(engineFile, header)) {
+        mArtifact = header;
+        mOutputType  = static_cast<nvinfer1::DataType>(header.output_type);
+        mOutputRange = header.output_range;
+        mInputType   = static_cast<nvinfer1::DataType>(header.input_type);
+        mInputRange  = header.input_range;
+        mProfileCount = std::max(header.profiles, 1);
+    } else {
+        memset(&mArtifact, 0, sizeof(EngineArtifactHeader));
+    }
+    std::string registryKey = EngineRegistry::MakeKey(engineFile, mArtifact);
+    bool share = true;
+    bool shared = false;
+    if (InitSharedEngine(registryKey, share, shared)) {
+        return shared;
+    }
+    if (!DeserializeEngine(engineFile, "")) {
+        return false;
+    }
+    if (share) {
+        mEngine = EngineRegistry::Instance().Add(registryKey, mEngine, mArtifact.payload_size);
+        mProfiles = EngineRegistry::Instance().Profiles(registryKey);
+    }
+    mInfoLogger.logger("Create execute context and malloc device memory...");
+    return InitEngine();
 }
 
 void RTEngine::Forward() {
-    mContext->execute(mBatchSize, &mBinding[0]);
+    if (mDynamicBatch) {
+        mContext->executeV2(&mEngineBinding[0]);
+    } else {
+        mContext->execute(mBatchSize, &mEngineBinding[0]);
+    }
+    if (mRecorder) mRecorder->Record(*this, mCurBatch, nullptr);
 }
 
 void RTEngine::ForwardAsync(const cudaStream_t& stream) {
-    mContext->enqueue(mBatchSize, &mBinding[0], stream, nullptr);
+    if (mDynamicBatch) {
+        mContext->enqueueV2(&mEngineBinding[0], stream, nullptr);
+    } else {
+        mContext->enqueue(mBatchSize, &mEngineBinding[0], stream, nullptr);
+    }
+    if (mRecorder) mRecorder->Record(*this, mCurBatch, stream);
 }
 
 void RTEngine::CopyFromHostToDevice(const std::vector<float>& input, int bindIndex) {
@@ -99,6 +240,25 @@ int RTEngine::GetMaxBatchSize() const {
     return mBatchSize;
 }
 
+bool RTEngine::SetBatchSize(int batch) {
+    assert(batch > 0 && batch <= mBatchSize);
+    mCurBatch = batch;
+    if (!mDynamicBatch) {
+        return false;
+    }
+    // output dims are inferred from input dims by context
+    for (size_t i = 0; i < mBinding.size(); ++i) {
+        if (!mBindingIsInput[i]) continue;
+        nvinfer1::Dims dims = mBindingDims[i];
+        dims.d[0] = batch;
+        if (!mContext->setBindingDimensions(mBindingOffset + i, dims)) {
+            mInfoLogger.logger("Set binding dimensions failed, batch: ", batch, logger::LEVEL::ERROR);
+            return false;
+        }
+    }
+    return true;
+}
+
 void* RTEngine::GetBindingPtr(int bindIndex) const {
     return mBinding[bindIndex];
 }
@@ -115,6 +275,15 @@ nvinfer1::DataType RTEngine::GetBindingDataType(int bindIndex) const {
     return mBindingDataType[bindIndex];
 }
 
+float RTEngine::GetBindingScale(int bindIndex) const {
+    if (mBindingDataType[bindIndex] != nvinfer1::DataType::kINT8) return 1.f;
+    return (mBindingIsInput[bindIndex] ? mInputRange : mOutputRange) / 127.f;
+}
+
+bool RTEngine::BindingIsInput(int bindIndex) const {
+    return mBindingIsInput[bindIndex];
+}
+
 void RTEngine::SaveEngine(const std::string& fileName) {
     if (fileName == "") {
         mInfoLogger.logger("Empty engine file name, skip save");
@@ -127,8 +296,12 @@ void RTEngine::SaveEngine(const std::string& fileName) {
         file.open(fileName,std::ios::binary | std::ios::out);
         if(!file.is_open()) {
             mInfoLogger.logger("Read create engine file failed: ",fileName);
+            data->destroy();
             return;
         }
+        if (mArtifact.key == 0) hashArtifactKey(mOnnxModel, mArtifact);
+        mArtifact.payload_size = data->size();
+        file.write((const char*)&mArtifact, sizeof(EngineArtifactHeader));
         file.write((const char*)data->data(), data->size());
         file.close();
         data->destroy();
@@ -137,26 +310,46 @@ void RTEngine::SaveEngine(const std::string& fileName) {
     }
 }
 
-bool RTEngine::DeserializeEngine(const std::string& engineFile) {
-    std::ifstream in(engineFile.c_str(), std::ifstream::binary);
-    if (in.is_open()) {
-        mInfoLogger.logger("Deserialize engine from:", engineFile);
-        auto const start_pos = in.tellg();
-        in.ignore(std::numeric_limits<std::streamsize>::max());
-        size_t bufCount = in.gcount();
-        in.seekg(start_pos);
-        std::unique_ptr<char[]> engineBuf(new char[bufCount]);
-        in.read(engineBuf.get(), bufCount);
-        initLibNvInferPlugins(&mLogger, "");
-        mRuntime = nvinfer1::createInferRuntime(mLogger);
-        mEngine = mRuntime->deserializeCudaEngine((void*)engineBuf.get(), bufCount, nullptr);
-        assert(mEngine != nullptr);
-        mBatchSize = mEngine->getMaxBatchSize();
-        mInfoLogger.logger("Max batch size of deserialized engine:",mEngine->getMaxBatchSize());
-        mRuntime->destroy();
-        return true;
+bool RTEngine::DeserializeEngine(const std::string& engineFile, const std::string& onnxModel) {
+    MappedFile in;
+    const uint8_t* engineBuf = nullptr;
+    size_t bufCount = 0;
+    {
+        StartupStage stage(mStartup, startup::kEngineRead);
+        if (engineFile.empty() || !in.Open(engineFile)) {
+            return false;
+        }
+        engineBuf = in.Data();
+        bufCount = in.Size();
+        EngineArtifactHeader header;
+        if (bufCount >= sizeof(header.magic) && memcmp(engineBuf, ARTIFACT_MAGIC, sizeof(header.magic)) == 0) {
+            if (!readArtifactHeader(engineBuf, bufCount, header)
+                || header.header_size + header.payload_size > bufCount
+                || !validateArtifact(header, mArtifact, onnxModel)) {
+                mInfoLogger.logger("Engine file is stale or mismatch onnx/mode/bchw/workspace/TensorRT version/output type, skip it: ", engineFile, logger::LEVEL::WARNING);
+                return false;
+            }
+            engineBuf += header.header_size;
+            bufCount   = header.payload_size;
+        } else {
+            mInfoLogger.logger("Engine file has no artifact header and can't be validated: ", engineFile, logger::LEVEL::WARNING);
+        }
     }
-    return false;
+
+    mArtifact.payload_size = bufCount;
+    mInfoLogger.logger("Deserialize engine from:", engineFile);
+    StartupStage stage(mStartup, startup::kDeserialize);
+    // tasks may be created concurrently, register plugins once with a logger outliving engines
+    static std::once_flag pluginsOnce;
+    static RTEngineLogger pluginLogger;
+    std::call_once(pluginsOnce, []() { initLibNvInferPlugins(&pluginLogger, ""); });
+    mRuntime = nvinfer1::createInferRuntime(mLogger);
+    mEngine = shareEngine(mRuntime->deserializeCudaEngine((const void*)engineBuf, bufCount, nullptr));
+    assert(mEngine != nullptr);
+    mBatchSize = mEngine->getMaxBatchSize();
+    mInfoLogger.logger("Max batch size of deserialized engine:",mEngine->getMaxBatchSize());
+    mRuntime->destroy();
+    return true;
 }
 
 bool RTEngine::BuildEngine(const std::string& onnxModel,
@@ -165,6 +358,7 @@ bool RTEngine::BuildEngine(const std::string& onnxModel,
                            int maxBatchSize,
                            RunMode runMode,
                            long workspace_size) {
+    StartupStage stage(mStartup, startup::kBuild);
     mInfoLogger.logger("The ONNX Parser shipped with TensorRT 5.1.x+ supports ONNX IR (Intermediate Representation) version 0.0.3, opset version 9");
     mBatchSize = maxBatchSize;
     mInfoLogger.logger("Build onnx engine from: ", onnxModel);
@@ -181,8 +375,74 @@ bool RTEngine::BuildEngine(const std::string& onnxModel,
 
     nvinfer1::IBuilderConfig* config = builder->createBuilderConfig();
     builder->setMaxBatchSize(mBatchSize);
+
+    nvinfer1::DataType outputType = mOutputType;
+    if (outputType == nvinfer1::DataType::kINT8 && (runMode != RunMode::kINT8 || !builder->platformHasFastInt8())) {
+        mInfoLogger.logger("INT8 outputs need int8 mode, keep outputs in float.", logger::LEVEL::WARNING);
+        outputType = nvinfer1::DataType::kFLOAT;
+    }
+    if (outputType == nvinfer1::DataType::kHALF && runMode == RunMode::kFP32) {
+        mInfoLogger.logger("Half outputs of fp32 engine only narrow the copy, results are rounded to half.", logger::LEVEL::WARNING);
+    }
+    // narrow outputs in linear layout, post process reads them as they are
+    if (outputType == nvinfer1::DataType::kHALF || outputType == nvinfer1::DataType::kINT8) {
+        for (int i = 0; i < network->getNbOutputs(); ++i) {
+            nvinfer1::ITensor* output = network->getOutput(i);
+            output->setType(outputType);
+            output->setAllowedFormats(1U << static_cast<uint32_t>(nvinfer1::TensorFormat::kLINEAR));
+            if (outputType == nvinfer1::DataType::kINT8) {
+                output->setDynamicRange(-mOutputRange, mOutputRange);
+            }
+        }
+        mInfoLogger.logger("Output bindings in: ", outputType == nvinfer1::DataType::kHALF ? "half" : "int8");
+    }
+    nvinfer1::DataType inputType = mInputType;
+    if (inputType == nvinfer1::DataType::kINT8 && (runMode != RunMode::kINT8 || !builder->platformHasFastInt8())) {
+        mInfoLogger.logger("INT8 input needs int8 mode, keep input in float.", logger::LEVEL::WARNING);
+        inputType = nvinfer1::DataType::kFLOAT;
+    }
+    // tasks write input in its type, first input only as tasks bind one image input
+    if (inputType == nvinfer1::DataType::kHALF || inputType == nvinfer1::DataType::kINT8) {
+        nvinfer1::ITensor* input = network->getInput(0);
+        input->setType(inputType);
+        input->setAllowedFormats(1U << static_cast<uint32_t>(nvinfer1::TensorFormat::kLINEAR));
+        if (inputType == nvinfer1::DataType::kINT8) {
+            input->setDynamicRange(-mInputRange, mInputRange);
+        }
+        mInfoLogger.logger("Input binding in: ", inputType == nvinfer1::DataType::kHALF ? "half" : "int8");
+    }
     config->setMaxWorkspaceSize(workspace_size << 20);
 
+    // onnx exported with dynamic batch axis, build same profile for batch 1..max
+    // for every context, contexts can't share a profile. first one calibrates
+    nvinfer1::IOptimizationProfile* profile = nullptr;
+    if (network->getInput(0)->getDimensions().d[0] == -1) {
+        mInfoLogger.logger("Build optimization profiles for dynamic batch, max batch: ", mBatchSize,
+                           ", profiles: " + std::to_string(mProfileCount));
+        for (int p = 0; p < mProfileCount; ++p) {
+            nvinfer1::IOptimizationProfile* current = builder->createOptimizationProfile();
+            for (int i = 0; i < network->getNbInputs(); ++i) {
+                nvinfer1::ITensor* input = network->getInput(i);
+                nvinfer1::Dims dims = input->getDimensions();
+                if (i == 0 && !mBCHW.empty()) {
+                    for (int d = 1; d < dims.nbDims && d < static_cast<int>(mBCHW.size()); ++d) {
+                        if (dims.d[d] == -1) dims.d[d] = mBCHW[d];
+                    }
+                }
+                dims.d[0] = 1;
+                current->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMIN, dims);
+                dims.d[0] = mBatchSize;
+                current->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kOPT, dims);
+                current->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMAX, dims);
+            }
+            config->addOptimizationProfile(current);
+            if (profile == nullptr) profile = current;
+        }
+    } else {
+        mInfoLogger.logger("Batch of onnx input is fixed, engine always runs full batch, export onnx with dynamic batch axis for partial batch.", logger::LEVEL::WARNING);
+    }
+
+    std::unique_ptr<nvinfer1::IInt8Calibrator> calibrator;
     switch(runMode) {
         case(RunMode::kFP16): {
             if (!builder->platformHasFastFp16()) {
@@ -202,17 +462,29 @@ bool RTEngine::BuildEngine(const std::string& onnxModel,
             } else {
                 mInfoLogger.logger("Set engine to int8 mode ");
                 config->setFlag(nvinfer1::BuilderFlag::kINT8);
-                setAllTensorScales(network, 127.0f, 127.0f);
+                if (mCalibratorFactory) calibrator.reset(mCalibratorFactory());
+                if (calibrator) {
+                    // calibration batches are of bchw, same as opt dims of profile
+                    config->setInt8Calibrator(calibrator.get());
+                    if (profile != nullptr) config->setCalibrationProfile(profile);
+                } else {
+                    mInfoLogger.logger("No calibration images, int8 engine uses placeholder ranges and is inaccurate, set `calib_dir`.", logger::LEVEL::WARNING);
+                    setAllTensorScales(network, 127.0f, 127.0f);
+                }
     //            builder->setStrictTypeConstraints(true);
                 break;
             }
         }
     }
 
-    mEngine = builder -> buildEngineWithConfig(*network, *config);
+    mEngine = shareEngine(builder -> buildEngineWithConfig(*network, *config));
     assert(mEngine != nullptr);
     mInfoLogger.logger("Serialize engine to: ", engineFile);
     SaveEngine(engineFile);
+    if (!mCacheDir.empty()) {
+        mkdir(mCacheDir.c_str(), 0755);
+        SaveEngine(artifactPath(mCacheDir, mArtifact.key));
+    }
 
     builder->destroy();
     network->destroy();
@@ -220,21 +492,67 @@ bool RTEngine::BuildEngine(const std::string& onnxModel,
     return true;
 }
 
-void RTEngine::InitEngine() {
+bool RTEngine::InitEngine() {
     mInfoLogger.logger("Init engine...");
-    mContext = mEngine->createExecutionContext();
+    {
+        StartupStage stage(mStartup, startup::kContext);
+        mContext = mEngine->createExecutionContext();
+    }
     assert(mContext != nullptr);
+    StartupStage stage(mStartup, startup::kBindings);
+
+    // every profile has its own copy of bindings, profile p owns [p * nbBindings, (p + 1) * nbBindings)
+    int nbProfiles = std::max(mEngine->getNbOptimizationProfiles(), 1);
+    int nbBindings = mEngine->getNbBindings() / nbProfiles;
+    for (int i = 0; i < nbBindings; i++) {
+        if (mEngine->bindingIsInput(i) && mEngine->getBindingDimensions(i).d[0] == -1) mDynamicBatch = true;
+    }
+    mProfile = 0;
+    if (mDynamicBatch) {
+        if (mProfiles == nullptr) mProfiles = std::make_shared<ProfileSlots>(nbProfiles);
+        mProfile = mProfiles->Reserve();
+        if (mProfile < 0) {
+            mInfoLogger.logger("All optimization profiles of engine are taken by other contexts, profiles: ", nbProfiles,
+                               logger::LEVEL::ERROR);
+            return false;
+        }
+        if (mProfile > 0 && !mContext->setOptimizationProfile(mProfile)) {
+            mInfoLogger.logger("Set optimization profile failed, profile: ", mProfile, logger::LEVEL::ERROR);
+            return false;
+        }
+    }
+    mBindingOffset = mProfile * nbBindings;
+
+    // dynamic batch: set inputs to max batch of profile, then outputs are resolved by context
+    for (int i = 0; i < nbBindings; i++) {
+        if (!mEngine->bindingIsInput(i) || mEngine->getBindingDimensions(i).d[0] != -1) continue;
+        int index = mBindingOffset + i;
+        nvinfer1::Dims dims = mEngine->getProfileDimensions(index, mProfile, nvinfer1::OptProfileSelector::kMAX);
+        if (!mContext->setBindingDimensions(index, dims)) {
+            mInfoLogger.logger("Set binding dimensions failed, binding: ", mEngine->getBindingName(i), logger::LEVEL::ERROR);
+            return false;
+        }
+        mBatchSize = dims.d[0];
+    }
 
     mInfoLogger.logger("Malloc device memory...");
-    int nbBindings = mEngine->getNbBindings();
     mInfoLogger.logger("nbBingdings: ", nbBindings);
     mBinding.resize(nbBindings);
     mBindingSize.resize(nbBindings);
     mBindingName.resize(nbBindings);
     mBindingDims.resize(nbBindings);
     mBindingDataType.resize(nbBindings);
+    mBindingIsInput.resize(nbBindings);
+    if (!mDynamicBatch && mFromOnnx && nbBindings > 0) {
+        // explicit batch engine reports max batch 1, take it from input
+        mBatchSize = mEngine->getBindingDimensions(0).d[0];
+    }
+    mCurBatch = mBatchSize;
+    mInfoLogger.logger("Max batch size: ", mBatchSize, mDynamicBatch ? ", dynamic batch" : ", fixed batch");
+
     for (int i=0; i< nbBindings; i++) {
-        nvinfer1::Dims dims = mEngine->getBindingDimensions(i);
+        // names of profile 0, those of others have a " [profile p]" suffix
+        nvinfer1::Dims dims = mDynamicBatch ? mContext->getBindingDimensions(mBindingOffset + i) : mEngine->getBindingDimensions(i);
         nvinfer1::DataType dtype = mEngine->getBindingDataType(i);
         const char* name = mEngine->getBindingName(i);
         int64_t totalSize;
@@ -247,6 +565,7 @@ void RTEngine::InitEngine() {
         mBindingName[i] = name;
         mBindingDims[i] = dims;
         mBindingDataType[i] = dtype;
+        mBindingIsInput[i] = mEngine->bindingIsInput(i);
         if (mEngine->bindingIsInput(i)) {
             mInfoLogger.logger("Input: ");
         } else {
@@ -263,4 +582,7 @@ void RTEngine::InitEngine() {
             mInputSize++;
         }
     }
+    mEngineBinding.assign(nbProfiles * nbBindings, nullptr);
+    std::copy(mBinding.begin(), mBinding.end(), mEngineBinding.begin() + mBindingOffset);
+    return true;
 }
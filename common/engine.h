@@ -6,16 +6,22 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <numeric>
 #include <algorithm>
+#include <functional>
 
 #include "NvInfer.h"
+#include "backend.h"
+#include "engine_artifact.h"
 #include "logger.h"
 #include "utils.h"
 
+class ProfileSlots;
+
 class RTEngineLogger : public nvinfer1::ILogger {
     void log(Severity severity, const char* msg) override
     {
@@ -26,7 +32,7 @@ class RTEngineLogger : public nvinfer1::ILogger {
 };
 
 
-class RTEngine {
+class RTEngine : public InferBackend {
 public:
     /**
      * Default constructor.
@@ -41,36 +47,101 @@ public:
      *              save engine file
      * maxBatchSize: max batch size for inference.
      * runMode: mode while running, fp32/fp16/int8
-     * return:
+     * Engine has no bindings if it can't be loaded, built or its context fails.
      */
     void CreateEngine(const std::string& onnxModel,
                       const std::string& engineFile,
                       const std::vector<std::string>& customOutput,
                       int maxBatchSize,
                       RunMode runMode,
-                      long workspace_size);
+                      long workspace_size) override;
+
+    /**
+     * Share ICudaEngine, create execution context and device bindings for clone.
+     * Context of dynamic batch engine binds a free optimization profile, nullptr
+     * if all profiles are taken, see SetProfileCount.
+     */
+    InferBackend* Clone() const override;
 
     /**
      * Do inference on engine context, make sure you already copy your data to device memory,
      * using CopyFromHostToDevice etc.
      */
-    void Forward();
+    void Forward() override;
 
     /**
      * Async inference on engine context.
      * stream: cuda stream for async inference and data copy
      */
-    void ForwardAsync(const cudaStream_t& stream);
+    void ForwardAsync(const cudaStream_t& stream) override;
+
+    void CopyFromHostToDevice(const std::vector<float>& input, int bindIndex) override;
+
+    void CopyFromDeviceToHost(std::vector<float>& output, int bindIndex) override;
+
+    void CopyFromHostToDevice(const std::vector<float>& input, int bindIndex,const cudaStream_t& stream) override;
+
+    void CopyFromDeviceToHost(std::vector<float>& output, int bindIndex,const cudaStream_t& stream) override;
+
+    void SetDevice(int device) override;
+
+    /**
+     * Params used by engine artifact header, call it before CreateEngine.
+     * bchw: input shape in yaml, part of artifact key.
+     * cacheDir: engine artifact directory, artifacts are named by key, it's
+     *           looked up before building and built engine is saved in it.
+     */
+    void SetArtifactSpec(const std::vector<int>& bchw, const std::string& cacheDir);
 
-    void CopyFromHostToDevice(const std::vector<float>& input, int bindIndex);
+    /**
+     * Optimization profiles built for dynamic batch engine, one per execution
+     * context on it(pool size of task), call it before CreateEngine. It's part
+     * of artifact key, engine built with fewer profiles runs fewer contexts.
+     */
+    void SetProfileCount(int count);
 
-    void CopyFromDeviceToHost(std::vector<float>& output, int bindIndex);
+    /**
+     * Load engine file as it is, without checking it against onnx and params,
+     * e.g. serve with an older or fp32 engine while the expected one is building.
+     * return: false if file is missing or can't be deserialized.
+     */
+    bool LoadEngine(const std::string& engineFile);
 
-    void CopyFromHostToDevice(const std::vector<float>& input, int bindIndex,const cudaStream_t& stream);
+    /**
+     * Create calibrator of int8 build, called only if engine is built in int8
+     * mode, engine owns the calibrator and frees it after build.
+     */
+    typedef std::function<nvinfer1::IInt8Calibrator*()> CalibratorFactory;
 
-    void CopyFromDeviceToHost(std::vector<float>& output, int bindIndex,const cudaStream_t& stream);
+    /**
+     * Calibrate int8 engine with calibrator of factory, call it before CreateEngine.
+     * Without it all tensors are set to a placeholder range of [-127, 127].
+     */
+    void SetInt8Calibrator(const CalibratorFactory& factory);
 
-    void SetDevice(int device);
+    /**
+     * Data type of output bindings, kFLOAT(default), kHALF or kINT8, call it before
+     * CreateEngine. Narrow outputs halve or quarter device to host copies, post
+     * process converts them on host. range: dynamic range of int8 outputs, value
+     * is int8 x range / 127. Int8 outputs need int8 mode, else they stay float.
+     */
+    void SetOutputType(nvinfer1::DataType type, float range);
+
+    /**
+     * Data type of input binding, kFLOAT(default), kHALF or kINT8, call it before
+     * CreateEngine. Tasks write input in it, so uploads and input memory shrink to a
+     * half or a quarter. range: dynamic range of int8 input, value is int8 x range
+     * / 127. Int8 input needs int8 mode, else it stays float.
+     */
+    void SetInputType(nvinfer1::DataType type, float range);
+
+    BackendType GetBackendType() const override {
+        return BackendType::kTensorRT;
+    }
+
+    bool IsDeviceMemory() const override {
+        return true;
+    }
 
     int GetDevice();
 
@@ -78,7 +149,13 @@ public:
      * Get max batch size of build engine.
      * return: max batch size of build engine.
      */
-    int GetMaxBatchSize() const;
+    int GetMaxBatchSize() const override;
+
+    /**
+     * Set batch dimension of input bindings if engine is built with dynamic
+     * batch, otherwise engine always runs max batch and false is returned.
+     */
+    bool SetBatchSize(int batch) override;
 
     /**
      * Get binding data pointer in device. For example if you want to do some post processing
@@ -86,31 +163,40 @@ public:
      * use this function to avoid extra data io.
      * return: pointer point to device memory.
      */
-    void* GetBindingPtr(int bindIndex) const;
+    void* GetBindingPtr(int bindIndex) const override;
 
     /**
      * Get binding data size in byte, so maybe you need to divide it by sizeof(T) where T is data type
      * like float.
      * return: size in byte.
      */
-    size_t GetBindingSize(int bindIndex) const;
+    size_t GetBindingSize(int bindIndex) const override;
 
     /**
      * Get binding dimemsions.
      * return: binding dimemsions, see https://docs.nvidia.com/deeplearning/sdk/tensorrt-api/c_api/classnvinfer1_1_1_dims.html
      */
-    nvinfer1::Dims GetBindingDims(int bindIndex) const;
+    nvinfer1::Dims GetBindingDims(int bindIndex) const override;
 
     /**
      * Get binding data type.
      * return: binding data type, see https://docs.nvidia.com/deeplearning/sdk/tensorrt-api/c_api/namespacenvinfer1.html#afec8200293dc7ed40aca48a763592217
      */
-    nvinfer1::DataType GetBindingDataType(int bindIndex) const;
+    nvinfer1::DataType GetBindingDataType(int bindIndex) const override;
 
-    std::vector<std::string> mBindingName;
+    bool BindingIsInput(int bindIndex) const override;
+
+    /**
+     * range / 127 of int8 bindings, see SetOutputType and SetInputType.
+     */
+    float GetBindingScale(int bindIndex) const override;
 
 private:
-    bool DeserializeEngine(const std::string& engineFile);
+    /**
+     * Map engine file and deserialize it, return false if file is missing or
+     * its artifact header mismatch current onnx and params.
+     */
+    bool DeserializeEngine(const std::string& engineFile, const std::string& onnxModel);
 
     bool BuildEngine(const std::string& onnxModel,
                      const std::string& engineFile,
@@ -120,12 +206,22 @@ private:
                      long workspace_size);
 
     /**
-     * Init resource such as device memory
+     * Create context on engine of registry key if it's loaded, profiles are
+     * reserved in registry. share: set false if every profile of registered
+     * engine is taken, then caller loads a copy not shared.
+     * ok: false if context on registered engine failed otherwise, caller fails.
+     * return: true if registered engine is taken, whether ok or not.
+     */
+    bool InitSharedEngine(const std::string& registryKey, bool& share, bool& ok);
+
+    /**
+     * Init resource such as device memory, and bind a free profile of dynamic
+     * batch engine. return: false if no profile is free or it can't be set.
      */
-    void InitEngine();
+    bool InitEngine();
 
     /**
-     * Save engine to engine file
+     * Save engine to engine file with artifact header
      */
     void SaveEngine(const std::string& fileName);
 
@@ -136,7 +232,8 @@ private:
     // tensorrt run mode 0:fp32 1:fp16 2:int8
     int mRunMode;
 
-    nvinfer1::ICudaEngine* mEngine = nullptr;
+    // shared by clones, destroyed with last one
+    std::shared_ptr<nvinfer1::ICudaEngine> mEngine;
 
     nvinfer1::IExecutionContext* mContext = nullptr;
 
@@ -152,9 +249,32 @@ private:
 
     std::vector<nvinfer1::DataType> mBindingDataType;
 
+    std::vector<bool> mBindingIsInput;
+
+    // bindings of all profiles for enqueue, those of other profiles are null
+    std::vector<void*> mEngineBinding;
+
+    EngineArtifactHeader mArtifact;
+    std::vector<int> mBCHW;
+    std::string mCacheDir;
+    std::string mOnnxModel;
+    CalibratorFactory mCalibratorFactory;
+    nvinfer1::DataType mOutputType = nvinfer1::DataType::kFLOAT;
+    float mOutputRange = 0.f;
+    nvinfer1::DataType mInputType = nvinfer1::DataType::kFLOAT;
+    float mInputRange = 0.f;
+
     int mInputSize = 0;
     int mBatchSize;
     bool mFromOnnx = true;
+    // batch dimension of onnx input is -1, engine has optimization profiles [1, mBatchSize]
+    bool mDynamicBatch = false;
+    int mProfileCount = 1;
+    // profile of context, its bindings start at mProfile * bindings per profile
+    int mProfile = -1;
+    int mBindingOffset = 0;
+    // shared by clones, and by tasks sharing engine through registry
+    std::shared_ptr<ProfileSlots> mProfiles;
 };
 
 #endif  // ENGINE_H
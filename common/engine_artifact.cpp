@@ -0,0 +1,182 @@
+/**
+ * Engine artifact header and memory mapped file.
+ * 2021/02/15
+ */
+#include "engine_artifact.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "NvInfer.h"
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const std::string& file) {
+    Close();
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    mData = static_cast<uint8_t*>(data);
+    mSize = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (mData != nullptr) {
+        munmap(mData, mSize);
+        mData = nullptr;
+        mSize = 0;
+    }
+}
+
+uint64_t fnv1a64(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+int32_t trtVersion() {
+    return NV_TENSORRT_MAJOR * 1000 + NV_TENSORRT_MINOR * 100 + NV_TENSORRT_PATCH;
+}
+
+EngineArtifactHeader makeArtifactHeader(const std::string& onnxModel,
+                                        RunMode runMode,
+                                        const std::vector<int>& bchw,
+                                        long workspace,
+                                        bool hash_onnx,
+                                        int32_t outputType,
+                                        float outputRange,
+                                        int32_t inputType,
+                                        float inputRange,
+                                        int32_t profiles) {
+    EngineArtifactHeader header;
+    memset(&header, 0, sizeof(EngineArtifactHeader));
+    memcpy(header.magic, ARTIFACT_MAGIC, sizeof(header.magic));
+    header.version     = ARTIFACT_VERSION;
+    header.header_size = sizeof(EngineArtifactHeader);
+    header.run_mode    = static_cast<int32_t>(runMode);
+    for (size_t i = 0; i < 4 && i < bchw.size(); ++i) {
+        header.bchw[i] = bchw[i];
+    }
+    header.trt_version = trtVersion();
+    header.workspace   = workspace;
+    header.output_type = outputType;
+    header.output_range = outputType == 0 ? 0.f : outputRange;
+    header.input_type  = inputType;
+    header.input_range = inputType == static_cast<int32_t>(nvinfer1::DataType::kINT8) ? inputRange : 0.f;
+    header.profiles    = profiles > 1 ? profiles : 0;
+
+    struct stat st;
+    if (stat(onnxModel.c_str(), &st) == 0) {
+        header.onnx_size  = static_cast<uint64_t>(st.st_size);
+        header.onnx_mtime = static_cast<int64_t>(st.st_mtime);
+    }
+    if (hash_onnx) hashArtifactKey(onnxModel, header);
+    return header;
+}
+
+bool hashArtifactKey(const std::string& onnxModel, EngineArtifactHeader& header) {
+    MappedFile onnx;
+    if (!onnx.Open(onnxModel)) return false;
+    uint64_t key = fnv1a64(onnx.Data(), onnx.Size());
+    key = fnv1a64(&header.run_mode, sizeof(header.run_mode), key);
+    key = fnv1a64(header.bchw, sizeof(header.bchw), key);
+    key = fnv1a64(&header.workspace, sizeof(header.workspace), key);
+    key = fnv1a64(&header.trt_version, sizeof(header.trt_version), key);
+    // float outputs keep keys of artifacts built before output type existed
+    if (header.output_type != 0) {
+        key = fnv1a64(&header.output_type, sizeof(header.output_type), key);
+        key = fnv1a64(&header.output_range, sizeof(header.output_range), key);
+    }
+    if (header.input_type != 0) {
+        key = fnv1a64(&header.input_type, sizeof(header.input_type), key);
+        key = fnv1a64(&header.input_range, sizeof(header.input_range), key);
+    }
+    if (header.profiles != 0) {
+        key = fnv1a64(&header.profiles, sizeof(header.profiles), key);
+    }
+    header.key = key;
+    return true;
+}
+
+bool readArtifactHeader(const std::string& file, EngineArtifactHeader& header) {
+    FILE* fp = fopen(file.c_str(), "rb");
+    if (fp == nullptr) return false;
+    uint8_t data[sizeof(EngineArtifactHeader)];
+    size_t count = fread(data, 1, sizeof(data), fp);
+    fclose(fp);
+    return readArtifactHeader(data, count, header);
+}
+
+bool readArtifactHeader(const uint8_t* data, size_t size, EngineArtifactHeader& header) {
+    const size_t base = offsetof(EngineArtifactHeader, output_type);
+    if (size < base) return false;
+    memset(&header, 0, sizeof(EngineArtifactHeader));
+    memcpy(&header, data, base);
+    if (memcmp(header.magic, ARTIFACT_MAGIC, sizeof(header.magic)) != 0
+        || header.version != ARTIFACT_VERSION
+        || header.header_size < base) {
+        return false;
+    }
+    // bytes after header_size are payload, not fields
+    size_t fields = std::min<size_t>(header.header_size, sizeof(EngineArtifactHeader));
+    if (size < fields) return false;
+    memcpy(&header, data, fields);
+    return true;
+}
+
+bool sameArtifactParams(const EngineArtifactHeader& found, const EngineArtifactHeader& expected) {
+    return found.run_mode == expected.run_mode
+           && memcmp(found.bchw, expected.bchw, sizeof(found.bchw)) == 0
+           && found.workspace == expected.workspace
+           && found.trt_version == expected.trt_version
+           && found.output_type == expected.output_type
+           && found.output_range == expected.output_range
+           && found.input_type == expected.input_type
+           && found.input_range == expected.input_range
+           && found.profiles == expected.profiles;
+}
+
+bool validateArtifact(const EngineArtifactHeader& found,
+                      EngineArtifactHeader& expected,
+                      const std::string& onnxModel) {
+    if (!sameArtifactParams(found, expected)) {
+        return false;
+    }
+    // onnx untouched, params are same, so is the key
+    if (found.onnx_size == expected.onnx_size && found.onnx_mtime == expected.onnx_mtime) {
+        expected.key = found.key;
+        return true;
+    }
+    if (expected.key == 0 && !hashArtifactKey(onnxModel, expected)) {
+        // onnx is not deployed with engine, params are all we can check
+        return expected.onnx_size == 0;
+    }
+    return found.key == expected.key;
+}
+
+std::string artifactPath(const std::string& cacheDir, uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.engine", static_cast<unsigned long long>(key));
+    if (cacheDir.empty()) return name;
+    return cacheDir.back() == '/' ? cacheDir + name : cacheDir + "/" + name;
+}
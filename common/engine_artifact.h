@@ -0,0 +1,125 @@
+/**
+ * Engine artifact: serialized engine with a small metadata header, so a stale
+ * or mismatched engine file can be detected without deserializing it.
+ *   | EngineArtifactHeader | serialized engine |
+ * Artifacts are keyed by hash of onnx bytes + run mode + bchw + workspace +
+ * TensorRT version(+ output type and range if outputs aren't float, input type
+ * and range if input isn't, profile count if more than one), and could be kept in a cache directory named by key.
+ * 2021/02/15
+ */
+
+#ifndef ENGINE_ARTIFACT_H
+#define ENGINE_ARTIFACT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+#define ARTIFACT_MAGIC "TRTENG01"
+#define ARTIFACT_VERSION 1
+
+struct EngineArtifactHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;   // payload starts here
+    uint64_t key;           // content key, see makeArtifactHeader
+    uint64_t onnx_size;     // onnx stat, skip hashing onnx while it's not touched
+    int64_t  onnx_mtime;
+    int32_t  run_mode;
+    int32_t  bchw[4];
+    int32_t  trt_version;
+    int64_t  workspace;
+    uint64_t payload_size;
+    // appended later, header_size of older artifacts ends before them, see readArtifactHeader
+    int32_t  output_type;   // nvinfer1::DataType of output bindings
+    float    output_range;  // dynamic range of int8 outputs
+    int32_t  input_type;    // nvinfer1::DataType of input binding
+    float    input_range;   // dynamic range of int8 input
+    int32_t  profiles;      // optimization profiles of dynamic batch if more than one, else 0
+};
+
+/**
+ * Read only memory map of a whole file.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& file);
+    void Close();
+
+    const uint8_t* Data() const { return mData; }
+    size_t Size() const { return mSize; }
+
+private:
+    uint8_t* mData = nullptr;
+    size_t mSize = 0;
+};
+
+/**
+ * 64-bit FNV-1a.
+ */
+uint64_t fnv1a64(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ULL);
+
+/**
+ * Library version of TensorRT build engine, major * 1000 + minor * 100 + patch.
+ */
+int32_t trtVersion();
+
+/**
+ * Header expected for onnx and engine params, key is filled only if hash_onnx
+ * is set since it reads whole onnx file.
+ */
+EngineArtifactHeader makeArtifactHeader(const std::string& onnxModel,
+                                        RunMode runMode,
+                                        const std::vector<int>& bchw,
+                                        long workspace,
+                                        bool hash_onnx,
+                                        int32_t outputType = 0,
+                                        float outputRange = 0.f,
+                                        int32_t inputType = 0,
+                                        float inputRange = 0.f,
+                                        int32_t profiles = 1);
+
+/**
+ * Fill key of header by hashing onnx file, return false if onnx can't be read.
+ */
+bool hashArtifactKey(const std::string& onnxModel, EngineArtifactHeader& header);
+
+/**
+ * Read header of artifact file, return false if file is missing or has no header.
+ * Fields beyond header_size of older artifacts are zero, i.e. float input and
+ * outputs, one profile.
+ */
+bool readArtifactHeader(const std::string& file, EngineArtifactHeader& header);
+
+/**
+ * Same as above for artifact data in memory, e.g. a mapped engine file.
+ */
+bool readArtifactHeader(const uint8_t* data, size_t size, EngineArtifactHeader& header);
+
+/**
+ * Whether engine of found header was built with params of expected one, onnx
+ * content is not compared.
+ */
+bool sameArtifactParams(const EngineArtifactHeader& found, const EngineArtifactHeader& expected);
+
+/**
+ * Check header of artifact against expected one, onnx is hashed only when its
+ * stat changed, so touched but same onnx is not rebuilt.
+ */
+bool validateArtifact(const EngineArtifactHeader& found,
+                      EngineArtifactHeader& expected,
+                      const std::string& onnxModel);
+
+/**
+ * Path of artifact in cache directory, named by hex key.
+ */
+std::string artifactPath(const std::string& cacheDir, uint64_t key);
+
+#endif  // ENGINE_ARTIFACT_H
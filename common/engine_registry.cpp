@@ -0,0 +1,128 @@
+/**
+ * Process wide registry of loaded engines.
+ * 2021/03/08
+ */
+#include "engine_registry.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+#include "utils.h"
+
+ProfileSlots::ProfileSlots(int count) : mTaken(count > 1 ? count : 1, false) {
+}
+
+int ProfileSlots::Reserve() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (size_t i = 0; i < mTaken.size(); ++i) {
+        if (!mTaken[i]) {
+            mTaken[i] = true;
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void ProfileSlots::Release(int profile) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (profile >= 0 && profile < static_cast<int>(mTaken.size())) mTaken[profile] = false;
+}
+
+EngineRegistry& EngineRegistry::Instance() {
+    static EngineRegistry registry;
+    return registry;
+}
+
+std::string EngineRegistry::MakeKey(const std::string& engineFile, const EngineArtifactHeader& header) {
+    // engine file may be not built yet, so resolve its directory only
+    std::string path = engineFile;
+    size_t pos = engineFile.find_last_of('/');
+    std::string dir  = pos == std::string::npos ? "." : engineFile.substr(0, pos);
+    std::string name = pos == std::string::npos ? engineFile : engineFile.substr(pos + 1);
+    char resolved[PATH_MAX];
+    if (realpath(dir.c_str(), resolved) != nullptr) {
+        path = std::string(resolved) + "/" + name;
+    }
+    int device = 0;
+    cudaGetDevice(&device);
+    char params[128];
+    snprintf(params, sizeof(params), "#mode%d_%dx%dx%dx%d_ws%lld_out%d_in%d_prof%d_gpu%d", header.run_mode,
+             header.bchw[0], header.bchw[1], header.bchw[2], header.bchw[3],
+             static_cast<long long>(header.workspace), header.output_type, header.input_type,
+             header.profiles > 1 ? header.profiles : 1, device);
+    return path + params;
+}
+
+std::shared_ptr<nvinfer1::ICudaEngine> EngineRegistry::Acquire(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mEntries.find(key);
+    if (iter == mEntries.end()) return nullptr;
+    std::shared_ptr<nvinfer1::ICudaEngine> engine = iter->second.engine.lock();
+    if (engine == nullptr) return nullptr;
+    iter->second.users++;
+    mLogger.logger("Share loaded engine: ", key, "users: " + std::to_string(iter->second.users));
+    return MakeHandle(key, engine);
+}
+
+std::shared_ptr<nvinfer1::ICudaEngine> EngineRegistry::Add(const std::string& key,
+                                                           const std::shared_ptr<nvinfer1::ICudaEngine>& engine,
+                                                           size_t size) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Entry& entry = mEntries[key];
+    std::shared_ptr<nvinfer1::ICudaEngine> loaded = entry.engine.lock();
+    if (loaded != nullptr) {
+        // loaded by another task meanwhile, use that one and drop this
+        entry.users++;
+        return MakeHandle(key, loaded);
+    }
+    entry.engine = engine;
+    entry.profiles = std::make_shared<ProfileSlots>(engine->getNbOptimizationProfiles());
+    entry.size   = size;
+    entry.users  = 1;
+    return MakeHandle(key, engine);
+}
+
+std::shared_ptr<ProfileSlots> EngineRegistry::Profiles(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mEntries.find(key);
+    return iter == mEntries.end() ? nullptr : iter->second.profiles;
+}
+
+size_t EngineRegistry::SavedBytes() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t saved = 0;
+    for (const auto& item : mEntries) {
+        saved += (item.second.users - 1) * item.second.size;
+    }
+    return saved;
+}
+
+void EngineRegistry::Report() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t saved = 0;
+    for (const auto& item : mEntries) {
+        const Entry& entry = item.second;
+        std::cout << "Engine: " << item.first << ", users: " << entry.users
+                  << ", size: " << entry.size / 1024.f / 1024.f << " MB" << std::endl;
+        saved += (entry.users - 1) * entry.size;
+    }
+    mLogger.logger("Memory saved by sharing engines(MB): ", saved / 1024.f / 1024.f);
+}
+
+std::shared_ptr<nvinfer1::ICudaEngine> EngineRegistry::MakeHandle(const std::string& key,
+                                                                  const std::shared_ptr<nvinfer1::ICudaEngine>& engine) {
+    // handle keeps engine alive, and leaves registry when it's released
+    return std::shared_ptr<nvinfer1::ICudaEngine>(engine.get(), [this, key, engine](nvinfer1::ICudaEngine*) {
+        Release(key);
+    });
+}
+
+void EngineRegistry::Release(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mEntries.find(key);
+    if (iter == mEntries.end()) return;
+    if (--iter->second.users <= 0) {
+        mEntries.erase(iter);
+    }
+}
@@ -0,0 +1,108 @@
+/**
+ * Process wide registry of loaded engines. Tasks loading same engine(same
+ * engine file, run mode, bchw, workspace, profile count and device) share one
+ * ICudaEngine, weights are in memory only once and every task creates its own
+ * contexts. A dynamic batch engine serves as many contexts as it has
+ * optimization profiles(`pool_size` of the task building it) over all tasks,
+ * a task finding every profile taken loads a copy of its own, not shared.
+ * 2021/03/08
+ */
+
+#ifndef ENGINE_REGISTRY_H
+#define ENGINE_REGISTRY_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "NvInfer.h"
+#include "engine_artifact.h"
+#include "logger.h"
+
+/**
+ * Optimization profiles of a dynamic batch engine taken by its execution
+ * contexts. A context binds one profile and no other context may use it
+ * meanwhile, so engine built with N profiles runs N contexts at most.
+ */
+class ProfileSlots {
+public:
+    explicit ProfileSlots(int count);
+
+    /**
+     * Take a free profile, -1 if all are taken.
+     */
+    int Reserve();
+
+    void Release(int profile);
+
+    int Count() const {
+        return static_cast<int>(mTaken.size());
+    }
+
+private:
+    std::mutex mMutex;
+    std::vector<bool> mTaken;
+};
+
+class EngineRegistry {
+public:
+    static EngineRegistry& Instance();
+
+    /**
+     * Key of engine, engine file path(made absolute) with params of artifact
+     * header(profile count included) and current cuda device.
+     */
+    static std::string MakeKey(const std::string& engineFile, const EngineArtifactHeader& header);
+
+    /**
+     * Handle of registered engine, nullptr if it's not loaded. Every handle is a
+     * user of engine, engine is destroyed with handle of last user.
+     */
+    std::shared_ptr<nvinfer1::ICudaEngine> Acquire(const std::string& key);
+
+    /**
+     * Register loaded engine and return handle of first user. If same engine
+     * is registered meanwhile, handle of registered one is returned.
+     * size: serialized engine size in byte, counted as weights size.
+     */
+    std::shared_ptr<nvinfer1::ICudaEngine> Add(const std::string& key,
+                                               const std::shared_ptr<nvinfer1::ICudaEngine>& engine,
+                                               size_t size);
+
+    /**
+     * Optimization profiles of registered engine, contexts of all tasks sharing
+     * it reserve theirs here. nullptr if it's not registered.
+     */
+    std::shared_ptr<ProfileSlots> Profiles(const std::string& key);
+
+    /**
+     * Memory not allocated thanks to sharing, (users - 1) * size of every engine.
+     */
+    size_t SavedBytes();
+
+    /**
+     * Log engines, users and saved memory.
+     */
+    void Report();
+
+private:
+    struct Entry {
+        std::weak_ptr<nvinfer1::ICudaEngine> engine;
+        std::shared_ptr<ProfileSlots> profiles;
+        size_t size = 0;
+        int users = 0;
+    };
+
+    EngineRegistry() = default;
+    std::shared_ptr<nvinfer1::ICudaEngine> MakeHandle(const std::string& key, const std::shared_ptr<nvinfer1::ICudaEngine>& engine);
+    void Release(const std::string& key);
+
+private:
+    logger::Logger mLogger;
+    std::mutex mMutex;
+    std::map<std::string, Entry> mEntries;
+};
+
+#endif  // ENGINE_REGISTRY_H
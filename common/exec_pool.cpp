@@ -0,0 +1,115 @@
+/**
+ * Pool of execution states.
+ * 2021/03/01
+ */
+#include "exec_pool.h"
+
+#include <algorithm>
+#include <cassert>
+
+void ExecPool::Add(ExecState* state) {
+    state->index = static_cast<int>(mStates.size());
+    mStates.emplace_back(state);
+    mBusy.emplace_back(false);
+}
+
+ExecPool::Lease ExecPool::Acquire() {
+    assert(!mStates.empty());
+    std::unique_lock<std::mutex> lock(mMutex);
+    size_t index = 0;
+    mCond.wait(lock, [&] {
+        for (index = 0; index < mBusy.size(); ++index) {
+            if (!mBusy[index]) return true;
+        }
+        return false;
+    });
+    mBusy[index] = true;
+    return Lease(this, mStates[index]);
+}
+
+ExecPool::Lease ExecPool::Acquire(int index) {
+    assert(index >= 0 && index < Size());
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCond.wait(lock, [&] { return !mBusy[index]; });
+    mBusy[index] = true;
+    return Lease(this, mStates[index]);
+}
+
+void ExecPool::Release(ExecState* state) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBusy[state->index] = false;
+    }
+    mCond.notify_all();
+}
+
+ExecGeneration::ExecGeneration(InferBackend* net, int pool_size, size_t input_size, int width, int height, bool show_time, int id) : mId(id) {
+    bool on_device = net->IsDeviceMemory();
+    std::vector<InferBackend*> nets{net};
+    for (int i = 1; i < pool_size; ++i) {
+        InferBackend* clone = net->Clone();
+        if (clone == nullptr) {
+            mLogger.logger("Engine can't run more execution contexts, states in pool: ", i, logger::LEVEL::ERROR);
+            break;
+        }
+        nets.push_back(clone);
+    }
+    mStates.resize(nets.size());  // pool keeps pointers, never resize after here
+    for (size_t i = 0; i < nets.size(); ++i) {
+        ExecState& state = mStates[i];
+        state.net = nets[i];
+        state.inputW = width;
+        state.inputH = height;
+        state.inputSize = input_size;
+        if (on_device) {
+            CUDA_CHECK(cudaStreamCreate(&state.stream));
+            CUDA_CHECK(cudaMalloc((void**)&state.inputNHWC, input_size));
+        } else {
+            state.inputNHWC = new uint8_t[input_size];
+        }
+        state.timer = new Timer(state.stream, show_time, on_device);
+        mPool.Add(&state);
+    }
+}
+
+ExecGeneration::~ExecGeneration() {
+    for (auto& state : mStates) {
+        bool on_device = state.net->IsDeviceMemory();
+        state.extra.reset();
+        delete state.net;
+        delete state.timer;
+        if (on_device) {
+            if (state.ownsInput) CUDA_CHECK(cudaFree(state.inputNHWC));
+            if (state.source) CUDA_CHECK(cudaFree(state.source));
+            if (state.hostInput) CUDA_CHECK(cudaFreeHost(state.hostInput));
+            CUDA_CHECK(cudaStreamDestroy(state.stream));
+        } else if (state.ownsInput) {
+            delete[] state.inputNHWC;
+        }
+    }
+}
+
+void ExecGeneration::BindInput(int index, uint8_t* input) {
+    ExecState& state = mStates[index];
+    if (state.ownsInput) {
+        if (state.net->IsDeviceMemory()) {
+            CUDA_CHECK(cudaFree(state.inputNHWC));
+        } else {
+            delete[] state.inputNHWC;
+        }
+    }
+    state.inputNHWC = input;
+    state.ownsInput = false;
+}
+
+ExecPool::Lease ExecGeneration::Acquire() {
+    ExecPool::Lease lease = mPool.Acquire();
+    lease.Keep(shared_from_this());
+    return lease;
+}
+
+ExecPool::Lease ExecGeneration::Acquire(int index) {
+    ExecPool::Lease lease = mPool.Acquire(index);
+    lease.Keep(shared_from_this());
+    return lease;
+}
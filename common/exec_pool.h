@@ -0,0 +1,185 @@
+/**
+ * Pool of execution states. A state is everything one run() of task writes:
+ * backend context and bindings, cuda stream, staging buffer of images and timer.
+ * Loaded engine is shared by all states, so one task serves concurrent callers,
+ * each caller checks out a state for a whole run.
+ * States of one engine make a generation, task swaps in a new generation when
+ * engine changes, old one is freed after its last run ends(RCU).
+ * 2021/03/01
+ */
+
+#ifndef EXEC_POOL_H
+#define EXEC_POOL_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "backend.h"
+#include "logger.h"
+#include "nhwc2nchw_cpu.h"
+#include "structs.h"
+#include "timer.h"
+#include "utils.h"
+
+struct ExecState {
+    int            index     = 0;
+    InferBackend*  net       = nullptr;
+    cudaStream_t   stream    = nullptr;
+    uint8_t*       inputNHWC = nullptr;  // staging buffer of images, device memory unless host backend
+    size_t         inputSize = 0;        // of inputNHWC in byte
+    bool           ownsInput = true;     // false if inputNHWC is in an arena of memory planner
+    Timer*         timer     = nullptr;
+    int            inputW    = 0;  // input size of engine of state
+    int            inputH    = 0;
+    std::vector<ImageTransform> transforms;  // source image to input of every image of current run, set by prepareInputs
+    void*          workspace = nullptr;  // post process scratch in arena of memory planner, nullptr if task allocates its own
+    size_t         workspaceSize = 0;
+    uint8_t*       source     = nullptr;  // device copy of source images of fused preprocessing, grown on demand
+    size_t         sourceSize = 0;
+    uint8_t*       hostInput  = nullptr;  // pinned host staging images are packed into before one upload, grown on demand
+    size_t         hostInputSize = 0;
+    NormalizeLut   inputLut;  // means/stds/format of task in data type and scale of input binding of net
+
+    /**
+     * Task specific scratch of state(e.g. post process buffers), created on first
+     * use. State is used by one run at a time, so it needs no lock.
+     */
+    template <typename T, typename... Args>
+    T& scratch(Args&&... args) {
+        if (!extra) extra = std::make_shared<T>(std::forward<Args>(args)...);
+        return *static_cast<T*>(extra.get());
+    }
+
+    std::shared_ptr<void> extra;
+};
+
+class ExecPool {
+public:
+    /**
+     * Checked out state, it's returned to pool on destruction.
+     */
+    class Lease {
+    public:
+        Lease(ExecPool* pool, ExecState* state) : mPool(pool), mState(state) {}
+        Lease(Lease&& other) : mPool(other.mPool), mState(other.mState), mOwner(std::move(other.mOwner)) {
+            other.mState = nullptr;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() {
+            if (mState) mPool->Release(mState);
+        }
+
+        ExecState& operator*() const { return *mState; }
+        ExecState* operator->() const { return mState; }
+
+        /**
+         * Keep owner of pool alive until state is returned.
+         */
+        void Keep(const std::shared_ptr<void>& owner) { mOwner = owner; }
+
+    private:
+        ExecPool* mPool;
+        ExecState* mState;
+        std::shared_ptr<void> mOwner;  // released after state is returned
+    };
+
+    ExecPool() = default;
+    ExecPool(const ExecPool&) = delete;
+    ExecPool& operator=(const ExecPool&) = delete;
+
+    /**
+     * Add state to pool, pool doesn't own it. Not thread safe, add all states
+     * before first Acquire.
+     */
+    void Add(ExecState* state);
+
+    /**
+     * Check out a free state, block until one is returned if all are busy.
+     */
+    Lease Acquire();
+
+    /**
+     * Check out state of index, block until it's free.
+     */
+    Lease Acquire(int index);
+
+    int Size() const {
+        return static_cast<int>(mStates.size());
+    }
+
+    ExecState& State(int index) {
+        return *mStates[index];
+    }
+
+private:
+    void Release(ExecState* state);
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::vector<ExecState*> mStates;
+    std::vector<bool> mBusy;
+};
+
+/**
+ * Execution states of one engine. First state uses net and others use clones
+ * of it, generation owns all of them. Leases keep generation alive, so it's
+ * freed after last run on it even if task swapped in a new one.
+ */
+class ExecGeneration : public std::enable_shared_from_this<ExecGeneration> {
+public:
+    /**
+     * pool_size: states wanted, fewer if net can't be cloned as often, see Size.
+     * input_size: staging buffer size in byte of every state.
+     * width, height: input size of net.
+     */
+    ExecGeneration(InferBackend* net, int pool_size, size_t input_size, int width, int height, bool show_time, int id);
+    ~ExecGeneration();
+    ExecGeneration(const ExecGeneration&) = delete;
+    ExecGeneration& operator=(const ExecGeneration&) = delete;
+
+    ExecPool::Lease Acquire();
+
+    ExecPool::Lease Acquire(int index);
+
+    int Id() const {
+        return mId;
+    }
+
+    int Size() const {
+        return static_cast<int>(mStates.size());
+    }
+
+    InferBackend* Net() const {
+        return mStates[0].net;
+    }
+
+    int InputW() const {
+        return mStates[0].inputW;
+    }
+
+    int InputH() const {
+        return mStates[0].inputH;
+    }
+
+    ExecState& State(int index) {
+        return mStates[index];
+    }
+
+    /**
+     * Use input as staging buffer of state instead of its own, which is freed.
+     * Input is not owned, it must outlive generation. Call it before runs.
+     */
+    void BindInput(int index, uint8_t* input);
+
+private:
+    logger::Logger mLogger;
+    std::vector<ExecState> mStates;
+    ExecPool mPool;
+    int mId;
+};
+
+#endif  // EXEC_POOL_H
@@ -0,0 +1,118 @@
+#include "frame_cache.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <tuple>
+
+#include "engine_artifact.h"
+
+bool FrameKey::operator<(const FrameKey& other) const {
+    return std::tie(frame, kind, roi_x, roi_y, roi_w, roi_h, width, height, padding, lut) <
+           std::tie(other.frame, other.kind, other.roi_x, other.roi_y, other.roi_w, other.roi_h, other.width,
+                    other.height, other.padding, other.lut);
+}
+
+FrameCache::FrameCache(int max_frames, bool pyramid) : mMaxFrames(std::max(1, max_frames)), mPyramid(pyramid) {}
+
+FrameKey FrameCache::Key(const ImageView& view, Kind kind, int width, int height, bool padding, uint64_t lut) {
+    FrameKey key;
+    key.frame = view.frame_id;
+    key.kind = kind;
+    key.roi_x = view.roi_x;
+    key.roi_y = view.roi_y;
+    key.roi_w = view.cols();
+    key.roi_h = view.rows();
+    key.width = width;
+    key.height = height;
+    key.padding = padding;
+    key.lut = lut;
+    return key;
+}
+
+uint64_t FrameCache::LutKey(const NormalizeLut& lut) {
+    uint64_t key = fnv1a64(lut.means, sizeof(lut.means));
+    key = fnv1a64(lut.stds, sizeof(lut.stds), key);
+    key = fnv1a64(&lut.scale, sizeof(lut.scale), key);
+    key = fnv1a64(lut.source, sizeof(lut.source), key);
+    key = fnv1a64(&lut.dtype, sizeof(lut.dtype), key);
+    return fnv1a64(&lut.qscale, sizeof(lut.qscale), key);
+}
+
+FrameCache::EntryPtr FrameCache::Find(const FrameKey& key) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(key);
+    Stats& stats = mStats[key.kind];
+    if (it == mEntries.end()) {
+        stats.misses++;
+        return nullptr;
+    }
+    stats.hits++;
+    stats.saved_ms += it->second->cost_ms;
+    return it->second;
+}
+
+FrameCache::EntryPtr FrameCache::Insert(const FrameKey& key, std::shared_ptr<Entry> entry) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (std::find(mFrames.begin(), mFrames.end(), key.frame) == mFrames.end()) {
+        mFrames.push_back(key.frame);
+        while (static_cast<int>(mFrames.size()) > mMaxFrames) {
+            // keys are ordered by frame first, entries of a frame are one range
+            FrameKey first, last;
+            first.frame = mFrames.front();
+            last.frame = mFrames.front() + 1;
+            auto begin = mEntries.lower_bound(first);
+            auto end = mFrames.front() + 1 == 0 ? mEntries.end() : mEntries.lower_bound(last);
+            for (auto it = begin; it != end; ++it) {
+                mBytes -= it->second->bytes.size();
+            }
+            mEntries.erase(begin, end);
+            mFrames.pop_front();
+        }
+    }
+    auto inserted = mEntries.emplace(key, entry);
+    if (inserted.second) mBytes += entry->bytes.size();
+    return inserted.first->second;
+}
+
+long FrameCache::Hits(Kind kind) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats[kind].hits;
+}
+
+long FrameCache::Misses(Kind kind) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats[kind].misses;
+}
+
+double FrameCache::SavedMs(Kind kind) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats[kind].saved_ms;
+}
+
+size_t FrameCache::Bytes() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBytes;
+}
+
+void FrameCache::Report() const {
+    const char* names[kKinds] = {"input", "resized", "level"};
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << "Frame cache(" << mBytes / 1048576. << " MB held):" << std::endl
+        << std::setw(10) << std::left << "kind" << std::right << std::setw(10) << "hits" << std::setw(10) << "misses"
+        << std::setw(12) << "hit rate" << std::setw(12) << "saved ms" << std::endl;
+    double saved = 0.0;
+    for (int k = 0; k < kKinds; ++k) {
+        const Stats& s = mStats[k];
+        long lookups = s.hits + s.misses;
+        out << std::setw(10) << std::left << names[k] << std::right << std::setw(10) << s.hits << std::setw(10)
+            << s.misses << std::setw(11) << (lookups > 0 ? 100. * s.hits / lookups : 0.) << "%" << std::setw(12)
+            << s.saved_ms << std::endl;
+        saved += s.saved_ms;
+    }
+    out << "saved " << saved << " ms" << std::endl;
+    std::cout << out.str();
+}
@@ -0,0 +1,129 @@
+/**
+ * Preprocessing shared by tasks running on the same frame. Tasks look up work
+ * done for a frame by tasks before them, keyed by frame id of ImageView(0 is
+ * never cached), roi, input size, padding and normalization:
+ *  - input: normalized input of an image in data type of lut, tasks of same
+ *    size and normalization on host backends copy it into their binding.
+ *  - resized: bgr bytes at input size, tasks of same size but other
+ *    normalization, or device backends, normalize or upload it.
+ *  - level: pyramid of frame, every level half of previous by 2x2 average,
+ *    tasks resize from smallest level still covering their resized size, so
+ *    nearby resolutions start from the same smaller image(with pyramid on,
+ *    inputs differ from resizing full frame by bilinear taps then).
+ * Entries are copies: a miss pays a copy of what it computed, a hit a copy into
+ * binding. Entries of last max_frames frame ids are kept. Thread safe, tasks
+ * running concurrently on one frame may both compute an entry, first insert is
+ * kept.
+ * 2021/07/12
+ */
+
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "nhwc2nchw_cpu.h"
+#include "structs.h"
+
+struct FrameKey {
+    uint64_t frame = 0;
+    int kind = 0;
+    int roi_x = 0;
+    int roi_y = 0;
+    int roi_w = 0;
+    int roi_h = 0;
+    int width = 0;
+    int height = 0;
+    bool padding = false;
+    uint64_t lut = 0;  // FrameCache::LutKey of normalization, inputs only
+
+    bool operator<(const FrameKey& other) const;
+};
+
+class FrameCache {
+public:
+    enum Kind {
+        kInput,
+        kResized,
+        kLevel,
+        kKinds,
+    };
+
+    struct Entry {
+        std::vector<uint8_t> bytes;
+        int width = 0;  // bgr image of resized and levels
+        int height = 0;
+        ImageTransform transform;  // of input and resized
+        float cost_ms = 0.f;       // time computing it took, saved by every hit
+    };
+    typedef std::shared_ptr<const Entry> EntryPtr;
+
+    /**
+     * max_frames: frame ids kept, e.g. frames of cameras in flight at once.
+     * pyramid: tasks resize from pyramid levels, a level costs a pass over
+     * frame, so it pays off when several small inputs share it.
+     */
+    explicit FrameCache(int max_frames = 2, bool pyramid = false);
+    FrameCache(const FrameCache&) = delete;
+    FrameCache& operator=(const FrameCache&) = delete;
+
+    static FrameKey Key(const ImageView& view, Kind kind, int width, int height, bool padding = false, uint64_t lut = 0);
+
+    /**
+     * Hash of everything normalized values depend on: means, stds, scale,
+     * channel order and output data type.
+     */
+    static uint64_t LutKey(const NormalizeLut& lut);
+
+    /**
+     * Entry of key or nullptr, counted as hit or miss of its kind.
+     */
+    EntryPtr Find(const FrameKey& key);
+
+    /**
+     * Insert entry of key, return entry stored under key(an earlier one if
+     * another task inserted it first). Entries of frames older than last
+     * max_frames ids are dropped.
+     */
+    EntryPtr Insert(const FrameKey& key, std::shared_ptr<Entry> entry);
+
+    bool Pyramid() const {
+        return mPyramid;
+    }
+
+    long Hits(Kind kind) const;
+    long Misses(Kind kind) const;
+    double SavedMs(Kind kind) const;
+
+    /**
+     * Bytes held by entries.
+     */
+    size_t Bytes() const;
+
+    /**
+     * Print hits, hit rate and ms saved of every kind.
+     */
+    void Report() const;
+
+private:
+    struct Stats {
+        long hits = 0;
+        long misses = 0;
+        double saved_ms = 0.0;
+    };
+
+    mutable std::mutex mMutex;
+    std::map<FrameKey, EntryPtr> mEntries;
+    std::deque<uint64_t> mFrames;  // ids kept, oldest first
+    Stats mStats[kKinds];
+    size_t mBytes = 0;
+    int mMaxFrames;
+    bool mPyramid;
+};
+
+#endif  // FRAME_CACHE_H
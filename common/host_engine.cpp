@@ -0,0 +1,155 @@
+/**
+ * Host inference backend.
+ * 2021/02/01
+ */
+#include "host_engine.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "tensor_record.h"
+
+HostEngine::HostEngine(const std::vector<HostBinding>& bindings) : mBindings(bindings) {}
+
+void HostEngine::CreateEngine(const std::string& onnxModel,
+                              const std::string& engineFile,
+                              const std::vector<std::string>& customOutput,
+                              int maxBatchSize,
+                              RunMode runMode,
+                              long workspace_size) {
+    UNUSED(onnxModel);
+    UNUSED(engineFile);
+    UNUSED(customOutput);
+    UNUSED(runMode);
+    UNUSED(workspace_size);
+    StartupStage stage(mStartup, startup::kBindings);
+    mBatchSize = maxBatchSize;
+    mCurBatch  = maxBatchSize;
+    mLogger.logger("Init host engine, nbBindings: ", mBindings.size());
+    mBuffers.resize(mBindings.size());
+    mBindingName.resize(mBindings.size());
+    for (size_t i = 0; i < mBindings.size(); ++i) {
+        const HostBinding& binding = mBindings[i];
+        if (binding.dims.nbDims > 0 && binding.dims.d[0] != maxBatchSize) {
+            mLogger.logger("Batch of host binding mismatch bchw: ", binding.name, logger::LEVEL::WARNING);
+        }
+        mBuffers[i].assign(volume(binding.dims) * getElementSize(binding.dtype), 0);
+        mBindingName[i] = binding.name;
+        std::cout << "Binding bindIndex: " << i << ", Name: " << binding.name << ", Size in bytes: " << mBuffers[i].size() << std::endl;
+    }
+}
+
+InferBackend* HostEngine::Clone() const {
+    HostEngine* engine = new HostEngine(mBindings);
+    engine->SetForward(mForward);
+    engine->SetRecorder(mRecorder);
+    engine->CreateEngine("", "", {}, mBatchSize, RunMode::kFP32, 0);
+    return engine;
+}
+
+void HostEngine::Forward() {
+    if (mForward) {
+        mForward(*this);
+    }
+    if (mRecorder) mRecorder->Record(*this, mCurBatch, nullptr);
+}
+
+void HostEngine::ForwardAsync(const cudaStream_t& stream) {
+    UNUSED(stream);
+    Forward();
+}
+
+void HostEngine::CopyFromHostToDevice(const std::vector<float>& input, int bindIndex) {
+    assert(input.size() * sizeof(float) >= mBuffers[bindIndex].size());
+    memcpy(mBuffers[bindIndex].data(), input.data(), mBuffers[bindIndex].size());
+}
+
+void HostEngine::CopyFromDeviceToHost(std::vector<float>& output, int bindIndex) {
+    assert(output.size() * sizeof(float) >= mBuffers[bindIndex].size());
+    memcpy(output.data(), mBuffers[bindIndex].data(), mBuffers[bindIndex].size());
+}
+
+void HostEngine::CopyFromHostToDevice(const std::vector<float>& input, int bindIndex, const cudaStream_t& stream) {
+    UNUSED(stream);
+    CopyFromHostToDevice(input, bindIndex);
+}
+
+void HostEngine::CopyFromDeviceToHost(std::vector<float>& output, int bindIndex, const cudaStream_t& stream) {
+    UNUSED(stream);
+    CopyFromDeviceToHost(output, bindIndex);
+}
+
+int HostEngine::GetMaxBatchSize() const {
+    return mBatchSize;
+}
+
+bool HostEngine::SetBatchSize(int batch) {
+    assert(batch > 0 && batch <= mBatchSize);
+    mCurBatch = batch;
+    return true;
+}
+
+void* HostEngine::GetBindingPtr(int bindIndex) const {
+    return const_cast<uint8_t*>(mBuffers[bindIndex].data());
+}
+
+size_t HostEngine::GetBindingSize(int bindIndex) const {
+    return mBuffers[bindIndex].size();
+}
+
+nvinfer1::Dims HostEngine::GetBindingDims(int bindIndex) const {
+    return mBindings[bindIndex].dims;
+}
+
+nvinfer1::DataType HostEngine::GetBindingDataType(int bindIndex) const {
+    return mBindings[bindIndex].dtype;
+}
+
+bool HostEngine::BindingIsInput(int bindIndex) const {
+    return mBindings[bindIndex].is_input;
+}
+
+float HostEngine::GetBindingScale(int bindIndex) const {
+    return mBindings[bindIndex].scale;
+}
+
+int HostEngine::GetBindingIndex(const std::string& name) const {
+    for (size_t i = 0; i < mBindings.size(); ++i) {
+        if (mBindings[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void HostEngine::SetForward(const ForwardFn& fn) {
+    mForward = fn;
+}
+
+nvinfer1::DataType parseDataType(const std::string& name) {
+    if (name == "half") return nvinfer1::DataType::kHALF;
+    if (name == "int8") return nvinfer1::DataType::kINT8;
+    if (name == "int32") return nvinfer1::DataType::kINT32;
+    return nvinfer1::DataType::kFLOAT;
+}
+
+std::vector<HostBinding> parseHostBindings(const YAML::Node& node) {
+    std::vector<HostBinding> bindings;
+    if (!node) {
+        return bindings;
+    }
+    for (const auto& item : node) {
+        HostBinding binding;
+        binding.name = item["name"] ? item["name"].as<std::string>() : "binding_" + std::to_string(bindings.size());
+        std::vector<int> dims = item["dims"].as<std::vector<int>>();
+        assert(static_cast<int>(dims.size()) <= nvinfer1::Dims::MAX_DIMS);
+        binding.dims.nbDims = static_cast<int>(dims.size());
+        for (size_t i = 0; i < dims.size(); ++i) {
+            binding.dims.d[i] = dims[i];
+        }
+        binding.dtype = parseDataType(item["dtype"] ? item["dtype"].as<std::string>() : "float");
+        binding.scale = item["scale"] ? item["scale"].as<float>() : 1.f;
+        // first binding is input unless told otherwise, same as onnx engines here
+        binding.is_input = item["input"] ? item["input"].as<bool>() : bindings.empty();
+        bindings.emplace_back(binding);
+    }
+    return bindings;
+}
@@ -0,0 +1,127 @@
+/**
+ * Host inference backend. Bindings are plain host buffers and forward is a
+ * pluggable callable, so pre/post process of every task can run without GPU.
+ * 2021/02/01
+ */
+
+#ifndef HOST_ENGINE_H
+#define HOST_ENGINE_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "NvInfer.h"
+#include "backend.h"
+#include "logger.h"
+#include "utils.h"
+#include "yaml-cpp/yaml.h"
+
+struct HostBinding {
+    std::string name;
+    nvinfer1::Dims dims;
+    nvinfer1::DataType dtype;
+    bool is_input;
+    float scale = 1.f;  // of int8 binding
+};
+
+class HostEngine : public InferBackend {
+public:
+    /**
+     * Forward callable, reads input bindings and fills output bindings of engine.
+     */
+    typedef std::function<void(HostEngine& engine)> ForwardFn;
+
+    HostEngine(const std::vector<HostBinding>& bindings);
+    ~HostEngine() = default;
+
+    /**
+     * Allocate host bindings, model and engine file are ignored.
+     */
+    void CreateEngine(const std::string& onnxModel,
+                      const std::string& engineFile,
+                      const std::vector<std::string>& customOutput,
+                      int maxBatchSize,
+                      RunMode runMode,
+                      long workspace_size) override;
+
+    /**
+     * Same bindings and forward callable, own host buffers.
+     */
+    InferBackend* Clone() const override;
+
+    /**
+     * Call forward callable, outputs keep their last value if it is not set.
+     */
+    void Forward() override;
+
+    void ForwardAsync(const cudaStream_t& stream) override;
+
+    void CopyFromHostToDevice(const std::vector<float>& input, int bindIndex) override;
+
+    void CopyFromDeviceToHost(std::vector<float>& output, int bindIndex) override;
+
+    void CopyFromHostToDevice(const std::vector<float>& input, int bindIndex, const cudaStream_t& stream) override;
+
+    void CopyFromDeviceToHost(std::vector<float>& output, int bindIndex, const cudaStream_t& stream) override;
+
+    BackendType GetBackendType() const override {
+        return BackendType::kHost;
+    }
+
+    bool IsDeviceMemory() const override {
+        return false;
+    }
+
+    int GetMaxBatchSize() const override;
+
+    /**
+     * Forward callable reads GetBatchSize() of engine, so partial batch is
+     * always supported.
+     */
+    bool SetBatchSize(int batch) override;
+
+    void* GetBindingPtr(int bindIndex) const override;
+
+    size_t GetBindingSize(int bindIndex) const override;
+
+    nvinfer1::Dims GetBindingDims(int bindIndex) const override;
+
+    nvinfer1::DataType GetBindingDataType(int bindIndex) const override;
+
+    bool BindingIsInput(int bindIndex) const override;
+
+    float GetBindingScale(int bindIndex) const override;
+
+    /**
+     * Get binding index by name, return -1 if not found.
+     */
+    int GetBindingIndex(const std::string& name) const;
+
+    void SetForward(const ForwardFn& fn);
+
+private:
+    logger::Logger mLogger;
+
+    std::vector<HostBinding> mBindings;
+
+    std::vector<std::vector<uint8_t>> mBuffers;
+
+    ForwardFn mForward;
+
+    int mBatchSize = 0;
+};
+
+/**
+ * Parse data type from yaml string, float/half/int8/int32, float by default.
+ */
+nvinfer1::DataType parseDataType(const std::string& name);
+
+/**
+ * Parse host bindings from yaml, each item is {name, dims, dtype, input, scale},
+ * dtype is one of float/half/int8/int32 and float by default, scale of int8
+ * binding is 1 by default.
+ */
+std::vector<HostBinding> parseHostBindings(const YAML::Node& node);
+
+#endif  // HOST_ENGINE_H
@@ -0,0 +1,147 @@
+#include "image_loader.h"
+
+#include <csetjmp>
+#include <cstdio>
+#include <fstream>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#ifdef WITH_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+int ImageLoader::ScaleDenom(int src_w, int src_h, int width, int height) {
+    for (int denom = 8; denom > 1; denom /= 2) {
+        if ((src_w + denom - 1) / denom >= width && (src_h + denom - 1) / denom >= height) return denom;
+    }
+    return 1;
+}
+
+bool ImageLoader::JpegSize(const std::string& path, int* width, int* height) {
+    std::ifstream file(path, std::ios::binary);
+    if (file.get() != 0xff || file.get() != 0xd8) return false;
+    while (file) {
+        int marker = file.get();
+        if (marker != 0xff) return false;
+        // fill bytes before marker code
+        while ((marker = file.get()) == 0xff) {}
+        if (marker == EOF) return false;
+        // markers without a segment
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) continue;
+        int length = file.get() << 8;
+        length |= file.get();
+        if (!file || length < 2) return false;
+        // frame headers SOF0 - SOF15, but DHT, JPG and DAC share the range
+        if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+            uint8_t header[5];  // precision, height, width
+            if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+            *height = (header[1] << 8) | header[2];
+            *width  = (header[3] << 8) | header[4];
+            return *width > 0 && *height > 0;
+        }
+        file.seekg(length - 2, std::ios::cur);
+    }
+    return false;
+}
+
+#ifdef WITH_LIBJPEG
+namespace {
+// default error_exit of libjpeg calls exit(), jump back to decodeJpeg instead
+struct JpegError {
+    jpeg_error_mgr mgr;
+    jmp_buf jump;
+};
+
+void jpegErrorExit(j_common_ptr cinfo) {
+    longjmp(reinterpret_cast<JpegError*>(cinfo->err)->jump, 1);
+}
+
+// warnings(e.g. corrupt data libjpeg recovers from) are not printed for every frame
+void jpegOutputMessage(j_common_ptr) {}
+}  // namespace
+
+bool ImageLoader::decodeJpeg(const std::string& path, int width, int height, cv::Mat& decoded) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    // other formats go to imread without a warning
+    bool jpeg = fgetc(file) == 0xff && fgetc(file) == 0xd8;
+    if (!jpeg || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return false;
+    }
+    jpeg_decompress_struct cinfo;
+    JpegError error;
+    cinfo.err = jpeg_std_error(&error.mgr);
+    error.mgr.error_exit = jpegErrorExit;
+    error.mgr.output_message = jpegOutputMessage;
+    if (setjmp(error.jump)) {
+        char message[JMSG_LENGTH_MAX];
+        (*cinfo.err->format_message)(reinterpret_cast<j_common_ptr>(&cinfo), message);
+        mLogger.logger("libjpeg can't decode " + path + ", read by imread:", message, logger::LEVEL::WARNING);
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    mDenom = ScaleDenom(static_cast<int>(cinfo.image_width), static_cast<int>(cinfo.image_height), width, height);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = static_cast<unsigned int>(mDenom);
+#ifdef JCS_EXTENSIONS
+    cinfo.out_color_space = JCS_EXT_BGR;  // libjpeg-turbo writes bgr itself, gray too
+#else
+    cinfo.out_color_space = JCS_RGB;
+#endif
+    jpeg_start_decompress(&cinfo);
+    int w = static_cast<int>(cinfo.output_width);
+    int h = static_cast<int>(cinfo.output_height);
+    size_t step = static_cast<size_t>(w) * 3;
+    if (mStaging.size() < step * h) mStaging.resize(step * h);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = mStaging.data() + cinfo.output_scanline * step;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+    decoded = cv::Mat(h, w, CV_8UC3, mStaging.data());
+#ifndef JCS_EXTENSIONS
+    cv::cvtColor(decoded, decoded, cv::COLOR_RGB2BGR);
+#endif
+    return true;
+}
+#else
+bool ImageLoader::decodeJpeg(const std::string& path, int width, int height, cv::Mat& decoded) {
+    int src_w = 0, src_h = 0;
+    if (!JpegSize(path, &src_w, &src_h)) return false;
+    mDenom = ScaleDenom(src_w, src_h, width, height);
+    const int flags[] = {cv::IMREAD_COLOR, cv::IMREAD_REDUCED_COLOR_2, cv::IMREAD_REDUCED_COLOR_4, cv::IMREAD_REDUCED_COLOR_8};
+    int level = mDenom == 8 ? 3 : mDenom / 2;
+    decoded = cv::imread(path, flags[level]);
+    return !decoded.empty();
+}
+#endif  // WITH_LIBJPEG
+
+cv::Mat ImageLoader::Decode(const std::string& path, int width, int height) {
+    cv::Mat decoded;
+    if (decodeJpeg(path, width, height, decoded)) return decoded;
+    mDenom = 1;
+    decoded = cv::imread(path);
+    if (decoded.empty()) {
+        mLogger.logger("Can't read image:", path, logger::LEVEL::ERROR);
+    }
+    return decoded;
+}
+
+bool ImageLoader::Load(const std::string& path, cv::Mat& dst, int width, int height) {
+    cv::Mat decoded = Decode(path, width, height);
+    if (decoded.empty()) return false;
+    if (decoded.cols == width && decoded.rows == height) {
+        decoded.copyTo(dst);
+    } else {
+        cv::resize(decoded, dst, cv::Size(width, height));
+    }
+    return true;
+}
@@ -0,0 +1,77 @@
+/**
+ * Image loader decoding jpeg at reduced size. libjpeg scales DCT blocks while
+ * decoding(1/2, 1/4 or 1/8 of every side), so a frame that ends up as a small
+ * input of a task is decoded at the smallest scale still covering input size,
+ * into a staging buffer every load reuses, and only a residual cv::resize of
+ * less than 2x is left. Other formats, and jpeg libjpeg can not decode into
+ * bgr(e.g. cmyk), are read full size by cv::imread. Built without libjpeg(not
+ * found by cmake), cv::imread with IMREAD_REDUCED_COLOR_* picks the same scale.
+ * Exif orientation is not applied. One loader per thread.
+ * 2021/06/28
+ */
+
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "logger.h"
+
+class ImageLoader {
+public:
+    ImageLoader() = default;
+    ImageLoader(const ImageLoader&) = delete;
+    ImageLoader& operator=(const ImageLoader&) = delete;
+
+    /**
+     * Largest of 1, 2, 4 and 8 whose scaled source, rounded up as libjpeg does,
+     * still covers width x height.
+     */
+    static int ScaleDenom(int src_w, int src_h, int width, int height);
+
+    /**
+     * Width and height of jpeg at path from its frame header, false if path is
+     * not a jpeg or can't be read.
+     */
+    static bool JpegSize(const std::string& path, int* width, int* height);
+
+    /**
+     * Image at path decoded at smallest scale covering width x height, bgr, not
+     * resized. Returned Mat is staging buffer of loader(jpeg) and valid until
+     * next Decode or Load. Empty if path can't be read.
+     */
+    cv::Mat Decode(const std::string& path, int width, int height);
+
+    /**
+     * Decode, then resize into dst of width x height, bgr, by INTER_LINEAR.
+     * dst keeps its buffer if it's already of that size, e.g. a slot of staging
+     * buffer of a task. false if path can't be read.
+     */
+    bool Load(const std::string& path, cv::Mat& dst, int width, int height);
+
+    /**
+     * Scale denominator of last Decode, 1 if read full size.
+     */
+    int LastDenom() const {
+        return mDenom;
+    }
+
+    size_t StagingBytes() const {
+        return mStaging.size();
+    }
+
+private:
+    // decode into mStaging by libjpeg, false on any libjpeg error
+    bool decodeJpeg(const std::string& path, int width, int height, cv::Mat& decoded);
+
+private:
+    logger::Logger mLogger;
+    std::vector<uint8_t> mStaging;  // grows to largest decoded image, never shrinks
+    int mDenom = 1;
+};
+
+#endif  // IMAGE_LOADER_H
@@ -0,0 +1,156 @@
+/**
+ * Memory planner of scratch buffers across tasks.
+ * 2021/05/17
+ */
+#include "memory_planner.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+
+#include "utils.h"
+
+MemoryPlanner::MemoryPlanner(size_t alignment) : mAlignment(std::max<size_t>(alignment, 1)) {}
+
+MemoryPlanner::~MemoryPlanner() {
+    for (auto& arena : mArenas) {
+        if (arena.second.ptr) arena.second.free(arena.second.ptr);
+    }
+}
+
+int MemoryPlanner::Add(const ScratchRequest& request) {
+    mRequests.emplace_back(request);
+    mOffsets.emplace_back(0);
+    return static_cast<int>(mRequests.size()) - 1;
+}
+
+static bool liveTogether(const ScratchRequest& a, const ScratchRequest& b) {
+    return a.device == b.device && a.first <= b.last && b.first <= a.last;
+}
+
+void MemoryPlanner::Plan() {
+    std::vector<int> order(mRequests.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return mRequests[a].size > mRequests[b].size;
+    });
+    mPeaks.clear();
+    std::vector<int> placed;
+    for (int id : order) {
+        const ScratchRequest& request = mRequests[id];
+        // placed buffers live with this one, by offset, fit into first gap
+        std::vector<int> live;
+        for (int other : placed) {
+            if (liveTogether(request, mRequests[other])) live.emplace_back(other);
+        }
+        std::sort(live.begin(), live.end(), [&](int a, int b) { return mOffsets[a] < mOffsets[b]; });
+        size_t offset = 0;
+        for (int other : live) {
+            if (offset + request.size <= mOffsets[other]) break;
+            offset = std::max(offset, Align(mOffsets[other] + mRequests[other].size));
+        }
+        mOffsets[id] = offset;
+        placed.emplace_back(id);
+        size_t& peak = mPeaks[request.device];
+        peak = std::max(peak, Align(offset + request.size));
+    }
+}
+
+bool MemoryPlanner::Check() const {
+    for (size_t i = 0; i < mRequests.size(); ++i) {
+        if (mOffsets[i] % mAlignment != 0 || mOffsets[i] + mRequests[i].size > PlannedPeak(mRequests[i].device)) {
+            return false;
+        }
+        for (size_t j = i + 1; j < mRequests.size(); ++j) {
+            if (!liveTogether(mRequests[i], mRequests[j]) || mRequests[i].size == 0 || mRequests[j].size == 0) continue;
+            if (mOffsets[i] < mOffsets[j] + mRequests[j].size && mOffsets[j] < mOffsets[i] + mRequests[i].size) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void MemoryPlanner::Allocate(int device, const AllocFn& alloc, const FreeFn& free) {
+    Arena& arena = mArenas[device];
+    if (arena.ptr) arena.free(arena.ptr);
+    size_t size = PlannedPeak(device);
+    arena.ptr  = size > 0 ? alloc(size) : nullptr;
+    arena.free = free;
+}
+
+void MemoryPlanner::Allocate() {
+    for (int device : Devices()) {
+        if (device == kHostArena) {
+            Allocate(device, [](size_t size) -> void* { return new uint8_t[size]; },
+                     [](void* ptr) { delete[] static_cast<uint8_t*>(ptr); });
+            continue;
+        }
+        Allocate(device, [device](size_t size) -> void* {
+            void* ptr = nullptr;
+            CUDA_CHECK(cudaSetDevice(device));
+            CUDA_CHECK(cudaMalloc(&ptr, size));
+            return ptr;
+        }, [device](void* ptr) {
+            CUDA_CHECK(cudaSetDevice(device));
+            CUDA_CHECK(cudaFree(ptr));
+        });
+    }
+}
+
+void* MemoryPlanner::Ptr(int id) const {
+    auto arena = mArenas.find(mRequests[id].device);
+    if (arena == mArenas.end() || arena->second.ptr == nullptr) return nullptr;
+    return static_cast<uint8_t*>(arena->second.ptr) + mOffsets[id];
+}
+
+std::vector<int> MemoryPlanner::Devices() const {
+    std::vector<int> devices;
+    for (const auto& request : mRequests) {
+        if (std::find(devices.begin(), devices.end(), request.device) == devices.end()) {
+            devices.emplace_back(request.device);
+        }
+    }
+    std::sort(devices.begin(), devices.end());
+    return devices;
+}
+
+size_t MemoryPlanner::PlannedPeak(int device) const {
+    auto peak = mPeaks.find(device);
+    return peak == mPeaks.end() ? 0 : peak->second;
+}
+
+size_t MemoryPlanner::NaivePeak(int device) const {
+    size_t total = 0;
+    for (const auto& request : mRequests) {
+        if (request.device == device) total += Align(request.size);
+    }
+    return total;
+}
+
+static std::string deviceName(int device) {
+    return device == kHostArena ? "host" : "gpu" + std::to_string(device);
+}
+
+void MemoryPlanner::Report() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << "Scratch memory plan(MB):" << std::endl
+        << std::setw(10) << std::left << "owner" << std::setw(18) << "buffer" << std::right
+        << std::setw(8) << "arena" << std::setw(8) << "steps" << std::setw(10) << "size" << std::setw(10) << "offset" << std::endl;
+    for (size_t i = 0; i < mRequests.size(); ++i) {
+        const ScratchRequest& r = mRequests[i];
+        std::string steps = std::to_string(r.first) + (r.last != r.first ? "-" + std::to_string(r.last) : "");
+        out << std::setw(10) << std::left << r.owner << std::setw(18) << r.name << std::right
+            << std::setw(8) << deviceName(r.device) << std::setw(8) << steps
+            << std::setw(10) << r.size / 1048576. << std::setw(10) << mOffsets[i] / 1048576. << std::endl;
+    }
+    for (int device : Devices()) {
+        size_t planned = PlannedPeak(device);
+        size_t naive = NaivePeak(device);
+        out << deviceName(device) << " peak: planned " << planned / 1048576. << " MB, naive " << naive / 1048576.
+            << " MB, saved " << (naive > 0 ? 100. * (naive - planned) / naive : 0.) << "%" << std::endl;
+    }
+    std::cout << out.str();
+}
@@ -0,0 +1,129 @@
+/**
+ * Memory planner of scratch buffers across tasks. Tasks declare buffers they
+ * need only while running(staging of images, post process scratch) with the
+ * steps of execution order they run in, planner places buffers whose steps
+ * never overlap at the same offsets of one arena per device, so peak is the
+ * largest set of buffers live together instead of sum of all buffers.
+ * 2021/05/17
+ */
+
+#ifndef MEMORY_PLANNER_H
+#define MEMORY_PLANNER_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "logger.h"
+
+/**
+ * Arena of host memory, others are cuda devices.
+ */
+const int kHostArena = -1;
+
+struct ScratchRequest {
+    std::string owner;  // task
+    std::string name;   // buffer of task
+    size_t size = 0;    // in byte
+    int first = 0;      // steps of execution order buffer is live in, inclusive
+    int last = 0;
+    int device = kHostArena;
+};
+
+class MemoryPlanner {
+public:
+    typedef std::function<void*(size_t size)> AllocFn;
+    typedef std::function<void(void* ptr)> FreeFn;
+
+    /**
+     * alignment: of every buffer offset, 256 matches cudaMalloc.
+     */
+    explicit MemoryPlanner(size_t alignment = 256);
+    ~MemoryPlanner();
+    MemoryPlanner(const MemoryPlanner&) = delete;
+    MemoryPlanner& operator=(const MemoryPlanner&) = delete;
+
+    /**
+     * Declare a buffer, return its id. Call it before Plan.
+     */
+    int Add(const ScratchRequest& request);
+
+    /**
+     * Assign offsets, greedy by size: larger buffers first, each at the lowest
+     * offset not overlapping buffers of same device live in any of its steps.
+     */
+    void Plan();
+
+    /**
+     * Check plan: no two buffers of a device live in a common step overlap.
+     */
+    bool Check() const;
+
+    /**
+     * Allocate arena of device with alloc, freed with free by destructor, or
+     * by a later Allocate of same device.
+     */
+    void Allocate(int device, const AllocFn& alloc, const FreeFn& free);
+
+    /**
+     * Allocate arenas of all devices, new[] for host and cudaMalloc on device.
+     */
+    void Allocate();
+
+    size_t Offset(int id) const {
+        return mOffsets[id];
+    }
+
+    /**
+     * Address of buffer in its arena, nullptr before Allocate.
+     */
+    void* Ptr(int id) const;
+
+    const ScratchRequest& Request(int id) const {
+        return mRequests[id];
+    }
+
+    int Size() const {
+        return static_cast<int>(mRequests.size());
+    }
+
+    /**
+     * Devices of requests, host first.
+     */
+    std::vector<int> Devices() const;
+
+    /**
+     * Arena size of device after Plan.
+     */
+    size_t PlannedPeak(int device) const;
+
+    /**
+     * Sum of buffers of device, every buffer allocated on its own.
+     */
+    size_t NaivePeak(int device) const;
+
+    /**
+     * Print planned versus naive peak of every device and buffers of every owner.
+     */
+    void Report() const;
+
+private:
+    size_t Align(size_t size) const {
+        return (size + mAlignment - 1) / mAlignment * mAlignment;
+    }
+
+    struct Arena {
+        void* ptr = nullptr;
+        FreeFn free;
+    };
+
+    size_t mAlignment;
+    std::vector<ScratchRequest> mRequests;
+    std::vector<size_t> mOffsets;
+    std::map<int, size_t> mPeaks;
+    std::map<int, Arena> mArenas;
+    logger::Logger mLogger;
+};
+
+#endif  // MEMORY_PLANNER_H
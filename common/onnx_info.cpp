@@ -0,0 +1,574 @@
+/**
+ * Onnx protobuf reader.
+ * 2021/03/29
+ */
+#include "onnx_info.h"
+
+#include <cstring>
+#include <fnmatch.h>
+#include <set>
+
+#include "engine_artifact.h"
+
+// protobuf wire types
+enum WireType : uint32_t {
+    kVarint = 0,
+    kFixed64 = 1,
+    kBytes = 2,
+    kFixed32 = 5
+};
+
+// field numbers of onnx.proto used here
+namespace onnx_field {
+const uint32_t kModelIrVersion  = 1;
+const uint32_t kModelGraph      = 7;
+const uint32_t kModelOpset      = 8;
+const uint32_t kOpsetDomain     = 1;
+const uint32_t kOpsetVersion    = 2;
+const uint32_t kGraphNode       = 1;
+const uint32_t kGraphInit       = 5;
+const uint32_t kGraphInput      = 11;
+const uint32_t kGraphOutput     = 12;
+const uint32_t kNodeInput       = 1;
+const uint32_t kNodeOutput      = 2;
+const uint32_t kNodeName        = 3;
+const uint32_t kNodeOpType      = 4;
+const uint32_t kNodeAttribute   = 5;
+const uint32_t kAttrName        = 1;
+const uint32_t kAttrFloat       = 2;
+const uint32_t kAttrInt         = 3;
+const uint32_t kAttrString      = 4;
+const uint32_t kAttrTensor      = 5;
+const uint32_t kAttrFloats      = 7;
+const uint32_t kAttrInts        = 8;
+const uint32_t kTensorDims      = 1;
+const uint32_t kTensorDataType  = 2;
+const uint32_t kTensorFloatData = 4;
+const uint32_t kTensorInt32Data = 5;
+const uint32_t kTensorInt64Data = 7;
+const uint32_t kTensorName      = 8;
+const uint32_t kTensorRawData   = 9;
+const uint32_t kTensorLocation  = 14;
+const uint32_t kValueName       = 1;
+const uint32_t kValueType       = 2;
+const uint32_t kTypeTensor      = 1;
+const uint32_t kTensorElemType  = 1;
+const uint32_t kTensorShape     = 2;
+const uint32_t kShapeDim        = 1;
+const uint32_t kDimValue        = 1;
+}  // namespace onnx_field
+
+// onnx TensorProto.DataType
+enum OnnxDataType : int32_t {
+    kOnnxFloat = 1,
+    kOnnxInt32 = 6,
+    kOnnxInt64 = 7
+};
+
+/**
+ * Cursor of one protobuf message, fields are read in order.
+ */
+class ProtoReader {
+public:
+    ProtoReader(const uint8_t* data, size_t size) : mPos(data), mEnd(data + size) {}
+
+    /**
+     * Read key of next field, return false at end of message or on broken data.
+     */
+    bool Next(uint32_t& field, uint32_t& wire) {
+        uint64_t key;
+        if (mPos >= mEnd || !varint(key)) return false;
+        field = static_cast<uint32_t>(key >> 3);
+        wire  = static_cast<uint32_t>(key & 7);
+        return true;
+    }
+
+    bool Varint(uint64_t& value) {
+        return varint(value);
+    }
+
+    bool Fixed32(uint32_t& value) {
+        if (mEnd - mPos < 4) return false;
+        memcpy(&value, mPos, 4);
+        mPos += 4;
+        return true;
+    }
+
+    bool End() const {
+        return mPos >= mEnd;
+    }
+
+    /**
+     * Payload of length delimited field, a sub message, string or packed array.
+     */
+    bool Bytes(const uint8_t*& data, size_t& size) {
+        uint64_t length;
+        if (!varint(length) || length > static_cast<uint64_t>(mEnd - mPos)) return false;
+        data = mPos;
+        size = static_cast<size_t>(length);
+        mPos += size;
+        return true;
+    }
+
+    bool Skip(uint32_t wire) {
+        uint64_t value;
+        const uint8_t* data;
+        size_t size;
+        switch (wire) {
+            case kVarint:  return varint(value);
+            case kBytes:   return Bytes(data, size);
+            case kFixed64: return advance(8);
+            case kFixed32: return advance(4);
+            default:       return false;  // groups are not used by onnx
+        }
+    }
+
+private:
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && mPos < mEnd; shift += 7) {
+            uint8_t byte = *mPos++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    bool advance(size_t size) {
+        if (size > static_cast<size_t>(mEnd - mPos)) return false;
+        mPos += size;
+        return true;
+    }
+
+private:
+    const uint8_t* mPos;
+    const uint8_t* mEnd;
+};
+
+static bool readDim(const uint8_t* data, size_t size, int64_t& dim) {
+    ProtoReader reader(data, size);
+    uint32_t field, wire;
+    dim = -1;  // dim_param or unset
+    while (reader.Next(field, wire)) {
+        if (field == onnx_field::kDimValue && wire == kVarint) {
+            uint64_t value;
+            if (!reader.Varint(value)) return false;
+            dim = static_cast<int64_t>(value);
+        } else if (!reader.Skip(wire)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool readTensorType(const uint8_t* data, size_t size, OnnxTensorInfo& tensor) {
+    ProtoReader reader(data, size);
+    uint32_t field, wire;
+    while (reader.Next(field, wire)) {
+        const uint8_t* sub;
+        size_t sub_size;
+        if (field == onnx_field::kTensorElemType && wire == kVarint) {
+            uint64_t value;
+            if (!reader.Varint(value)) return false;
+            tensor.elem_type = static_cast<int32_t>(value);
+        } else if (field == onnx_field::kTensorShape && wire == kBytes) {
+            if (!reader.Bytes(sub, sub_size)) return false;
+            ProtoReader shape(sub, sub_size);
+            uint32_t shape_field, shape_wire;
+            while (shape.Next(shape_field, shape_wire)) {
+                if (shape_field != onnx_field::kShapeDim || shape_wire != kBytes) {
+                    if (!shape.Skip(shape_wire)) return false;
+                    continue;
+                }
+                const uint8_t* dim_data;
+                size_t dim_size;
+                int64_t dim;
+                if (!shape.Bytes(dim_data, dim_size) || !readDim(dim_data, dim_size, dim)) return false;
+                tensor.dims.emplace_back(dim);
+            }
+        } else if (!reader.Skip(wire)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool readValueInfo(const uint8_t* data, size_t size, OnnxTensorInfo& tensor) {
+    ProtoReader reader(data, size);
+    uint32_t field, wire;
+    while (reader.Next(field, wire)) {
+        const uint8_t* sub;
+        size_t sub_size;
+        if (field == onnx_field::kValueName && wire == kBytes) {
+            if (!reader.Bytes(sub, sub_size)) return false;
+            tensor.name.assign(reinterpret_cast<const char*>(sub), sub_size);
+        } else if (field == onnx_field::kValueType && wire == kBytes) {
+            if (!reader.Bytes(sub, sub_size)) return false;
+            // TypeProto, only tensor_type is used by models here
+            ProtoReader type(sub, sub_size);
+            uint32_t type_field, type_wire;
+            while (type.Next(type_field, type_wire)) {
+                const uint8_t* tensor_data;
+                size_t tensor_size;
+                if (type_field == onnx_field::kTypeTensor && type_wire == kBytes) {
+                    if (!type.Bytes(tensor_data, tensor_size) || !readTensorType(tensor_data, tensor_size, tensor)) return false;
+                } else if (!type.Skip(type_wire)) {
+                    return false;
+                }
+            }
+        } else if (!reader.Skip(wire)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool readInitializerName(const uint8_t* data, size_t size, std::string& name) {
+    ProtoReader reader(data, size);
+    uint32_t field, wire;
+    while (reader.Next(field, wire)) {
+        if (field == onnx_field::kTensorName && wire == kBytes) {
+            const uint8_t* sub;
+            size_t sub_size;
+            if (!reader.Bytes(sub, sub_size)) return false;
+            name.assign(reinterpret_cast<const char*>(sub), sub_size);
+            return true;  // raw data of tensor is not touched
+        } else if (!reader.Skip(wire)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool readString(ProtoReader& reader, std::string& str) {
+    const uint8_t* data;
+    size_t size;
+    if (!reader.Bytes(data, size)) return false;
+    str.assign(reinterpret_cast<const char*>(data), size);
+    return true;
+}
+
+/**
+ * Repeated int field, packed or not.
+ */
+static bool readInts(ProtoReader& reader, uint32_t wire, std::vector<int64_t>& values) {
+    uint64_t value;
+    if (wire == kVarint) {
+        if (!reader.Varint(value)) return false;
+        values.emplace_back(static_cast<int64_t>(value));
+        return true;
+    }
+    const uint8_t* data;
+    size_t size;
+    if (wire != kBytes || !reader.Bytes(data, size)) return false;
+    ProtoReader packed(data, size);
+    while (!packed.End()) {
+        if (!packed.Varint(value)) return false;
+        values.emplace_back(static_cast<int64_t>(value));
+    }
+    return true;
+}
+
+/**
+ * Repeated float field, packed or not.
+ */
+static bool readFloats(ProtoReader& reader, uint32_t wire, std::vector<float>& values) {
+    if (wire == kFixed32) {
+        uint32_t bits;
+        if (!reader.Fixed32(bits)) return false;
+        float value;
+        memcpy(&value, &bits, sizeof(float));
+        values.emplace_back(value);
+        return true;
+    }
+    const uint8_t* data;
+    size_t size;
+    if (wire != kBytes || !reader.Bytes(data, size) || size % sizeof(float) != 0) return false;
+    size_t count = values.size();
+    values.resize(count + size / sizeof(float));
+    memcpy(values.data() + count, data, size);
+    return true;
+}
+
+static bool readTensor(const uint8_t* data, size_t size, OnnxTensor& tensor) {
+    ProtoReader reader(data, size);
+    uint32_t field, wire;
+    const uint8_t* raw = nullptr;
+    size_t raw_size = 0;
+    while (reader.Next(field, wire)) {
+        uint64_t value = 0;
+        bool ok;
+        switch (field) {
+            case onnx_field::kTensorDims:      ok = readInts(reader, wire, tensor.dims); break;
+            case onnx_field::kTensorFloatData: ok = readFloats(reader, wire, tensor.floats); break;
+            case onnx_field::kTensorInt32Data:
+            case onnx_field::kTensorInt64Data: ok = readInts(reader, wire, tensor.ints); break;
+            case onnx_field::kTensorName:      ok = wire == kBytes && readString(reader, tensor.name); break;
+            case onnx_field::kTensorRawData:   ok = wire == kBytes && reader.Bytes(raw, raw_size); break;
+            case onnx_field::kTensorDataType:
+                ok = wire == kVarint && reader.Varint(value);
+                tensor.elem_type = static_cast<int32_t>(value);
+                break;
+            case onnx_field::kTensorLocation:
+                // 1 for external data, weights are not in this file
+                ok = wire == kVarint && reader.Varint(value) && value == 0;
+                break;
+            default: ok = reader.Skip(wire); break;
+        }
+        if (!ok) return false;
+    }
+    if (raw != nullptr) {
+        if (tensor.elem_type == kOnnxFloat) {
+            tensor.floats.resize(raw_size / sizeof(float));
+            memcpy(tensor.floats.data(), raw, tensor.floats.size() * sizeof(float));
+        } else if (tensor.elem_type == kOnnxInt64) {
+            tensor.ints.resize(raw_size / sizeof(int64_t));
+            memcpy(tensor.ints.data(), raw, tensor.ints.size() * sizeof(int64_t));
+        } else if (tensor.elem_type == kOnnxInt32) {
+            std::vector<int32_t> ints(raw_size / sizeof(int32_t));
+            memcpy(ints.data(), raw, ints.size() * sizeof(int32_t));
+            tensor.ints.assign(ints.begin(), ints.end());
+        }
+    }
+    if (tensor.elem_type == kOnnxInt32 || tensor.elem_type == kOnnxInt64) {
+        tensor.floats.assign(tensor.ints.begin(), tensor.ints.end());
+    }
+    return true;
+}
+
+static bool readAttribute(const uint8_t* data, size_t size, OnnxAttribute& attr) {
+    ProtoReader reader(data, size);
+    uint32_t field, wire;
+    while (reader.Next(field, wire)) {
+        const uint8_t* sub;
+        size_t sub_size;
+        uint64_t value = 0;
+        uint32_t bits = 0;
+        bool ok;
+        switch (field) {
+            case onnx_field::kAttrName:   ok = wire == kBytes && readString(reader, attr.name); break;
+            case onnx_field::kAttrString: ok = wire == kBytes && readString(reader, attr.s); break;
+            case onnx_field::kAttrFloats: ok = readFloats(reader, wire, attr.floats); break;
+            case onnx_field::kAttrInts:   ok = readInts(reader, wire, attr.ints); break;
+            case onnx_field::kAttrFloat:
+                ok = wire == kFixed32 && reader.Fixed32(bits);
+                memcpy(&attr.f, &bits, sizeof(float));
+                break;
+            case onnx_field::kAttrInt:
+                ok = wire == kVarint && reader.Varint(value);
+                attr.i = static_cast<int64_t>(value);
+                break;
+            case onnx_field::kAttrTensor:
+                ok = wire == kBytes && reader.Bytes(sub, sub_size) && readTensor(sub, sub_size, attr.t);
+                break;
+            default: ok = reader.Skip(wire); break;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static bool readNode(const uint8_t* data, size_t size, OnnxNode& node) {
+    ProtoReader reader(data, size);
+    uint32_t field, wire;
+    while (reader.Next(field, wire)) {
+        const uint8_t* sub;
+        size_t sub_size;
+        std::string str;
+        bool ok;
+        switch (field) {
+            case onnx_field::kNodeInput:
+            case onnx_field::kNodeOutput:
+                ok = wire == kBytes && readString(reader, str);
+                (field == onnx_field::kNodeInput ? node.inputs : node.outputs).emplace_back(str);
+                break;
+            case onnx_field::kNodeName:   ok = wire == kBytes && readString(reader, node.name); break;
+            case onnx_field::kNodeOpType: ok = wire == kBytes && readString(reader, node.op_type); break;
+            case onnx_field::kNodeAttribute:
+                node.attributes.emplace_back();
+                ok = wire == kBytes && reader.Bytes(sub, sub_size) && readAttribute(sub, sub_size, node.attributes.back());
+                break;
+            default: ok = reader.Skip(wire); break;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+/**
+ * Value of Constant node as initializer.
+ */
+static bool constantTensor(const OnnxNode& node, OnnxTensor& tensor) {
+    if (node.outputs.size() != 1 || node.attributes.size() != 1) return false;
+    const OnnxAttribute& attr = node.attributes[0];
+    if (attr.name == "value") {
+        tensor = attr.t;
+    } else if (attr.name == "value_float" || attr.name == "value_floats") {
+        tensor.elem_type = kOnnxFloat;
+        tensor.floats = attr.name == "value_float" ? std::vector<float>{attr.f} : attr.floats;
+        if (attr.name == "value_floats") tensor.dims = {static_cast<int64_t>(attr.floats.size())};
+    } else if (attr.name == "value_int" || attr.name == "value_ints") {
+        tensor.elem_type = kOnnxInt64;
+        tensor.ints = attr.name == "value_int" ? std::vector<int64_t>{attr.i} : attr.ints;
+        tensor.floats.assign(tensor.ints.begin(), tensor.ints.end());
+        if (attr.name == "value_ints") tensor.dims = {static_cast<int64_t>(attr.ints.size())};
+    } else {
+        return false;
+    }
+    tensor.name = node.outputs[0];
+    return true;
+}
+
+/**
+ * Inputs and outputs of graph into info, nodes and initializers into graph
+ * if it's not null.
+ */
+static bool readGraph(const uint8_t* data, size_t size, OnnxModelInfo& info, OnnxGraph* graph) {
+    ProtoReader reader(data, size);
+    uint32_t field, wire;
+    std::set<std::string> initializers;
+    std::vector<OnnxTensorInfo> inputs;
+    while (reader.Next(field, wire)) {
+        const uint8_t* sub;
+        size_t sub_size;
+        bool wanted = field == onnx_field::kGraphInit || field == onnx_field::kGraphInput || field == onnx_field::kGraphOutput
+                      || (graph != nullptr && field == onnx_field::kGraphNode);
+        if (wire != kBytes || !wanted) {
+            if (!reader.Skip(wire)) return false;
+            continue;
+        }
+        if (!reader.Bytes(sub, sub_size)) return false;
+        if (field == onnx_field::kGraphNode) {
+            OnnxNode node;
+            if (!readNode(sub, sub_size, node)) return false;
+            OnnxTensor tensor;
+            if (node.op_type == "Constant" && constantTensor(node, tensor)) {
+                graph->initializers[tensor.name] = tensor;
+            } else {
+                graph->nodes.emplace_back(node);
+            }
+        } else if (field == onnx_field::kGraphInit && graph != nullptr) {
+            OnnxTensor tensor;
+            if (!readTensor(sub, sub_size, tensor)) return false;
+            initializers.insert(tensor.name);
+            graph->initializers[tensor.name] = tensor;
+        } else if (field == onnx_field::kGraphInit) {
+            std::string name;
+            if (!readInitializerName(sub, sub_size, name)) return false;
+            initializers.insert(name);
+        } else {
+            OnnxTensorInfo tensor;
+            if (!readValueInfo(sub, sub_size, tensor)) return false;
+            (field == onnx_field::kGraphInput ? inputs : info.outputs).emplace_back(tensor);
+        }
+    }
+    // models exported with old opset list weights as graph inputs too
+    for (auto& input : inputs) {
+        if (initializers.count(input.name) == 0) info.inputs.emplace_back(input);
+    }
+    return true;
+}
+
+static bool readModel(const std::string& onnxModel, OnnxModelInfo& info, OnnxGraph* graph) {
+    MappedFile file;
+    if (!file.Open(onnxModel)) return false;
+    info = OnnxModelInfo();
+    ProtoReader reader(file.Data(), file.Size());
+    uint32_t field, wire;
+    bool has_graph = false;
+    while (reader.Next(field, wire)) {
+        const uint8_t* sub;
+        size_t sub_size;
+        if (field == onnx_field::kModelIrVersion && wire == kVarint) {
+            uint64_t value;
+            if (!reader.Varint(value)) return false;
+            info.ir_version = static_cast<int64_t>(value);
+        } else if (field == onnx_field::kModelGraph && wire == kBytes) {
+            if (!reader.Bytes(sub, sub_size) || !readGraph(sub, sub_size, info, graph)) return false;
+            has_graph = true;
+        } else if (field == onnx_field::kModelOpset && wire == kBytes) {
+            if (!reader.Bytes(sub, sub_size)) return false;
+            ProtoReader opset(sub, sub_size);
+            uint32_t opset_field, opset_wire;
+            std::string domain;
+            uint64_t version = 0;
+            while (opset.Next(opset_field, opset_wire)) {
+                const uint8_t* domain_data;
+                size_t domain_size;
+                if (opset_field == onnx_field::kOpsetDomain && opset_wire == kBytes) {
+                    if (!opset.Bytes(domain_data, domain_size)) return false;
+                    domain.assign(reinterpret_cast<const char*>(domain_data), domain_size);
+                } else if (opset_field == onnx_field::kOpsetVersion && opset_wire == kVarint) {
+                    if (!opset.Varint(version)) return false;
+                } else if (!opset.Skip(opset_wire)) {
+                    return false;
+                }
+            }
+            if (domain.empty() || domain == "ai.onnx") info.opset = static_cast<int64_t>(version);
+        } else if (!reader.Skip(wire)) {
+            return false;
+        }
+    }
+    return has_graph && !info.inputs.empty() && !info.outputs.empty();
+}
+
+bool readOnnxInfo(const std::string& onnxModel, OnnxModelInfo& info) {
+    return readModel(onnxModel, info, nullptr);
+}
+
+bool readOnnxGraph(const std::string& onnxModel, OnnxGraph& graph) {
+    graph = OnnxGraph();
+    return readModel(onnxModel, graph.info, &graph);
+}
+
+const OnnxAttribute* OnnxNode::Attribute(const std::string& key) const {
+    for (const auto& attr : attributes) {
+        if (attr.name == key) return &attr;
+    }
+    return nullptr;
+}
+
+int64_t OnnxNode::GetInt(const std::string& key, int64_t value) const {
+    const OnnxAttribute* attr = Attribute(key);
+    return attr ? attr->i : value;
+}
+
+float OnnxNode::GetFloat(const std::string& key, float value) const {
+    const OnnxAttribute* attr = Attribute(key);
+    return attr ? attr->f : value;
+}
+
+std::string OnnxNode::GetString(const std::string& key, const std::string& value) const {
+    const OnnxAttribute* attr = Attribute(key);
+    return attr ? attr->s : value;
+}
+
+std::vector<int64_t> OnnxNode::GetInts(const std::string& key) const {
+    const OnnxAttribute* attr = Attribute(key);
+    return attr ? attr->ints : std::vector<int64_t>();
+}
+
+bool matchNames(const std::vector<std::string>& names,
+                const std::vector<std::string>& patterns,
+                int offset,
+                std::vector<int>& index) {
+    index.clear();
+    bool ok = true;
+    for (const auto& pattern : patterns) {
+        size_t count = index.size();
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (fnmatch(pattern.c_str(), names[i].c_str(), 0) == 0) index.emplace_back(static_cast<int>(i) + offset);
+        }
+        ok = ok && index.size() > count;
+    }
+    return ok;
+}
+
+std::string dimsString(const std::vector<int64_t>& dims) {
+    std::string str;
+    for (size_t i = 0; i < dims.size(); ++i) {
+        if (i > 0) str += "x";
+        str += dims[i] < 0 ? "?" : std::to_string(dims[i]);
+    }
+    return str;
+}
@@ -0,0 +1,102 @@
+/**
+ * Graph inputs, outputs and opset of onnx model, read straight from protobuf
+ * wire format of the mapped file, without protobuf or onnx library. Only a
+ * few fields are decoded and others are skipped, so it takes milliseconds
+ * even for big models, and is used to check yaml against model before
+ * building engine. readOnnxGraph decodes nodes and float/int64 initializers
+ * too, for the cpu backend.
+ * 2021/03/29
+ */
+
+#ifndef ONNX_INFO_H
+#define ONNX_INFO_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+struct OnnxTensorInfo {
+    std::string name;
+    int32_t elem_type = 0;       // onnx TensorProto.DataType, 1 for float
+    std::vector<int64_t> dims;   // -1 for symbolic or unknown dim
+};
+
+struct OnnxModelInfo {
+    int64_t ir_version = 0;
+    int64_t opset      = 0;      // version of default domain
+    std::vector<OnnxTensorInfo> inputs;   // initializers are excluded
+    std::vector<OnnxTensorInfo> outputs;
+};
+
+/**
+ * Initializer or value of Constant node. float, int32 and int64 tensors are
+ * decoded(int ones into both ints and floats), others keep dims only.
+ */
+struct OnnxTensor {
+    std::string name;
+    int32_t elem_type = 0;
+    std::vector<int64_t> dims;
+    std::vector<float> floats;
+    std::vector<int64_t> ints;
+};
+
+struct OnnxAttribute {
+    std::string name;
+    int64_t i = 0;
+    float f = 0.f;
+    std::string s;
+    std::vector<int64_t> ints;
+    std::vector<float> floats;
+    OnnxTensor t;
+};
+
+struct OnnxNode {
+    std::string name;
+    std::string op_type;
+    std::vector<std::string> inputs;   // "" for omitted optional input
+    std::vector<std::string> outputs;
+    std::vector<OnnxAttribute> attributes;
+
+    const OnnxAttribute* Attribute(const std::string& key) const;
+    int64_t GetInt(const std::string& key, int64_t value) const;
+    float GetFloat(const std::string& key, float value) const;
+    std::string GetString(const std::string& key, const std::string& value) const;
+    std::vector<int64_t> GetInts(const std::string& key) const;
+};
+
+struct OnnxGraph {
+    OnnxModelInfo info;
+    std::vector<OnnxNode> nodes;                     // in onnx order, which is topological
+    std::map<std::string, OnnxTensor> initializers;  // Constant nodes are moved here
+};
+
+/**
+ * Read inputs, outputs and opset of onnx file, return false if file is missing
+ * or it's not a valid onnx model.
+ */
+bool readOnnxInfo(const std::string& onnxModel, OnnxModelInfo& info);
+
+/**
+ * Read whole graph of onnx file, weights stored out of file(external data) are
+ * not supported. Return false if file is missing or broken.
+ */
+bool readOnnxGraph(const std::string& onnxModel, OnnxGraph& graph);
+
+/**
+ * Index of names matching glob patterns(`*` and `?`), in order of patterns and
+ * in order of names for each pattern. Every pattern should match one name at
+ * least, return false otherwise.
+ * offset: added to every index, e.g. count of inputs for binding index of outputs.
+ */
+bool matchNames(const std::vector<std::string>& names,
+                const std::vector<std::string>& patterns,
+                int offset,
+                std::vector<int>& index);
+
+/**
+ * Dims as string, e.g. "1x3x640x640", "?x3x640x640" for dynamic batch.
+ */
+std::string dimsString(const std::vector<int64_t>& dims);
+
+#endif  // ONNX_INFO_H
@@ -0,0 +1,169 @@
+/**
+ * Output bindings of any data type read as float on host.
+ * 2021/05/10
+ */
+#include "binding_convert.h"
+
+#include <cstring>
+#include <vector>
+
+#include "utils.h"
+
+#if defined(__F16C__) && defined(__AVX2__)
+#include <immintrin.h>
+#define BINDING_CONVERT_F16C
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define BINDING_CONVERT_NEON
+#endif
+
+const char* bindingConvertIsa() {
+#if defined(BINDING_CONVERT_F16C)
+    return "f16c";
+#elif defined(BINDING_CONVERT_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+static inline float halfToFloatScalar(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+    uint32_t exp  = (h >> 10) & 0x1fu;
+    uint32_t mant = h & 0x3ffu;
+    uint32_t bits;
+    if (exp == 0x1fu) {
+        bits = sign | 0x7f800000u | (mant << 13);  // inf, nan
+    } else if (exp != 0) {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    } else if (mant == 0) {
+        bits = sign;
+    } else {
+        // subnormal half is a normal float, shift mantissa up to the implicit bit
+        exp = 113;
+        while ((mant & 0x400u) == 0) {
+            mant <<= 1;
+            --exp;
+        }
+        bits = sign | (exp << 23) | ((mant & 0x3ffu) << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static inline uint16_t floatToHalfScalar(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000u;
+    uint32_t abs  = x & 0x7fffffffu;
+    if (abs >= 0x7f800000u) {
+        return static_cast<uint16_t>(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u));
+    }
+    if (abs >= 0x477ff000u) {
+        return static_cast<uint16_t>(sign | 0x7c00u);  // 65520 and above round to inf
+    }
+    if (abs < 0x38800000u) {
+        // below 2^-14, subnormal half of 2^-24 units
+        if (abs < 0x33000000u) return static_cast<uint16_t>(sign);
+        uint32_t e = abs >> 23;
+        uint32_t m = (abs & 0x7fffffu) | 0x800000u;
+        uint32_t shift = 126 - e;
+        uint32_t k = m >> shift;
+        uint32_t rem = m & ((1u << shift) - 1);
+        uint32_t half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (k & 1u))) ++k;
+        return static_cast<uint16_t>(sign | k);
+    }
+    // round to nearest even on the 13 dropped bits, carry goes into exponent
+    uint32_t r = abs + 0xfffu + ((abs >> 13) & 1u) - (112u << 23);
+    return static_cast<uint16_t>(sign | (r >> 13));
+}
+
+void halfToFloat(const uint16_t* src, float* dst, size_t count) {
+    size_t i = 0;
+#if defined(BINDING_CONVERT_F16C)
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+#elif defined(BINDING_CONVERT_NEON)
+    for (; i + 8 <= count; i += 8) {
+        float16x8_t h = vreinterpretq_f16_u16(vld1q_u16(src + i));
+        vst1q_f32(dst + i, vcvt_f32_f16(vget_low_f16(h)));
+        vst1q_f32(dst + i + 4, vcvt_high_f32_f16(h));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = halfToFloatScalar(src[i]);
+    }
+}
+
+void floatToHalf(const float* src, uint16_t* dst, size_t count) {
+    size_t i = 0;
+#if defined(BINDING_CONVERT_F16C)
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+#elif defined(BINDING_CONVERT_NEON)
+    for (; i + 8 <= count; i += 8) {
+        float16x8_t h = vcvt_high_f16_f32(vcvt_f16_f32(vld1q_f32(src + i)), vld1q_f32(src + i + 4));
+        vst1q_u16(dst + i, vreinterpretq_u16_f16(h));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = floatToHalfScalar(src[i]);
+    }
+}
+
+void int8ToFloat(const int8_t* src, float* dst, size_t count, float scale) {
+    size_t i = 0;
+#if defined(BINDING_CONVERT_F16C)
+    __m256 s = _mm256_set1_ps(scale);
+    for (; i + 8 <= count; i += 8) {
+        __m128i q = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+        __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(q));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(v, s));
+    }
+#elif defined(BINDING_CONVERT_NEON)
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t q = vmovl_s8(vld1_s8(src + i));
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(q))), scale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(q))), scale));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = static_cast<float>(src[i]) * scale;
+    }
+}
+
+void copyBindingToHost(float* dst, const BindingView& binding, size_t offset, size_t count) {
+    size_t element = getElementSize(binding.dtype);
+    const uint8_t* src = static_cast<const uint8_t*>(binding.ptr) + offset * element;
+    if (binding.dtype == nvinfer1::DataType::kFLOAT) {
+        copyToHost(dst, src, count * element, binding.on_device);
+        return;
+    }
+    // narrow elements cross the bus, staging grows to largest slice of thread
+    thread_local std::vector<uint8_t> staging;
+    if (binding.on_device) {
+        if (staging.size() < count * element) staging.resize(count * element);
+        copyToHost(staging.data(), src, count * element, true);
+        src = staging.data();
+    }
+    switch (binding.dtype) {
+        case nvinfer1::DataType::kHALF:
+            halfToFloat(reinterpret_cast<const uint16_t*>(src), dst, count);
+            break;
+        case nvinfer1::DataType::kINT8:
+            int8ToFloat(reinterpret_cast<const int8_t*>(src), dst, count, binding.scale);
+            break;
+        default: {
+            const int32_t* values = reinterpret_cast<const int32_t*>(src);
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = static_cast<float>(values[i]);
+            }
+        }
+    }
+}
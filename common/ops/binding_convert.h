@@ -0,0 +1,47 @@
+/**
+ * Output bindings of any data type read as float on host. Half and int8
+ * bindings are copied from device at their own size and converted to float
+ * on host, by F16C/AVX2(build with -DCPU_AVX2=ON) on x86 and NEON on ARM.
+ * 2021/05/10
+ */
+
+#ifndef BINDING_CONVERT_H
+#define BINDING_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <NvInfer.h>
+
+/**
+ * Output binding for decoding: data, element type and scale of int8 elements
+ * (value = int8 * scale).
+ */
+struct BindingView {
+    const void* ptr = nullptr;
+    nvinfer1::DataType dtype = nvinfer1::DataType::kFLOAT;
+    float scale = 1.f;
+    bool on_device = true;
+};
+
+/**
+ * Name of instruction set conversions are built with: f16c, neon or scalar.
+ */
+const char* bindingConvertIsa();
+
+/**
+ * IEEE half to float and back, float to half rounds to nearest even.
+ */
+void halfToFloat(const uint16_t* src, float* dst, size_t count);
+void floatToHalf(const float* src, uint16_t* dst, size_t count);
+
+void int8ToFloat(const int8_t* src, float* dst, size_t count, float scale);
+
+/**
+ * Copy count elements from element offset of binding to dst as float. Only
+ * count x element size bytes are read from device, they're staged in a host
+ * buffer of calling thread and converted from there. Host bindings are
+ * converted in place without staging.
+ */
+void copyBindingToHost(float* dst, const BindingView& binding, size_t offset, size_t count);
+
+#endif  // BINDING_CONVERT_H
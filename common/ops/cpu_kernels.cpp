@@ -0,0 +1,356 @@
+/**
+ * Float kernels of cpu backend.
+ * 2021/04/12
+ */
+#include "cpu_kernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define CPU_KERNEL_AVX2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CPU_KERNEL_NEON
+#endif
+
+/* -==================Gemm================*/
+static const int kTileM = 4;
+#ifdef CPU_KERNEL_AVX2
+static const int kTileN = 16;
+#else
+static const int kTileN = 8;
+#endif
+
+const char* cpuKernelIsa() {
+#if defined(CPU_KERNEL_AVX2)
+    return "avx2";
+#elif defined(CPU_KERNEL_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+// full tile of kTileM x kTileN, accumulated in registers over whole K
+static void gemmTile(int K, const float* A, int lda, const float* B, int ldb, float* C, int ldc) {
+#if defined(CPU_KERNEL_AVX2)
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    for (int k = 0; k < K; ++k) {
+        __m256 b0 = _mm256_loadu_ps(B + k * ldb);
+        __m256 b1 = _mm256_loadu_ps(B + k * ldb + 8);
+        __m256 a = _mm256_broadcast_ss(A + k);
+        c00 = _mm256_fmadd_ps(a, b0, c00);
+        c01 = _mm256_fmadd_ps(a, b1, c01);
+        a = _mm256_broadcast_ss(A + lda + k);
+        c10 = _mm256_fmadd_ps(a, b0, c10);
+        c11 = _mm256_fmadd_ps(a, b1, c11);
+        a = _mm256_broadcast_ss(A + 2 * lda + k);
+        c20 = _mm256_fmadd_ps(a, b0, c20);
+        c21 = _mm256_fmadd_ps(a, b1, c21);
+        a = _mm256_broadcast_ss(A + 3 * lda + k);
+        c30 = _mm256_fmadd_ps(a, b0, c30);
+        c31 = _mm256_fmadd_ps(a, b1, c31);
+    }
+    _mm256_storeu_ps(C, c00);
+    _mm256_storeu_ps(C + 8, c01);
+    _mm256_storeu_ps(C + ldc, c10);
+    _mm256_storeu_ps(C + ldc + 8, c11);
+    _mm256_storeu_ps(C + 2 * ldc, c20);
+    _mm256_storeu_ps(C + 2 * ldc + 8, c21);
+    _mm256_storeu_ps(C + 3 * ldc, c30);
+    _mm256_storeu_ps(C + 3 * ldc + 8, c31);
+#elif defined(CPU_KERNEL_NEON)
+    float32x4_t c00 = vdupq_n_f32(0.f), c01 = vdupq_n_f32(0.f);
+    float32x4_t c10 = vdupq_n_f32(0.f), c11 = vdupq_n_f32(0.f);
+    float32x4_t c20 = vdupq_n_f32(0.f), c21 = vdupq_n_f32(0.f);
+    float32x4_t c30 = vdupq_n_f32(0.f), c31 = vdupq_n_f32(0.f);
+    for (int k = 0; k < K; ++k) {
+        float32x4_t b0 = vld1q_f32(B + k * ldb);
+        float32x4_t b1 = vld1q_f32(B + k * ldb + 4);
+        c00 = vmlaq_n_f32(c00, b0, A[k]);
+        c01 = vmlaq_n_f32(c01, b1, A[k]);
+        c10 = vmlaq_n_f32(c10, b0, A[lda + k]);
+        c11 = vmlaq_n_f32(c11, b1, A[lda + k]);
+        c20 = vmlaq_n_f32(c20, b0, A[2 * lda + k]);
+        c21 = vmlaq_n_f32(c21, b1, A[2 * lda + k]);
+        c30 = vmlaq_n_f32(c30, b0, A[3 * lda + k]);
+        c31 = vmlaq_n_f32(c31, b1, A[3 * lda + k]);
+    }
+    vst1q_f32(C, c00);
+    vst1q_f32(C + 4, c01);
+    vst1q_f32(C + ldc, c10);
+    vst1q_f32(C + ldc + 4, c11);
+    vst1q_f32(C + 2 * ldc, c20);
+    vst1q_f32(C + 2 * ldc + 4, c21);
+    vst1q_f32(C + 3 * ldc, c30);
+    vst1q_f32(C + 3 * ldc + 4, c31);
+#else
+    float acc[kTileM][kTileN] = {};
+    for (int k = 0; k < K; ++k) {
+        const float* b = B + k * ldb;
+        for (int i = 0; i < kTileM; ++i) {
+            float a = A[i * lda + k];
+            for (int j = 0; j < kTileN; ++j) {
+                acc[i][j] += a * b[j];
+            }
+        }
+    }
+    for (int i = 0; i < kTileM; ++i) {
+        memcpy(C + i * ldc, acc[i], kTileN * sizeof(float));
+    }
+#endif
+}
+
+// any m x n, rows and columns left by full tiles
+static void gemmEdge(int m, int n, int K, const float* A, int lda, const float* B, int ldb, float* C, int ldc) {
+    for (int i = 0; i < m; ++i) {
+        float* c = C + i * ldc;
+        std::fill(c, c + n, 0.f);
+        for (int k = 0; k < K; ++k) {
+            float a = A[i * lda + k];
+            const float* b = B + k * ldb;
+            for (int j = 0; j < n; ++j) {
+                c[j] += a * b[j];
+            }
+        }
+    }
+}
+
+void cpuGemm(int M, int N, int K, const float* A, int lda, const float* B, int ldb, float* C, int ldc) {
+    int m_end = M - M % kTileM;
+    int n_end = N - N % kTileN;
+    for (int i = 0; i < m_end; i += kTileM) {
+        for (int j = 0; j < n_end; j += kTileN) {
+            gemmTile(K, A + i * lda, lda, B + j, ldb, C + i * ldc + j, ldc);
+        }
+        if (n_end < N) {
+            gemmEdge(kTileM, N - n_end, K, A + i * lda, lda, B + n_end, ldb, C + i * ldc + n_end, ldc);
+        }
+    }
+    if (m_end < M) {
+        gemmEdge(M - m_end, N, K, A + m_end * lda, lda, B, ldb, C + m_end * ldc, ldc);
+    }
+}
+
+float cpuDot(const float* x, const float* y, int n) {
+    int i = 0;
+    float sum = 0.f;
+#if defined(CPU_KERNEL_AVX2)
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), acc1);
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, _mm256_add_ps(acc0, acc1));
+    for (float lane : lanes) {
+        sum += lane;
+    }
+#elif defined(CPU_KERNEL_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.f), acc1 = vdupq_n_f32(0.f);
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(x + i), vld1q_f32(y + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(x + i + 4), vld1q_f32(y + i + 4));
+    }
+    float lanes[4];
+    vst1q_f32(lanes, vaddq_f32(acc0, acc1));
+    for (float lane : lanes) {
+        sum += lane;
+    }
+#endif
+    for (; i < n; ++i) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+/* -==================Convolution================*/
+// range [first, last) of output x whose input x = ox * stride - pad + offset is in [0, width)
+static void validRange(int width, int stride, int pad, int offset, int out_w, int& first, int& last) {
+    int start = pad - offset;
+    first = start <= 0 ? 0 : (start + stride - 1) / stride;
+    int end = width + pad - offset;  // ox * stride < end
+    last = end <= 0 ? 0 : std::min(out_w, (end + stride - 1) / stride);
+    first = std::min(first, last);
+}
+
+void cpuIm2col(const float* input, int channels, int height, int width,
+               int kernel_h, int kernel_w, int stride_h, int stride_w,
+               int pad_h, int pad_w, int dilation_h, int dilation_w,
+               int out_h, int out_w, float* cols) {
+    for (int c = 0; c < channels; ++c) {
+        const float* plane = input + static_cast<size_t>(c) * height * width;
+        for (int ky = 0; ky < kernel_h; ++ky) {
+            for (int kx = 0; kx < kernel_w; ++kx) {
+                int x_first, x_last;
+                validRange(width, stride_w, pad_w, kx * dilation_w, out_w, x_first, x_last);
+                for (int oy = 0; oy < out_h; ++oy) {
+                    float* row = cols + static_cast<size_t>(oy) * out_w;
+                    int iy = oy * stride_h - pad_h + ky * dilation_h;
+                    if (iy < 0 || iy >= height) {
+                        std::fill(row, row + out_w, 0.f);
+                        continue;
+                    }
+                    std::fill(row, row + x_first, 0.f);
+                    const float* src = plane + iy * width - pad_w + kx * dilation_w;
+                    if (stride_w == 1) {
+                        memcpy(row + x_first, src + x_first, (x_last - x_first) * sizeof(float));
+                    } else {
+                        for (int ox = x_first; ox < x_last; ++ox) {
+                            row[ox] = src[ox * stride_w];
+                        }
+                    }
+                    std::fill(row + x_last, row + out_w, 0.f);
+                }
+                cols += static_cast<size_t>(out_h) * out_w;
+            }
+        }
+    }
+}
+
+void cpuDepthwiseConv(const float* input, const float* weight, const float* bias,
+                      int channels, int height, int width,
+                      int kernel_h, int kernel_w, int stride_h, int stride_w,
+                      int pad_h, int pad_w, int dilation_h, int dilation_w,
+                      int out_h, int out_w, float* output) {
+    for (int c = 0; c < channels; ++c) {
+        const float* plane = input + static_cast<size_t>(c) * height * width;
+        const float* w = weight + c * kernel_h * kernel_w;
+        float* out = output + static_cast<size_t>(c) * out_h * out_w;
+        std::fill(out, out + out_h * out_w, bias ? bias[c] : 0.f);
+        for (int oy = 0; oy < out_h; ++oy) {
+            float* row = out + oy * out_w;
+            for (int ky = 0; ky < kernel_h; ++ky) {
+                int iy = oy * stride_h - pad_h + ky * dilation_h;
+                if (iy < 0 || iy >= height) continue;
+                for (int kx = 0; kx < kernel_w; ++kx) {
+                    int x_first, x_last;
+                    validRange(width, stride_w, pad_w, kx * dilation_w, out_w, x_first, x_last);
+                    const float* src = plane + iy * width - pad_w + kx * dilation_w;
+                    float k = w[ky * kernel_w + kx];
+                    // border handled by range, so the loop vectorizes for stride 1
+                    if (stride_w == 1) {
+                        for (int ox = x_first; ox < x_last; ++ox) {
+                            row[ox] += k * src[ox];
+                        }
+                    } else {
+                        for (int ox = x_first; ox < x_last; ++ox) {
+                            row[ox] += k * src[ox * stride_w];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* -==================Activation================*/
+template <typename Fn>
+static void applyRow(float* data, int size, float bias, Fn fn) {
+    for (int i = 0; i < size; ++i) {
+        data[i] = fn(data[i] + bias);
+    }
+}
+
+void cpuBiasActivate(float* data, int channels, int spatial, const float* bias, const CpuActParams& act) {
+    float a = act.a;
+    float b = act.b;
+    for (int c = 0; c < channels; ++c) {
+        float* row = data + static_cast<size_t>(c) * spatial;
+        float add = bias ? bias[c] : 0.f;
+        switch (act.type) {
+            case CpuActivation::kNone:
+                if (bias) applyRow(row, spatial, add, [](float x) { return x; });
+                break;
+            case CpuActivation::kRelu:
+                applyRow(row, spatial, add, [](float x) { return std::max(x, 0.f); });
+                break;
+            case CpuActivation::kClip:
+                applyRow(row, spatial, add, [=](float x) { return std::min(std::max(x, a), b); });
+                break;
+            case CpuActivation::kSigmoid:
+                applyRow(row, spatial, add, [](float x) { return 1.f / (1.f + std::exp(-x)); });
+                break;
+            case CpuActivation::kHardSigmoid:
+                applyRow(row, spatial, add, [=](float x) { return std::max(0.f, std::min(1.f, a * x + b)); });
+                break;
+            case CpuActivation::kHardSwish:
+                applyRow(row, spatial, add, [=](float x) { return x * std::max(0.f, std::min(1.f, a * x + b)); });
+                break;
+        }
+    }
+}
+
+/* -==================Pooling================*/
+void cpuPool(const float* input, int channels, int height, int width,
+             int kernel_h, int kernel_w, int stride_h, int stride_w,
+             int pad_h, int pad_w, int pad_bottom, int pad_right, int out_h, int out_w,
+             bool max_pool, bool count_include_pad, float* output) {
+    for (int c = 0; c < channels; ++c) {
+        const float* plane = input + static_cast<size_t>(c) * height * width;
+        for (int oy = 0; oy < out_h; ++oy) {
+            int y0 = oy * stride_h - pad_h;
+            int y_first = std::max(y0, 0);
+            int y_last = std::min(y0 + kernel_h, height);
+            for (int ox = 0; ox < out_w; ++ox) {
+                int x0 = ox * stride_w - pad_w;
+                int x_first = std::max(x0, 0);
+                int x_last = std::min(x0 + kernel_w, width);
+                float value = max_pool ? -FLT_MAX : 0.f;
+                for (int y = y_first; y < y_last; ++y) {
+                    for (int x = x_first; x < x_last; ++x) {
+                        float v = plane[y * width + x];
+                        value = max_pool ? std::max(value, v) : value + v;
+                    }
+                }
+                if (!max_pool) {
+                    // window of ceil mode is clipped to padded input
+                    int count = count_include_pad
+                                ? (std::min(y0 + kernel_h, height + pad_bottom) - y0) * (std::min(x0 + kernel_w, width + pad_right) - x0)
+                                : (y_last - y_first) * (x_last - x_first);
+                    value /= std::max(count, 1);
+                }
+                *output++ = value;
+            }
+        }
+    }
+}
+
+void cpuGlobalAvgPool(const float* input, int channels, int spatial, float* output) {
+    for (int c = 0; c < channels; ++c) {
+        const float* plane = input + static_cast<size_t>(c) * spatial;
+        float sum = 0.f;
+        for (int i = 0; i < spatial; ++i) {
+            sum += plane[i];
+        }
+        output[c] = sum / spatial;
+    }
+}
+
+void cpuSoftmax(const float* input, int outer, int n, int inner, float* output) {
+    for (int o = 0; o < outer; ++o) {
+        for (int i = 0; i < inner; ++i) {
+            const float* x = input + static_cast<size_t>(o) * n * inner + i;
+            float* y = output + static_cast<size_t>(o) * n * inner + i;
+            float max_value = -FLT_MAX;
+            for (int k = 0; k < n; ++k) {
+                max_value = std::max(max_value, x[k * inner]);
+            }
+            float sum = 0.f;
+            for (int k = 0; k < n; ++k) {
+                y[k * inner] = std::exp(x[k * inner] - max_value);
+                sum += y[k * inner];
+            }
+            for (int k = 0; k < n; ++k) {
+                y[k * inner] /= sum;
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/**
+ * Float kernels of cpu backend, for one image in NCHW: gemm, im2col, depthwise
+ * convolution, pooling and activations. Gemm runs 4 rows x 16(AVX2+FMA) or 8
+ * (NEON, scalar) columns per tile, build with -mavx2 -mfma to enable AVX2.
+ * 2021/04/12
+ */
+
+#ifndef CPU_KERNELS_H
+#define CPU_KERNELS_H
+
+#include <cstddef>
+
+enum class CpuActivation : int {
+    kNone,
+    kRelu,
+    kClip,          // min(max(x, a), b)
+    kSigmoid,
+    kHardSigmoid,   // max(0, min(1, a * x + b))
+    kHardSwish      // x * max(0, min(1, a * x + b))
+};
+
+struct CpuActParams {
+    CpuActivation type = CpuActivation::kNone;
+    float a = 0.f;
+    float b = 0.f;
+};
+
+/**
+ * Name of instruction set gemm is built with: avx2, neon or scalar.
+ */
+const char* cpuKernelIsa();
+
+/**
+ * C[M, N] = A[M, K] * B[K, N], row major with leading dims.
+ */
+void cpuGemm(int M, int N, int K,
+             const float* A, int lda,
+             const float* B, int ldb,
+             float* C, int ldc);
+
+/**
+ * Dot product of x and y of size n.
+ */
+float cpuDot(const float* x, const float* y, int n);
+
+/**
+ * Columns of convolution, cols is [C * kh * kw, oh * ow], zero for padding.
+ */
+void cpuIm2col(const float* input, int channels, int height, int width,
+               int kernel_h, int kernel_w, int stride_h, int stride_w,
+               int pad_h, int pad_w, int dilation_h, int dilation_w,
+               int out_h, int out_w, float* cols);
+
+/**
+ * Convolution of every channel by its own kernel, weight is [C, kh, kw], bias
+ * may be null.
+ */
+void cpuDepthwiseConv(const float* input, const float* weight, const float* bias,
+                      int channels, int height, int width,
+                      int kernel_h, int kernel_w, int stride_h, int stride_w,
+                      int pad_h, int pad_w, int dilation_h, int dilation_w,
+                      int out_h, int out_w, float* output);
+
+/**
+ * Add bias of every channel(bias may be null) and apply activation, data is
+ * [channels, spatial].
+ */
+void cpuBiasActivate(float* data, int channels, int spatial, const float* bias, const CpuActParams& act);
+
+/**
+ * Max or average pooling, count_include_pad is used by average pooling only,
+ * pad_bottom and pad_right bound windows counting padding.
+ */
+void cpuPool(const float* input, int channels, int height, int width,
+             int kernel_h, int kernel_w, int stride_h, int stride_w,
+             int pad_h, int pad_w, int pad_bottom, int pad_right, int out_h, int out_w,
+             bool max_pool, bool count_include_pad, float* output);
+
+/**
+ * Mean of every channel, data is [channels, spatial].
+ */
+void cpuGlobalAvgPool(const float* input, int channels, int spatial, float* output);
+
+/**
+ * Softmax over axis of size n, data is [outer, n, inner].
+ */
+void cpuSoftmax(const float* input, int outer, int n, int inner, float* output);
+
+#endif  // CPU_KERNELS_H
@@ -0,0 +1,88 @@
+#include "letterbox.h"
+
+// weights of letterbox_cpu.cpp linearTaps for one output coordinate
+__device__ void linearTap(int d, int src_size, int dst_size, int* index, int* w0, int* w1) {
+    double scale = (double)src_size / dst_size;
+    float f = (float)((d + 0.5) * scale - 0.5);
+    int s = (int)floorf(f);
+    f -= s;
+    if (s < 0) {
+        s = 0;
+        f = 0.f;
+    }
+    if (s >= src_size - 1) {
+        s = src_size - 1;
+        f = 0.f;
+    }
+    *index = s;
+    *w0 = __float2int_rn((1.f - f) * 2048.f);
+    *w1 = __float2int_rn(f * 2048.f);
+}
+
+template <typename T>
+__global__ void letterbox_kernel(
+        const uint8_t* src,
+        const int src_step,
+        const ImageTransform t,
+        T* dst,
+        const float scale,
+        const float3 means,
+        const float3 stds,
+        const int3 source,
+        const int pad) {
+    int idx = blockIdx.x * blockDim.x + threadIdx.x;
+    int plane = t.dst_w * t.dst_h;
+    if (idx >= plane) return;
+    int x = idx % t.dst_w;
+    int y = idx / t.dst_w;
+    int rx = x - t.pad_x;
+    int ry = y - t.pad_y;
+
+    int v[3] = {pad, pad, pad};
+    if (rx >= 0 && rx < t.resized_w && ry >= 0 && ry < t.resized_h) {
+        int sx, sy, a0, a1, b0, b1;
+        linearTap(rx, t.src_w, t.resized_w, &sx, &a0, &a1);
+        linearTap(ry, t.src_h, t.resized_h, &sy, &b0, &b1);
+        const uint8_t* s0 = src + sy * src_step;
+        const uint8_t* s1 = src + min(sy + 1, t.src_h - 1) * src_step;
+        int x0 = sx * 3;
+        int x1 = min(sx + 1, t.src_w - 1) * 3;
+        // vertical then horizontal with rounding of blendRows and resizeRow, same bytes as host
+        for (int k = 0; k < 3; ++k) {
+            int v0 = (s0[x0 + k] * b0 + s1[x0 + k] * b1 + 16) >> 5;
+            int v1 = (s0[x1 + k] * b0 + s1[x1 + k] * b1 + 16) >> 5;
+            v[k] = (v0 * a0 + v1 * a1 + (1 << 16)) >> 17;
+        }
+    }
+    // entries of NormalizeLut tables, fma as makeNormalizeLut
+    storeInput(dst + idx, __fmaf_rn((float)v[source.x], scale, -means.x) / stds.x);
+    storeInput(dst + idx + plane, __fmaf_rn((float)v[source.y], scale, -means.y) / stds.y);
+    storeInput(dst + idx + 2 * plane, __fmaf_rn((float)v[source.z], scale, -means.z) / stds.z);
+}
+
+template <typename T>
+static void letterboxTo(const uint8_t* src, int src_step, const ImageTransform& transform, T* dst,
+                        const NormalizeLut& lut, uint8_t pad, cudaStream_t stream) {
+    int count = transform.dst_w * transform.dst_h;
+    letterbox_kernel<<<(count - 1) / BLOCK + 1, BLOCK, 0, stream>>>(
+            src, src_step, transform, dst, lut.scale,
+            make_float3(lut.means[0], lut.means[1], lut.means[2]),
+            inputDivisors(lut),
+            make_int3(lut.source[0], lut.source[1], lut.source[2]),
+            pad);
+}
+
+void letterboxNormalize(
+        const uint8_t* src,
+        int src_step,
+        const ImageTransform& transform,
+        void* dst,
+        const NormalizeLut& lut,
+        uint8_t pad,
+        cudaStream_t stream) {
+    switch (lut.dtype) {
+        case nvinfer1::DataType::kHALF: letterboxTo(src, src_step, transform, static_cast<__half*>(dst), lut, pad, stream); break;
+        case nvinfer1::DataType::kINT8: letterboxTo(src, src_step, transform, static_cast<int8_t*>(dst), lut, pad, stream); break;
+        default: letterboxTo(src, src_step, transform, static_cast<float*>(dst), lut, pad, stream);
+    }
+}
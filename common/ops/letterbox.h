@@ -0,0 +1,28 @@
+/**
+ * Resize of image to model input in one pass on device, same as
+ * letterboxNormalize_cpu.
+ * 2021/05/31
+ */
+
+#ifndef LETTERBOX_H
+#define LETTERBOX_H
+
+#include <cuda.h>
+
+#include "letterbox_cpu.h"
+#include "nhwc2nchw.h"
+
+/**
+ * src: bgr image on device, dst: binding of input on device in data type of
+ * lut, see letterboxNormalize_cpu. Runs on stream as NHWC2NCHW_binding.
+ */
+void letterboxNormalize(
+        const uint8_t* src,
+        int src_step,
+        const ImageTransform& transform,
+        void* dst,
+        const NormalizeLut& lut,
+        uint8_t pad = 114,
+        cudaStream_t stream = 0);
+
+#endif  // LETTERBOX_H
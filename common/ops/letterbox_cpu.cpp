@@ -0,0 +1,437 @@
+#include "letterbox_cpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LETTERBOX_AVX2
+#endif
+
+ImageTransform letterboxTransform(int src_w, int src_h, int dst_w, int dst_h, bool padding) {
+    ImageTransform t;
+    t.src_w = src_w;
+    t.src_h = src_h;
+    t.dst_w = dst_w;
+    t.dst_h = dst_h;
+    t.resized_w = dst_w;
+    t.resized_h = dst_h;
+    if (src_w == dst_w && src_h == dst_h) return t;
+    if (!padding) {
+        t.scale_x = static_cast<float>(dst_w) / static_cast<float>(src_w);
+        t.scale_y = static_cast<float>(dst_h) / static_cast<float>(src_h);
+        return t;
+    }
+    float scale = std::min(static_cast<float>(dst_w) / static_cast<float>(src_w), static_cast<float>(dst_h) / static_cast<float>(src_h));
+    t.resized_w = static_cast<int>(scale * static_cast<float>(src_w));
+    t.resized_h = static_cast<int>(scale * static_cast<float>(src_h));
+    t.scale_x = scale;
+    t.scale_y = scale;
+    t.pad_x = (dst_w - t.resized_w) / 2;
+    t.pad_y = (dst_h - t.resized_h) / 2;
+    return t;
+}
+
+/**
+ * Source index and 11 bit weights of every output coordinate along one axis,
+ * as cv::resize INTER_LINEAR computes them: half pixel centers, clamped at borders.
+ */
+static void linearTaps(int src_size, int dst_size, std::vector<int>& index, std::vector<short>& weights) {
+    double scale = static_cast<double>(src_size) / dst_size;
+    index.resize(dst_size);
+    weights.resize(dst_size * 2);
+    for (int d = 0; d < dst_size; ++d) {
+        float f = static_cast<float>((d + 0.5) * scale - 0.5);
+        int s = static_cast<int>(std::floor(f));
+        f -= s;
+        if (s < 0) {
+            s = 0;
+            f = 0.f;
+        }
+        if (s >= src_size - 1) {
+            s = src_size - 1;
+            f = 0.f;
+        }
+        index[d] = s;
+        weights[d * 2]     = static_cast<short>(std::lrint((1.f - f) * 2048.f));
+        weights[d * 2 + 1] = static_cast<short>(std::lrint(f * 2048.f));
+    }
+}
+
+/**
+ * Source rows blended vertically first, over contiguous bytes, into 16 bit values
+ * of 32 x level: (s0 * b0 + s1 * b1 + 16) >> 5.
+ */
+static void blendRows(const uint8_t* s0, const uint8_t* s1, int b0, int b1, int count, int16_t* v) {
+    int i = 0;
+#if defined(LETTERBOX_AVX2)
+    // byte pairs of both rows times weight pairs by madd
+    const __m256i weights = _mm256_set1_epi32((b1 << 16) | b0);
+    const __m256i round = _mm256_set1_epi32(16);
+    for (; i + 16 <= count; i += 16) {
+        __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + i));
+        __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + i));
+        __m256i lo = _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(r0, r1)), weights);
+        __m256i hi = _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm_unpackhi_epi8(r0, r1)), weights);
+        lo = _mm256_srai_epi32(_mm256_add_epi32(lo, round), 5);
+        hi = _mm256_srai_epi32(_mm256_add_epi32(hi, round), 5);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(v + i), packed);
+    }
+#endif
+    for (; i < count; ++i) {
+        v[i] = static_cast<int16_t>((s0[i] * b0 + s1[i] * b1 + 16) >> 5);
+    }
+}
+
+/**
+ * Blended row resized horizontally into bgr bytes: (v0 * a0 + v1 * a1 + (1 << 16)) >> 17.
+ * Right tap of every pixel is next source pixel, clamped pixels have zero right
+ * weight, so v keeps 8 readable values after count pixels.
+ */
+static void resizeRow(const int16_t* v, const int* xofs, const int* alpha, int count, uint8_t* out) {
+    int rx = 0;
+#if defined(LETTERBOX_AVX2)
+    // one unaligned load holds both taps of a pixel, pairs are shuffled next to each other for madd
+    const __m128i pairs = _mm_setr_epi8(0, 1, 6, 7, 2, 3, 8, 9, 4, 5, 10, 11, -1, -1, -1, -1);
+    const __m128i compact = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m128i round = _mm_set1_epi32(1 << 16);
+    // 4 pixels a step, 16 bytes stored of which 12 are kept
+    for (; rx + 4 <= count; rx += 4) {
+        __m128i sums[4];
+        for (int k = 0; k < 4; ++k) {
+            __m128i taps = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + xofs[rx + k]));
+            sums[k] = _mm_madd_epi16(_mm_shuffle_epi8(taps, pairs), _mm_set1_epi32(alpha[rx + k]));
+            sums[k] = _mm_srai_epi32(_mm_add_epi32(sums[k], round), 17);
+        }
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(sums[0], sums[1]), _mm_packs_epi32(sums[2], sums[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + rx * 3), _mm_shuffle_epi8(bytes, compact));
+    }
+#endif
+    for (; rx < count; ++rx) {
+        const int16_t* v0 = v + xofs[rx];
+        int a0 = alpha[rx] & 0xffff;
+        int a1 = alpha[rx] >> 16;
+        for (int c = 0; c < 3; ++c) {
+            out[rx * 3 + c] = static_cast<uint8_t>((v0[c] * a0 + v0[c + 3] * a1 + (1 << 16)) >> 17);
+        }
+    }
+}
+
+/**
+ * BT.601 limited range of cv::cvtColor in 20 bit fixed point:
+ * r = (max(y - 16, 0) * CY + CVR * v + round) >> 20, u and v minus 128.
+ */
+static const int kYuvShift = 20;
+static const int kCY  = 1220542;
+static const int kCUB = 2116026;
+static const int kCUG = -409993;
+static const int kCVG = -852492;
+static const int kCVR = 1673527;
+
+static inline uint8_t saturateByte(int v) {
+    return static_cast<uint8_t>(std::min(std::max(v, 0), 255));
+}
+
+static void yuvPixels(const uint8_t* y, const uint8_t* u, const uint8_t* v, int uv_pixel, int first, int last,
+                      uint8_t* out) {
+    for (int x = first; x < last; ++x) {
+        int uu = u[(x >> 1) * uv_pixel] - 128;
+        int vv = v[(x >> 1) * uv_pixel] - 128;
+        int yy = std::max(y[x] - 16, 0) * kCY + (1 << (kYuvShift - 1));
+        out[x * 3]     = saturateByte((yy + kCUB * uu) >> kYuvShift);
+        out[x * 3 + 1] = saturateByte((yy + kCVG * vv + kCUG * uu) >> kYuvShift);
+        out[x * 3 + 2] = saturateByte((yy + kCVR * vv) >> kYuvShift);
+    }
+}
+
+#if defined(LETTERBOX_AVX2)
+// 16 values of 2 x 8 int32 to bytes, saturated
+static inline __m128i packBytes(__m256i lo, __m256i hi) {
+    __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+    return _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+}
+
+/**
+ * Shuffles of planar b, g, r bytes into 3 chunks of 16 interleaved bytes, byte j
+ * of chunk k is channel (16k + j) % 3 of pixel (16k + j) / 3.
+ */
+struct InterleaveMasks {
+    alignas(16) int8_t masks[3][3][16];
+    InterleaveMasks() {
+        for (int k = 0; k < 3; ++k) {
+            for (int c = 0; c < 3; ++c) {
+                for (int j = 0; j < 16; ++j) {
+                    int byte = 16 * k + j;
+                    masks[k][c][j] = static_cast<int8_t>(byte % 3 == c ? byte / 3 : -1);
+                }
+            }
+        }
+    }
+};
+#endif
+
+// one row of 4:2:0 pixels to bgr bytes
+static void yuvRow(const uint8_t* y, const uint8_t* u, const uint8_t* v, int uv_pixel, int width, uint8_t* out) {
+    int x = 0;
+#if defined(LETTERBOX_AVX2)
+    static const InterleaveMasks shuffles;
+    const __m256i y16 = _mm256_set1_epi32(16);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i cy = _mm256_set1_epi32(kCY);
+    const __m256i round = _mm256_set1_epi32(1 << (kYuvShift - 1));
+    const __m256i c128 = _mm256_set1_epi32(128);
+    // chroma of pixel pairs 0-3 and 4-7 repeated for both pixels of a pair
+    const __m256i pairs_lo = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i pairs_hi = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+    // u bytes to low half and v bytes to high half of interleaved uv
+    const __m128i split = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    // 16 pixels a step, 8 chroma samples of each plane
+    for (; x + 16 <= width; x += 16) {
+        __m128i us, vs;
+        if (uv_pixel == 2) {
+            // v = u + 1, one load holds both
+            __m128i uv = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x)), split);
+            us = uv;
+            vs = _mm_srli_si128(uv, 8);
+        } else {
+            us = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x / 2));
+            vs = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x / 2));
+        }
+        __m256i uu = _mm256_sub_epi32(_mm256_cvtepu8_epi32(us), c128);
+        __m256i vv = _mm256_sub_epi32(_mm256_cvtepu8_epi32(vs), c128);
+        __m256i buv = _mm256_add_epi32(_mm256_mullo_epi32(uu, _mm256_set1_epi32(kCUB)), round);
+        __m256i guv = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(vv, _mm256_set1_epi32(kCVG)),
+                                                        _mm256_mullo_epi32(uu, _mm256_set1_epi32(kCUG))), round);
+        __m256i ruv = _mm256_add_epi32(_mm256_mullo_epi32(vv, _mm256_set1_epi32(kCVR)), round);
+        __m128i ys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+        __m256i y_lo = _mm256_cvtepu8_epi32(ys);
+        __m256i y_hi = _mm256_cvtepu8_epi32(_mm_srli_si128(ys, 8));
+        y_lo = _mm256_mullo_epi32(_mm256_max_epi32(_mm256_sub_epi32(y_lo, y16), zero), cy);
+        y_hi = _mm256_mullo_epi32(_mm256_max_epi32(_mm256_sub_epi32(y_hi, y16), zero), cy);
+        __m128i planes[3];
+        const __m256i chroma[3] = {buv, guv, ruv};
+        for (int c = 0; c < 3; ++c) {
+            __m256i lo = _mm256_add_epi32(y_lo, _mm256_permutevar8x32_epi32(chroma[c], pairs_lo));
+            __m256i hi = _mm256_add_epi32(y_hi, _mm256_permutevar8x32_epi32(chroma[c], pairs_hi));
+            planes[c] = packBytes(_mm256_srai_epi32(lo, kYuvShift), _mm256_srai_epi32(hi, kYuvShift));
+        }
+        for (int k = 0; k < 3; ++k) {
+            __m128i chunk = _mm_shuffle_epi8(planes[0], _mm_load_si128(reinterpret_cast<const __m128i*>(shuffles.masks[k][0])));
+            chunk = _mm_or_si128(chunk, _mm_shuffle_epi8(planes[1], _mm_load_si128(reinterpret_cast<const __m128i*>(shuffles.masks[k][1]))));
+            chunk = _mm_or_si128(chunk, _mm_shuffle_epi8(planes[2], _mm_load_si128(reinterpret_cast<const __m128i*>(shuffles.masks[k][2]))));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 3 + k * 16), chunk);
+        }
+    }
+#endif
+    yuvPixels(y, u, v, uv_pixel, x, width, out);
+}
+
+void yuv420ToBgr_cpu(const YuvImage& src, int width, int first, int last, uint8_t* dst, int dst_step) {
+    for (int row = first; row < last; ++row) {
+        size_t chroma = static_cast<size_t>(row >> 1) * src.uv_step;
+        yuvRow(src.y + static_cast<size_t>(row) * src.y_step, src.u + chroma, src.v + chroma, src.uv_pixel, width,
+               dst + static_cast<size_t>(row - first) * dst_step);
+    }
+}
+
+// rows of a bgr image, read in place
+struct BgrRows {
+    const uint8_t* src;
+    int step;
+
+    const uint8_t* row(int y) {
+        return src + static_cast<size_t>(y) * step;
+    }
+};
+
+/**
+ * Rows of a 4:2:0 image converted to bgr as they're read. Taps of consecutive
+ * output rows share source rows, so the last two converted rows are kept.
+ */
+struct YuvRows {
+    const YuvImage* src;
+    int width;
+    std::vector<uint8_t> cache[2];
+    int cached[2] = {-1, -1};
+    int recent = 0;  // slot read last
+
+    YuvRows(const YuvImage& src, int width) : src(&src), width(width) {}
+
+    const uint8_t* row(int y) {
+        for (int s = 0; s < 2; ++s) {
+            if (cached[s] == y) {
+                recent = s;
+                return cache[s].data();
+            }
+        }
+        recent ^= 1;
+        cache[recent].resize(width * 3);
+        yuv420ToBgr_cpu(*src, width, y, y + 1, cache[recent].data(), width * 3);
+        cached[recent] = y;
+        return cache[recent].data();
+    }
+};
+
+// rows of input written planar in elements of lut, pad holds border elements of every channel
+template <typename T>
+struct NormalizedRows {
+    T* dst;
+    const NormalizeLut* lut;
+    const T* pad;
+
+    void border(const ImageTransform& t, int y) const {
+        int plane = t.dst_w * t.dst_h;
+        for (int c = 0; c < 3; ++c) {
+            std::fill(dst + c * plane + y * t.dst_w, dst + c * plane + (y + 1) * t.dst_w, pad[c]);
+        }
+    }
+
+    void write(const ImageTransform& t, int y, const uint8_t* resized) const {
+        int plane = t.dst_w * t.dst_h;
+        int x_end = t.pad_x + t.resized_w;
+        for (int c = 0; c < 3; ++c) {
+            T* op = dst + c * plane + y * t.dst_w;
+            std::fill(op, op + t.pad_x, pad[c]);
+            std::fill(op + x_end, op + t.dst_w, pad[c]);
+        }
+        normalizePixels(resized, dst + y * t.dst_w + t.pad_x, plane, 0, t.resized_w, *lut);
+    }
+};
+
+// rows of input written as bgr bytes
+struct BgrOutput {
+    uint8_t* dst;
+    int step;
+    uint8_t pad;
+
+    void border(const ImageTransform& t, int y) const {
+        std::fill(dst + y * step, dst + y * step + t.dst_w * 3, pad);
+    }
+
+    void write(const ImageTransform& t, int y, const uint8_t* resized) const {
+        uint8_t* op = dst + y * step;
+        std::fill(op, op + t.pad_x * 3, pad);
+        std::copy(resized, resized + t.resized_w * 3, op + t.pad_x * 3);
+        std::fill(op + (t.pad_x + t.resized_w) * 3, op + t.dst_w * 3, pad);
+    }
+};
+
+// output rows [first, last), source is copied so every thread has its own rows
+template <typename Source, typename Output>
+static void letterboxRows(Source source, const ImageTransform& t, const Output& output,
+                          const std::vector<int>& xofs, const std::vector<int>& alpha,
+                          const std::vector<int>& yofs, const std::vector<short>& beta, int first, int last) {
+    // padded for 16 byte loads and stores past last pixel
+    std::vector<int16_t> blended(t.src_w * 3 + 8, 0);
+    std::vector<uint8_t> resized(t.resized_w * 3 + 4);
+    for (int y = first; y < last; ++y) {
+        int ry = y - t.pad_y;
+        if (ry < 0 || ry >= t.resized_h) {
+            output.border(t, y);
+            continue;
+        }
+        const uint8_t* s0 = source.row(yofs[ry]);
+        const uint8_t* s1 = source.row(std::min(yofs[ry] + 1, t.src_h - 1));
+        blendRows(s0, s1, beta[ry * 2], beta[ry * 2 + 1], t.src_w * 3, blended.data());
+        resizeRow(blended.data(), xofs.data(), alpha.data(), t.resized_w, resized.data());
+        output.write(t, y, resized.data());
+    }
+}
+
+template <typename Source, typename Output>
+static void letterboxWith(const Source& source, const ImageTransform& transform, const Output& output, int threads) {
+    std::vector<int> xofs, yofs;
+    std::vector<short> weights, beta;
+    linearTaps(transform.src_w, transform.resized_w, xofs, weights);
+    linearTaps(transform.src_h, transform.resized_h, yofs, beta);
+    // byte offsets of left taps and both weights of a column in one int, as madd reads them
+    std::vector<int> alpha(transform.resized_w);
+    for (int rx = 0; rx < transform.resized_w; ++rx) {
+        xofs[rx] *= 3;
+        alpha[rx] = (weights[rx * 2 + 1] << 16) | weights[rx * 2];
+    }
+    int rows = transform.dst_h;
+    int parts = std::max(1, std::min(threads, rows));
+    std::vector<std::thread> workers;
+    for (int t = 1; t < parts; ++t) {
+        workers.emplace_back(letterboxRows<Source, Output>, source, std::cref(transform), std::cref(output),
+                             std::cref(xofs), std::cref(alpha), std::cref(yofs), std::cref(beta),
+                             rows * t / parts, rows * (t + 1) / parts);
+    }
+    letterboxRows(source, transform, output, xofs, alpha, yofs, beta, 0, rows / parts);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// planar output in data type of lut, border of every channel is pad normalized
+template <typename Source>
+static void letterboxNormalizeFrom(const Source& source, const ImageTransform& transform, void* dst,
+                                   const NormalizeLut& lut, uint8_t pad, int threads) {
+    switch (lut.dtype) {
+        case nvinfer1::DataType::kHALF: {
+            const uint16_t pad_values[3] = {lut.halves[0][pad], lut.halves[1][pad], lut.halves[2][pad]};
+            letterboxWith(source, transform, NormalizedRows<uint16_t>{static_cast<uint16_t*>(dst), &lut, pad_values}, threads);
+            break;
+        }
+        case nvinfer1::DataType::kINT8: {
+            const int8_t pad_values[3] = {lut.quants[0][pad], lut.quants[1][pad], lut.quants[2][pad]};
+            letterboxWith(source, transform, NormalizedRows<int8_t>{static_cast<int8_t*>(dst), &lut, pad_values}, threads);
+            break;
+        }
+        default: {
+            const float pad_values[3] = {lut.values[0][pad], lut.values[1][pad], lut.values[2][pad]};
+            letterboxWith(source, transform, NormalizedRows<float>{static_cast<float*>(dst), &lut, pad_values}, threads);
+        }
+    }
+}
+
+void letterboxNormalize_cpu(
+        const uint8_t* src,
+        int src_step,
+        const ImageTransform& transform,
+        void* dst,
+        const NormalizeLut& lut,
+        uint8_t pad,
+        int threads) {
+    letterboxNormalizeFrom(BgrRows{src, src_step}, transform, dst, lut, pad, threads);
+}
+
+void letterboxNormalizeYuv_cpu(
+        const YuvImage& src,
+        const ImageTransform& transform,
+        void* dst,
+        const NormalizeLut& lut,
+        uint8_t pad,
+        int threads) {
+    letterboxNormalizeFrom(YuvRows(src, transform.src_w), transform, dst, lut, pad, threads);
+}
+
+void letterboxYuv_cpu(
+        const YuvImage& src,
+        const ImageTransform& transform,
+        uint8_t* dst,
+        int dst_step,
+        uint8_t pad,
+        int threads) {
+    letterboxWith(YuvRows(src, transform.src_w), transform, BgrOutput{dst, dst_step, pad}, threads);
+}
+
+#ifdef CPU_ONLY
+#include "letterbox.h"
+
+// BUILD_CPU_ONLY has no kernels, device memory is host memory there
+void letterboxNormalize(
+        const uint8_t* src,
+        int src_step,
+        const ImageTransform& transform,
+        void* dst,
+        const NormalizeLut& lut,
+        uint8_t pad,
+        cudaStream_t) {
+    letterboxNormalize_cpu(src, src_step, transform, dst, lut, pad);
+}
+#endif  // CPU_ONLY
@@ -0,0 +1,86 @@
+/**
+ * Resize of image to model input in one pass on cpu: bilinear resize into the
+ * letterboxed region, border fill, channel order and normalization, written
+ * as planar input in data type of lut(float, half or int8). Bilinear uses 11 bit weights of cv::resize
+ * INTER_LINEAR, source rows are blended vertically first, then horizontally
+ * (AVX2 when built with it), results are within one level of cv::resize.
+ * 4:2:0 yuv sources(NV12, I420) are converted to bgr row by row as resize
+ * reads them, only source rows bilinear taps touch and never a whole bgr image.
+ * Conversion is BT.601 limited range in fixed point of cv::cvtColor
+ * COLOR_YUV2BGR_NV12/I420, bit exact, chroma is shared by every 2x2 pixels.
+ * 2021/05/31
+ */
+
+#ifndef LETTERBOX_CPU_H
+#define LETTERBOX_CPU_H
+
+#include <cstdint>
+
+#include "nhwc2nchw_cpu.h"
+#include "structs.h"
+
+/**
+ * Transform of src_w x src_h image to dst_w x dst_h input, letterbox keeps
+ * aspect ratio and centers resized image, otherwise image is stretched.
+ */
+ImageTransform letterboxTransform(int src_w, int src_h, int dst_w, int dst_h, bool padding);
+
+/**
+ * src: bgr image of transform.src_w x transform.src_h, rows src_step bytes apart.
+ * dst: 3 x dst_h x dst_w elements of lut.dtype, host memory.
+ * pad: value of border before normalization.
+ * Rows of output are split into threads parts.
+ */
+void letterboxNormalize_cpu(
+        const uint8_t* src,
+        int src_step,
+        const ImageTransform& transform,
+        void* dst,
+        const NormalizeLut& lut,
+        uint8_t pad = 114,
+        int threads = 1);
+
+/**
+ * 4:2:0 image: luma plane and chroma planes at half width and height(rounded
+ * up). NV12 has u and v interleaved, so v = u + 1 and uv_pixel 2, I420 has u and
+ * v planes and uv_pixel 1.
+ */
+struct YuvImage {
+    const uint8_t* y = nullptr;
+    int y_step = 0;
+    const uint8_t* u = nullptr;
+    const uint8_t* v = nullptr;
+    int uv_step = 0;
+    int uv_pixel = 2;  // bytes from one chroma sample to next in a row
+};
+
+/**
+ * Rows [first, last) of src to bgr, width pixels each, into dst rows dst_step
+ * bytes apart.
+ */
+void yuv420ToBgr_cpu(const YuvImage& src, int width, int first, int last, uint8_t* dst, int dst_step);
+
+/**
+ * Same as letterboxNormalize_cpu from a 4:2:0 image of transform.src_w x transform.src_h.
+ */
+void letterboxNormalizeYuv_cpu(
+        const YuvImage& src,
+        const ImageTransform& transform,
+        void* dst,
+        const NormalizeLut& lut,
+        uint8_t pad = 114,
+        int threads = 1);
+
+/**
+ * Letterbox of 4:2:0 image into bgr bytes, no normalization(staging of device
+ * backends), dst rows dst_step bytes apart, border bytes are pad.
+ */
+void letterboxYuv_cpu(
+        const YuvImage& src,
+        const ImageTransform& transform,
+        uint8_t* dst,
+        int dst_step,
+        uint8_t pad = 114,
+        int threads = 1);
+
+#endif  // LETTERBOX_CPU_H
@@ -1,57 +1,103 @@
-#include "nhwc2nchw.h"
-
-__global__ void transpose_kernel(
-        const uint8_t* input,
-        float* output,
-        const int n,
-        const int h,
-        const int w,
-        const float mean_0,
-        const float mean_1,
-        const float mean_2,
-        const float var_0,
-        const float var_1,
-        const float var_2,
-        const ImageFormat format) {
-    int stride = h * w;
-    int idx = blockIdx.x * blockDim.x + threadIdx.x;
-
-    int pn = idx / stride;
-    if (pn >= n)
-        return;
-
-    const uint8_t* ip = input + idx * 3;
-    float* op = output + idx + pn * 2 * stride;
-
-    float scale_factor = 1.f;
-    if (format == ImageFormat::kRGB || format == ImageFormat::kBGR) scale_factor = 1.f / 255.f;
-
-    if (format == ImageFormat::kBGR || format == ImageFormat::kBGR255) {
-        op[0]          = ((float)ip[0] * scale_factor - mean_0) / var_0;
-        op[stride]     = ((float)ip[1] * scale_factor - mean_1) / var_1;
-        op[2 * stride] = ((float)ip[2] * scale_factor - mean_2) / var_2;
-    } else {
-        op[0]          = ((float)ip[2] * scale_factor - mean_0) / var_0;
-        op[stride]     = ((float)ip[1] * scale_factor - mean_1) / var_1;
-        op[2 * stride] = ((float)ip[0] * scale_factor - mean_2) / var_2;
-    }
-
-}
-
-void NHWC2NCHW(
-        const uint8_t* input,
-        float* output,
-        const int n,
-        const int h,
-        const int w,
-        const float mean_0,
-        const float mean_1,
-        const float mean_2,
-        const float var_0,
-        const float var_1,
-        const float var_2,
-        const ImageFormat format) {
-    transpose_kernel<<<(n * h * w - 1) / BLOCK + 1, BLOCK>>>(input, output, n, h, w,
-                                                             mean_0, mean_1, mean_2,
-                                                             var_0, var_1, var_2, format);
-}
+#include "nhwc2nchw.h"
+
+__global__ void transpose_kernel(
+        const uint8_t* input,
+        float* output,
+        const int n,
+        const int h,
+        const int w,
+        const float mean_0,
+        const float mean_1,
+        const float mean_2,
+        const float var_0,
+        const float var_1,
+        const float var_2,
+        const ImageFormat format) {
+    int stride = h * w;
+    int idx = blockIdx.x * blockDim.x + threadIdx.x;
+
+    int pn = idx / stride;
+    if (pn >= n)
+        return;
+
+    const uint8_t* ip = input + idx * 3;
+    float* op = output + idx + pn * 2 * stride;
+
+    float scale_factor = 1.f;
+    if (format == ImageFormat::kRGB || format == ImageFormat::kBGR) scale_factor = 1.f / 255.f;
+
+    if (format == ImageFormat::kBGR || format == ImageFormat::kBGR255) {
+        op[0]          = ((float)ip[0] * scale_factor - mean_0) / var_0;
+        op[stride]     = ((float)ip[1] * scale_factor - mean_1) / var_1;
+        op[2 * stride] = ((float)ip[2] * scale_factor - mean_2) / var_2;
+    } else {
+        op[0]          = ((float)ip[2] * scale_factor - mean_0) / var_0;
+        op[stride]     = ((float)ip[1] * scale_factor - mean_1) / var_1;
+        op[2 * stride] = ((float)ip[0] * scale_factor - mean_2) / var_2;
+    }
+
+}
+
+void NHWC2NCHW(
+        const uint8_t* input,
+        float* output,
+        const int n,
+        const int h,
+        const int w,
+        const float mean_0,
+        const float mean_1,
+        const float mean_2,
+        const float var_0,
+        const float var_1,
+        const float var_2,
+        const ImageFormat format) {
+    transpose_kernel<<<(n * h * w - 1) / BLOCK + 1, BLOCK>>>(input, output, n, h, w,
+                                                             mean_0, mean_1, mean_2,
+                                                             var_0, var_1, var_2, format);
+}
+
+// one pixel per thread, entries of NormalizeLut tables computed by fma as makeNormalizeLut
+template <typename T>
+__global__ void transpose_lut_kernel(
+        const uint8_t* input,
+        T* output,
+        const int n,
+        const int stride,
+        const float scale,
+        const float3 means,
+        const float3 stds,
+        const int3 source) {
+    int idx = blockIdx.x * blockDim.x + threadIdx.x;
+    int pn = idx / stride;
+    if (pn >= n) return;
+    const uint8_t* ip = input + idx * 3;
+    T* op = output + idx + pn * 2 * stride;
+    storeInput(op, __fmaf_rn((float)ip[source.x], scale, -means.x) / stds.x);
+    storeInput(op + stride, __fmaf_rn((float)ip[source.y], scale, -means.y) / stds.y);
+    storeInput(op + 2 * stride, __fmaf_rn((float)ip[source.z], scale, -means.z) / stds.z);
+}
+
+template <typename T>
+static void transposeLut(const uint8_t* input, T* output, int n, int h, int w, const NormalizeLut& lut,
+                         cudaStream_t stream) {
+    transpose_lut_kernel<<<(n * h * w - 1) / BLOCK + 1, BLOCK, 0, stream>>>(
+            input, output, n, h * w, lut.scale,
+            make_float3(lut.means[0], lut.means[1], lut.means[2]),
+            inputDivisors(lut),
+            make_int3(lut.source[0], lut.source[1], lut.source[2]));
+}
+
+void NHWC2NCHW_binding(
+        const uint8_t* input,
+        void* output,
+        const int n,
+        const int h,
+        const int w,
+        const NormalizeLut& lut,
+        cudaStream_t stream) {
+    switch (lut.dtype) {
+        case nvinfer1::DataType::kHALF: transposeLut(input, static_cast<__half*>(output), n, h, w, lut, stream); break;
+        case nvinfer1::DataType::kINT8: transposeLut(input, static_cast<int8_t*>(output), n, h, w, lut, stream); break;
+        default: transposeLut(input, static_cast<float*>(output), n, h, w, lut, stream);
+    }
+}
@@ -1,5 +1,7 @@
 /**
  * Convert input image from nhwc mode to nchw mode.
+ * NHWC2NCHW_binding writes input binding in its own data type(float, half or
+ * int8), see setLutOutput.
  * 2020/11/20
  */
 
@@ -9,10 +11,34 @@
 #include <cuda.h>
 #include <array>
 
+#include "nhwc2nchw_cpu.h"
 #include "utils.h"
 
 #define BLOCK 512
 
+#ifdef __CUDACC__
+#include <cuda_fp16.h>
+
+// element of input binding from fma(v, scale, -mean) / divisor, rounded as tables of NormalizeLut
+__device__ inline void storeInput(float* dst, float value) {
+    *dst = value;
+}
+
+__device__ inline void storeInput(__half* dst, float value) {
+    *dst = __float2half_rn(value);
+}
+
+__device__ inline void storeInput(int8_t* dst, float value) {
+    *dst = (int8_t)__float2int_rn(fminf(fmaxf(value, -128.f), 127.f));
+}
+
+// stds of lut, or stds x qscale for int8
+inline float3 inputDivisors(const NormalizeLut& lut) {
+    const float* d = lut.dtype == nvinfer1::DataType::kINT8 ? lut.qstds : lut.stds;
+    return make_float3(d[0], d[1], d[2]);
+}
+#endif
+
 __global__ void transpose_kernel(
         const uint8_t* input,
         float* output,
@@ -41,4 +67,18 @@ extern "C" void NHWC2NCHW(
         const float var_2,
         const ImageFormat format);
 
+/**
+ * NHWC2NCHW by means/stds/format of lut into elements of lut.dtype, values are
+ * same as NHWC2NCHW_lut on host. Runs on stream, stream of execution state
+ * keeps it ordered with upload and forward of that state.
+ */
+void NHWC2NCHW_binding(
+        const uint8_t* input,
+        void* output,
+        const int n,
+        const int h,
+        const int w,
+        const NormalizeLut& lut,
+        cudaStream_t stream = 0);
+
 #endif  // NWHC2NCHW_H
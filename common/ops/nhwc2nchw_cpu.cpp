@@ -0,0 +1,316 @@
+#include "nhwc2nchw_cpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "binding_convert.h"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define NHWC2NCHW_AVX512
+#elif defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+#include <immintrin.h>
+#define NHWC2NCHW_AVX2
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define NHWC2NCHW_NEON
+#endif
+
+const char* nhwc2nchwIsa() {
+#if defined(NHWC2NCHW_AVX512)
+    return "avx512";
+#elif defined(NHWC2NCHW_AVX2)
+    return "avx2";
+#elif defined(NHWC2NCHW_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+void makeNormalizeLut(
+        NormalizeLut& lut,
+        const float mean_0,
+        const float mean_1,
+        const float mean_2,
+        const float var_0,
+        const float var_1,
+        const float var_2,
+        const ImageFormat format) {
+    float scale_factor = 1.f;
+    if (format == ImageFormat::kRGB || format == ImageFormat::kBGR) scale_factor = 1.f / 255.f;
+    // same channel order as transpose_kernel
+    bool keep_order = format == ImageFormat::kBGR || format == ImageFormat::kBGR255;
+    lut.source[0] = keep_order ? 0 : 2;
+    lut.source[1] = 1;
+    lut.source[2] = keep_order ? 2 : 0;
+    const float means[3] = {mean_0, mean_1, mean_2};
+    const float vars[3]  = {var_0, var_1, var_2};
+    lut.scale = scale_factor;
+    for (int c = 0; c < 3; ++c) {
+        lut.means[c] = means[c];
+        lut.stds[c]  = vars[c];
+        for (int v = 0; v < 256; ++v) {
+            // fused multiply subtract as fmsub of vector path, so both give same bits
+            lut.values[c][v] = std::fma((float)v, scale_factor, -means[c]) / vars[c];
+        }
+    }
+    setLutOutput(lut, lut.dtype, lut.qscale);
+}
+
+// saturated to int8 before rounding, so vector paths clamping floats give same bytes
+static inline int8_t quantize(float value) {
+    return static_cast<int8_t>(std::lrint(std::min(std::max(value, -128.f), 127.f)));
+}
+
+void setLutOutput(NormalizeLut& lut, nvinfer1::DataType dtype, float scale) {
+    lut.dtype  = dtype == nvinfer1::DataType::kHALF || dtype == nvinfer1::DataType::kINT8 ? dtype : nvinfer1::DataType::kFLOAT;
+    lut.qscale = scale > 0.f ? scale : 1.f;
+    for (int c = 0; c < 3; ++c) {
+        floatToHalf(lut.values[c], lut.halves[c], 256);
+        // one division by stds x scale instead of two, int8 costs as much as float
+        lut.qstds[c] = lut.stds[c] * lut.qscale;
+        for (int v = 0; v < 256; ++v) {
+            lut.quants[c][v] = quantize(std::fma((float)v, lut.scale, -lut.means[c]) / lut.qstds[c]);
+        }
+    }
+}
+
+static inline const float* tableOf(const NormalizeLut& lut, int c, const float*) {
+    return lut.values[c];
+}
+
+static inline const uint16_t* tableOf(const NormalizeLut& lut, int c, const uint16_t*) {
+    return lut.halves[c];
+}
+
+static inline const int8_t* tableOf(const NormalizeLut& lut, int c, const int8_t*) {
+    return lut.quants[c];
+}
+
+// what fma(v, scale, -means[c]) is divided by for elements of output
+template <typename T>
+static inline const float* divisorsOf(const NormalizeLut& lut, const T*) {
+    return lut.stds;
+}
+
+static inline const float* divisorsOf(const NormalizeLut& lut, const int8_t*) {
+    return lut.qstds;
+}
+
+#if defined(NHWC2NCHW_AVX512) || defined(NHWC2NCHW_AVX2)
+// pshufb masks taking bytes of channel c of 16 pixels from each of 3 loads of 16 bytes
+struct DeinterleaveMasks {
+    __m128i masks[3][3];  // [channel][load]
+    DeinterleaveMasks() {
+        for (int c = 0; c < 3; ++c) {
+            for (int l = 0; l < 3; ++l) {
+                alignas(16) int8_t bytes[16];
+                for (int p = 0; p < 16; ++p) {
+                    int src = 3 * p + c;
+                    bytes[p] = src / 16 == l ? static_cast<int8_t>(src % 16) : static_cast<int8_t>(-128);
+                }
+                masks[c][l] = _mm_load_si128(reinterpret_cast<const __m128i*>(bytes));
+            }
+        }
+    }
+};
+#endif
+
+#if defined(NHWC2NCHW_AVX512)
+// 16 values of a channel as elements of output, conversions round to nearest even as tables do
+static inline void store16(float* dst, __m512 v, const NormalizeLut& lut) {
+    _mm512_storeu_ps(dst, v);
+}
+
+static inline void store16(uint16_t* dst, __m512 v, const NormalizeLut& lut) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+}
+
+static inline void store16(int8_t* dst, __m512 v, const NormalizeLut& lut) {
+    v = _mm512_min_ps(_mm512_max_ps(v, _mm512_set1_ps(-128.f)), _mm512_set1_ps(127.f));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm512_cvtsepi32_epi8(_mm512_cvtps_epi32(v)));
+}
+#elif defined(NHWC2NCHW_AVX2)
+static inline void store16(float* dst, __m256 lo, __m256 hi, const NormalizeLut& lut) {
+    _mm256_storeu_ps(dst, lo);
+    _mm256_storeu_ps(dst + 8, hi);
+}
+
+static inline void store16(uint16_t* dst, __m256 lo, __m256 hi, const NormalizeLut& lut) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_cvtps_ph(lo, _MM_FROUND_TO_NEAREST_INT));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), _mm256_cvtps_ph(hi, _MM_FROUND_TO_NEAREST_INT));
+}
+
+static inline void store16(int8_t* dst, __m256 lo, __m256 hi, const NormalizeLut& lut) {
+    const __m256 low = _mm256_set1_ps(-128.f);
+    const __m256 high = _mm256_set1_ps(127.f);
+    lo = _mm256_min_ps(_mm256_max_ps(lo, low), high);
+    hi = _mm256_min_ps(_mm256_max_ps(hi, low), high);
+    // packs works per 128 bit lane, permute puts lo before hi again
+    __m256i words = _mm256_packs_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+    words = _mm256_permute4x64_epi64(words, 0xd8);
+    __m128i bytes = _mm_packs_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), bytes);
+}
+#endif
+
+template <typename T>
+static void normalizeTo(const uint8_t* input, T* output, int stride, int first, int last, const NormalizeLut& lut) {
+    const uint8_t* ip = input + first * 3;
+    T* op[3] = {output + first, output + stride + first, output + 2 * stride + first};
+    int count = last - first;
+    int i = 0;
+#if defined(NHWC2NCHW_AVX512) || defined(NHWC2NCHW_AVX2)
+    // 16 pixels a step, 3 pshufb + 2 or per channel, then table entry of each byte computed in place
+    static const DeinterleaveMasks deinterleave;
+    const float* divisors = divisorsOf(lut, output);
+    for (; i + 16 <= count; i += 16, ip += 48) {
+        __m128i loads[3] = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(ip)),
+                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(ip + 16)),
+                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(ip + 32))};
+        for (int c = 0; c < 3; ++c) {
+            const __m128i* m = deinterleave.masks[lut.source[c]];
+            __m128i index = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(loads[0], m[0]), _mm_shuffle_epi8(loads[1], m[1])),
+                                         _mm_shuffle_epi8(loads[2], m[2]));
+#if defined(NHWC2NCHW_AVX512)
+            __m512 v = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(index));
+            v = _mm512_fmsub_ps(v, _mm512_set1_ps(lut.scale), _mm512_set1_ps(lut.means[c]));
+            store16(op[c] + i, _mm512_div_ps(v, _mm512_set1_ps(divisors[c])), lut);
+#else
+            __m256 scale = _mm256_set1_ps(lut.scale);
+            __m256 mean  = _mm256_set1_ps(lut.means[c]);
+            __m256 dev   = _mm256_set1_ps(divisors[c]);
+            __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(index));
+            __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(index, 8)));
+            store16(op[c] + i, _mm256_div_ps(_mm256_fmsub_ps(lo, scale, mean), dev),
+                    _mm256_div_ps(_mm256_fmsub_ps(hi, scale, mean), dev), lut);
+#endif
+        }
+    }
+#elif defined(NHWC2NCHW_NEON)
+    // no float gather on NEON, deinterleave by vld3 and look up lanes
+    for (; i + 16 <= count; i += 16, ip += 48) {
+        uint8x16x3_t pixels = vld3q_u8(ip);
+        uint8_t channels[3][16];
+        vst1q_u8(channels[0], pixels.val[0]);
+        vst1q_u8(channels[1], pixels.val[1]);
+        vst1q_u8(channels[2], pixels.val[2]);
+        for (int c = 0; c < 3; ++c) {
+            const T* table = tableOf(lut, c, output);
+            const uint8_t* index = channels[lut.source[c]];
+            for (int k = 0; k < 16; ++k) {
+                op[c][i + k] = table[index[k]];
+            }
+        }
+    }
+#endif
+    const T* tables[3] = {tableOf(lut, 0, output), tableOf(lut, 1, output), tableOf(lut, 2, output)};
+    for (; i < count; ++i, ip += 3) {
+        op[0][i] = tables[0][ip[lut.source[0]]];
+        op[1][i] = tables[1][ip[lut.source[1]]];
+        op[2][i] = tables[2][ip[lut.source[2]]];
+    }
+}
+
+void normalizePixels(const uint8_t* input, void* output, int stride, int first, int last, const NormalizeLut& lut) {
+    switch (lut.dtype) {
+        case nvinfer1::DataType::kHALF:
+            normalizeTo(input, static_cast<uint16_t*>(output), stride, first, last, lut);
+            break;
+        case nvinfer1::DataType::kINT8:
+            normalizeTo(input, static_cast<int8_t*>(output), stride, first, last, lut);
+            break;
+        default:
+            normalizeTo(input, static_cast<float*>(output), stride, first, last, lut);
+    }
+}
+
+// rows [first, last) of all n x h rows
+static void convertRows(const uint8_t* input, void* output, int h, int w, int first, int last, const NormalizeLut& lut) {
+    int stride = h * w;
+    size_t element = getElementSize(lut.dtype);
+    for (int row = first; row < last;) {
+        int pn = row / h;
+        int end = std::min(last, (pn + 1) * h);  // rows of same image are contiguous pixels
+        normalizePixels(input + pn * stride * 3, static_cast<uint8_t*>(output) + pn * stride * 3 * element, stride,
+                      (row - pn * h) * w, (end - pn * h) * w, lut);
+        row = end;
+    }
+}
+
+void NHWC2NCHW_lut(
+        const uint8_t* input,
+        void* output,
+        const int n,
+        const int h,
+        const int w,
+        const NormalizeLut& lut,
+        const int threads) {
+    int rows = n * h;
+    int parts = std::max(1, std::min(threads, rows));
+    if (parts == 1) {
+        convertRows(input, output, h, w, 0, rows, lut);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (int t = 1; t < parts; ++t) {
+        workers.emplace_back(convertRows, input, output, h, w, rows * t / parts, rows * (t + 1) / parts, std::cref(lut));
+    }
+    convertRows(input, output, h, w, 0, rows / parts, lut);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void NHWC2NCHW_cpu(
+        const uint8_t* input,
+        float* output,
+        const int n,
+        const int h,
+        const int w,
+        const float mean_0,
+        const float mean_1,
+        const float mean_2,
+        const float var_0,
+        const float var_1,
+        const float var_2,
+        const ImageFormat format) {
+    NormalizeLut lut;
+    makeNormalizeLut(lut, mean_0, mean_1, mean_2, var_0, var_1, var_2, format);
+    NHWC2NCHW_lut(input, output, n, h, w, lut);
+}
+
+#ifdef CPU_ONLY
+#include "nhwc2nchw.h"
+
+// BUILD_CPU_ONLY has no kernels, device memory is host memory there
+void NHWC2NCHW(
+        const uint8_t* input,
+        float* output,
+        const int n,
+        const int h,
+        const int w,
+        const float mean_0,
+        const float mean_1,
+        const float mean_2,
+        const float var_0,
+        const float var_1,
+        const float var_2,
+        const ImageFormat format) {
+    NHWC2NCHW_cpu(input, output, n, h, w, mean_0, mean_1, mean_2, var_0, var_1, var_2, format);
+}
+
+void NHWC2NCHW_binding(
+        const uint8_t* input,
+        void* output,
+        const int n,
+        const int h,
+        const int w,
+        const NormalizeLut& lut,
+        cudaStream_t) {
+    NHWC2NCHW_lut(input, output, n, h, w, lut);
+}
+#endif  // CPU_ONLY
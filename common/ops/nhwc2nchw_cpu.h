@@ -0,0 +1,99 @@
+/**
+ * Convert input image from nhwc mode to nchw mode on cpu. Every uint8 of a
+ * channel maps to one float, so normalization is a lookup of per-channel
+ * 256-entry tables built once from means/stds/format. On ARM channels are
+ * deinterleaved by NEON and looked up per element. On x86 channels are
+ * deinterleaved in registers and AVX-512(build with -DCPU_AVX512=ON) or
+ * AVX2+FMA(-DCPU_AVX2=ON) compute the table entries directly, bit exact, since
+ * gathers of table values are slower than mul/sub/div at these sizes. Rows of
+ * the batch are split across threads.
+ * Output is in data type of input binding: float, half(F16C/AVX-512 or NEON
+ * conversion) or int8 quantized by scale of binding, see setLutOutput.
+ * 2021/05/24
+ */
+
+#ifndef NHWC2NCHW_CPU_H
+#define NHWC2NCHW_CPU_H
+
+#include <cstdint>
+
+#include "utils.h"
+
+/**
+ * Normalized value of every uint8 per output channel, and input channel each
+ * output channel reads(bgr formats keep channel order, rgb formats swap 0 and 2
+ * as transpose_kernel does).
+ */
+struct NormalizeLut {
+    float values[3][256];
+    int   source[3] = {0, 1, 2};
+    float scale = 1.f;  // values[c][v] = fma(v, scale, -means[c]) / stds[c]
+    float means[3] = {0.f, 0.f, 0.f};
+    float stds[3] = {1.f, 1.f, 1.f};
+    nvinfer1::DataType dtype = nvinfer1::DataType::kFLOAT;  // element type of output
+    float qscale = 1.f;       // value of one int8 step
+    float qstds[3] = {1.f, 1.f, 1.f};  // stds x qscale, int8 is fma(v, scale, -means[c]) / qstds[c] rounded to nearest even
+    uint16_t halves[3][256];  // values as IEEE half, set by setLutOutput
+    int8_t quants[3][256];    // values quantized, set by setLutOutput
+};
+
+/**
+ * Name of instruction set conversion is built with: avx512, avx2, neon or scalar.
+ */
+const char* nhwc2nchwIsa();
+
+void makeNormalizeLut(
+        NormalizeLut& lut,
+        const float mean_0,
+        const float mean_1,
+        const float mean_2,
+        const float var_0,
+        const float var_1,
+        const float var_2,
+        const ImageFormat format);
+
+/**
+ * Data type output of lut is written in: kFLOAT(default), kHALF, or kINT8 with
+ * scale of binding(value = int8 x scale). Other types are written as float.
+ * Tables of lut are rebuilt, so call it after makeNormalizeLut.
+ */
+void setLutOutput(NormalizeLut& lut, nvinfer1::DataType dtype, float scale = 1.f);
+
+/**
+ * Pixels [first, last) of one image by lut, input is nhwc and planes of output
+ * are stride elements apart, elements are of lut.dtype, on calling thread.
+ */
+void normalizePixels(const uint8_t* input, void* output, int stride, int first, int last, const NormalizeLut& lut);
+
+/**
+ * NHWC2NCHW_cpu by a prebuilt lut, n x h rows split into threads parts.
+ * output: elements of lut.dtype.
+ */
+void NHWC2NCHW_lut(
+        const uint8_t* input,
+        void* output,
+        const int n,
+        const int h,
+        const int w,
+        const NormalizeLut& lut,
+        const int threads = 1);
+
+/**
+ * Same as NHWC2NCHW, but input and output are host memory. Builds lut on every
+ * call and runs on calling thread.
+ */
+extern "C" void NHWC2NCHW_cpu(
+        const uint8_t* input,
+        float* output,
+        const int n,
+        const int h,
+        const int w,
+        const float mean_0,
+        const float mean_1,
+        const float mean_2,
+        const float var_0,
+        const float var_1,
+        const float var_2,
+        const ImageFormat format);
+
+#endif  // NHWC2NCHW_CPU_H
@@ -0,0 +1,86 @@
+/**
+ * Threads preprocessing images of a batch in parallel.
+ * 2021/06/07
+ */
+#include "preprocess_pool.h"
+
+#include <algorithm>
+
+PreprocessPool::PreprocessPool(int threads) {
+    for (int i = 1; i < threads; ++i) {
+        mWorkers.emplace_back(&PreprocessPool::work, this);
+    }
+}
+
+PreprocessPool::~PreprocessPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mCond.notify_all();
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+int PreprocessPool::take(Batch* batch) {
+    int index = batch->next++;
+    if (batch->next == batch->count) {
+        mQueue.erase(std::find(mQueue.begin(), mQueue.end(), batch));
+    }
+    return index;
+}
+
+void PreprocessPool::finish(Batch* batch) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        batch->done++;
+    }
+    mDoneCond.notify_all();
+}
+
+void PreprocessPool::Run(int count, const std::function<void(int)>& job) {
+    if (mWorkers.empty() || count <= 1) {
+        for (int i = 0; i < count; ++i) {
+            job(i);
+        }
+        return;
+    }
+    Batch batch;
+    batch.job = &job;
+    batch.count = count;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueue.push_back(&batch);
+    }
+    mCond.notify_all();
+    // calling thread takes jobs of its own batch only, so a run never waits on jobs of another
+    while (true) {
+        int index;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (batch.next == batch.count) break;
+            index = take(&batch);
+        }
+        job(index);
+        finish(&batch);
+    }
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCond.wait(lock, [&batch]() { return batch.done == batch.count; });
+}
+
+void PreprocessPool::work() {
+    while (true) {
+        Batch* batch;
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCond.wait(lock, [this]() { return mStop || !mQueue.empty(); });
+            if (mStop) return;
+            batch = mQueue.front();
+            index = take(batch);
+        }
+        (*batch->job)(index);
+        finish(batch);
+    }
+}
@@ -0,0 +1,60 @@
+/**
+ * Threads preprocessing images of a batch in parallel(resize, packing into
+ * staging, normalization), one job per image. Calling thread runs jobs of its
+ * own batch too, so a pool of n threads has n - 1 workers. One pool serves
+ * all concurrent runs of a task, their batches share a queue.
+ * 2021/06/07
+ */
+
+#ifndef PREPROCESS_POOL_H
+#define PREPROCESS_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PreprocessPool {
+public:
+    /**
+     * threads: including calling thread, 1 runs every job on calling thread.
+     */
+    explicit PreprocessPool(int threads);
+    ~PreprocessPool();
+    PreprocessPool(const PreprocessPool&) = delete;
+    PreprocessPool& operator=(const PreprocessPool&) = delete;
+
+    int Threads() const {
+        return static_cast<int>(mWorkers.size()) + 1;
+    }
+
+    /**
+     * Run job(0), ..., job(count - 1), return after all of them end.
+     */
+    void Run(int count, const std::function<void(int)>& job);
+
+private:
+    struct Batch {
+        const std::function<void(int)>* job;
+        int count;
+        int next = 0;  // next index to take
+        int done = 0;
+    };
+
+    // take next index of batch under lock, drop batch from queue when its last index is taken
+    int take(Batch* batch);
+    void finish(Batch* batch);
+    void work();
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCond;      // queue has jobs or pool stops
+    std::condition_variable mDoneCond;  // a job ended
+    std::deque<Batch*> mQueue;
+    std::vector<std::thread> mWorkers;
+    bool mStop = false;
+};
+
+#endif  // PREPROCESS_POOL_H
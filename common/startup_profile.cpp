@@ -0,0 +1,143 @@
+/**
+ * Cold start breakdown of tasks.
+ * 2021/04/26
+ */
+#include "startup_profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "logger.h"
+#include "yaml-cpp/yaml.h"
+
+void StartupProfile::Add(const std::string& stage, double ms) {
+    for (auto& s : mStages) {
+        if (s.first == stage) {
+            s.second += ms;
+            return;
+        }
+    }
+    mStages.emplace_back(stage, ms);
+}
+
+void StartupProfile::Merge(const StartupProfile& other) {
+    for (const auto& s : other.mStages) {
+        Add(s.first, s.second);
+    }
+}
+
+double StartupProfile::Get(const std::string& stage) const {
+    for (const auto& s : mStages) {
+        if (s.first == stage) return s.second;
+    }
+    return 0.;
+}
+
+double StartupProfile::Total() const {
+    double total = 0.;
+    for (const auto& s : mStages) {
+        total += s.second;
+    }
+    return total;
+}
+
+std::string StartupProfile::ToString() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < mStages.size(); ++i) {
+        out << (i > 0 ? ", " : "") << mStages[i].first << " " << mStages[i].second << " ms";
+    }
+    return out.str();
+}
+
+// stages of all profiles, known stages in order of cold start and then others
+static std::vector<std::string> stageColumns(const std::vector<std::pair<std::string, StartupProfile>>& profiles) {
+    std::vector<std::string> columns = {startup::kConfig, startup::kOnnxCheck, startup::kEngineRead, startup::kDeserialize,
+                                        startup::kBuild, startup::kContext, startup::kBindings, startup::kExecStates,
+                                        startup::kWarmup, startup::kOther};
+    std::vector<bool> used(columns.size(), false);
+    for (const auto& p : profiles) {
+        for (const auto& s : p.second.Stages()) {
+            auto found = std::find(columns.begin(), columns.end(), s.first);
+            if (found == columns.end()) {
+                columns.emplace_back(s.first);
+                used.emplace_back(true);
+            } else {
+                used[found - columns.begin()] = true;
+            }
+        }
+    }
+    std::vector<std::string> result;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (used[i]) result.emplace_back(columns[i]);
+    }
+    return result;
+}
+
+void printStartupReport(const std::vector<std::pair<std::string, StartupProfile>>& profiles) {
+    std::vector<std::string> columns = stageColumns(profiles);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << "Startup breakdown(ms):" << std::endl << std::setw(10) << std::left << "task" << std::right;
+    for (const auto& c : columns) {
+        out << std::setw(std::max<int>(c.size(), 8) + 2) << c;
+    }
+    out << std::setw(10) << "total" << std::endl;
+    for (const auto& p : profiles) {
+        out << std::setw(10) << std::left << p.first << std::right;
+        for (const auto& c : columns) {
+            out << std::setw(std::max<int>(c.size(), 8) + 2) << p.second.Get(c);
+        }
+        out << std::setw(10) << p.second.Total() << std::endl;
+    }
+    std::cout << out.str();
+}
+
+int checkStartupBaseline(const std::string& file,
+                         const std::vector<std::pair<std::string, StartupProfile>>& profiles,
+                         double tolerance,
+                         double min_ms) {
+    logger::Logger log;
+    YAML::Node baseline;
+    try {
+        baseline = YAML::LoadFile(file);
+    } catch (const YAML::Exception&) {
+        YAML::Node node;
+        for (const auto& p : profiles) {
+            for (const auto& s : p.second.Stages()) {
+                node[p.first][s.first] = s.second;
+            }
+            node[p.first]["total"] = p.second.Total();
+        }
+        std::ofstream out(file);
+        out << node << std::endl;
+        log.logger("No startup baseline, write current breakdown as baseline: ", file, logger::LEVEL::WARNING);
+        return 0;
+    }
+
+    int regressions = 0;
+    char message[256];
+    for (const auto& p : profiles) {
+        const YAML::Node& expected = baseline[p.first];
+        if (!expected) {
+            log.logger("Task is not in startup baseline: ", p.first, logger::LEVEL::WARNING);
+            continue;
+        }
+        std::vector<std::pair<std::string, double>> stages = p.second.Stages();
+        stages.emplace_back("total", p.second.Total());
+        for (const auto& s : stages) {
+            if (!expected[s.first]) continue;
+            double base = expected[s.first].as<double>();
+            if (s.second > base * tolerance && s.second - base > min_ms) {
+                snprintf(message, sizeof(message), "%s %s: %.1f ms, baseline %.1f ms", p.first.c_str(), s.first.c_str(), s.second, base);
+                log.logger("Startup regression, ", message, logger::LEVEL::WARNING);
+                ++regressions;
+            }
+        }
+    }
+    return regressions;
+}
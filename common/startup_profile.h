@@ -0,0 +1,94 @@
+/**
+ * Cold start breakdown of tasks. Backends add stages while creating engine,
+ * task adds its own, main reports them per task and compares them with a
+ * baseline file to flag startup regressions.
+ * 2021/04/26
+ */
+
+#ifndef STARTUP_PROFILE_H
+#define STARTUP_PROFILE_H
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Stage names, in order of a cold start.
+ */
+namespace startup {
+const char* const kConfig      = "config";       // yaml parse
+const char* const kOnnxCheck   = "onnx_check";   // read onnx and check it against yaml
+const char* const kEngineRead  = "engine_read";  // open and validate engine file(mapped, page-ins fall into deserialize), or read onnx/replay file
+const char* const kDeserialize = "deserialize";
+const char* const kBuild       = "build";        // build from onnx, TensorRT builder or cpu backend planning
+const char* const kContext     = "context";      // execution context creation
+const char* const kBindings    = "bindings";     // binding allocation
+const char* const kExecStates  = "exec_states";  // streams, inputs and clones of execution pool
+const char* const kWarmup      = "warmup";       // first forward
+const char* const kOther       = "other";        // rest of task constructor
+}  // namespace startup
+
+class StartupProfile {
+public:
+    /**
+     * Add ms to stage, stages keep order of first add.
+     */
+    void Add(const std::string& stage, double ms);
+
+    void Merge(const StartupProfile& other);
+
+    /**
+     * ms of stage, 0 if it never ran.
+     */
+    double Get(const std::string& stage) const;
+
+    double Total() const;
+
+    const std::vector<std::pair<std::string, double>>& Stages() const {
+        return mStages;
+    }
+
+    /**
+     * "stage ms, stage ms, ...".
+     */
+    std::string ToString() const;
+
+private:
+    std::vector<std::pair<std::string, double>> mStages;
+};
+
+/**
+ * Add time from construction to destruction to stage of profile.
+ */
+class StartupStage {
+public:
+    StartupStage(StartupProfile& profile, const char* stage) : mProfile(profile), mStage(stage),
+                                                             mStart(std::chrono::steady_clock::now()) {}
+    ~StartupStage() {
+        mProfile.Add(mStage, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mStart).count());
+    }
+
+private:
+    StartupProfile& mProfile;
+    const char* mStage;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+/**
+ * Print profiles of tasks as a table of stages, one row per task.
+ */
+void printStartupReport(const std::vector<std::pair<std::string, StartupProfile>>& profiles);
+
+/**
+ * Compare stages of tasks with baseline yaml file({task: {stage: ms}}), a stage
+ * regresses if it takes more than tolerance x baseline and min_ms more than
+ * baseline, so sub-millisecond noise is ignored. Baseline is written if file
+ * doesn't exist. Return count of regressed stages.
+ */
+int checkStartupBaseline(const std::string& file,
+                         const std::vector<std::pair<std::string, StartupProfile>>& profiles,
+                         double tolerance,
+                         double min_ms);
+
+#endif  // STARTUP_PROFILE_H
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <vector>
 #include <array>
+#include <cstdint>
 #include <string>
 
 typedef std::vector<std::vector<std::array<float, 5>>> BatchBox;
@@ -25,4 +26,150 @@ struct Bbox{
 	int fea_index;
 };
 
+/**
+ * Resize of a source image to model input, input = source * scale + pad, boxes
+ * on input map back by (x - pad) / scale. Plain resize has pad 0 and scale of
+ * both axes, letterbox has one scale and pads.
+ */
+struct ImageTransform {
+    int src_w = 0;
+    int src_h = 0;
+    int dst_w = 0;
+    int dst_h = 0;
+    float scale_x = 1.f;
+    float scale_y = 1.f;
+    int pad_x = 0;
+    int pad_y = 0;
+    int resized_w = 0;  // size of resized image inside input, from pad_x and pad_y
+    int resized_h = 0;
+    int offset_x = 0;  // origin of roi in caller's image, added after mapping back
+    int offset_y = 0;
+
+    bool identity() const {
+        return src_w == dst_w && src_h == dst_h && pad_x == 0 && pad_y == 0 && offset_x == 0 && offset_y == 0;
+    }
+};
+
+/**
+ * Byte order of pixels of caller's buffers, tasks take 8 bit images only.
+ * kNV12 and kI420 are 4:2:0 yuv of cameras and video decoders: luma plane, then
+ * chroma at half width and height, u and v interleaved(NV12) or in u and v
+ * planes(I420).
+ */
+enum class PixelFormat {
+    kBGR,
+    kRGB,
+    kBGRA,
+    kRGBA,
+    kGray,
+    kNV12,
+    kI420,
+};
+
+// bytes of a pixel, of luma plane for yuv formats
+inline int pixelChannels(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::kBGRA:
+        case PixelFormat::kRGBA: return 4;
+        case PixelFormat::kGray:
+        case PixelFormat::kNV12:
+        case PixelFormat::kI420: return 1;
+        default: return 3;
+    }
+}
+
+inline bool isYuv420(PixelFormat format) {
+    return format == PixelFormat::kNV12 || format == PixelFormat::kI420;
+}
+
+/**
+ * Caller owned image task reads in place(decoder or capture buffers, sub-views),
+ * rows are stride bytes apart. Roi of empty size is whole image, results of
+ * a roi map back to coordinates of whole image. Buffer must outlive run().
+ * Yuv formats have data and stride of luma plane and chroma planes of their
+ * own, roi of them starts at even x and y.
+ */
+struct ImageView {
+    const uint8_t* data = nullptr;
+    int stride = 0;
+    int width = 0;
+    int height = 0;
+    PixelFormat format = PixelFormat::kBGR;
+    int roi_x = 0;
+    int roi_y = 0;
+    int roi_w = 0;
+    int roi_h = 0;
+    const uint8_t* u = nullptr;  // chroma of yuv formats, v = u + 1 for NV12
+    const uint8_t* v = nullptr;
+    int uv_stride = 0;
+    uint64_t frame_id = 0;  // views of one frame share it for FrameCache, 0 is never cached
+
+    ImageView() = default;
+    ImageView(const uint8_t* data, int stride, int width, int height, PixelFormat format = PixelFormat::kBGR)
+        : data(data), stride(stride), width(width), height(height), format(format) {}
+
+    /**
+     * NV12 of separate planes, e.g. a decoder surface, uv plane is
+     * (height + 1) / 2 rows of interleaved u and v.
+     */
+    static ImageView nv12(const uint8_t* y, int y_stride, const uint8_t* uv, int uv_stride, int width, int height) {
+        ImageView view(y, y_stride, width, height, PixelFormat::kNV12);
+        view.u = uv;
+        view.v = uv + 1;
+        view.uv_stride = uv_stride;
+        return view;
+    }
+
+    /**
+     * NV12 of one buffer, uv plane follows height rows of luma at same stride.
+     */
+    static ImageView nv12(const uint8_t* data, int stride, int width, int height) {
+        return nv12(data, stride, data + static_cast<size_t>(stride) * height, stride, width, height);
+    }
+
+    static ImageView i420(const uint8_t* y, int y_stride, const uint8_t* u, const uint8_t* v, int uv_stride,
+                          int width, int height) {
+        ImageView view(y, y_stride, width, height, PixelFormat::kI420);
+        view.u = u;
+        view.v = v;
+        view.uv_stride = uv_stride;
+        return view;
+    }
+
+    /**
+     * I420 of one buffer, u and v planes of stride / 2 follow luma.
+     */
+    static ImageView i420(const uint8_t* data, int stride, int width, int height) {
+        const uint8_t* u = data + static_cast<size_t>(stride) * height;
+        return i420(data, stride, u, u + static_cast<size_t>(stride / 2) * ((height + 1) / 2), stride / 2, width, height);
+    }
+
+    ImageView crop(int x, int y, int w, int h) const {
+        ImageView view = *this;
+        view.roi_x = x;
+        view.roi_y = y;
+        view.roi_w = w;
+        view.roi_h = h;
+        return view;
+    }
+
+    // size of region read
+    int cols() const {
+        return roi_w > 0 ? roi_w : width;
+    }
+
+    int rows() const {
+        return roi_h > 0 ? roi_h : height;
+    }
+
+    // roi inside image, stride holds a row, chroma rows of yuv hold their samples
+    bool valid() const {
+        bool chroma = !isYuv420(format) ||
+                      (u && v && uv_stride >= (width + 1) / 2 * (format == PixelFormat::kNV12 ? 2 : 1) &&
+                       roi_x % 2 == 0 && roi_y % 2 == 0);
+        return data && width > 0 && height > 0 && stride >= width * pixelChannels(format) && roi_x >= 0 && roi_y >= 0 &&
+               roi_w >= 0 && roi_h >= 0 && roi_x + cols() <= width && roi_y + rows() <= height && chroma;
+    }
+};
+
 #endif  // STRUCTS_H
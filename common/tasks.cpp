@@ -6,8 +6,13 @@
 
 #include "tasks.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
 /* -==================Base Task Class================*/
 Task::Task(const YAML::Node& cfg) : cfg(cfg) {
+    auto start = std::chrono::steady_clock::now();
     // init member variables
     mNX_ON         = cfg["engine"]["nx"].as<bool>();
     mGPU_ID        = cfg["engine"]["gpu_id"].as<int>();
@@ -17,10 +22,14 @@ Task::Task(const YAML::Node& cfg) : cfg(cfg) {
     mWorkspaceSize = cfg["engine"]["workspace"].as<int>();
     mOnnxFile      = cfg["engine"]["onnx_file"].as<string>();
     mEngineFile    = cfg["engine"]["engine_file"].as<string>();
-    CUDA_CHECK(cudaStreamCreate(&mStream));
-
-    // create timer
-    mTimer = new Timer(mStream, cfg["misc"]["show_time"].as<bool>());
+    mBackendType   = parseBackendType(cfg["engine"]["backend"] ? cfg["engine"]["backend"].as<string>() : "tensorrt");
+#ifdef CPU_ONLY
+    if (mBackendType == BackendType::kTensorRT) {
+        mLogger.logger("Built without TensorRT(BUILD_CPU_ONLY), run onnx on cpu backend instead.", logger::LEVEL::WARNING);
+        mBackendType = BackendType::kCPU;
+    }
+#endif
+    bool on_device = mBackendType == BackendType::kTensorRT;
 
     // set image format: rgb, rgb255, bgr, bgr255
     int format = cfg["params"]["image_format"].as<int>();
@@ -30,6 +39,15 @@ Task::Task(const YAML::Node& cfg) : cfg(cfg) {
         case (2): mImageFormat = ImageFormat::kBGR; break;
         case (3): mImageFormat = ImageFormat::kBGR255; break;
     }
+    vector<float> means = cfg["params"]["means"].as<vector<float>>();
+    vector<float> stds  = cfg["params"]["stds"].as<vector<float>>();
+    makeNormalizeLut(mInputLut, means[0], means[1], means[2], stds[0], stds[1], stds[2], mImageFormat);
+    mPreprocessThreads = cfg["engine"]["cpu_threads"] ? cfg["engine"]["cpu_threads"].as<int>() : 1;
+    // one thread per image of a batch by default, calling thread is one of them
+    int hardware_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int prep_threads = cfg["engine"]["preprocess_threads"] ? cfg["engine"]["preprocess_threads"].as<int>()
+                                                           : std::min(mBatchSize, hardware_threads);
+    mPrepPool.reset(new PreprocessPool(std::max(1, prep_threads)));
 
     // init Net
     int mode = cfg["engine"]["mode"].as<int>();
@@ -40,94 +58,1049 @@ Task::Task(const YAML::Node& cfg) : cfg(cfg) {
         default  : mRunMode = RunMode::kFP32; break;
     }
 
-    if (!mNX_ON) cudaSetDevice(mGPU_ID);
-    mNet = new RTEngine();
+    if (on_device && !mNX_ON) cudaSetDevice(mGPU_ID);
+    mNet = nullptr;
 
+    mPoolSize = cfg["engine"]["pool_size"] ? cfg["engine"]["pool_size"].as<int>() : 1;
+    mShowTime = cfg["misc"]["show_time"].as<bool>();
+    mPadding  = cfg["params"]["padding"] && cfg["params"]["padding"].as<bool>();
+    mVariantMinScale = cfg["engine"]["variant_min_scale"] ? cfg["engine"]["variant_min_scale"].as<float>() : 1.f;
+    mOutputType  = parseDataType(cfg["engine"]["output_type"] ? cfg["engine"]["output_type"].as<string>() : "float");
+    mOutputRange = cfg["engine"]["output_range"] ? cfg["engine"]["output_range"].as<float>() : 0.f;
+    if (mOutputType == nvinfer1::DataType::kINT8 && mOutputRange <= 0.f) {
+        mLogger.logger("INT8 outputs need `output_range` > 0, keep outputs in float.", logger::LEVEL::WARNING);
+        mOutputType = nvinfer1::DataType::kFLOAT;
+    }
+    mInputType  = parseDataType(cfg["engine"]["input_type"] ? cfg["engine"]["input_type"].as<string>() : "float");
+    mInputRange = cfg["engine"]["input_range"] ? cfg["engine"]["input_range"].as<float>() : 0.f;
+    if (mInputType == nvinfer1::DataType::kINT32 || (mInputType == nvinfer1::DataType::kINT8 && mInputRange <= 0.f)) {
+        mLogger.logger("Input type should be float/half, or int8 with `input_range` > 0, keep input in float.", logger::LEVEL::WARNING);
+        mInputType = nvinfer1::DataType::kFLOAT;
+    }
+    mStartup.Add(startup::kConfig, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
     if (!initEngine()) {
         mLogger.logger("Initialize RT Engine Failed!", logger::LEVEL::ERROR);
     }
 
-    CUDA_CHECK(cudaMalloc((void**)&mInputDataNHWC, mBatchSize * 3 * mModel_W * mModel_H * sizeof(uint8_t)));
+    if (mNet) {
+        mStartup.Merge(mNet->GetStartupProfile());
+        {
+            StartupStage stage(mStartup, startup::kExecStates);
+            mGeneration = makeGeneration(mNet, 0, mModel_W, mModel_H);
+        }
+        initVariants();
+        warmup(cfg["engine"]["warmup_runs"] ? cfg["engine"]["warmup_runs"].as<int>() : 1);
+    }
+    mReady = mGeneration != nullptr;
+#ifndef CPU_ONLY
+    if (mBuildPending) {
+        // cfg is read here, build thread must not look it up while run() does
+        RTEngine* net = new RTEngine();
+        setupRTEngine(net, mOnnxFile, cfg["engine"]["bchw"].as<vector<int>>(),
+                      cfg["engine"]["calib_cache"] ? cfg["engine"]["calib_cache"].as<string>() : "");
+        buildInBackground([this, net]() {
+            if (!mNX_ON) CUDA_CHECK(cudaSetDevice(mGPU_ID));
+            net->CreateEngine(mOnnxFile, mEngineFile, mOutputNames, mBatchSize, mRunMode, mWorkspaceSize);
+            if (net->GetNbBindings() == 0) {
+                delete net;
+                return static_cast<InferBackend*>(nullptr);
+            }
+            return static_cast<InferBackend*>(net);
+        });
+    }
+#endif
 }
 
 Task::~Task() {
-    if (mNet) {
-        delete mNet;
-        mNet = nullptr;
+    // a engine building can't be cancelled, wait for it
+    if (mBuildThread.joinable()) mBuildThread.join();
+    if (!mGeneration) delete mNet;
+    mGeneration.reset();
+    mNet = nullptr;
+    if (mRecorder) {
+        delete mRecorder;
+        mRecorder = nullptr;
     }
-    if (mTimer) {
-        delete mTimer;
-        mTimer = nullptr;
+    if (mReplay) {
+        delete mReplay;
+        mReplay = nullptr;
     }
-    CUDA_CHECK(cudaFree(mInputDataNHWC));
-    CUDA_CHECK(cudaStreamDestroy(mStream));
 }
 
-bool Task::initEngine() {
-    if (mOnnxFile.empty()) {
-        mLogger.logger("ONNX file not specified! Set it in specific yaml file.", logger::LEVEL::ERROR);
+bool Task::setHostForward(const HostEngine::ForwardFn& fn) {
+    if (mBackendType != BackendType::kHost) {
+        mLogger.logger("Host forward is only used by host backend.", logger::LEVEL::WARNING);
+        return false;
+    }
+    vector<std::shared_ptr<ExecGeneration>> generations = mVariants;
+    generations.emplace_back(currentGeneration());
+    for (auto& generation : generations) {
+        for (int i = 0; i < generation->Size(); ++i) {
+            static_cast<HostEngine*>(generation->State(i).net)->SetForward(fn);
+        }
+    }
+    return true;
+}
+
+vector<std::pair<int, int>> Task::inputSizes() const {
+    vector<std::pair<int, int>> sizes;
+    auto current = currentGeneration();
+    if (current) sizes.emplace_back(current->InputW(), current->InputH());
+    for (const auto& variant : mVariants) {
+        sizes.emplace_back(variant->InputW(), variant->InputH());
+    }
+    return sizes;
+}
+
+std::pair<int, int> Task::inputSizeFor(const vector<Mat>& imgs) const {
+    auto generation = selectGeneration(imgs);
+    return std::make_pair(generation->InputW(), generation->InputH());
+}
+
+std::shared_ptr<ExecGeneration> Task::makeGeneration(InferBackend* net, int id, int width, int height) {
+    size_t input_size = mBatchSize * 3 * width * height * sizeof(uint8_t);
+    if (mPoolSize > 1) mLogger.logger("Execution states share one engine: ", mPoolSize);
+    auto generation = std::make_shared<ExecGeneration>(net, mPoolSize, input_size, width, height, mShowTime, id);
+    // inputs are written in type of binding, engines swapped in may differ from current one
+    nvinfer1::DataType input_type = net->GetBindingDataType(0);
+    if (input_type == nvinfer1::DataType::kINT32) {
+        mLogger.logger("INT32 input binding is not supported, input is written as float.", logger::LEVEL::ERROR);
     }
-    if (mEngineFile.empty()) {
-        mLogger.logger("Engine file not specified! Set it in specific yaml file.", logger::LEVEL::ERROR);
+    NormalizeLut lut = mInputLut;
+    setLutOutput(lut, input_type, net->GetBindingScale(0));
+    for (int i = 0; i < generation->Size(); ++i) {
+        generation->State(i).inputLut = lut;
     }
-    mNet->SetDevice(mGPU_ID);
-    mNet->CreateEngine(mOnnxFile, mEngineFile, mOutputNames, mBatchSize, mRunMode, mWorkspaceSize);
+    if (lut.dtype == nvinfer1::DataType::kHALF) {
+        mLogger.logger("Input binding in: ", "half");
+    } else if (lut.dtype == nvinfer1::DataType::kINT8) {
+        mLogger.logger("Input binding in: ", "int8, scale: " + std::to_string(lut.qscale));
+    }
+    return generation;
+}
+
+std::shared_ptr<ExecGeneration> Task::currentGeneration() const {
+    return std::atomic_load(&mGeneration);
+}
+
+ExecPool::Lease Task::acquireState() {
+    ExecPool::Lease state = currentGeneration()->Acquire();
+    // current device is per thread, caller may not be thread created task
+    if (state->net->IsDeviceMemory() && !mNX_ON) CUDA_CHECK(cudaSetDevice(mGPU_ID));
+    return state;
+}
+
+ExecPool::Lease Task::acquireState(int index) {
+    ExecPool::Lease state = currentGeneration()->Acquire(index);
+    if (state->net->IsDeviceMemory() && !mNX_ON) CUDA_CHECK(cudaSetDevice(mGPU_ID));
+    return state;
+}
+
+ExecPool::Lease Task::acquireState(const vector<Mat>& imgs) {
+    ExecPool::Lease state = selectGeneration(imgs)->Acquire();
+    if (state->net->IsDeviceMemory() && !mNX_ON) CUDA_CHECK(cudaSetDevice(mGPU_ID));
+    return state;
+}
+
+ExecPool::Lease Task::acquireState(const vector<ImageView>& views) {
+    ExecPool::Lease state = selectGeneration(views)->Acquire();
+    if (state->net->IsDeviceMemory() && !mNX_ON) CUDA_CHECK(cudaSetDevice(mGPU_ID));
+    return state;
+}
+
+std::shared_ptr<ExecGeneration> Task::selectGeneration(const vector<Mat>& imgs) const {
+    return selectGeneration(imageViews(imgs));
+}
+
+std::shared_ptr<ExecGeneration> Task::selectGeneration(const vector<ImageView>& views) const {
+    auto current = currentGeneration();
+    if (mVariants.empty() || views.empty()) return current;
+    // one engine runs whole batch, so it must fit the largest image
+    int src_w = 1;
+    int src_h = 1;
+    for (const auto& view : views) {
+        src_w = std::max(src_w, view.cols());
+        src_h = std::max(src_h, view.rows());
+    }
+    auto area = [](const std::shared_ptr<ExecGeneration>& g) {
+        return static_cast<long>(g->InputW()) * g->InputH();
+    };
+    std::shared_ptr<ExecGeneration> best;
+    std::shared_ptr<ExecGeneration> largest = current;
+    auto consider = [&](const std::shared_ptr<ExecGeneration>& g) {
+        float scale = std::min(static_cast<float>(g->InputW()) / src_w, static_cast<float>(g->InputH()) / src_h);
+        if (scale >= mVariantMinScale && (!best || area(g) < area(best))) best = g;
+        if (area(g) > area(largest)) largest = g;
+    };
+    consider(current);
+    for (const auto& variant : mVariants) {
+        consider(variant);
+    }
+    return best ? best : largest;
+}
+
+// same binding names, directions and max batch, so output index and post process fit both
+static bool bindingsMatch(const InferBackend* net, const InferBackend* other) {
+    bool match = net->GetNbBindings() == other->GetNbBindings() && net->GetMaxBatchSize() == other->GetMaxBatchSize();
+    for (int i = 0; match && i < net->GetNbBindings(); ++i) {
+        match = net->mBindingName[i] == other->mBindingName[i] && net->BindingIsInput(i) == other->BindingIsInput(i);
+    }
+    return match;
+}
 
+void Task::initVariants() {
+    const YAML::Node& variants = cfg["engine"]["variants"];
+    if (!variants || variants.size() == 0) return;
+    if (mReplay) {
+        mLogger.logger("Replayed frames are of `bchw` engine, skip variants.", logger::LEVEL::WARNING);
+        return;
+    }
+    for (const auto& variant : variants) {
+        InferBackend* net = createVariant(variant);
+        if (net == nullptr) continue;
+        mStartup.Merge(net->GetStartupProfile());
+        vector<int> hw = variant["hw"].as<vector<int>>();
+        StartupStage stage(mStartup, startup::kExecStates);
+        mVariants.emplace_back(makeGeneration(net, 0, hw[1], hw[0]));
+        mLogger.logger("Engine variant of input size(w x h): ", hw[1], "x" + std::to_string(hw[0]));
+    }
+}
+
+InferBackend* Task::createVariant(const YAML::Node& variant) {
+    if (!variant["hw"] || variant["hw"].size() != 2) {
+        mLogger.logger("Variant needs `hw: [height, width]`, skip it.", logger::LEVEL::ERROR);
+        return nullptr;
+    }
+    vector<int> hw = variant["hw"].as<vector<int>>();
+    vector<int> bchw = {mBatchSize, 3, hw[0], hw[1]};
+    string onnx_file = variant["onnx_file"] ? variant["onnx_file"].as<string>() : "";
+    string engine_file = variant["engine_file"] ? variant["engine_file"].as<string>() : "";
+    InferBackend* net = nullptr;
+    if (mBackendType == BackendType::kHost) {
+        vector<HostBinding> bindings = parseHostBindings(variant["host_bindings"]);
+        if (bindings.empty()) {
+            mLogger.logger("Host backend needs `host_bindings` in variant, skip it.", logger::LEVEL::ERROR);
+            return nullptr;
+        }
+        net = new HostEngine(bindings);
+    } else if (!checkOnnx(onnx_file, bchw)) {
+        return nullptr;
+    } else if (mBackendType == BackendType::kCPU) {
+        CpuEngine* cpu = new CpuEngine();
+        cpu->SetInputShape(bchw);
+        cpu->SetThreads(cfg["engine"]["cpu_threads"] ? cfg["engine"]["cpu_threads"].as<int>() : 1);
+        net = cpu;
+    } else {
+#ifndef CPU_ONLY
+        RTEngine* rt = new RTEngine();
+        setupRTEngine(rt, onnx_file, bchw, variant["calib_cache"] ? variant["calib_cache"].as<string>() : "");
+        rt->SetDevice(mGPU_ID);
+        net = rt;
+#endif
+    }
+    if (net == nullptr) return nullptr;
+    net->CreateEngine(onnx_file, engine_file, mOutputNames, mBatchSize, mRunMode, mWorkspaceSize);
+    if (net->GetNbBindings() == 0 || !bindingsMatch(net, mNet)) {
+        mLogger.logger("Engine of variant failed or its bindings mismatch `bchw` engine, skip it: ", onnx_file, logger::LEVEL::ERROR);
+        delete net;
+        return nullptr;
+    }
+    return net;
+}
+
+void Task::declareScratch(MemoryPlanner& planner, const string& owner, int first, int last) {
+    vector<std::shared_ptr<ExecGeneration>> generations = mVariants;
+    generations.insert(generations.begin(), currentGeneration());
+    for (const auto& generation : generations) {
+        for (int i = 0; i < generation->Size(); ++i) {
+            ExecState& state = generation->State(i);
+            ScratchRequest request;
+            request.owner  = owner;
+            request.first  = first;
+            request.last   = last;
+            request.device = state.net->IsDeviceMemory() ? mGPU_ID : kHostArena;
+            string suffix  = std::to_string(state.inputW) + "x" + std::to_string(state.inputH) + "#" + std::to_string(i);
+            ScratchIds ids = {generation, i, -1, -1};
+            request.name = "in" + suffix;
+            request.size = state.inputSize;
+            ids.input = planner.Add(request);
+            request.size = workspaceSize(state);
+            if (request.size > 0) {
+                request.name = "post" + suffix;
+                ids.workspace = planner.Add(request);
+            }
+            mScratch.emplace_back(ids);
+        }
+    }
+}
+
+void Task::bindScratch(const MemoryPlanner& planner) {
+    for (const auto& ids : mScratch) {
+        uint8_t* input = static_cast<uint8_t*>(planner.Ptr(ids.input));
+        if (input == nullptr) continue;
+        ExecGeneration& generation = *ids.generation;
+        generation.BindInput(ids.index, input);
+        if (ids.workspace >= 0) {
+            ExecState& state = generation.State(ids.index);
+            // scratch created by warm up holds its own buffers, it's created again on workspace
+            state.extra.reset();
+            state.workspace = planner.Ptr(ids.workspace);
+            state.workspaceSize = planner.Request(ids.workspace).size;
+        }
+    }
+    mScratch.clear();
+}
+
+BindingView Task::outputBinding(const InferBackend* net, int index) {
+    BindingView binding;
+    binding.ptr       = net->GetBindingPtr(index);
+    binding.dtype     = net->GetBindingDataType(index);
+    binding.scale     = net->GetBindingScale(index);
+    binding.on_device = net->IsDeviceMemory();
+    return binding;
+}
+
+void Task::mapToSource(BatchBox& boxes, const vector<ImageTransform>& transforms) {
+    for (size_t b = 0; b < boxes.size() && b < transforms.size(); ++b) {
+        const ImageTransform& t = transforms[b];
+        if (t.identity()) continue;
+        float max_x = static_cast<float>(t.src_w);
+        float max_y = static_cast<float>(t.src_h);
+        for (auto& box : boxes[b]) {
+            box[0] = std::min(std::max((box[0] - t.pad_x) / t.scale_x, 0.f), max_x) + t.offset_x;
+            box[1] = std::min(std::max((box[1] - t.pad_y) / t.scale_y, 0.f), max_y) + t.offset_y;
+            box[2] = std::min(std::max((box[2] - t.pad_x) / t.scale_x, 0.f), max_x) + t.offset_x;
+            box[3] = std::min(std::max((box[3] - t.pad_y) / t.scale_y, 0.f), max_y) + t.offset_y;
+        }
+    }
+}
+
+bool Task::swapEngine(InferBackend* net) {
+    auto current = currentGeneration();
+    if (!bindingsMatch(net, current->Net())) {
+        mLogger.logger("Bindings of new engine mismatch current one, skip swap.", logger::LEVEL::ERROR);
+        delete net;
+        return false;
+    }
+    if (mRecorder) net->SetRecorder(mRecorder);
+    auto generation = makeGeneration(net, current->Id() + 1, current->InputW(), current->InputH());
+    std::atomic_store(&mGeneration, generation);
+    mLogger.logger("Swap in engine generation: ", generation->Id());
     return true;
 }
 
-bool Task::prepareInputs(const vector<Mat>& imgs) {
-    int img_stride = 3 * mModel_W * mModel_H;
-    for (int i = 0; i < mBatchSize; ++i) {
-        CUDA_CHECK(cudaMemcpy(mInputDataNHWC + i * img_stride, imgs[i].data, img_stride * sizeof(uint8_t), cudaMemcpyHostToDevice));
+void Task::buildInBackground(const EngineBuilder& builder) {
+    if (mBuildThread.joinable()) mBuildThread.join();
+    mBuildThread = std::thread([this, builder]() {
+        InferBackend* net = builder();
+        if (net == nullptr) {
+            mLogger.logger("Background build of engine failed, keep current engine.", logger::LEVEL::ERROR);
+            return;
+        }
+        swapEngine(net);
+    });
+}
+
+void Task::warmup(int runs) {
+    // replayed frames must stay aligned with run() calls
+    if (runs <= 0 || mReplay) return;
+    StartupStage stage(mStartup, startup::kWarmup);
+    vector<std::shared_ptr<ExecGeneration>> generations = mVariants;
+    generations.emplace_back(currentGeneration());
+    for (auto& generation : generations) {
+        for (int i = 0; i < generation->Size(); ++i) {
+            InferBackend* net = generation->State(i).net;
+            TensorRecorder* recorder = net->GetRecorder();
+            net->SetRecorder(nullptr);
+            for (int r = 0; r < runs; ++r) {
+                net->Forward();
+            }
+            net->SetRecorder(recorder);
+        }
+    }
+}
+
+int Task::engineGeneration() const {
+    auto generation = currentGeneration();
+    return generation ? generation->Id() : 0;
+}
+
+#ifndef CPU_ONLY
+bool Task::initEngineInBackground(RTEngine* net) {
+    if (!cfg["engine"]["background_build"] || !cfg["engine"]["background_build"].as<bool>()) {
+        return false;
+    }
+    EngineArtifactHeader expected = makeArtifactHeader(mOnnxFile, mRunMode, cfg["engine"]["bchw"].as<vector<int>>(), mWorkspaceSize, false,
+                                                       static_cast<int32_t>(mOutputType), mOutputRange,
+                                                       static_cast<int32_t>(mInputType), mInputRange);
+    EngineArtifactHeader found;
+    bool exists = readArtifactHeader(mEngineFile, found);
+    if (exists && sameArtifactParams(found, expected)) {
+        return false;  // up to date, or only onnx changed which is checked by CreateEngine
+    }
+    string serving = exists ? mEngineFile : "";
+    string fallback = cfg["engine"]["fallback_engine"] ? cfg["engine"]["fallback_engine"].as<string>() : "";
+    if (serving.empty()) serving = fallback;
+    if (serving.empty() || !net->LoadEngine(serving)) {
+        return false;
+    }
+    mLogger.logger("Serve with engine: ", serving, ", engine_file is building in background", logger::LEVEL::WARNING);
+    mBuildPending = true;
+    return true;
+}
+#endif
+
+bool Task::initEngine() {
+    if (mBackendType == BackendType::kHost) {
+        vector<HostBinding> bindings = parseHostBindings(cfg["engine"]["host_bindings"]);
+        string replay_file = cfg["engine"]["replay_file"] ? cfg["engine"]["replay_file"].as<string>() : "";
+        if (!replay_file.empty()) {
+            StartupStage stage(mStartup, startup::kEngineRead);
+            mReplay = new TensorReplay();
+            if (!mReplay->Open(replay_file)) {
+                return false;
+            }
+            // bindings of recorded engine, so output_index in yaml is still valid
+            if (bindings.empty()) bindings = mReplay->GetBindings();
+        }
+        if (bindings.empty()) {
+            mLogger.logger("Host backend needs `host_bindings` or `replay_file` in engine config!", logger::LEVEL::ERROR);
+            return false;
+        }
+        HostEngine* net = new HostEngine(bindings);
+        if (mReplay) net->SetForward(mReplay->MakeForward());
+        mNet = net;
+        mNet->CreateEngine(mOnnxFile, mEngineFile, mOutputNames, mBatchSize, mRunMode, mWorkspaceSize);
+    } else if (mBackendType == BackendType::kCPU) {
+        if (!checkOnnx(mOnnxFile, cfg["engine"]["bchw"].as<vector<int>>())) {
+            return false;
+        }
+        CpuEngine* net = new CpuEngine();
+        net->SetInputShape(cfg["engine"]["bchw"].as<vector<int>>());
+        net->SetThreads(cfg["engine"]["cpu_threads"] ? cfg["engine"]["cpu_threads"].as<int>() : 1);
+        net->CreateEngine(mOnnxFile, mEngineFile, mOutputNames, mBatchSize, mRunMode, mWorkspaceSize);
+        if (net->GetNbBindings() == 0) {
+            delete net;
+            return false;
+        }
+        mNet = net;
+    } else {
+#ifdef CPU_ONLY
+        mLogger.logger("TensorRT backend is not built(BUILD_CPU_ONLY)!", logger::LEVEL::ERROR);
+        return false;
+#else
+        RTEngine* net = new RTEngine();
+        setupRTEngine(net, mOnnxFile, cfg["engine"]["bchw"].as<vector<int>>(), cfg["engine"]["calib_cache"] ? cfg["engine"]["calib_cache"].as<string>() : "");
+        mNet = net;
+        if (mOnnxFile.empty()) {
+            mLogger.logger("ONNX file not specified! Set it in specific yaml file.", logger::LEVEL::ERROR);
+        }
+        if (mEngineFile.empty()) {
+            mLogger.logger("Engine file not specified! Set it in specific yaml file.", logger::LEVEL::ERROR);
+        }
+        mNet->SetDevice(mGPU_ID);
+        if (!checkOnnx(mOnnxFile, cfg["engine"]["bchw"].as<vector<int>>())) {
+            // no engine to make execution states on
+            delete mNet;
+            mNet = nullptr;
+            return false;
+        }
+        if (!initEngineInBackground(net)) {
+            mNet->CreateEngine(mOnnxFile, mEngineFile, mOutputNames, mBatchSize, mRunMode, mWorkspaceSize);
+        }
+        if (mNet->GetNbBindings() == 0) {
+            delete mNet;
+            mNet = nullptr;
+            mBuildPending = false;
+            return false;
+        }
+#endif
+    }
+
+    string record_file = cfg["engine"]["record_file"] ? cfg["engine"]["record_file"].as<string>() : "";
+    if (!record_file.empty()) {
+        mRecorder = new TensorRecorder();
+        if (mRecorder->Open(record_file, *mNet)) {
+            mNet->SetRecorder(mRecorder);
+        }
+    }
+    return true;
+}
+
+bool Task::checkOnnx(const string& onnx_file, const vector<int>& bchw) {
+    StartupStage stage(mStartup, startup::kOnnxCheck);
+    OnnxModelInfo info;
+    auto start = std::chrono::steady_clock::now();
+    if (!readOnnxInfo(onnx_file, info)) {
+        mLogger.logger("Can't read onnx, skip checking it: ", onnx_file, logger::LEVEL::WARNING);
+        return true;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    mLogger.logger("Read onnx in ms: ", ms, ", opset: " + std::to_string(info.opset));
+    vector<string> output_names;
+    for (const auto& input : info.inputs) {
+        mLogger.logger("ONNX input: ", input.name, dimsString(input.dims));
+    }
+    for (const auto& output : info.outputs) {
+        mLogger.logger("ONNX output: ", output.name, dimsString(output.dims));
+        output_names.emplace_back(output.name);
+    }
+
+    if (info.inputs.empty()) {
+        mLogger.logger("Onnx has no input other than initializers: ", onnx_file, logger::LEVEL::ERROR);
+        return false;
+    }
+    bool ok = true;
+    const vector<int64_t>& dims = info.inputs[0].dims;
+    if (dims.size() != 4) {
+        mLogger.logger("Input of onnx is not nchw: ", dimsString(dims), logger::LEVEL::ERROR);
+        ok = false;
+    }
+    for (size_t i = 0; ok && i < 4; ++i) {
+        // symbolic dims take value of bchw
+        if (dims[i] >= 0 && dims[i] != bchw[i]) {
+            mLogger.logger("bchw mismatch input of onnx, onnx: ", dimsString(dims), logger::LEVEL::ERROR);
+            ok = false;
+        }
+    }
+
+    // outputs are bound after inputs in order of onnx
+    int nb_inputs = static_cast<int>(info.inputs.size());
+    vector<int> index;
+    if (cfg["params"]["output_names"]) {
+        if (!matchNames(output_names, cfg["params"]["output_names"].as<vector<string>>(), nb_inputs, index)) {
+            mLogger.logger("Some pattern of output_names matches no output of onnx", logger::LEVEL::ERROR);
+            ok = false;
+        }
+    } else if (cfg["params"]["output_index"]) {
+        for (int i : cfg["params"]["output_index"].as<vector<int>>()) {
+            if (i < nb_inputs || i >= nb_inputs + static_cast<int>(output_names.size())) {
+                mLogger.logger("output_index is not an output of onnx: ", i, logger::LEVEL::ERROR);
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+bool Task::initOutputIndex(int count) {
+    // engine may be swapped already, bindings of every generation match
+    auto generation = currentGeneration();
+    if (!generation) return false;
+    const InferBackend* net = generation->Net();
+    vector<string> names;
+    vector<int> bindings;
+    for (int i = 0; i < net->GetNbBindings(); ++i) {
+        if (net->BindingIsInput(i)) continue;
+        names.emplace_back(net->mBindingName[i]);
+        bindings.emplace_back(i);
+    }
+    mOutputIndex.clear();
+    if (cfg["params"]["output_names"]) {
+        vector<int> matched;
+        if (!matchNames(names, cfg["params"]["output_names"].as<vector<string>>(), 0, matched)) {
+            mLogger.logger("Some pattern of output_names matches no output binding", logger::LEVEL::ERROR);
+        }
+        for (int i : matched) {
+            mOutputIndex.emplace_back(bindings[i]);
+        }
+    } else if (cfg["params"]["output_index"]) {
+        mOutputIndex = cfg["params"]["output_index"].as<vector<int>>();
+    } else {
+        mOutputIndex = bindings;
     }
-    // debug code
-//    cout << "imgs[i].data " << (float)imgs[0].data[0] << " "<< (float)imgs[0].data[1] << " "<< (float)imgs[0].data[2]<<endl;
+    if (count > 0 && static_cast<int>(mOutputIndex.size()) != count) {
+        // post process would decode other tensors than it expects
+        mLogger.logger("Count of outputs for post process mismatch, expect: ", count, ", got: " + std::to_string(mOutputIndex.size()), logger::LEVEL::ERROR);
+        mOutputIndex.clear();
+        mReady = false;
+        return false;
+    }
+    for (size_t i = 0; i < mOutputIndex.size(); ++i) {
+        mLogger.logger("Output for post process: ", i, net->mBindingName[mOutputIndex[i]]);
+    }
+    return true;
+}
+
+#ifndef CPU_ONLY
+void Task::setupRTEngine(RTEngine* net, const string& onnx_file, const vector<int>& bchw, const string& calib_cache) {
+    net->SetArtifactSpec(bchw, cfg["engine"]["cache_dir"] ? cfg["engine"]["cache_dir"].as<string>() : "");
+    net->SetProfileCount(mPoolSize);
+    net->SetOutputType(mOutputType, mOutputRange);
+    net->SetInputType(mInputType, mInputRange);
+    const YAML::Node& engine = cfg["engine"];
+    string calib_dir = engine["calib_dir"] ? engine["calib_dir"].as<string>() : "";
+    if (calib_dir.empty()) return;
+    // yaml is read now, factory may run on build thread of engine
     vector<float> means = cfg["params"]["means"].as<vector<float>>();
     vector<float> stds  = cfg["params"]["stds"].as<vector<float>>();
+    int batches = engine["calib_batches"] ? engine["calib_batches"].as<int>() : 0;
+    int threads = engine["calib_threads"] ? engine["calib_threads"].as<int>() : 4;
+    CalibAlgorithm algo = parseCalibAlgorithm(engine["calib_algo"] ? engine["calib_algo"].as<string>() : "entropy");
+    ImageFormat format = mImageFormat;
+    bool padding = mPadding;
+    // images are decoded only if engine is built in int8 mode
+    net->SetInt8Calibrator([=]() -> nvinfer1::IInt8Calibrator* {
+        int width = bchw[3];
+        int height = bchw[2];
+        std::unique_ptr<CalibBatchStream> stream(new CalibBatchStream(
+                calib_dir, bchw, means, stds, format,
+                [=](const Mat& img) { return resizeImage(img, width, height, padding); },
+                batches, threads));
+        if (stream->NbBatches() == 0) return nullptr;
+        uint64_t model_key = makeArtifactHeader(onnx_file, RunMode::kINT8, bchw, 0, true).key;
+        return createInt8Calibrator(algo, std::move(stream), calib_cache, model_key);
+    });
+}
+#endif
+
+Mat Task::resizeImage(const Mat& img, int width, int height, bool padding, ImageTransform* transform) {
+    ImageTransform t = letterboxTransform(img.cols, img.rows, width, height, padding);
+    if (transform) *transform = t;
+    if (t.identity()) return img;
+    cv::Mat resized(height, width, CV_8UC3);
+    resizeInto(img, resized, padding);
+    return resized;
+}
+
+ImageTransform Task::resizeInto(const Mat& img, Mat& dst, bool padding) {
+    ImageTransform t = letterboxTransform(img.cols, img.rows, dst.cols, dst.rows, padding);
+    if (t.identity()) {
+        img.copyTo(dst);
+        return t;
+    }
+    resizeRegion(img, dst, t);
+    return t;
+}
 
-    NHWC2NCHW(
-            mInputDataNHWC,
-            (float*)mNet->GetBindingPtr(0),
-            mBatchSize,
-            mModel_H,
-            mModel_W,
-            means[0], means[1], means[2],
-            stds[0], stds[1], stds[2],
-            mImageFormat);
-    // debug code
-//    uint8_t* cls_f = (uint8_t*)malloc(320*320*3*sizeof(uint8_t));
-//    cudaMemcpy(cls_f, mInputDataNHWC, 320*320*3*sizeof(uint8_t), cudaMemcpyDeviceToHost);
-//    cout << "* GetBindingPtr" << (unsigned)cls_f[144450] << " " <<(unsigned) (cls_f[144451]) << " "<<(unsigned) (cls_f[144452]) <<endl;
+void Task::resizeRegion(const Mat& img, Mat& dst, const ImageTransform& t) {
+    // views of dst, resize and border write in place
+    Mat resized(dst, cv::Rect(t.pad_x, t.pad_y, t.resized_w, t.resized_h));
+    cv::resize(img, resized, resized.size());
+    const cv::Scalar border(114, 114, 114);
+    int bottom = t.pad_y + t.resized_h;
+    int right  = t.pad_x + t.resized_w;
+    if (t.pad_y > 0) Mat(dst, cv::Rect(0, 0, dst.cols, t.pad_y)).setTo(border);
+    if (bottom < dst.rows) Mat(dst, cv::Rect(0, bottom, dst.cols, dst.rows - bottom)).setTo(border);
+    if (t.pad_x > 0) Mat(dst, cv::Rect(0, t.pad_y, t.pad_x, t.resized_h)).setTo(border);
+    if (right < dst.cols) Mat(dst, cv::Rect(right, t.pad_y, dst.cols - right, t.resized_h)).setTo(border);
+}
+
+Mat Task::viewImage(const ImageView& view) {
+    int channels = pixelChannels(view.format);
+    uint8_t* origin = const_cast<uint8_t*>(view.data) + view.roi_y * view.stride + view.roi_x * channels;
+    return Mat(view.rows(), view.cols(), CV_8UC(channels), origin, view.stride);
+}
+
+YuvImage Task::yuvImage(const ImageView& view) {
+    YuvImage yuv;
+    yuv.y = view.data + view.roi_y * view.stride + view.roi_x;
+    yuv.y_step = view.stride;
+    yuv.uv_pixel = view.format == PixelFormat::kNV12 ? 2 : 1;
+    // roi starts at even x and y, so at a chroma sample
+    size_t chroma = static_cast<size_t>(view.roi_y / 2) * view.uv_stride + view.roi_x / 2 * yuv.uv_pixel;
+    yuv.u = view.u + chroma;
+    yuv.v = view.v + chroma;
+    yuv.uv_step = view.uv_stride;
+    return yuv;
+}
+
+vector<ImageView> Task::imageViews(const vector<Mat>& imgs) {
+    vector<ImageView> views;
+    views.reserve(imgs.size());
+    for (const auto& img : imgs) {
+        views.emplace_back(img.data, static_cast<int>(img.step[0]), img.cols, img.rows);
+    }
+    return views;
+}
+
+ImageTransform Task::resizeView(const ImageView& view, Mat& dst, bool padding) {
+    Mat img = viewImage(view);
+    ImageTransform t;
+    switch (view.format) {
+        case PixelFormat::kNV12:
+        case PixelFormat::kI420:
+            t = letterboxTransform(img.cols, img.rows, dst.cols, dst.rows, padding);
+            letterboxYuv_cpu(yuvImage(view), t, dst.data, static_cast<int>(dst.step[0]));
+            break;
+        case PixelFormat::kBGR:
+            t = resizeInto(img, dst, padding);
+            break;
+        case PixelFormat::kRGB:
+            // swapped in place after resize, border is gray so it's the same either way
+            t = resizeInto(img, dst, padding);
+            cv::cvtColor(dst, dst, cv::COLOR_RGB2BGR);
+            break;
+        default: {
+            int code = view.format == PixelFormat::kBGRA ? cv::COLOR_BGRA2BGR
+                     : view.format == PixelFormat::kRGBA ? cv::COLOR_RGBA2BGR
+                                                         : cv::COLOR_GRAY2BGR;
+            // no 4 or 1 channel resize into 3 channel slot, at input size convert straight into it
+            if (img.cols == dst.cols && img.rows == dst.rows) {
+                cv::cvtColor(img, dst, code);
+                t = letterboxTransform(img.cols, img.rows, dst.cols, dst.rows, padding);
+            } else {
+                Mat bgr;
+                cv::cvtColor(img, bgr, code);
+                t = resizeInto(bgr, dst, padding);
+            }
+        }
+    }
+    t.offset_x = view.roi_x;
+    t.offset_y = view.roi_y;
+    return t;
+}
+
+static float elapsedMs(std::chrono::steady_clock::time_point& start) {
+    auto now = std::chrono::steady_clock::now();
+    float ms = std::chrono::duration<float, std::milli>(now - start).count();
+    start = now;
+    return ms;
+}
+
+bool Task::checkViews(const vector<ImageView>& views) {
+    int batch = static_cast<int>(views.size());
+    if (batch == 0 || batch > mBatchSize) {
+        mLogger.logger("Count of images should be in [1, max batch], got: ", batch, logger::LEVEL::ERROR);
+        return false;
+    }
+    for (const auto& view : views) {
+        if (!view.valid()) {
+            mLogger.logger("Image view is empty or roi is out of image, stride: ", view.stride, logger::LEVEL::ERROR);
+            return false;
+        }
+    }
+    return true;
+}
+
+vector<ImageView> Task::inputViews(const vector<Mat>& imgs) {
+    vector<ImageView> views = imageViews(imgs);
+    for (size_t i = 0; i < imgs.size(); ++i) {
+        if (imgs[i].empty() || imgs[i].type() != CV_8UC3) {
+            mLogger.logger("Images should be 8 bit bgr.", logger::LEVEL::ERROR);
+            views[i] = ImageView();
+        }
+    }
+    return views;
+}
+
+// bgr image of a level or resized entry, entry outlives it
+static Mat entryImage(const FrameCache::EntryPtr& entry) {
+    return Mat(entry->height, entry->width, CV_8UC3, const_cast<uint8_t*>(entry->bytes.data()));
+}
+
+Mat Task::pyramidLevel(const ImageView& view, int width, int height, FrameCache::EntryPtr& hold) {
+    if (!mFrameCache || !mFrameCache->Pyramid() || view.frame_id == 0) return Mat();
+    int level = 0;
+    while ((view.cols() >> (level + 1)) >= width && (view.rows() >> (level + 1)) >= height) ++level;
+    // deepest level built so far, levels below it are not needed again
+    int k = level;
+    for (; k > 0; --k) {
+        hold = mFrameCache->Find(FrameCache::Key(view, FrameCache::kLevel, view.cols() >> k, view.rows() >> k));
+        if (hold) break;
+    }
+    Mat src = k > 0 ? entryImage(hold) : Mat();
+    for (++k; k <= level; ++k) {
+        auto start = std::chrono::steady_clock::now();
+        auto entry = std::make_shared<FrameCache::Entry>();
+        entry->width = view.cols() >> k;
+        entry->height = view.rows() >> k;
+        entry->bytes.resize(static_cast<size_t>(entry->width) * entry->height * 3);
+        Mat dst = entryImage(entry);
+        // bilinear to half size is 2x2 average, roi of any format converts to bgr once at first level
+        if (k == 1) {
+            resizeView(view, dst, false);
+        } else {
+            resizeInto(src, dst, false);
+        }
+        entry->cost_ms = elapsedMs(start);
+        hold = mFrameCache->Insert(FrameCache::Key(view, FrameCache::kLevel, entry->width, entry->height), entry);
+        src = entryImage(hold);
+    }
+    return src;
+}
+
+ImageTransform Task::resizeCached(const ImageView& view, Mat& dst, bool padding) {
+    if (!mFrameCache || view.frame_id == 0) return resizeView(view, dst, padding);
+    FrameKey key = FrameCache::Key(view, FrameCache::kResized, dst.cols, dst.rows, padding);
+    size_t bytes = static_cast<size_t>(dst.cols) * dst.rows * 3;
+    if (FrameCache::EntryPtr entry = mFrameCache->Find(key)) {
+        memcpy(dst.data, entry->bytes.data(), bytes);
+        return entry->transform;
+    }
+    auto start = std::chrono::steady_clock::now();
+    ImageTransform t = letterboxTransform(view.cols(), view.rows(), dst.cols, dst.rows, padding);
+    FrameCache::EntryPtr hold;
+    Mat level = pyramidLevel(view, t.resized_w, t.resized_h, hold);
+    if (level.empty()) {
+        t = resizeView(view, dst, padding);
+    } else {
+        // transform stays that of roi, only pixels come from the level
+        resizeRegion(level, dst, t);
+        t.offset_x = view.roi_x;
+        t.offset_y = view.roi_y;
+    }
+    auto entry = std::make_shared<FrameCache::Entry>();
+    entry->bytes.assign(dst.data, dst.data + bytes);
+    entry->width = dst.cols;
+    entry->height = dst.rows;
+    entry->transform = t;
+    entry->cost_ms = elapsedMs(start);
+    mFrameCache->Insert(key, entry);
+    return t;
+}
+
+bool Task::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    for (const auto& img : imgs) {
+        if (img.empty() || img.type() != CV_8UC3) {
+            mLogger.logger("Images should be 8 bit bgr.", logger::LEVEL::ERROR);
+            return false;
+        }
+    }
+    return prepareViews(state, imageViews(imgs));
+}
+
+bool Task::prepareViews(ExecState& state, const vector<ImageView>& views) {
+    if (!checkViews(views)) return false;
+    int batch = static_cast<int>(views.size());
+    bool on_device = state.net->IsDeviceMemory();
+    uint8_t* input = static_cast<uint8_t*>(state.net->GetBindingPtr(0));
+    size_t input_stride = 3 * state.inputW * state.inputH * getElementSize(state.inputLut.dtype);
+    state.transforms.resize(batch);
+    int convert_threads = std::max(1, mPreprocessThreads / batch);
+    uint64_t lut_key = mFrameCache ? FrameCache::LutKey(state.inputLut) : 0;
+    vector<FrameKey> input_keys(batch);
+    // normalized input another task of same size and normalization made of this frame
+    auto cached = [&](int i) {
+        return mFrameCache && views[i].frame_id != 0 && !on_device;
+    };
+    auto insert = [&](int i, float ms) {
+        if (!cached(i)) return;
+        auto entry = std::make_shared<FrameCache::Entry>();
+        entry->bytes.assign(input + i * input_stride, input + (i + 1) * input_stride);
+        entry->transform = state.transforms[i];
+        entry->cost_ms = ms;
+        mFrameCache->Insert(input_keys[i], entry);
+    };
+    // images not at input size of engine of state are resized, results map back by transforms
+    return stageInputs(state, batch, [&](int i, Mat& slot, uint8_t* binding) {
+        auto job_start = std::chrono::steady_clock::now();
+        if (cached(i)) {
+            input_keys[i] = FrameCache::Key(views[i], FrameCache::kInput, state.inputW, state.inputH, mPadding, lut_key);
+            if (FrameCache::EntryPtr entry = mFrameCache->Find(input_keys[i])) {
+                memcpy(binding, entry->bytes.data(), input_stride);
+                state.transforms[i] = entry->transform;
+                return false;
+            }
+        }
+        if (!on_device && isYuv420(views[i].format)) {
+            // no bgr slot, conversion of yuv is part of resize pass
+            ImageTransform& t = state.transforms[i];
+            t = letterboxTransform(views[i].cols(), views[i].rows(), state.inputW, state.inputH, mPadding);
+            t.offset_x = views[i].roi_x;
+            t.offset_y = views[i].roi_y;
+            letterboxNormalizeYuv_cpu(yuvImage(views[i]), t, binding, state.inputLut, 114, convert_threads);
+            insert(i, elapsedMs(job_start));
+            return false;
+        }
+        state.transforms[i] = resizeCached(views[i], slot, mPadding);
+        return true;
+    }, insert);
+}
+
+bool Task::stageInputs(ExecState& state, int batch, const StageFill& fill, const StageDone& staged) {
+    size_t img_stride = 3 * state.inputW * state.inputH;
+    bool on_device = state.net->IsDeviceMemory();
+    auto start = std::chrono::steady_clock::now();
+    float resize_ms = 0.f, upload_ms = 0.f, convert_ms = 0.f;
+    // host backends pack into staging buffer itself, device ones into pinned host staging
+    if (on_device && state.hostInputSize < img_stride * batch) {
+        if (state.hostInput) CUDA_CHECK(cudaFreeHost(state.hostInput));
+        CUDA_CHECK(cudaMallocHost((void**)&state.hostInput, img_stride * mBatchSize));
+        state.hostInputSize = img_stride * mBatchSize;
+    }
+    uint8_t* staging = on_device ? state.hostInput : state.inputNHWC;
+    uint8_t* input = static_cast<uint8_t*>(state.net->GetBindingPtr(0));
+    size_t input_stride = img_stride * getElementSize(state.inputLut.dtype);
+    state.net->SetBatchSize(batch);
+    // on host resize and convert of an image are one job, stages are those of slowest image
+    int convert_threads = std::max(1, mPreprocessThreads / batch);
+    vector<float> resize_times(batch), convert_times(batch);
+    mPrepPool->Run(batch, [&](int i) {
+        auto job_start = std::chrono::steady_clock::now();
+        uint8_t* binding = input + i * input_stride;
+        Mat slot(state.inputH, state.inputW, CV_8UC3, staging + i * img_stride);
+        bool filled = fill(i, slot, binding);
+        resize_times[i] = elapsedMs(job_start);
+        if (!filled || on_device) return;
+        NHWC2NCHW_lut(slot.data, binding, 1, state.inputH, state.inputW, state.inputLut, convert_threads);
+        convert_times[i] = elapsedMs(job_start);
+        if (staged) staged(i, resize_times[i] + convert_times[i]);
+    });
+    resize_ms = *std::max_element(resize_times.begin(), resize_times.end());
+    if (!on_device) {
+        convert_ms = *std::max_element(convert_times.begin(), convert_times.end());
+        state.timer->addDataStages(resize_ms, 0.f, convert_ms);
+        return true;
+    }
+    elapsedMs(start);
+    // upload and convert are ordered before forward on stream of state, synced only to time them
+    CUDA_CHECK(cudaMemcpyAsync(state.inputNHWC, staging, img_stride * batch, cudaMemcpyHostToDevice, state.stream));
+    if (state.timer->showTime()) {
+        CUDA_CHECK(cudaStreamSynchronize(state.stream));
+        upload_ms = elapsedMs(start);
+    }
+    NHWC2NCHW_binding(state.inputNHWC, input, batch, state.inputH, state.inputW, state.inputLut, state.stream);
+    if (state.timer->showTime()) {
+        CUDA_CHECK(cudaStreamSynchronize(state.stream));
+        convert_ms = elapsedMs(start);
+    }
+    state.timer->addDataStages(resize_ms, upload_ms, convert_ms);
+    return true;
+}
+
+bool Task::prepareFused(ExecState& state, const vector<ImageView>& views) {
+    if (!checkViews(views)) return false;
+    int batch = static_cast<int>(views.size());
+    for (const auto& view : views) {
+        if (pixelChannels(view.format) != 3) return Task::prepareViews(state, views);
+    }
+    bool on_device = state.net->IsDeviceMemory();
+    auto start = std::chrono::steady_clock::now();
+    state.net->SetBatchSize(batch);
+    state.transforms.resize(batch);
+    for (int i = 0; i < batch; ++i) {
+        ImageTransform& t = state.transforms[i];
+        t = letterboxTransform(views[i].cols(), views[i].rows(), state.inputW, state.inputH, mPadding);
+        t.offset_x = views[i].roi_x;
+        t.offset_y = views[i].roi_y;
+    }
+    // source of kernel is roi or a pyramid level of frame cache, geometry is transform from it
+    vector<Mat> imgs(batch);
+    vector<ImageTransform> geometry(batch);
+    vector<FrameCache::EntryPtr> levels(batch);
+    auto selectSource = [&](int i) {
+        geometry[i] = state.transforms[i];
+        imgs[i] = pyramidLevel(views[i], geometry[i].resized_w, geometry[i].resized_h, levels[i]);
+        if (imgs[i].empty()) {
+            imgs[i] = viewImage(views[i]);
+        } else {
+            geometry[i].src_w = imgs[i].cols;
+            geometry[i].src_h = imgs[i].rows;
+        }
+    };
+    // rgb views read channels of lut swapped, levels are bgr
+    NormalizeLut swapped = state.inputLut;
+    std::swap(swapped.source[0], swapped.source[2]);
+    auto lutOf = [&](int i) -> const NormalizeLut& {
+        return views[i].format == PixelFormat::kRGB && !levels[i] ? swapped : state.inputLut;
+    };
+    uint8_t* input = static_cast<uint8_t*>(state.net->GetBindingPtr(0));
+    size_t plane = 3 * state.inputW * state.inputH * getElementSize(state.inputLut.dtype);
+    if (!on_device) {
+        int threads = std::max(1, mPreprocessThreads / batch);
+        uint64_t lut_key = mFrameCache ? FrameCache::LutKey(state.inputLut) : 0;
+        mPrepPool->Run(batch, [&](int i) {
+            auto job_start = std::chrono::steady_clock::now();
+            bool cached = mFrameCache && views[i].frame_id != 0;
+            FrameKey input_key;
+            if (cached) {
+                input_key = FrameCache::Key(views[i], FrameCache::kInput, state.inputW, state.inputH, mPadding, lut_key);
+                if (FrameCache::EntryPtr entry = mFrameCache->Find(input_key)) {
+                    memcpy(input + i * plane, entry->bytes.data(), plane);
+                    return;
+                }
+            }
+            selectSource(i);
+            letterboxNormalize_cpu(imgs[i].data, static_cast<int>(imgs[i].step[0]), geometry[i], input + i * plane,
+                                   lutOf(i), 114, threads);
+            if (cached) {
+                auto entry = std::make_shared<FrameCache::Entry>();
+                entry->bytes.assign(input + i * plane, input + (i + 1) * plane);
+                entry->transform = state.transforms[i];
+                entry->cost_ms = elapsedMs(job_start);
+                mFrameCache->Insert(input_key, entry);
+            }
+        });
+        // resize, border and convert are one pass, all of it counts as resize
+        state.timer->addDataStages(elapsedMs(start), 0.f, 0.f);
+        return true;
+    }
+    // a level uploads fewer bytes than its roi
+    size_t total = 0;
+    vector<size_t> offsets(batch);
+    for (int i = 0; i < batch; ++i) {
+        selectSource(i);
+        offsets[i] = total;
+        total += imgs[i].cols * imgs[i].rows * 3;
+    }
+    if (state.sourceSize < total) {
+        if (state.source) CUDA_CHECK(cudaFree(state.source));
+        CUDA_CHECK(cudaMalloc((void**)&state.source, total));
+        state.sourceSize = total;
+    }
+    if (state.hostInputSize < total) {
+        if (state.hostInput) CUDA_CHECK(cudaFreeHost(state.hostInput));
+        CUDA_CHECK(cudaMallocHost((void**)&state.hostInput, total));
+        state.hostInputSize = total;
+    }
+    // source images packed at their own size, uploaded with one copy
+    mPrepPool->Run(batch, [&](int i) {
+        Mat packed(imgs[i].rows, imgs[i].cols, CV_8UC3, state.hostInput + offsets[i]);
+        imgs[i].copyTo(packed);
+    });
+    float pack_ms = elapsedMs(start);
+    float upload_ms = 0.f, convert_ms = 0.f;
+    CUDA_CHECK(cudaMemcpyAsync(state.source, state.hostInput, total, cudaMemcpyHostToDevice, state.stream));
+    if (state.timer->showTime()) {
+        CUDA_CHECK(cudaStreamSynchronize(state.stream));
+        upload_ms = elapsedMs(start);
+    }
+    for (int i = 0; i < batch; ++i) {
+        letterboxNormalize(state.source + offsets[i], imgs[i].cols * 3, geometry[i], input + i * plane, lutOf(i), 114,
+                           state.stream);
+    }
+    if (state.timer->showTime()) {
+        CUDA_CHECK(cudaStreamSynchronize(state.stream));
+        convert_ms = elapsedMs(start);
+    }
+    state.timer->addDataStages(pack_ms, upload_ms, convert_ms);
     return true;
 }
 
 /* -==================Classification Task Class================*/
 ClassificationTask::ClassificationTask(const YAML::Node& cfg) : Task(cfg) {}
 
-bool ClassificationTask::prepareInputs(const vector<Mat>& imgs) {
-    return Task::prepareInputs(imgs);
+bool ClassificationTask::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return Task::prepareInputs(state, imgs);
 }
 
 vector<int> ClassificationTask::run(const vector<Mat>& imgs) {
-    mTimer->dataStart();
-    if (!prepareInputs(imgs)) {
+    return run(inputViews(imgs));
+}
+
+vector<int> ClassificationTask::run(const vector<ImageView>& views) {
+    ExecPool::Lease state = acquireState(views);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareViews(*state, views)) {
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("Data  time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Post  time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("Data  time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Data  stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+        mLogger.logger("Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Post  time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
     return results;
@@ -136,29 +1109,36 @@ vector<int> ClassificationTask::run(const vector<Mat>& imgs) {
 /* -==================Detection Task Class================*/
 DetectionTask::DetectionTask(const YAML::Node& cfg) : Task(cfg) {}
 
-bool DetectionTask::prepareInputs(const vector<Mat>& imgs) {
-    return Task::prepareInputs(imgs);
+bool DetectionTask::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return Task::prepareInputs(state, imgs);
 }
 
 BatchBox DetectionTask::run(const vector<Mat>& imgs) {
-    mTimer->dataStart();
-    if (!prepareInputs(imgs)) {
+    return run(inputViews(imgs));
+}
+
+BatchBox DetectionTask::run(const vector<ImageView>& views) {
+    ExecPool::Lease state = acquireState(views);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareViews(*state, views)) {
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("Data  time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Post  time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("Data  time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Data  stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+        mLogger.logger("Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Post  time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
     return results;
@@ -167,29 +1147,36 @@ BatchBox DetectionTask::run(const vector<Mat>& imgs) {
 /* -==================Track Task Class================*/
 TrackTask::TrackTask(const YAML::Node& cfg) : Task(cfg) {}
 
-bool TrackTask::prepareInputs(const vector<Mat>& imgs) {
-    return Task::prepareInputs(imgs);
+bool TrackTask::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return Task::prepareInputs(state, imgs);
+}
+
+TrackRes TrackTask::run(const vector<Mat>& imgs) {
+    return run(inputViews(imgs));
 }
 
-TrackRes TrackTask::run(const vector<Mat>& imgs){
-    mTimer->dataStart();
-    if (!prepareInputs(imgs)) {
+TrackRes TrackTask::run(const vector<ImageView>& views){
+    ExecPool::Lease state = acquireState(views);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareViews(*state, views)) {
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("Data  time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Post  time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("Data  time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Data  stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+        mLogger.logger("Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Post  time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
     return results;
@@ -198,29 +1185,36 @@ TrackRes TrackTask::run(const vector<Mat>& imgs){
 /* -==================Segmentation Task Class================*/
 SegmentationTask::SegmentationTask(const YAML::Node& cfg) : Task(cfg) {}
 
-bool SegmentationTask::prepareInputs(const vector<Mat>& imgs) {
-    return Task::prepareInputs(imgs);
+bool SegmentationTask::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return Task::prepareInputs(state, imgs);
 }
 
 vector<Mat> SegmentationTask::run(const vector<Mat>& imgs) {
-    mTimer->dataStart();
-    if (!prepareInputs(imgs)) {
+    return run(inputViews(imgs));
+}
+
+vector<Mat> SegmentationTask::run(const vector<ImageView>& views) {
+    ExecPool::Lease state = acquireState(views);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareViews(*state, views)) {
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("Data  time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Post  time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("Data  time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Data  stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+        mLogger.logger("Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Post  time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
     return results;
@@ -229,29 +1223,36 @@ vector<Mat> SegmentationTask::run(const vector<Mat>& imgs) {
 /* -==================Keypoint Task Class================*/
 KeypointTask::KeypointTask(const YAML::Node& cfg) : Task(cfg) {}
 
-bool KeypointTask::prepareInputs(const vector<Mat>& imgs) {
-    return Task::prepareInputs(imgs);
+bool KeypointTask::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return Task::prepareInputs(state, imgs);
 }
 
 vector<int> KeypointTask::run(const vector<Mat>& imgs) {
-    mTimer->dataStart();
-    if (!prepareInputs(imgs)) {
+    return run(inputViews(imgs));
+}
+
+vector<int> KeypointTask::run(const vector<ImageView>& views) {
+    ExecPool::Lease state = acquireState(views);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareViews(*state, views)) {
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("Data  time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Post  time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("Data  time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Data  stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+        mLogger.logger("Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Post  time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
     return results;
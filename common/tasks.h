@@ -9,18 +9,37 @@
 #ifndef TASKS_H
 #define TASKS_H
 
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <thread>
 #include <vector>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "backend.h"
+#include "binding_convert.h"
+#include "cpu_engine.h"
+#ifndef CPU_ONLY
+#include "calibrator.h"
 #include "engine.h"
+#endif
+#include "exec_pool.h"
+#include "frame_cache.h"
+#include "host_engine.h"
+#include "letterbox.h"
+#include "memory_planner.h"
+#include "onnx_info.h"
+#include "preprocess_pool.h"
+#include "startup_profile.h"
 #include "structs.h"
+#include "tensor_record.h"
 #include "logger.h"
 #include "timer.h"
 #include "utils.h"
 #include "nhwc2nchw.h"
+#include "nhwc2nchw_cpu.h"
 #include "yaml-cpp/yaml.h"
 
 using namespace std;
@@ -33,22 +52,283 @@ public:
     Task(const YAML::Node& cfg);
     virtual ~Task();
 
+    /**
+    ! setHostForward: set forward callable of host backend, return false if task
+    !                 is not running on host backend.
+    */
+    bool setHostForward(const HostEngine::ForwardFn& fn);
+
+    /**
+    ! Build a initialized backend, called on background thread.
+    */
+    typedef std::function<InferBackend*()> EngineBuilder;
+
+    /**
+    ! Hot swap of engine.
+    ! swapEngine: create execution states on net and swap them in atomically, task owns
+    !             net then. Runs in flight finish on old states, which are freed after
+    !             last of them. Bindings of net must match current engine.
+    ! buildInBackground: call builder on background thread and swap its result in, task
+    !                    keeps serving with current engine meanwhile.
+    ! engineGeneration: count of engines swapped in, 0 for engine created by task.
+    */
+    bool swapEngine(InferBackend* net);
+    void buildInBackground(const EngineBuilder& builder);
+    int engineGeneration() const;
+
+    /**
+    ! False if engine or outputs of post process failed in constructor, errors are
+    ! logged, run() must not be called then.
+    */
+    bool ready() const {
+        return mReady;
+    }
+
+    /**
+    ! Cold start breakdown of task constructor: onnx check, stages of backend creating
+    ! engine, execution states and warm up forwards.
+    */
+    const StartupProfile& startupProfile() const {
+        return mStartup;
+    }
+
+    /**
+    ! Input sizes(width, height) of engines of task, the `bchw` one first and then
+    ! `variants` in yaml order.
+    */
+    vector<std::pair<int, int>> inputSizes() const;
+
+    /**
+    ! Input size(width, height) of engine run() selects for images.
+    */
+    std::pair<int, int> inputSizeFor(const vector<Mat>& imgs) const;
+
+    /**
+    ! Resize image to width x height, with padding it keeps aspect ratio and pads
+    ! borders with 114(letterbox). transform receives the mapping of image to
+    ! resized one if it's not null.
+    */
+    static Mat resizeImage(const Mat& img, int width, int height, bool padding, ImageTransform* transform = nullptr);
+
+    /**
+    ! Same as resizeImage, into dst of input size(e.g. a slot of staging buffer)
+    ! instead of a new Mat. Return the transform.
+    */
+    static ImageTransform resizeInto(const Mat& img, Mat& dst, bool padding);
+
+    /**
+    ! Caller owned buffers as task input, see ImageView.
+    ! viewImage: header Mat of roi of view over its buffer, nothing is copied. Type
+    !            is by channels of pixel format, luma plane of yuv formats.
+    ! yuvImage: planes of roi of a NV12 or I420 view.
+    ! imageViews: bgr views of images, rows step[0] apart, sub-views work as is.
+    ! resizeView: resizeInto from view, bgr order in dst whatever format of view is.
+    !             Yuv views are converted and resized in one pass, border of 114 with
+    !             padding as resizeInto. Transform has origin of roi.
+    */
+    static Mat viewImage(const ImageView& view);
+    static YuvImage yuvImage(const ImageView& view);
+    static vector<ImageView> imageViews(const vector<Mat>& imgs);
+    static ImageTransform resizeView(const ImageView& view, Mat& dst, bool padding);
+
+    /**
+    ! Scratch buffers shared across tasks, see memory_planner.h.
+    ! declareScratch: declare staging buffer and post process scratch of every execution
+    !                 state(of current engine and variants) as owner, live in steps
+    !                 [first, last] of execution order of tasks.
+    ! bindScratch: move states to their buffers in arenas of planner, call it after
+    !              planner allocated arenas and before runs, planner must outlive task.
+    !              Engines swapped in later allocate their own buffers.
+    */
+    void declareScratch(MemoryPlanner& planner, const string& owner, int first, int last);
+    void bindScratch(const MemoryPlanner& planner);
+
+    /**
+    ! Share preprocessing of frames with other tasks running on them, see frame_cache.h.
+    ! Views with a frame_id look up normalized inputs, resized images and pyramid levels
+    ! of their frame before doing the work, and add what they computed. Cache must
+    ! outlive task, nullptr turns it off. Mats passed to run() have no frame id.
+    */
+    void setFrameCache(FrameCache* cache) {
+        mFrameCache = cache;
+    }
+
 protected:
     /**
     ! Base task provided two basic method.
-    ! initEngine: call api in tensorrt.h to build a engine.
+    ! initEngine: create backend selected by `engine: backend` and build a engine.
     ! prepareInputs: take vector of cv::Mat as task's input, do pre-process in it.
+    ! Images are resized straight into one staging buffer and converted in parallel
+    ! on preprocess pool, device backends upload the whole batch with one copy.
     */
     virtual bool initEngine();
-    virtual bool prepareInputs(const vector<Mat>& imgs);
+    virtual bool prepareInputs(ExecState& state, const vector<Mat>& imgs);
+
+    /**
+    ! prepareViews: pre-process of caller owned buffers, read in place. prepareInputs
+    !               passes views of its Mats here, override it to change pre-process
+    !               of both. On host backends yuv views are converted, resized and
+    !               normalized straight into input binding in one pass.
+    */
+    virtual bool prepareViews(ExecState& state, const vector<ImageView>& views);
+
+    /**
+    ! Same inputs as prepareViews in one pass per image: resize into letterbox region,
+    ! border, channel order and normalization written straight to input binding, no
+    ! resized or padded Mat and no staging. Device backends copy source images at their
+    ! own size. Transforms of images are set in state.transforms for decoding. Views
+    ! of 4 or 1 channel and yuv views take Task::prepareViews path.
+    */
+    bool prepareFused(ExecState& state, const vector<ImageView>& views);
+
+    /**
+    ! Staging, upload and convert of prepareViews for any image source, sets batch of net.
+    ! fill(i, slot, binding): in a job of preprocess pool, write bgr image i into slot of
+    !                        input size in staging and return true, or on host backends
+    !                        write normalized binding of it straight and return false.
+    ! Filled slots are normalized into binding in same job on host backends, device
+    ! backends upload staging with one copy and convert it on stream of state.
+    ! staged(i, ms): on host backends after slot i is normalized, ms of its job.
+    */
+    typedef std::function<bool(int, Mat&, uint8_t*)> StageFill;
+    typedef std::function<void(int, float)> StageDone;
+    bool stageInputs(ExecState& state, int batch, const StageFill& fill, const StageDone& staged = nullptr);
+
+    /**
+    ! Check count of views against max batch and every view against its buffer.
+    ! inputViews: imageViews of task input, images not 8 bit bgr are logged and get an
+    !             empty view, so run of views fails them as run of Mats did.
+    */
+    bool checkViews(const vector<ImageView>& views);
+    vector<ImageView> inputViews(const vector<Mat>& imgs);
+
+    /**
+    ! Frame cache of views with frame_id, no cache or frame id work as without it.
+    ! resizeRegion: resize img into region of transform in dst, border of 114 around it.
+    ! pyramidLevel: smallest pyramid level of roi of view still covering width x height,
+    !               bgr, levels are built from previous one and cached. Empty Mat if roi
+    !               itself is smallest or pyramid is off, hold keeps level alive.
+    ! resizeCached: resizeView through resized images and pyramid levels of cache, dst
+    !               is continuous.
+    */
+    static void resizeRegion(const Mat& img, Mat& dst, const ImageTransform& t);
+    Mat pyramidLevel(const ImageView& view, int width, int height, FrameCache::EntryPtr& hold);
+    ImageTransform resizeCached(const ImageView& view, Mat& dst, bool padding);
+
+    /**
+    ! Execution states, run() of task is reentrant by checking out one for every call.
+    ! makeGeneration: create `engine: pool_size` states on net, first one uses net and
+    !                 others use clones of it, engine is loaded only once.
+    ! currentGeneration: states of current engine.
+    ! acquireState: check out a free state or state of index, block while it's busy.
+    !               With images, state is checked out from the engine selected for
+    !               them, see selectGeneration.
+    */
+    std::shared_ptr<ExecGeneration> makeGeneration(InferBackend* net, int id, int width, int height);
+    std::shared_ptr<ExecGeneration> currentGeneration() const;
+    ExecPool::Lease acquireState();
+    ExecPool::Lease acquireState(int index);
+    ExecPool::Lease acquireState(const vector<Mat>& imgs);
+    ExecPool::Lease acquireState(const vector<ImageView>& views);
+
+    /**
+    ! Engines at other input sizes, `engine: variants` in yaml.
+    ! initVariants: create an engine and execution states for every variant, a variant
+    !               failing to load or with bindings mismatching the `bchw` engine is
+    !               skipped with an error.
+    ! createVariant: create a engine of variant on backend of task.
+    ! selectGeneration: smallest engine whose letterbox scale of largest image is at
+    !                   least `variant_min_scale`(1 means no upscale), or largest
+    !                   engine if none is.
+    */
+    void initVariants();
+    InferBackend* createVariant(const YAML::Node& variant);
+    std::shared_ptr<ExecGeneration> selectGeneration(const vector<Mat>& imgs) const;
+    std::shared_ptr<ExecGeneration> selectGeneration(const vector<ImageView>& views) const;
+
+    /**
+    ! Map boxes of every image from model input back to source image by transforms
+    ! set in prepareInputs, and clip them to source image.
+    */
+    static void mapToSource(BatchBox& boxes, const vector<ImageTransform>& transforms);
+
+    /**
+    ! Binding of net for decoding with copyBindingToHost, in whatever data type
+    ! the engine outputs it(`engine: output_type`).
+    */
+    static BindingView outputBinding(const InferBackend* net, int index);
+
+#ifndef CPU_ONLY
+    /**
+    ! Build engine_file on background thread while serving with engine_file of
+    ! other params(e.g. fp32 build before switching to fp16) or `fallback_engine`,
+    ! return false if engine_file is up to date or there is nothing to serve with.
+    */
+    bool initEngineInBackground(RTEngine* net);
+
+    /**
+    ! Params of engine artifact and int8 calibrator of `calib_dir` from yaml.
+    */
+    void setupRTEngine(RTEngine* net, const string& onnx_file, const vector<int>& bchw, const string& calib_cache);
+#endif
+
+    /**
+    ! Check onnx against yaml before building engine: bchw of input, `output_names`
+    ! patterns and range of `output_index`. Return false on mismatch, true if it's
+    ! fine or onnx is not deployed.
+    */
+    bool checkOnnx(const string& onnx_file, const vector<int>& bchw);
+
+    /**
+    ! Binding index of outputs used by post process, in order of `output_names`
+    ! glob patterns matched against binding names, or `output_index`, or all outputs
+    ! in binding order if neither is set.
+    ! count: outputs expected by post process, 0 for any. Return false and task is
+    ! not ready if bindings matched are not count.
+    */
+    bool initOutputIndex(int count);
+
+    /**
+    ! Forward every execution state `engine: warmup_runs` times, so lazy initialization
+    ! of backend is not paid by first run(). Warm up forwards are not recorded.
+    */
+    void warmup(int runs);
+
+    /**
+    ! Bytes of post process scratch of state, which task takes from state.workspace if
+    ! it's planned instead of allocating it. 0 if task has none.
+    */
+    virtual size_t workspaceSize(const ExecState& state) const {
+        UNUSED(state);
+        return 0;
+    }
 
 protected:
-    RTEngine*      mNet;
-    cudaStream_t   mStream;
+    InferBackend*  mNet = nullptr;  // backend of first generation until it's made, then use currentGeneration()->Net()
+    BackendType    mBackendType;
+    TensorRecorder* mRecorder = nullptr;
+    TensorReplay*   mReplay   = nullptr;
+    std::shared_ptr<ExecGeneration> mGeneration;  // read and swapped by std::atomic_load/store
+    vector<std::shared_ptr<ExecGeneration>> mVariants;  // engines at other input sizes, never swapped
+    float          mVariantMinScale = 1.f;
+    nvinfer1::DataType mOutputType = nvinfer1::DataType::kFLOAT;  // `output_type` of tensorrt engines
+    float          mOutputRange = 0.f;
+    nvinfer1::DataType mInputType = nvinfer1::DataType::kFLOAT;  // `input_type` of tensorrt engines
+    float          mInputRange = 0.f;
+    bool           mPadding = false;
+    std::thread    mBuildThread;
+    bool           mBuildPending = false;
+    bool           mReady = false;          // see ready(), set in constructors only
+    int            mPoolSize = 1;
+    bool           mShowTime = false;       // `misc: show_time`, read once as generations are made on build thread too
     RunMode        mRunMode;
     ImageFormat    mImageFormat;
-    Timer*         mTimer;
+    NormalizeLut   mInputLut;               // means/stds/format of params in float, states take it in type of their input binding
+    int            mPreprocessThreads = 1;  // `cpu_threads`, threads normalizing images of host backends
+    std::unique_ptr<PreprocessPool> mPrepPool;  // `preprocess_threads`, images of a batch in parallel
+    FrameCache*    mFrameCache = nullptr;   // caller owned, see setFrameCache
     logger::Logger mLogger;
+    StartupProfile mStartup;
 
     YAML::Node cfg;
 
@@ -60,8 +340,17 @@ protected:
     long mWorkspaceSize;
     string mOnnxFile;
     string mEngineFile;
-    uint8_t* mInputDataNHWC;
     vector<string> mOutputNames {};
+    vector<int> mOutputIndex;  // binding index of outputs for post process, see initOutputIndex
+
+    // planned buffers of a state, id of planner, -1 if not declared
+    struct ScratchIds {
+        std::shared_ptr<ExecGeneration> generation;
+        int index;
+        int input;
+        int workspace;
+    };
+    vector<ScratchIds> mScratch;
 };
 
 /* -==================Classification Task Class================*/
@@ -71,8 +360,10 @@ public:
     /**
     ! Instance inteface.
     ! run: run all pipeline of task: prepare inputs, inference, process outputs, recommend override it.
+    ! With views, images are read in place from caller's buffers, see ImageView.
     */
     virtual vector<int> run(const vector<Mat>& imgs);
+    virtual vector<int> run(const vector<ImageView>& views);
 
 protected:
     /**
@@ -82,8 +373,8 @@ protected:
     */
     ClassificationTask(const YAML::Node& cfg);
     virtual ~ClassificationTask() = default;
-    virtual bool prepareInputs(const vector<Mat>& imgs) override;
-    virtual vector<int> processOutputs() {};
+    virtual bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    virtual vector<int> processOutputs(ExecState& state) {};
 };
 /* -==================Detection Task Class================*/
 class DetectionTask : public Task
@@ -92,8 +383,10 @@ public:
     /**
     ! Instance inteface.
     ! run: run all pipeline of task: prepare inputs, inference, process outputs, recommend override it.
+    ! With views, images are read in place from caller's buffers, see ImageView.
     */
     virtual BatchBox run(const vector<Mat>& imgs);
+    virtual BatchBox run(const vector<ImageView>& views);
 
 protected:
     /**
@@ -103,8 +396,8 @@ protected:
     */
     DetectionTask(const YAML::Node& cfg);
     virtual ~DetectionTask() = default;
-    virtual bool prepareInputs(const vector<Mat>& imgs) override;
-    virtual BatchBox processOutputs() {};
+    virtual bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    virtual BatchBox processOutputs(ExecState& state) {};
 };
 
 /* -==================Track Task Class================*/
@@ -114,8 +407,10 @@ public:
     /**
     ! Instance inteface.
     ! run: run all pipeline of task: prepare inputs, inference, process outputs, recommend override it.
+    ! With views, images are read in place from caller's buffers, see ImageView.
     */
     virtual TrackRes run(const vector<Mat>& imgs);
+    virtual TrackRes run(const vector<ImageView>& views);
 
 protected:
     /**
@@ -125,8 +420,8 @@ protected:
     */
     TrackTask(const YAML::Node& cfg);
     virtual ~TrackTask() = default;
-    virtual bool prepareInputs(const vector<Mat>& imgs) override;
-    virtual TrackRes processOutputs() {};
+    virtual bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    virtual TrackRes processOutputs(ExecState& state) {};
 };
 
 /* -==================Segmentation Task Class================*/
@@ -136,8 +431,10 @@ public:
     /**
     ! Instance inteface.
     ! run: run all pipeline of task: prepare inputs, inference, process outputs, recommend override it.
+    ! With views, images are read in place from caller's buffers, see ImageView.
     */
     virtual vector<Mat> run(const vector<Mat>& imgs);
+    virtual vector<Mat> run(const vector<ImageView>& views);
 
 protected:
     /**
@@ -147,8 +444,8 @@ protected:
     */
     SegmentationTask(const YAML::Node& cfg);
     virtual ~SegmentationTask() = default;
-    virtual bool prepareInputs(const vector<Mat>& imgs) override;
-    virtual vector<Mat> processOutputs() {};
+    virtual bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    virtual vector<Mat> processOutputs(ExecState& state) {};
 };
 
 /* -==================Keypoint Task Class================*/
@@ -158,8 +455,10 @@ public:
     /**
     ! Instance inteface.
     ! run: run all pipeline of task: prepare inputs, inference, process outputs, recommend override it.
+    ! With views, images are read in place from caller's buffers, see ImageView.
     */
     virtual vector<int> run(const vector<Mat>& imgs);
+    virtual vector<int> run(const vector<ImageView>& views);
 
 protected:
     /**
@@ -169,8 +468,8 @@ protected:
     */
     KeypointTask(const YAML::Node& cfg);
     virtual ~KeypointTask() = default;
-    virtual bool prepareInputs(const vector<Mat>& imgs) override;
-    virtual vector<int> processOutputs() {};
+    virtual bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    virtual vector<int> processOutputs(ExecState& state) {};
 };
 
 #endif  // TASKS_H
@@ -0,0 +1,180 @@
+/**
+ * Record and replay output bindings of engine.
+ * 2021/02/08
+ */
+#include "tensor_record.h"
+
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static inline uint64_t alignUp(uint64_t size) {
+    return (size + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN;
+}
+
+/* -==================Recorder================*/
+TensorRecorder::~TensorRecorder() {
+    Close();
+}
+
+bool TensorRecorder::Open(const std::string& file, const InferBackend& backend) {
+    mFile = fopen(file.c_str(), "wb");
+    if (mFile == nullptr) {
+        mLogger.logger("Create record file failed: ", file, logger::LEVEL::ERROR);
+        return false;
+    }
+    int nbBindings = backend.GetNbBindings();
+    mBindings.resize(nbBindings);
+    uint64_t offset = alignUp(sizeof(RecordFrame));
+    for (int i = 0; i < nbBindings; ++i) {
+        RecordBinding& binding = mBindings[i];
+        memset(&binding, 0, sizeof(RecordBinding));
+        strncpy(binding.name, backend.mBindingName[i].c_str(), sizeof(binding.name) - 1);
+        nvinfer1::Dims dims = backend.GetBindingDims(i);
+        binding.dtype    = static_cast<int32_t>(backend.GetBindingDataType(i));
+        binding.is_input = backend.BindingIsInput(i);
+        binding.nb_dims  = dims.nbDims;
+        for (int d = 0; d < dims.nbDims; ++d) {
+            binding.dims[d] = dims.d[d];
+        }
+        binding.offset = offset;
+        binding.size   = binding.is_input ? 0 : backend.GetBindingSize(i);
+        offset += alignUp(binding.size);
+    }
+
+    memset(&mHeader, 0, sizeof(RecordHeader));
+    memcpy(mHeader.magic, RECORD_MAGIC, sizeof(mHeader.magic));
+    mHeader.version      = RECORD_VERSION;
+    mHeader.nb_bindings  = nbBindings;
+    mHeader.frame_stride = offset;
+    mHeader.nb_frames    = 0;
+    mHeader.data_offset  = alignUp(sizeof(RecordHeader) + nbBindings * sizeof(RecordBinding));
+
+    std::vector<uint8_t> head(mHeader.data_offset, 0);
+    memcpy(head.data(), &mHeader, sizeof(RecordHeader));
+    memcpy(head.data() + sizeof(RecordHeader), mBindings.data(), nbBindings * sizeof(RecordBinding));
+    fwrite(head.data(), 1, head.size(), mFile);
+    mFrame.assign(mHeader.frame_stride, 0);
+    mLogger.logger("Record output bindings to: ", file);
+    return true;
+}
+
+void TensorRecorder::Record(const InferBackend& backend, int batch, const cudaStream_t& stream) {
+    if (mFile == nullptr) return;
+    std::lock_guard<std::mutex> lock(mMutex);
+    bool on_device = backend.IsDeviceMemory();
+    if (on_device) CUDA_CHECK(cudaStreamSynchronize(stream));
+    RecordFrame* frame = reinterpret_cast<RecordFrame*>(mFrame.data());
+    frame->frame_index = mHeader.nb_frames;
+    frame->batch       = batch;
+    for (size_t i = 0; i < mBindings.size(); ++i) {
+        if (mBindings[i].is_input) continue;
+        copyToHost(mFrame.data() + mBindings[i].offset, backend.GetBindingPtr(i), mBindings[i].size, on_device);
+    }
+    fwrite(mFrame.data(), 1, mFrame.size(), mFile);
+    mHeader.nb_frames++;
+}
+
+void TensorRecorder::Close() {
+    if (mFile == nullptr) return;
+    fseek(mFile, 0, SEEK_SET);
+    fwrite(&mHeader, 1, sizeof(RecordHeader), mFile);
+    fclose(mFile);
+    mFile = nullptr;
+    mLogger.logger("Record frames: ", mHeader.nb_frames);
+}
+
+/* -==================Replay================*/
+TensorReplay::~TensorReplay() {
+    if (mData != nullptr) {
+        munmap(mData, mSize);
+        mData = nullptr;
+    }
+}
+
+bool TensorReplay::Open(const std::string& file) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        mLogger.logger("Open record file failed: ", file, logger::LEVEL::ERROR);
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    mSize = static_cast<size_t>(st.st_size);
+    if (mSize < sizeof(RecordHeader)) {
+        close(fd);
+        mLogger.logger("Record file is truncated: ", file, logger::LEVEL::ERROR);
+        return false;
+    }
+    void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        mLogger.logger("Map record file failed: ", file, logger::LEVEL::ERROR);
+        return false;
+    }
+    mData = static_cast<uint8_t*>(data);
+
+    const RecordHeader* header = Header();
+    if (memcmp(header->magic, RECORD_MAGIC, sizeof(header->magic)) != 0 || header->version != RECORD_VERSION) {
+        mLogger.logger("Not a record file or version mismatch: ", file, logger::LEVEL::ERROR);
+        return false;
+    }
+    if (header->data_offset + header->nb_frames * header->frame_stride > mSize) {
+        mLogger.logger("Record file is truncated: ", file, logger::LEVEL::ERROR);
+        return false;
+    }
+    mLogger.logger("Replay frames: ", header->nb_frames, file);
+    return true;
+}
+
+size_t TensorReplay::NbFrames() const {
+    return mData == nullptr ? 0 : Header()->nb_frames;
+}
+
+std::vector<HostBinding> TensorReplay::GetBindings() const {
+    std::vector<HostBinding> bindings;
+    if (mData == nullptr) return bindings;
+    for (uint32_t i = 0; i < Header()->nb_bindings; ++i) {
+        const RecordBinding* record = Binding(i);
+        HostBinding binding;
+        binding.name        = record->name;
+        binding.dtype       = static_cast<nvinfer1::DataType>(record->dtype);
+        binding.is_input    = record->is_input != 0;
+        binding.dims.nbDims = record->nb_dims;
+        for (int d = 0; d < record->nb_dims; ++d) {
+            binding.dims.d[d] = record->dims[d];
+        }
+        bindings.emplace_back(binding);
+    }
+    return bindings;
+}
+
+int TensorReplay::Feed(HostEngine& engine, size_t frame) const {
+    assert(frame < NbFrames());
+    const uint8_t* data = mData + Header()->data_offset + frame * Header()->frame_stride;
+    for (uint32_t i = 0; i < Header()->nb_bindings; ++i) {
+        const RecordBinding* record = Binding(i);
+        if (record->is_input) continue;
+        assert(engine.GetBindingSize(i) == record->size);
+        memcpy(engine.GetBindingPtr(i), data + record->offset, record->size);
+    }
+    return reinterpret_cast<const RecordFrame*>(data)->batch;
+}
+
+HostEngine::ForwardFn TensorReplay::MakeForward() {
+    return [this](HostEngine& engine) {
+        if (NbFrames() == 0) return;
+        Feed(engine, mCursor++ % NbFrames());
+    };
+}
+
+const RecordHeader* TensorReplay::Header() const {
+    return reinterpret_cast<const RecordHeader*>(mData);
+}
+
+const RecordBinding* TensorReplay::Binding(int index) const {
+    return reinterpret_cast<const RecordBinding*>(mData + sizeof(RecordHeader)) + index;
+}
@@ -0,0 +1,124 @@
+/**
+ * Record and replay output bindings of engine.
+ * Record file is memory-mappable, it has a fixed header, a binding table and
+ * frames with fixed stride, each frame holds every output binding of one forward:
+ *   | RecordHeader | RecordBinding x nb_bindings | (RecordFrame + outputs) x nb_frames |
+ * 2021/02/08
+ */
+
+#ifndef TENSOR_RECORD_H
+#define TENSOR_RECORD_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "NvInfer.h"
+#include "backend.h"
+#include "host_engine.h"
+#include "logger.h"
+#include "utils.h"
+
+#define RECORD_MAGIC "TRTREC01"
+#define RECORD_VERSION 1
+#define RECORD_ALIGN 64
+
+struct RecordHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t nb_bindings;
+    uint64_t frame_stride;  // bytes of one frame, includes RecordFrame
+    uint64_t nb_frames;
+    uint64_t data_offset;   // offset of first frame
+};
+
+struct RecordBinding {
+    char     name[64];
+    int32_t  dtype;         // nvinfer1::DataType
+    int32_t  is_input;      // input bindings keep meta only, no data
+    int32_t  nb_dims;
+    int32_t  dims[8];
+    uint64_t offset;        // offset in frame
+    uint64_t size;          // bytes
+};
+
+struct RecordFrame {
+    uint64_t frame_index;
+    int32_t  batch;
+    int32_t  reserved;
+};
+
+class TensorRecorder {
+public:
+    TensorRecorder() = default;
+    ~TensorRecorder();
+
+    /**
+     * Create record file, binding table is taken from backend, data of input
+     * bindings is not recorded.
+     */
+    bool Open(const std::string& file, const InferBackend& backend);
+
+    /**
+     * Copy every output binding to host and append them as one frame, stream is
+     * synchronized before copy. Clones of backend could record to same recorder.
+     */
+    void Record(const InferBackend& backend, int batch, const cudaStream_t& stream);
+
+    /**
+     * Write frame count to header and close file.
+     */
+    void Close();
+
+private:
+    logger::Logger mLogger;
+    std::mutex mMutex;
+    FILE* mFile = nullptr;
+    RecordHeader mHeader;
+    std::vector<RecordBinding> mBindings;
+    std::vector<uint8_t> mFrame;
+};
+
+class TensorReplay {
+public:
+    TensorReplay() = default;
+    ~TensorReplay();
+
+    /**
+     * Map record file and validate header.
+     */
+    bool Open(const std::string& file);
+
+    size_t NbFrames() const;
+
+    /**
+     * Host bindings with same index, name, dims and dtype as recorded engine.
+     */
+    std::vector<HostBinding> GetBindings() const;
+
+    /**
+     * Copy outputs of frame to engine bindings, return recorded batch.
+     */
+    int Feed(HostEngine& engine, size_t frame) const;
+
+    /**
+     * Forward callable feeding frames in order, restart from first frame at the end.
+     * Engines sharing it take frames in turn.
+     */
+    HostEngine::ForwardFn MakeForward();
+
+private:
+    const RecordHeader* Header() const;
+    const RecordBinding* Binding(int index) const;
+
+private:
+    logger::Logger mLogger;
+    uint8_t* mData = nullptr;
+    size_t mSize = 0;
+    std::atomic<size_t> mCursor {0};
+};
+
+#endif  // TENSOR_RECORD_H
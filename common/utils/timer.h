@@ -8,7 +8,9 @@
 #define TIMER_H
 
 #include <iostream>
+#include <sstream>
 #include <vector>
+#include <chrono>
 
 #include <cuda.h>
 #include "utils.h"
@@ -18,58 +20,52 @@ using namespace std;
 class Timer {
 
 public:
-    Timer(const cudaStream_t& stream, bool show_time) : mStream(stream), mShowTime(show_time) {
+    /**
+     * on_device: record time with cuda events on stream, otherwise with host clock,
+     *            which is used by host backend.
+     */
+    Timer(const cudaStream_t& stream, bool show_time, bool on_device = true) : mStream(stream), mShowTime(show_time), mOnDevice(on_device) {
+        if (!mOnDevice) return;
         CUDA_CHECK(cudaEventCreate(&mEvents));
         CUDA_CHECK(cudaEventCreate(&mEvente));
         
     };
     ~Timer() {
+        if (!mOnDevice) return;
         CUDA_CHECK(cudaEventDestroy(mEvents));
         CUDA_CHECK(cudaEventDestroy(mEvente));
     };
 
     void inferStart() {
         if (!mShowTime) return;
-        CUDA_CHECK(cudaEventRecord(mEvents, mStream));
+        start();
     };
 
     void inferEnd() {
         if (!mShowTime) return;
-        CUDA_CHECK(cudaEventRecord(mEvente, mStream));
-        CUDA_CHECK(cudaEventSynchronize(mEvente));
-        float once_cost;
-        CUDA_CHECK(cudaEventElapsedTime(&once_cost, mEvents, mEvente));
-        mInferTime += once_cost;
+        mInferTime += stop();
         mInferCount++;
     };
 
     void dataStart() {
         if (!mShowTime) return;
-        CUDA_CHECK(cudaEventRecord(mEvents, mStream));
+        start();
     };
 
     void dataEnd() {
         if (!mShowTime) return;
-        CUDA_CHECK(cudaEventRecord(mEvente, mStream));
-        CUDA_CHECK(cudaEventSynchronize(mEvente));
-        float once_cost;
-        CUDA_CHECK(cudaEventElapsedTime(&once_cost, mEvents, mEvente));
-        mDataTime += once_cost;
+        mDataTime += stop();
         mDataCount++;
     };
 
     void postStart() {
         if (!mShowTime) return;
-        CUDA_CHECK(cudaEventRecord(mEvents, mStream));
+        start();
     };
 
     void postEnd() {
         if (!mShowTime) return;
-        CUDA_CHECK(cudaEventRecord(mEvente, mStream));
-        CUDA_CHECK(cudaEventSynchronize(mEvente));
-        float once_cost;
-        CUDA_CHECK(cudaEventElapsedTime(&once_cost, mEvents, mEvente));
-        mPostTime += once_cost;
+        mPostTime += stop();
         mPostCount++;
     };
 
@@ -106,16 +102,66 @@ public:
         return t;
     };
 
+    /**
+     * Stages of data time, by host clock of prepareInputs: resize(and packing into
+     * staging), upload(one copy of whole batch) and convert(layout and normalization).
+     */
+    void addDataStages(float resize, float upload, float convert) {
+        if (!mShowTime) return;
+        mResizeTime  += resize;
+        mUploadTime  += upload;
+        mConvertTime += convert;
+        mStageCount++;
+    };
+
+    /**
+     * "resize x ms, upload y ms, convert z ms", average since last call.
+     */
+    string getDataStages() {
+        if (!mShowTime || mStageCount == 0) return "";
+        std::ostringstream out;
+        out << "resize " << mResizeTime / mStageCount << "ms, upload " << mUploadTime / mStageCount
+            << "ms, convert " << mConvertTime / mStageCount << "ms";
+        mResizeTime = mUploadTime = mConvertTime = 0.f;
+        mStageCount = 0;
+        return out.str();
+    };
+
     bool showTime() {
         return mShowTime;
     };
 
+private:
+    void start() {
+        if (!mOnDevice) {
+            mHostStart = std::chrono::steady_clock::now();
+            return;
+        }
+        CUDA_CHECK(cudaEventRecord(mEvents, mStream));
+    };
+
+    float stop() {
+        float once_cost;
+        if (!mOnDevice) {
+            once_cost = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - mHostStart).count();
+            return once_cost;
+        }
+        CUDA_CHECK(cudaEventRecord(mEvente, mStream));
+        CUDA_CHECK(cudaEventSynchronize(mEvente));
+        CUDA_CHECK(cudaEventElapsedTime(&once_cost, mEvents, mEvente));
+        return once_cost;
+    };
+
 private:
     bool mShowTime = false;
+    bool mOnDevice = true;
+    std::chrono::steady_clock::time_point mHostStart;
     cudaEvent_t mEvents, mEvente;
     cudaStream_t mStream;
     float mInferTime  = 0.f, mDataTime   = 0.f, mPostTime  = 0.f;
     int   mWarmupIter = 0,   mInferCount = 0,   mDataCount = 0, mPostCount = 0;
+    float mResizeTime = 0.f, mUploadTime = 0.f, mConvertTime = 0.f;
+    int   mStageCount = 0;
 };
 
 #endif  // TIMER_H
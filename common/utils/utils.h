@@ -10,6 +10,7 @@
 #include <iostream>
 #include <algorithm>
 #include <numeric>
+#include <cstring>
 #include <NvInfer.h>
 
 #include "cuda_runtime.h"
@@ -44,6 +45,7 @@ inline unsigned int getElementSize(nvinfer1::DataType t) {
     }
 }
 
+#ifndef CPU_ONLY
 inline void setAllTensorScales(nvinfer1::INetworkDefinition* network, float inScales = 2.0f, float outScales = 4.0f) {
     // Ensure that all layer inputs have a scale.
     for (int i = 0; i < network->getNbLayers(); i++) {
@@ -76,6 +78,7 @@ inline void setAllTensorScales(nvinfer1::INetworkDefinition* network, float inSc
         }
     }
 }
+#endif  // CPU_ONLY
 
 
 #ifndef CUDA_CHECK
@@ -113,6 +116,17 @@ inline void safeCudaFree(void* deviceMem) {
     CUDA_CHECK(cudaFree(deviceMem));
 }
 
+/**
+ * Copy binding data to host, bindings of host backend are copied by memcpy.
+ */
+inline void copyToHost(void* dst, const void* src, size_t size, bool on_device = true) {
+    if (on_device) {
+        CUDA_CHECK(cudaMemcpy(dst, src, size, cudaMemcpyDeviceToHost));
+    } else {
+        memcpy(dst, src, size);
+    }
+}
+
 inline void error(const std::string& message, const int line, const std::string& function, const std::string& file) {
     std::cout << message << " at " << line << " in " << function << " in " << file << std::endl;
 }
@@ -7,16 +7,102 @@
 #include "yolov5.h"
 #include "f_track.h"
 #include "fairmot.h"
+#ifndef CPU_ONLY
+#include "engine_registry.h"
+#endif
 #include "tasks.h"
+#include "frame_cache.h"
+#include "image_loader.h"
 #include "tools.h"
 #include "utils.h"
 #include "yaml-cpp/yaml.h"
+#include "startup_profile.h"
+#include <atomic>
 #include <thread>
 #include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
 
 using namespace std;
 using namespace cv;
 
+// one enabled task, created on a worker of createTasks
+struct TaskInit {
+    string name;
+    string cfg_file;
+    YAML::Node* cfg;  // cfg of task, loaded by createTasks
+    std::function<Task*(const YAML::Node&)> create;
+    StartupProfile profile;  // config parse, stages of task constructor and rest of it as other
+    bool ready = false;      // see Task::ready
+};
+
+// enabled task of frames shared through FrameCache, runs views of a frame
+struct FrameTask {
+    string img_path;  // `inputs: img_path`, frame of task
+    int batch_size;
+    std::function<void(const vector<ImageView>&)> run;
+};
+
+// every task on frame after frame, tasks of same img_path read one frame and share
+// its preprocessing through cache
+static bool runSharedFrames(const vector<FrameTask>& tasks, FrameCache& cache, int count) {
+    map<string, uint64_t> sources;  // frame ids of a path are source + k * count of paths
+    for (const auto& t : tasks) {
+        sources.emplace(t.img_path, 0);
+    }
+    uint64_t next = 1;  // 0 is never cached
+    for (auto& source : sources) {
+        source.second = next++;
+    }
+    for (int i = 0; i < count; ++i) {
+        map<string, cv::Mat> frames;
+        for (const auto& source : sources) {
+            cv::Mat frame = imread(source.first);
+            if (frame.empty()) {
+                cerr << "Can't read image: " << source.first << endl;
+                return false;
+            }
+            frames.emplace(source.first, frame);
+        }
+        for (const auto& t : tasks) {
+            const cv::Mat& frame = frames[t.img_path];
+            ImageView view(frame.data, static_cast<int>(frame.step[0]), frame.cols, frame.rows);
+            view.frame_id = sources[t.img_path] + static_cast<uint64_t>(i) * sources.size();
+            t.run(vector<ImageView>(t.batch_size, view));
+        }
+    }
+    return true;
+}
+
+// create tasks on `threads` workers, tasks are independent, every one binds its own device
+static void createTasks(vector<TaskInit>& inits, int threads) {
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < inits.size(); i = next++) {
+            TaskInit& init = inits[i];
+            auto start = chrono::steady_clock::now();
+            *init.cfg = YAML::LoadFile(init.cfg_file);
+            auto loaded = chrono::steady_clock::now();
+            Task* task = init.create(*init.cfg);
+            double create_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - loaded).count();
+            init.profile.Add(startup::kConfig, chrono::duration<double, milli>(loaded - start).count());
+            init.profile.Merge(task->startupProfile());
+            // post process setup of derived task
+            init.profile.Add(startup::kOther, max(create_ms - task->startupProfile().Total(), 0.));
+            init.ready = task->ready();
+        }
+    };
+    vector<thread> workers;
+    for (int t = 1; t < min(threads, static_cast<int>(inits.size())); ++t) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
 
 int main(){
     //cfg
@@ -31,55 +117,94 @@ int main(){
     YOLOV5*  yolo    = nullptr;
     SEMSEG*  semseg  = nullptr;
 
-/* -==================Classification task================*/
-    if (task["cls"] && task["cls"].as<bool>()){
-        string cfg_file = main_cfg["cls"]["cfg_file"].as<string>();
-        cls_cfg =  YAML::LoadFile(cfg_file);
-        cls = new CLS(cls_cfg);
+/* -==================Create tasks concurrently================*/
+    vector<TaskInit> inits;
+    if (task["cls"] && task["cls"].as<bool>()) {
+        inits.push_back({"cls", main_cfg["cls"]["cfg_file"].as<string>(), &cls_cfg, [&](const YAML::Node& cfg) { return cls = new CLS(cfg); }});
+    }
+    if (task["semseg"] && task["semseg"].as<bool>()) {
+        inits.push_back({"semseg", main_cfg["semseg"]["cfg_file"].as<string>(), &semseg_cfg, [&](const YAML::Node& cfg) { return semseg = new SEMSEG(cfg); }});
+    }
+    if (task["fairmot"] && task["fairmot"].as<bool>()) {
+        inits.push_back({"fairmot", main_cfg["fairmot"]["cfg_file"].as<string>(), &fairmot_cfg, [&](const YAML::Node& cfg) { return fairmot = new FairMOT(cfg); }});
+    }
+    if (task["f_track"] && task["f_track"].as<bool>()) {
+        inits.push_back({"f_track", main_cfg["f_track"]["cfg_file"].as<string>(), &f_track_cfg, [&](const YAML::Node& cfg) { return f_track = new FTrack(cfg); }});
     }
-/* -==================Segmentation task================*/
-    if (task["semseg"] && task["semseg"].as<bool>()){
-        string semseg_file = main_cfg["semseg"]["cfg_file"].as<string>();
-        semseg_cfg =  YAML::LoadFile(semseg_file);
-        semseg = new SEMSEG(semseg_cfg);
+    if (task["fcos"] && task["fcos"].as<bool>()) {
+        inits.push_back({"fcos", main_cfg["fcos"]["cfg_file"].as<string>(), &fcos_cfg, [&](const YAML::Node& cfg) { return fcos = new FCOS(cfg); }});
     }
-/* -==================Track task=======================*/
-    if (task["fairmot"] && task["fairmot"].as<bool>()){
-        string cfg_file = main_cfg["fairmot"]["cfg_file"].as<string>();
-        fairmot_cfg =  YAML::LoadFile(cfg_file);
-        fairmot = new FairMOT(fairmot_cfg);
+    if (task["yolo"] && task["yolo"].as<bool>()) {
+        inits.push_back({"yolo", main_cfg["yolo"]["cfg_file"].as<string>(), &yolo_cfg, [&](const YAML::Node& cfg) { return yolo = new YOLOV5(cfg); }});
     }
-    if (task["f_track"] && task["f_track"].as<bool>()){
-        string cfg_file = main_cfg["f_track"]["cfg_file"].as<string>();
-        f_track_cfg =  YAML::LoadFile(cfg_file);
-        f_track = new FTrack(f_track_cfg);
+    YAML::Node misc = main_cfg["misc"];
+    int init_threads = misc["init_threads"] ? misc["init_threads"].as<int>() : static_cast<int>(inits.size());
+    auto init_start = chrono::steady_clock::now();
+    createTasks(inits, init_threads);
+    double init_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - init_start).count();
+    for (const auto& init : inits) {
+        if (!init.ready) {
+            cerr << "Task " << init.name << " failed to initialize, see errors above." << endl;
+            return -1;
+        }
     }
-/* -==================Detection task=================*/
-    if (task["fcos"] && task["fcos"].as<bool>()){
-        string cfg_file = main_cfg["fcos"]["cfg_file"].as<string>();
-        fcos_cfg =  YAML::LoadFile(cfg_file);
-        fcos = new FCOS(fcos_cfg);
+
+    vector<pair<string, StartupProfile>> profiles;
+    double sum_ms = 0.;
+    for (const auto& init : inits) {
+        profiles.emplace_back(init.name, init.profile);
+        sum_ms += init.profile.Total();
     }
-    if (task["yolo"] && task["yolo"].as<bool>()){
-        string cfg_file = main_cfg["yolo"]["cfg_file"].as<string>();
-        yolo_cfg =  YAML::LoadFile(cfg_file);
-        yolo = new YOLOV5(yolo_cfg);
+    printStartupReport(profiles);
+    cout << "Startup of " << inits.size() << " tasks on " << init_threads << " threads: " << init_ms
+         << " ms, sum of tasks: " << sum_ms << " ms" << endl;
+    string baseline = misc["startup_baseline"] ? misc["startup_baseline"].as<string>() : "";
+    if (!baseline.empty()) {
+        checkStartupBaseline(baseline, profiles,
+                             misc["startup_tolerance"] ? misc["startup_tolerance"].as<double>() : 1.5,
+                             misc["startup_min_ms"] ? misc["startup_min_ms"].as<double>() : 10.);
+    }
+#ifndef CPU_ONLY
+    EngineRegistry::Instance().Report();
+#endif
+
+/* -==================Plan scratch memory================*/
+    // tasks below run one after another, so their scratch could share memory, unless multithreading
+    bool multithreading = main_cfg["misc"]["multithreading"].as<bool>();
+    vector<pair<string, Task*>> run_order = {{"cls", cls}, {"semseg", semseg}, {"fcos", fcos},
+                                             {"yolo", yolo}, {"fairmot", fairmot}, {"f_track", f_track}};
+    MemoryPlanner planner;  // outlives tasks, they're deleted in place below
+    if (misc["plan_memory"] && misc["plan_memory"].as<bool>()) {
+        int step = 0;
+        for (const auto& t : run_order) {
+            if (!t.second) continue;
+            int s = multithreading ? 0 : step++;
+            t.second->declareScratch(planner, t.first, s, s);
+        }
+        planner.Plan();
+        planner.Allocate();
+        planner.Report();
+        for (const auto& t : run_order) {
+            if (t.second) t.second->bindScratch(planner);
+        }
     }
 
 
 /* -==================Run tasks=================*/
     int count = main_cfg["misc"]["runtimes"].as<int>();
+    bool share_frames = misc["frame_cache"] && misc["frame_cache"].as<bool>();
     // multithreading
     // NOTE: not complement yet.
-    if(main_cfg["misc"]["multithreading"].as<bool>())
+    if(multithreading)
     {
         for (size_t i = 0; i < count; i++)
         {
             auto thread_func_0 = [&](){
-                cv::Mat frame = imread(fairmot_cfg["inputs"]["img_path"].as<string>());
                 int im_w = fairmot_cfg["inputs"]["width"].as<int>();
                 int im_h = fairmot_cfg["inputs"]["height"].as<int>();
-                cv::resize(frame, frame, cv::Size(im_w, im_h));
+                ImageLoader loader;
+                cv::Mat frame;
+                if (!loader.Load(fairmot_cfg["inputs"]["img_path"].as<string>(), frame, im_w, im_h)) return;
                 int batch_size = fairmot_cfg["engine"]["bchw"].as<vector<int>>()[0];
                 vector<cv::Mat> imgs;
                 for(int i = 0; i < batch_size; i++){
@@ -88,10 +213,11 @@ int main(){
                 auto fairmot_results = fairmot->run(imgs);
             };
             auto thread_func_1 = [&](){
-                cv::Mat frame = imread(fcos_cfg["inputs"]["img_path"].as<string>());
                 int im_w = fcos_cfg["inputs"]["width"].as<int>();
                 int im_h = fcos_cfg["inputs"]["height"].as<int>();
-                cv::resize(frame, frame, cv::Size(im_w, im_h));
+                ImageLoader loader;
+                cv::Mat frame;
+                if (!loader.Load(fcos_cfg["inputs"]["img_path"].as<string>(), frame, im_w, im_h)) return;
                 int batch_size = fcos_cfg["engine"]["bchw"].as<vector<int>>()[0];
                 vector<cv::Mat> imgs;
                 for(int i = 0; i < batch_size; i++){
@@ -100,10 +226,11 @@ int main(){
                 auto fcos_results = fcos->run(imgs);
             };
             auto thread_func_2 = [&](){
-                cv::Mat frame = imread(f_track_cfg["inputs"]["img_path"].as<string>());
                 int im_w = f_track_cfg["inputs"]["width"].as<int>();
                 int im_h = f_track_cfg["inputs"]["height"].as<int>();
-                cv::resize(frame, frame, cv::Size(im_w, im_h));
+                ImageLoader loader;
+                cv::Mat frame;
+                if (!loader.Load(f_track_cfg["inputs"]["img_path"].as<string>(), frame, im_w, im_h)) return;
                 int batch_size = f_track_cfg["engine"]["bchw"].as<vector<int>>()[0];
                 vector<cv::Mat> imgs;
                 for(int i = 0; i < batch_size; i++){
@@ -121,9 +248,45 @@ int main(){
         }
     }
 
+    // tasks one after another on every frame, preprocessing shared through frame cache
+    else if (share_frames)
+    {
+        vector<FrameTask> frame_tasks;
+        auto add = [&](auto* t, const YAML::Node& cfg) {
+            if (!t) return;
+            frame_tasks.push_back({cfg["inputs"]["img_path"].as<string>(), cfg["engine"]["bchw"].as<vector<int>>()[0],
+                                   [t](const vector<ImageView>& views) { t->run(views); }});
+        };
+        add(cls, cls_cfg);
+        add(semseg, semseg_cfg);
+        add(fcos, fcos_cfg);
+        add(yolo, yolo_cfg);
+        add(fairmot, fairmot_cfg);
+        add(f_track, f_track_cfg);
+        // a frame of every img_path is in flight at once
+        FrameCache cache(static_cast<int>(frame_tasks.size()),
+                         misc["frame_cache_pyramid"] && misc["frame_cache_pyramid"].as<bool>());
+        for (const auto& t : run_order) {
+            if (t.second) t.second->setFrameCache(&cache);
+        }
+        bool ok = runSharedFrames(frame_tasks, cache, count);
+        cache.Report();
+        for (const auto& t : run_order) {
+            delete t.second;
+        }
+        cls = nullptr;
+        semseg = nullptr;
+        fcos = nullptr;
+        yolo = nullptr;
+        fairmot = nullptr;
+        f_track = nullptr;
+        if (!ok) return -1;
+    }
+
     //singlethreading
     else
     {
+        ImageLoader loader;  // staging of decoding reused by every image read below
 /* -==================classification task================*/
         if (cls){
             int im_w = cls_cfg["inputs"]["width"].as<int>();
@@ -147,10 +310,12 @@ int main(){
                 for (int i = 0; i < 10; i += batch_size) {
                     vector <cv::Mat> imgs;
                     for (int b = 0; b < batch_size; ++b) {
-                        video.read(frame);
+                        // last batch of video could be partial, task runs only frames read
+                        if (!video.read(frame)) break;
                         cv::resize(frame, frame, cv::Size(im_w, im_h));
                         imgs.emplace_back(frame);
                     }
+                    if (imgs.empty()) break;
                     auto cls_results = cls->run(imgs);
                 }
 
@@ -158,8 +323,8 @@ int main(){
                 for (size_t i = 0; i < count; i++) {
                     vector <cv::Mat> imgs;
                     for (int i = 0; i < batch_size; i++) {
-                        cv::Mat frame = imread(cls_cfg["inputs"]["img_path"].as<string>());
-                        cv::resize(frame, frame, cv::Size(im_w, im_h));
+                        cv::Mat frame;
+                        if (!loader.Load(cls_cfg["inputs"]["img_path"].as<string>(), frame, im_w, im_h)) return -1;
                         imgs.emplace_back(frame);
                     }
                     auto cls_results = cls->run(imgs);
@@ -191,10 +356,12 @@ int main(){
                 for (int i = 0; i < 10; i += batch_size) {
                     vector <cv::Mat> imgs;
                     for (int b = 0; b < batch_size; ++b) {
-                        video.read(frame);
+                        // last batch of video could be partial, task runs only frames read
+                        if (!video.read(frame)) break;
                         cv::resize(frame, frame, cv::Size(im_w, im_h));
                         imgs.emplace_back(frame);
                     }
+                    if (imgs.empty()) break;
                     auto semseg_results = semseg->run(imgs);
                 }
 
@@ -202,8 +369,8 @@ int main(){
                 for (size_t i = 0; i < count; i++) {
                     vector <cv::Mat> imgs;
                     for (int i = 0; i < batch_size; i++) {
-                        cv::Mat frame = imread(semseg_cfg["inputs"]["img_path"].as<string>());
-                        cv::resize(frame, frame, cv::Size(im_w, im_h));
+                        cv::Mat frame;
+                        if (!loader.Load(semseg_cfg["inputs"]["img_path"].as<string>(), frame, im_w, im_h)) return -1;
                         imgs.emplace_back(frame);
                     }
                     auto semseg_results = semseg->run(imgs);
@@ -236,19 +403,21 @@ int main(){
                 for (int i = 0; i < 10; i += batch_size) {
                     vector <cv::Mat> imgs;
                     for (int b = 0; b < batch_size; ++b) {
-                        video.read(frame);
+                        // last batch of video could be partial, task runs only frames read
+                        if (!video.read(frame)) break;
                         cv::resize(frame, frame, cv::Size(im_w, im_h));
                         imgs.emplace_back(frame);
                     }
+                    if (imgs.empty()) break;
                     auto fcos_results = fcos->run(imgs);
                 }
 
             } else {
                 for (size_t i = 0; i < count; i++) {
-                    cv::Mat frame = imread(fcos_cfg["inputs"]["img_path"].as<string>());
                     int im_w = fcos_cfg["inputs"]["width"].as<int>();
                     int im_h = fcos_cfg["inputs"]["height"].as<int>();
-                    cv::resize(frame, frame, cv::Size(im_w, im_h));
+                    cv::Mat frame;
+                    if (!loader.Load(fcos_cfg["inputs"]["img_path"].as<string>(), frame, im_w, im_h)) return -1;
                     int batch_size = fcos_cfg["engine"]["bchw"].as < vector < int >> ()[0];
                     vector <cv::Mat> imgs;
                     for (int i = 0; i < batch_size; i++) {
@@ -289,10 +458,12 @@ int main(){
                 for (int i = 0; i < 10; i += batch_size) {
                     vector <cv::Mat> imgs;
                     for (int b = 0; b < batch_size; ++b) {
-                        video.read(frame);
+                        // last batch of video could be partial, task runs only frames read
+                        if (!video.read(frame)) break;
                         cv::resize(frame, frame, cv::Size(im_w, im_h));
                         imgs.emplace_back(frame);
                     }
+                    if (imgs.empty()) break;
                     auto yolo_results = yolo->run(imgs);
                 }
 
@@ -337,10 +508,12 @@ int main(){
                 for (int i = 0; i < 10; i += batch_size) {
                     vector <cv::Mat> imgs;
                     for (int b = 0; b < batch_size; ++b) {
-                        video.read(frame);
+                        // last batch of video could be partial, task runs only frames read
+                        if (!video.read(frame)) break;
                         cv::resize(frame, frame, cv::Size(im_w, im_h));
                         imgs.emplace_back(frame);
                     }
+                    if (imgs.empty()) break;
                     auto fairmot_results = fairmot->run(imgs);
                 }
 
@@ -348,8 +521,8 @@ int main(){
                 for (size_t i = 0; i < count; i++) {
                     vector <cv::Mat> imgs;
                     for (int i = 0; i < batch_size; i++) {
-                        cv::Mat frame = imread(fairmot_cfg["inputs"]["img_path"].as<string>());
-                        cv::resize(frame, frame, cv::Size(im_w, im_h));
+                        cv::Mat frame;
+                        if (!loader.Load(fairmot_cfg["inputs"]["img_path"].as<string>(), frame, im_w, im_h)) return -1;
                         imgs.emplace_back(frame);
                     }
                     auto fairmot_results = fairmot->run(imgs);
@@ -381,10 +554,12 @@ int main(){
                 for (int i = 0; i < 10; i += batch_size) {
                     vector <cv::Mat> imgs;
                     for (int b = 0; b < batch_size; ++b) {
-                        video.read(frame);
+                        // last batch of video could be partial, task runs only frames read
+                        if (!video.read(frame)) break;
                         cv::resize(frame, frame, cv::Size(im_w, im_h));
                         imgs.emplace_back(frame);
                     }
+                    if (imgs.empty()) break;
                     auto f_track_results = f_track->run(imgs);
                 }
 
@@ -392,8 +567,8 @@ int main(){
                 for (size_t i = 0; i < count; i++) {
                     vector <cv::Mat> imgs;
                     for (int i = 0; i < batch_size; i++) {
-                        cv::Mat frame = imread(f_track_cfg["inputs"]["img_path"].as<string>());
-                        cv::resize(frame, frame, cv::Size(im_w, im_h));
+                        cv::Mat frame;
+                        if (!loader.Load(f_track_cfg["inputs"]["img_path"].as<string>(), frame, im_w, im_h)) return -1;
                         imgs.emplace_back(frame);
                     }
                     // auto start = chrono::system_clock::now();
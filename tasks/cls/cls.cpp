@@ -6,32 +6,32 @@ CLS::CLS(const YAML::Node& cfg) : ClassificationTask(cfg) {
     mNumClasses = cfg["params"]["num_classes"].as<int>();
 }
 
-bool CLS::prepareInputs(const vector<Mat>& imgs) {
-    return ClassificationTask::prepareInputs(imgs);
+bool CLS::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return ClassificationTask::prepareInputs(state, imgs);
 }
 
-bool CLS::prepareInputs(uint8_t* imgs) {
-    NHWC2NCHW(
-            mInputDataNHWC,
-            (float*)mNet->GetBindingPtr(0),
-            mBatchSize,
-            mModel_H,
-            mModel_W,
-            103.52, 116.28, 123.675,
-            57.375,57.12,58.395,
-            mImageFormat);
+bool CLS::prepareInputs(ExecState& state, uint8_t* imgs) {
+    state.net->SetBatchSize(mBatchSize);
+    state.transforms.assign(mBatchSize, letterboxTransform(mModel_W, mModel_H, mModel_W, mModel_H, false));
+    if (!state.net->IsDeviceMemory()) {
+        NHWC2NCHW_lut(imgs, state.net->GetBindingPtr(0), mBatchSize, mModel_H, mModel_W, state.inputLut, mPreprocessThreads);
+        return true;
+    }
+    // means/stds of params, as images of run(vector<Mat>)
+    NHWC2NCHW_binding(imgs, state.net->GetBindingPtr(0), mBatchSize, mModel_H, mModel_W, state.inputLut, state.stream);
 //    float* cls_f = (float*)malloc(10*sizeof(float));
 //    cudaMemcpy(cls_f, (float*)mNet->GetBindingPtr(0), 10*sizeof(float), cudaMemcpyDeviceToHost);
 //    cout << "* GetBindingPtr0" << * cls_f << * (cls_f + 1) << * (cls_f + 2) <<endl;
      return true;
 }
 
-vector<int> CLS::processOutputs() {
+vector<int> CLS::processOutputs(ExecState& state) {
     vector<float> cls_res(mNumClasses * mBatchSize);
     int cls_bind_idx = 1;
     vector<int> labels;
-    mNet->CopyFromDeviceToHost(cls_res, cls_bind_idx, mStream);
-    for (int b = 0; b < mBatchSize; ++b) {
+    size_t count = state.net->GetBindingSize(cls_bind_idx) / getElementSize(state.net->GetBindingDataType(cls_bind_idx));
+    copyBindingToHost(cls_res.data(), outputBinding(state.net, cls_bind_idx), 0, std::min(count, cls_res.size()));
+    for (int b = 0; b < state.net->GetBatchSize(); ++b) {
         float max_score = 0.f;
         int label = -1;
         for (int i = b * mNumClasses; i < (b * mNumClasses + mNumClasses); i++) {
@@ -50,24 +50,35 @@ vector<int> CLS::run(const vector<Mat>& imgs) {
 }
 
 vector<int> CLS::run(uint8_t* p_input) {
-    mTimer->dataStart();
-    if (!prepareInputs(p_input)) {
+    // anywhere else than staging buffer of first state, input is a host batch read in place
+    if (p_input != getInputPtr()) {
+        vector<ImageView> views;
+        for (int b = 0; b < mBatchSize; ++b) {
+            views.emplace_back(p_input + b * getInputSize(), 3 * mModel_W, mModel_W, mModel_H);
+        }
+        return run(views);
+    }
+    // images are written to staging buffer of first state, see getInputPtr
+    ExecPool::Lease state = acquireState(0);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareInputs(*state, p_input)) {
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("CLS Data  time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("CLS Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("CLS Post  time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("CLS Data  time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("CLS Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("CLS Post  time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
     return results;
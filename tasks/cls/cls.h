@@ -22,19 +22,24 @@ class CLS : public ClassificationTask {
 public:
     CLS(const YAML::Node& cfg);
 
+    using ClassificationTask::run;  // views of caller buffers
     vector<int> run(const vector<Mat>& imgs) override;
+    /**
+    ! p_input: max batch of model sized bgr images, either written to getInputPtr()
+    !          (device memory on tensorrt backend) or a host buffer of caller.
+    */
     vector<int> run(uint8_t* p_input);
     uint8_t* getInputPtr() {
-        return mInputDataNHWC;
+        return currentGeneration()->State(0).inputNHWC;
     }
     int getInputSize() {
         return 3 * mModel_W * mModel_H;
     }
 
 private:
-    bool prepareInputs(const vector<Mat>& imgs) override;
-    bool prepareInputs(uint8_t* imgs);
-    vector<int> processOutputs() override;
+    bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    bool prepareInputs(ExecState& state, uint8_t* imgs);
+    vector<int> processOutputs(ExecState& state) override;
 
 private:
     int mNumClasses;
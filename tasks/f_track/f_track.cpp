@@ -4,57 +4,61 @@
 #include "f_track.h"
 #include "f_track_outputs.h"
 
-FTrack::FTrack(const YAML::Node& cfg) : TrackTask(cfg) {
+FTrack::FTrack(const YAML::Node& cfg)
+    : TrackTask(cfg),
+      mDetThresh(cfg["params"]["det_thresh"] ? cfg["params"]["det_thresh"].as<float>() : 0.f),
+      mAreaThresh(cfg["params"]["area_thresh"] ? cfg["params"]["area_thresh"].as<float>() : 0.f),
+      mRatioThresh(cfg["params"]["ratio_thresh"] ? cfg["params"]["ratio_thresh"].as<float>() : 0.f),
+      mNmsThresh(cfg["params"]["nms_thresh"].as<float>()) {
     mNumClasses = cfg["params"]["num_classes"].as<int>();
+    initOutputIndex(12);
 }
 
-bool FTrack::prepareInputs(const vector<Mat>& imgs) {
-    return TrackTask::prepareInputs(imgs);
+bool FTrack::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return TrackTask::prepareInputs(state, imgs);
 }
 
-TrackRes FTrack::processOutputs() {
-    vector <float*> inputs;
+TrackRes FTrack::processOutputs(ExecState& state) {
+    vector<BindingView> inputs;
     vector<size_t >sizes;
     vector<nvinfer1::Dims> dims;
-    vector<int> idx_list = cfg["params"]["output_index"].as<vector<int>>();
-    for (int i = 0; i < 12; ++i)
+    for (int idx : mOutputIndex)
     {
-        //fcos  onnx outputs from 1-15
-        inputs.push_back((float*)mNet->GetBindingPtr(idx_list[i]));
-        sizes.push_back((size_t)mNet->GetBindingSize(idx_list[i]));
-        dims.push_back(mNet->GetBindingDims(idx_list[i]));
+        //fcos outputs and re-id feature
+        inputs.push_back(outputBinding(state.net, idx));
+        sizes.push_back((size_t)state.net->GetBindingSize(idx));
+        dims.push_back(state.net->GetBindingDims(idx));
     }
     // results type -> std::pair<std::vector<std::vector<std::array<float, 5>>>, std::vector<std::vector<std::vector<float>>>>
-    float det_thresh   = cfg["params"]["det_thresh"] ? cfg["params"]["det_thresh"].as<float>() : 0.;
-    float area_thresh  = cfg["params"]["area_thresh"] ? cfg["params"]["area_thresh"].as<float>() : 0.;
-    float ratio_thresh = cfg["params"]["ratio_thresh"] ? cfg["params"]["ratio_thresh"].as<float>() : 0.;
-    float nms_thresh   = cfg["params"]["nms_thresh"].as<float>();
-    auto results = f_track_postProcess(inputs, sizes, dims, mModel_H, mModel_W,  mNumClasses, det_thresh, area_thresh, ratio_thresh, nms_thresh);
-    std::vector<std::vector<std::array<float, 5>>> boxes = results.first;
+    auto results = f_track_postProcess(inputs, sizes, dims, state.net->GetBatchSize(), state.inputH, state.inputW,  mNumClasses, mDetThresh, mAreaThresh, mRatioThresh, mNmsThresh);
+    mapToSource(results.first, state.transforms);
     // cout << "box1: "<<boxes[0][0][0] << " " << boxes[0][0][1] << " " << boxes[0][0][2] << " "<< boxes[0][0][3]<< " "<< boxes[0][0][4]<< endl;
 
     return results;
 }
 
 TrackRes FTrack::run(const vector<Mat>& imgs){
-    mTimer->dataStart();
-    if (!prepareInputs(imgs)){
+    ExecPool::Lease state = acquireState(imgs);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareInputs(*state, imgs)){
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("FTrack Data time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("FTrack Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("FTrack Post time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("FTrack Data time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("FTrack Data stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+        mLogger.logger("FTrack Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("FTrack Post time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
     return results;
@@ -23,14 +23,19 @@ public:
     FTrack(const YAML::Node& cfg);
     ~FTrack() = default;
 
+    using TrackTask::run;  // views of caller buffers
     TrackRes run(const vector<Mat>& imgs) override;
 
 private:
-    bool prepareInputs(const vector<Mat>& imgs) override;
-    TrackRes processOutputs() override;
+    bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    TrackRes processOutputs(ExecState& state) override;
 
 private:
     int mNumClasses;
+    const float mDetThresh;
+    const float mAreaThresh;
+    const float mRatioThresh;
+    const float mNmsThresh;
 };
 
 #endif  // F_TRACK_H
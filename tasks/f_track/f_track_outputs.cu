@@ -31,6 +31,8 @@ void filter(std::vector<Bbox> &bboxes, float area_thresh, float ratio) {
     }
 
 }
+
+#ifndef CPU_ONLY
 __global__ void gather_feat_kernel(
         float* output,
         const float** reid_fs,
@@ -73,6 +75,26 @@ void gather_feat(
     gather_feat_kernel<<<num, reid_dim>>>(output, reid_fs, strides, dims,
                                           reid_dim, ctrs, feat_ids, num);
 }
+#else
+// BUILD_CPU_ONLY builds this file as c++, same gather as gather_feat_kernel on host
+void gather_feat(
+        float* output,
+        const float** reid_fs,
+        const int* strides,
+        const int* dims,
+        const int reid_dim,
+        const int* ctrs,
+        const int* feat_ids,
+        const int num) {
+    for (int b_idx = 0; b_idx < num; ++b_idx) {
+        int f_idx = feat_ids[b_idx];
+        for (int c_idx = 0; c_idx < reid_dim; ++c_idx) {
+            int pos = dims[f_idx * 2] * (ctrs[b_idx * 2 + 1] + dims[f_idx * 2 + 1] * c_idx) + ctrs[b_idx * 2];
+            output[b_idx * reid_dim + c_idx] = *(reid_fs[f_idx] + pos);
+        }
+    }
+}
+#endif  // CPU_ONLY
 
 vector<vector<float>> getReidFeature_GPU(vector<Bbox> boxes, vector<float*> reid_fs, vector<nvinfer1::Dims> dims, vector<int> strides) {
     int num_boxes = boxes.size();
@@ -183,9 +205,10 @@ vector<vector<float>> getReidFeature(vector<Bbox> boxes, vector<float*> reid_fs,
 }
 
 std::pair<std::vector<std::vector<std::array<float, 5>>>, std::vector<std::vector<std::vector<float>>>>
-f_track_postProcess(vector <float*> inputs,
+f_track_postProcess(vector<BindingView> inputs,
         vector<size_t >sizes,
         vector<nvinfer1::Dims> dims,
+        int batch_size,
         int mModel_H,
         int mModel_W,
         int NumClass,
@@ -202,7 +225,6 @@ f_track_postProcess(vector <float*> inputs,
 #ifdef CPU
     vector<vector<array<float, 5>>> batch_boxes;
     vector<vector<vector<float>>> batch_reid_feats;
-    int batch_size = dims[0].d[0];
     for (int b = 0; b < batch_size; b++) {
         std::vector<Bbox> bboxes;
         Bbox bbox;
@@ -251,9 +273,9 @@ f_track_postProcess(vector <float*> inputs,
             float* cen_f = (float*)malloc(cen_size);
             float* reg_f = (float*)malloc(reg_size);
 
-            CUDA_CHECK(cudaMemcpy(cls_f, (const float*)inputs[i] + cls_offset * b, cls_size, cudaMemcpyDeviceToHost));
-            CUDA_CHECK(cudaMemcpy(cen_f, (const float*)inputs[i + 2] + cen_offset * b, cen_size, cudaMemcpyDeviceToHost));
-            CUDA_CHECK(cudaMemcpy(reg_f, (const float*)inputs[i + 3] + reg_offset * b , reg_size, cudaMemcpyDeviceToHost));
+            copyBindingToHost(cls_f, inputs[i], cls_offset * b, cls_offset);
+            copyBindingToHost(cen_f, inputs[i + 2], cen_offset * b, cen_offset);
+            copyBindingToHost(reg_f, inputs[i + 3], reg_offset * b, reg_offset);
 
             // CHW
             int index = 0;
@@ -295,14 +317,27 @@ f_track_postProcess(vector <float*> inputs,
     nms_cpu(bboxes, nmsThres);
     // filter(bboxes, area_thresh, ratio);
 
-    vector<float*> features_gpu = {
-        inputs[1] + offset0 * b,
-        inputs[5] + offset1 * b,
-        inputs[9] + offset2 * b,
-    };
-
-    vector<vector<float>> reid_results = getReidFeature_GPU(bboxes, features_gpu, fea_dims, strides);
-    // vector<vector<float>> reid_results = getReidFeature(bboxes, features, fea_dims, strides);
+    const int fea_inputs[3] = {1, 5, 9};
+    const int fea_offsets[3] = {offset0, offset1, offset2};
+    bool gather_on_device = true;
+    for (int k : fea_inputs) {
+        gather_on_device = gather_on_device && inputs[k].on_device && inputs[k].dtype == nvinfer1::DataType::kFLOAT;
+    }
+    // float features of host backend are read in place, half/int8 ones are converted to host first
+    vector<float*> features;
+    vector<vector<float>> converted(3);
+    for (int k = 0; k < 3; ++k) {
+        const BindingView& fea = inputs[fea_inputs[k]];
+        if (gather_on_device || (!fea.on_device && fea.dtype == nvinfer1::DataType::kFLOAT)) {
+            features.push_back(static_cast<float*>(const_cast<void*>(fea.ptr)) + fea_offsets[k] * b);
+        } else {
+            converted[k].resize(fea_offsets[k]);
+            copyBindingToHost(converted[k].data(), fea, static_cast<size_t>(fea_offsets[k]) * b, fea_offsets[k]);
+            features.push_back(converted[k].data());
+        }
+    }
+    vector<vector<float>> reid_results = gather_on_device ? getReidFeature_GPU(bboxes, features, fea_dims, strides)
+                                                          : getReidFeature(bboxes, features, fea_dims, strides);
     if (bboxes.size() != reid_results.size()) 
         cout << "Box size != ReID Feature size.";
     vector<array<float, 5>> one_img_box;
@@ -336,14 +371,14 @@ f_track_postProcess(vector <float*> inputs,
         int W = dims[i].d[3];
         int length = H * W;
 
-        float* cls_f = (float*)inputs[i];
+        float* cls_f = (float*)inputs[i].ptr;
         float* cls_f_sigmod = (float*)malloc(sizes[i]);
         sigmoid_gpu2cpu(cls_f, cls_f_sigmod, sizes[i], 0);  //todo  multi gpu
 
 
-        float* reg_f = (float*)inputs[i + 2];
+        float* reg_f = (float*)inputs[i + 2].ptr;
 
-        float* cen_f = (float*)inputs[i + 1];
+        float* cen_f = (float*)inputs[i + 1].ptr;
         float* cen_f_sigmod = (float*)malloc(sizes[i + 1]);
         sigmoid_gpu2cpu(cen_f, cen_f_sigmod, sizes[i + 1], 0);  //todo  multi gpu
         for (int pos = 0; pos < length; ++pos) {
@@ -12,8 +12,9 @@
 
 #include <NvInfer.h>
 
+#include "binding_convert.h"
 #include "structs.h"
 
-std::pair<std::vector<std::vector<std::array<float, 5>>>, std::vector<std::vector<std::vector<float>>>> f_track_postProcess(std::vector <float*> inputs, std::vector<size_t> sizes, std::vector<nvinfer1::Dims> dims, int mModel_H, int mModel_W, int NumClass, float postThres, float area_thresh, float  ratio, float nmsThres);
+std::pair<std::vector<std::vector<std::array<float, 5>>>, std::vector<std::vector<std::vector<float>>>> f_track_postProcess(std::vector<BindingView> inputs, std::vector<size_t> sizes, std::vector<nvinfer1::Dims> dims, int batch_size, int mModel_H, int mModel_W, int NumClass, float postThres, float area_thresh, float  ratio, float nmsThres);
 
 #endif  // F_TRACK_OUTPUTS_H
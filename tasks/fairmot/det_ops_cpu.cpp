@@ -0,0 +1,141 @@
+#include "det_ops_cpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+static inline float logist(float x) {
+    return 1.f / (1.f + std::exp(-x));
+}
+
+void det_nms_cpu(
+        const float* hm,
+        const float* reg,
+        const float* wh,
+        const float* id_feat,
+        float* output_nms,
+        int* resCount,
+        const int n,
+        const int h,
+        const int w,
+        const int reid_num,
+        const int kernel_h,
+        const int kernel_w,
+        const float score_th,
+        const bool batched) {
+    int stride = h * w;
+    int data_dim = 5 + reid_num;
+    float im_w = w * 4.f, im_h = h * 4.f;
+    if (batched) resCount[0] = 0;
+
+    for (int pn = 0; pn < n; ++pn) {
+        const float* ip = hm + pn * stride;
+        int& count = batched ? resCount[0] : resCount[pn];
+        float* output = batched ? output_nms : output_nms + pn * stride * data_dim;
+        if (!batched) count = 0;
+
+        for (int ph = 0; ph < h; ++ph) {
+            for (int pw = 0; pw < w; ++pw) {
+                int pos = ph * w + pw;
+                float objPred = ip[pos];
+                if (score_th >= objPred) continue;
+
+                /* compute local max: */
+                int hstart = std::max(ph - (kernel_h - 1) / 2, 0);
+                int wstart = std::max(pw - (kernel_w - 1) / 2, 0);
+                int hend = std::min(ph - (kernel_h - 1) / 2 + kernel_h, h);
+                int wend = std::min(pw - (kernel_w - 1) / 2 + kernel_w, w);
+                bool is_max = true;
+                for (int y = hstart; y < hend && is_max; ++y) {
+                    for (int x = wstart; x < wend; ++x) {
+                        if (ip[y * w + x] > objPred) {
+                            is_max = false;
+                            break;
+                        }
+                    }
+                }
+                if (!is_max) continue;
+
+                float* data = output + count * data_dim;
+                ++count;
+
+                const float* rp = reg + pn * 2 * stride + pos;
+                const float* sp = wh + pn * 2 * stride + pos;
+                float cx = (pw + rp[0]) * 4.f;
+                float cy = (ph + rp[stride]) * 4.f;
+                float w_half = sp[0] * 2.f;
+                float h_half = sp[stride] * 2.f;
+                float shift_w = im_w * pn;
+
+                data[0] = logist(objPred);
+                data[1] = std::min(std::max(cx - w_half, 0.f), im_w - 1.f) + shift_w;
+                data[2] = std::min(std::max(cy - h_half, 0.f), im_h - 1.f);
+                data[3] = std::min(std::max(cx + w_half, 0.f), im_w - 1.f) + shift_w;
+                data[4] = std::min(std::max(cy + h_half, 0.f), im_h - 1.f);
+
+                const float* fp = id_feat + pn * reid_num * stride + pos;
+                for (int i = 0; i < reid_num; ++i) {
+                    data[i + 5] = fp[i * stride];
+                }
+            }
+        }
+    }
+}
+
+void det_topk_cpu(
+        const float* input,
+        float* output,
+        const int resCount,
+        const int topk,
+        const int extra_dim,
+        const bool order) {
+    int data_dim = extra_dim + 1;
+    int k = std::min(topk, resCount);
+    std::vector<int> idx(resCount);
+    std::iota(idx.begin(), idx.end(), 0);
+    auto greater = [&](int a, int b) { return input[a * data_dim] > input[b * data_dim]; };
+    std::nth_element(idx.begin(), idx.begin() + k, idx.end(), greater);
+    if (order) {
+        std::sort(idx.begin(), idx.begin() + k, [&](int a, int b) { return greater(b, a); });
+    }
+    for (int i = 0; i < k; ++i) {
+        memcpy(output + i * data_dim, input + idx[i] * data_dim, data_dim * sizeof(float));
+    }
+}
+
+#ifdef CPU_ONLY
+#include "det_post_processor.h"
+
+// BUILD_CPU_ONLY has no kernels, device memory is host memory there
+void det_nms(
+        const float* hm,
+        const float* reg,
+        const float* wh,
+        const float* id_feat,
+        float* output_nms,
+        int* count,
+        int* resCount,
+        const int n,
+        const int h,
+        const int w,
+        const int reid_num,
+        const int kernel_h,
+        const int kernel_w,
+        const float score_th,
+        const bool batched) {
+    det_nms_cpu(hm, reg, wh, id_feat, output_nms, resCount, n, h, w, reid_num, kernel_h, kernel_w, score_th, batched);
+    memcpy(count, resCount, (batched ? 1 : n) * sizeof(int));
+}
+
+void det_topk(
+        float* input,
+        float* output,
+        const int resCount,
+        const int topk,
+        const int extra_dim,
+        const bool order) {
+    det_topk_cpu(input, output, resCount, topk, extra_dim, order);
+}
+#endif  // CPU_ONLY
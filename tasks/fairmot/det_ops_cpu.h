@@ -0,0 +1,43 @@
+/**
+ * Host version of det_nms and det_topk, used by DetPostProcessor when
+ * bindings are host memory.
+ * 2021/02/01
+ */
+
+#ifndef DET_OPS_CPU_H
+#define DET_OPS_CPU_H
+
+/**
+ * Same layout as det_nms: each result is [score, x1, y1, x2, y2, reid...],
+ * batched results are packed from output_nms, otherwise each image owns
+ * h * w * (5 + reid_num) floats.
+ */
+void det_nms_cpu(
+        const float* hm,
+        const float* reg,
+        const float* wh,
+        const float* id_feat,
+        float* output_nms,
+        int* resCount,
+        const int n,
+        const int h,
+        const int w,
+        const int reid_num,
+        const int kernel_h,
+        const int kernel_w,
+        const float score_th,
+        const bool batched);
+
+/**
+ * Keep topk rows with max score(first element of row), rows are kept in
+ * ascending order if order is true since getDets reads them from back.
+ */
+void det_topk_cpu(
+        const float* input,
+        float* output,
+        const int resCount,
+        const int topk,
+        const int extra_dim,
+        const bool order);
+
+#endif  // DET_OPS_CPU_H
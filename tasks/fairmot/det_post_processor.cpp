@@ -1,5 +1,7 @@
 #include "det_post_processor.h"
+#include "det_ops_cpu.h"
 #include "assert.h"
+#include <cstdint>
 #include <iostream>
 
 DetPostProcessor::DetPostProcessor(
@@ -12,8 +14,13 @@ DetPostProcessor::DetPostProcessor(
         int kernel_w,
         float score_thresh,
         bool order,
-        bool batched) :
+        bool batched,
+        bool on_device,
+        void* workspace) :
+        resCount(new int[batch]),
+        res(new float[batch * topk * (5 + reid_dim)]),
         batch(batch),
+        cur_batch(batch),
         height(height),
         width(width),
         reid_dim(reid_dim),
@@ -23,8 +30,22 @@ DetPostProcessor::DetPostProcessor(
         score_th(std::log(score_thresh / (1.f - score_thresh))),
         order(order),
         batched(batched),
-        resCount(new int[batch]),
-        res(new float[batch * topk * (5 + reid_dim)]) {
+        on_device(on_device),
+        own_workspace(workspace == nullptr) {
+    if (workspace) {
+        // counts first, float buffers after them keep 256 byte alignment of workspace
+        size_t count_size = (batch * sizeof(int) + 255) / 256 * 256;
+        nms_count   = static_cast<int*>(workspace);
+        nms_output  = reinterpret_cast<float*>(static_cast<uint8_t*>(workspace) + count_size);
+        topk_output = nms_output + batch * height * width * (5 + reid_dim);
+        return;
+    }
+    if (!on_device) {
+        nms_count   = new int[batch];
+        nms_output  = new float[batch * height * width * (5 + reid_dim)];
+        topk_output = new float[batch * topk * (5 + reid_dim)];
+        return;
+    }
     std::cout
             << "DetPostProcessor: CUDA malloc memory "
             << batch * (sizeof(int) + (topk + height * width) * (5 + reid_dim) * sizeof(float))
@@ -41,9 +62,20 @@ DetPostProcessor::DetPostProcessor(
     cudaMalloc((void**)&nms_output, batch * height * width * (5 + reid_dim) * sizeof(float));
     cudaMalloc((void**)&topk_output, batch * topk * (5 + reid_dim) * sizeof(float));
 }
+size_t DetPostProcessor::workspaceSize(int batch, int height, int width, int reid_dim, int topk) {
+    size_t count_size = (batch * sizeof(int) + 255) / 256 * 256;
+    return count_size + static_cast<size_t>(batch) * (height * width + topk) * (5 + reid_dim) * sizeof(float);
+}
 DetPostProcessor::~DetPostProcessor() {
     delete []resCount;
     delete []res;
+    if (!own_workspace) return;
+    if (!on_device) {
+        delete []nms_count;
+        delete []nms_output;
+        delete []topk_output;
+        return;
+    }
 
     std::cout
             << "DetPostProcessor: CUDA free memory "
@@ -59,7 +91,13 @@ void DetPostProcessor::process(
         const float* hm,
         const float* reg,
         const float* wh,
-        const float* reid) {
+        const float* reid,
+        int n) {
+    cur_batch = (n > 0 && n < batch) ? n : batch;
+    if (!on_device) {
+        processCpu(hm, reg, wh, reid);
+        return;
+    }
     det_nms(
             hm,
             reg,
@@ -68,7 +106,7 @@ void DetPostProcessor::process(
             nms_output,
             nms_count,
             resCount,
-            batch,
+            cur_batch,
             height,
             width,
             reid_dim,
@@ -78,19 +116,19 @@ void DetPostProcessor::process(
             batched);
 
     if (batched) {
-        if (resCount[0] > batch * topk) {
+        if (resCount[0] > cur_batch * topk) {
             det_topk(nms_output,
                      topk_output,
                      resCount[0],
-                     batch * topk,
+                     cur_batch * topk,
                      reid_dim + 4,
                      order);
         }
     } else {
-        for (int i = 0; i < batch; ++i) {
+        for (int i = 0; i < cur_batch; ++i) {
             if (resCount[i] > topk) {
                 det_topk(nms_output + i * height * width * (5 + reid_dim),
-                         topk_output + i * height * width * (5 + reid_dim),
+                         topk_output + i * topk * (5 + reid_dim),
                          resCount[i],
                          topk,
                          reid_dim + 4,
@@ -100,40 +138,69 @@ void DetPostProcessor::process(
     }
 }
 
+void DetPostProcessor::processCpu(
+        const float* hm,
+        const float* reg,
+        const float* wh,
+        const float* reid) {
+    det_nms_cpu(hm, reg, wh, reid, nms_output, resCount, cur_batch, height, width,
+                reid_dim, kernel_h, kernel_w, score_th, batched);
+    if (batched) {
+        if (resCount[0] > cur_batch * topk) {
+            det_topk_cpu(nms_output, topk_output, resCount[0], cur_batch * topk, reid_dim + 4, order);
+        }
+    } else {
+        for (int i = 0; i < cur_batch; ++i) {
+            if (resCount[i] > topk) {
+                det_topk_cpu(nms_output + i * height * width * (5 + reid_dim),
+                             topk_output + i * topk * (5 + reid_dim),
+                             resCount[i],
+                             topk,
+                             reid_dim + 4,
+                             order);
+            }
+        }
+    }
+}
+
+void DetPostProcessor::copyResult(float* dst, const float* src, size_t size) {
+    if (on_device) {
+        cudaMemcpy(dst, src, size, cudaMemcpyDeviceToHost);
+    } else {
+        memcpy(dst, src, size);
+    }
+}
+
 void DetPostProcessor::toCpu() {
     int data_dim = 5 + reid_dim;
 
     if (batched) {
-        if (resCount[0] <= batch * topk) {
-            cudaMemcpy(
+        if (resCount[0] <= cur_batch * topk) {
+            copyResult(
                     res,
                     nms_output,
-                    resCount[0] * data_dim * sizeof(float),
-                    cudaMemcpyDeviceToHost);
+                    resCount[0] * data_dim * sizeof(float));
         } else {
-            resCount[0] = batch * topk;
-            cudaMemcpy(
+            resCount[0] = cur_batch * topk;
+            copyResult(
                     res,
                     topk_output,
-                    resCount[0] * data_dim * sizeof(float),
-                    cudaMemcpyDeviceToHost);
+                    resCount[0] * data_dim * sizeof(float));
         }
     } else {
         int offset = height * width * data_dim;
-        for (int i = 0; i < batch; ++i) {
+        for (int i = 0; i < cur_batch; ++i) {
             if (resCount[i] <= topk) {
-                cudaMemcpy(
-                        res + i * offset,
+                copyResult(
+                        res + i * topk * data_dim,
                         nms_output + i * offset,
-                        resCount[i] * data_dim * sizeof(float),
-                        cudaMemcpyDeviceToHost);
+                        resCount[i] * data_dim * sizeof(float));
             } else {
                 resCount[i] = topk;
-                cudaMemcpy(
-                        res + i * offset,
-                        topk_output + i * offset,
-                        resCount[i] * data_dim * sizeof(float),
-                        cudaMemcpyDeviceToHost);
+                copyResult(
+                        res + i * topk * data_dim,
+                        topk_output + i * topk * data_dim,
+                        resCount[i] * data_dim * sizeof(float));
             }
         }
     }
@@ -164,11 +231,11 @@ DetPostProcessor::getDets() {
     assert(!batched);
     toCpu();
     int data_dim = 5 + reid_dim;
-    int offset = height * width * data_dim;
-    std::vector<std::vector<ARRAY1D(float, 5)>> dets(batch);
-    std::vector<std::vector<std::vector<float>>> id_features(batch);
+    int offset = topk * data_dim;
+    std::vector<std::vector<ARRAY1D(float, 5)>> dets(cur_batch);
+    std::vector<std::vector<std::vector<float>>> id_features(cur_batch);
     float* det;
-    for (int n = 0; n < batch; ++n) {
+    for (int n = 0; n < cur_batch; ++n) {
         dets[n].reserve(topk);
         id_features[n].reserve(topk);
         for (int i = (resCount[n] - 1) * data_dim; i >= 0; i -= data_dim) {
@@ -20,6 +20,7 @@ private:
     float* nms_output;
     float* topk_output;
     const int batch;
+    int cur_batch;  // images in last process, <= batch
     const int height;
     const int width;
     const int reid_dim;
@@ -29,6 +30,8 @@ private:
     const float score_th;
     const bool order;
     const bool batched;
+    const bool on_device;
+    const bool own_workspace;  // nms_count, nms_output and topk_output
 public:
     DetPostProcessor() = delete;
     DetPostProcessor(
@@ -41,18 +44,31 @@ public:
             int kernel_w = 3,
             float score_th = 0.6f,
             bool order = true,
-            bool batched = true);
+            bool batched = true,
+            bool on_device = true,
+            void* workspace = nullptr);
     ~DetPostProcessor();
+    // bytes of nms_count, nms_output and topk_output, which could be passed in as
+    // workspace(device memory if on_device) instead of allocated by constructor
+    static size_t workspaceSize(int batch, int height, int width, int reid_dim, int topk = 32);
+    // n: images actually in bindings, full batch if n <= 0
     void process(
             const float* hm,
             const float* reg,
             const float* wh,
-            const float* reid);
+            const float* reid,
+            int n = 0);
     std::pair<std::vector<ARRAY1D(float, 5)>,
             std::vector<std::vector<float>>> getDets_batched();
     std::pair<std::vector<std::vector<ARRAY1D(float, 5)>>,
             std::vector<std::vector<std::vector<float>>>> getDets();
 private:
+    void processCpu(
+            const float* hm,
+            const float* reg,
+            const float* wh,
+            const float* reid);
+    void copyResult(float* dst, const float* src, size_t size);
     void toCpu();
 };
 
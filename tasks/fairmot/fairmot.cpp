@@ -3,51 +3,63 @@
 #include "fairmot.h"
 
 FairMOT::FairMOT(const YAML::Node& cfg) : TrackTask(cfg) {
-    mDetPostProcessor = new DetPostProcessor(mBatchSize, mModel_H / 4, mModel_W / 4, 512, 32, 3, 3, 0.6, true);
+    initOutputIndex(4);
+    // DetPostProcessor decodes bindings in place, it has no half/int8 kernels
+    auto generation = currentGeneration();
+    for (int idx : mOutputIndex) {
+        if (generation && generation->Net()->GetBindingDataType(idx) != nvinfer1::DataType::kFLOAT) {
+            mLogger.logger("FairMOT decodes float outputs only, set `output_type: float`, binding: ", generation->Net()->mBindingName[idx], logger::LEVEL::ERROR);
+        }
+    }
 }
 
-FairMOT::~FairMOT() {
-    delete mDetPostProcessor;
-    mDetPostProcessor = nullptr;
+bool FairMOT::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return TrackTask::prepareInputs(state, imgs);
 }
 
-bool FairMOT::prepareInputs(const vector<Mat>& imgs) {
-    return TrackTask::prepareInputs(imgs);
+size_t FairMOT::workspaceSize(const ExecState& state) const {
+    return DetPostProcessor::workspaceSize(mBatchSize, state.inputH / 4, state.inputW / 4, 512, 32);
 }
 
-TrackRes FairMOT::processOutputs() {
-    DetPostProcessor& det_post_processer = *mDetPostProcessor;
-    vector<int> idx_list = cfg["params"]["output_index"].as<vector<int>>();
-    float* feat_gpu = (float*)mNet->GetBindingPtr(idx_list[0]);
-    float* wh_gpu = (float*)mNet->GetBindingPtr(idx_list[1]);;
-    float* reg_gpu = (float*)mNet->GetBindingPtr(idx_list[2]);;
-    float* reid_gpu = (float*)mNet->GetBindingPtr(idx_list[3]);;
+TrackRes FairMOT::processOutputs(ExecState& state) {
+    // post process buffers live with state, freed with engine generation of it, or
+    // in workspace of state if memory planner placed them
+    DetPostProcessor& det_post_processer = state.scratch<DetPostProcessor>(
+        mBatchSize, state.inputH / 4, state.inputW / 4, 512, 32, 3, 3, 0.6, true, false, state.net->IsDeviceMemory(), state.workspace);
+    float* feat_gpu = (float*)state.net->GetBindingPtr(mOutputIndex[0]);
+    float* wh_gpu = (float*)state.net->GetBindingPtr(mOutputIndex[1]);;
+    float* reg_gpu = (float*)state.net->GetBindingPtr(mOutputIndex[2]);;
+    float* reid_gpu = (float*)state.net->GetBindingPtr(mOutputIndex[3]);;
 
-    det_post_processer.process(feat_gpu, reg_gpu, wh_gpu, reid_gpu);
+    det_post_processer.process(feat_gpu, reg_gpu, wh_gpu, reid_gpu, state.net->GetBatchSize());
     auto res = det_post_processer.getDets();
+    mapToSource(res.first, state.transforms);
 
     return res;
 }
 
 TrackRes FairMOT::run(const vector<Mat>& imgs) {
-    mTimer->dataStart();
-    if (!prepareInputs(imgs)) {
+    ExecPool::Lease state = acquireState(imgs);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareInputs(*state, imgs)) {
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("FairMOT Data  time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("FairMOT Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("FairMOT Post  time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("FairMOT Data  time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("FairMOT Data  stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+        mLogger.logger("FairMOT Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("FairMOT Post  time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
     return results;
@@ -21,16 +21,14 @@ using namespace cv;
 class FairMOT : public TrackTask {
 public:
     FairMOT(const YAML::Node& cfg);
-    ~FairMOT();
 
+    using TrackTask::run;  // views of caller buffers
     TrackRes run(const vector<Mat>& imgs);
 
 private:
-    bool prepareInputs(const vector<Mat>& imgs) override;
-    TrackRes processOutputs() override;
-
-private:
-    DetPostProcessor *mDetPostProcessor;
+    bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    TrackRes processOutputs(ExecState& state) override;
+    size_t workspaceSize(const ExecState& state) const override;
 };
 
 #endif  /// FAIRMOT_H
@@ -3,50 +3,55 @@
 #include "fcos.h"
 #include "fcos_outputs.h"
 
-FCOS::FCOS(const YAML::Node& cfg) : DetectionTask(cfg) {
+FCOS::FCOS(const YAML::Node& cfg)
+    : DetectionTask(cfg),
+      mDetThresh(cfg["params"]["det_thresh"].as<float>()),
+      mNmsThresh(cfg["params"]["nms_thresh"].as<float>()) {
     mNumClasses = cfg["params"]["num_classes"].as<int>();
+    initOutputIndex(9);
 }
 
-bool FCOS::prepareInputs(const vector<Mat>& imgs) {
-    return DetectionTask::prepareInputs(imgs);
+bool FCOS::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return DetectionTask::prepareInputs(state, imgs);
 }
 
-BatchBox FCOS::processOutputs() {
-    vector<float*> inputs;
+BatchBox FCOS::processOutputs(ExecState& state) {
+    vector<BindingView> inputs;
     vector<size_t> sizes;
     vector<nvinfer1::Dims> dims;
-    vector<int> idx_list = cfg["params"]["output_index"].as<vector<int>>();
-    for (int i = 0; i < 9; ++i) {  // get size  TODO
-        //fcos  onnx outputs from 1-9
-        inputs.push_back((float*)mNet->GetBindingPtr(idx_list[i]));
-        sizes.push_back((size_t)mNet->GetBindingSize(idx_list[i]));
-        dims.push_back(mNet->GetBindingDims(idx_list[i]));
+    for (int idx : mOutputIndex) {
+        //fcos  onnx outputs, 3 center_ness, 3 reg, 3 classification
+        inputs.push_back(outputBinding(state.net, idx));
+        sizes.push_back((size_t)state.net->GetBindingSize(idx));
+        dims.push_back(state.net->GetBindingDims(idx));
     }
-    float det_thresh = cfg["params"]["det_thresh"].as<float>();
-    float nms_thresh = cfg["params"]["nms_thresh"].as<float>();
-    BatchBox results = postProcess(inputs, sizes, dims, mModel_H, mModel_W,  mNumClasses, det_thresh, nms_thresh);
+    BatchBox results = postProcess(inputs, sizes, dims, state.net->GetBatchSize(), state.inputH, state.inputW,  mNumClasses, mDetThresh, mNmsThresh);
+    mapToSource(results, state.transforms);
     return results;
 }
 
 BatchBox FCOS::run(const vector<Mat>& imgs) {
-    mTimer->dataStart();
-    if (!prepareInputs(imgs)) {
+    ExecPool::Lease state = acquireState(imgs);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareInputs(*state, imgs)) {
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("FCOS Data time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("FCOS Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("FCOS Post time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("FCOS Data time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("FCOS Data stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+        mLogger.logger("FCOS Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("FCOS Post time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
 	return results;
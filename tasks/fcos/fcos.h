@@ -25,14 +25,17 @@ public:
     FCOS(const YAML::Node& cfg);
     ~FCOS() = default;
 
+    using DetectionTask::run;  // views of caller buffers
     BatchBox run(const vector<Mat>& imgs) override;
 
 private:
-    bool prepareInputs(const vector<Mat>& imgs) override;
-    BatchBox processOutputs() override;
+    bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    BatchBox processOutputs(ExecState& state) override;
 
 private:
     int mNumClasses;
+    const float mDetThresh;
+    const float mNmsThresh;
 };
 
 #endif  // FCOS_H
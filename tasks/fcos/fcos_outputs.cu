@@ -1,6 +1,7 @@
 #include "fcos_outputs.h"
 
 #include <cassert>
+#include <cmath>
 
 #include "misc.h"
 #include "nms_cpu.h"
@@ -14,7 +15,7 @@ __device__ __inline__ float logist(float x) {
 
 // =============Post Process=============>
 
-BatchBox postProcess(vector <float*> inputs,vector<size_t >sizes, vector<nvinfer1::Dims> dims, int mModel_H, int mModel_W, int NumClass, float postThres, float nmsThres) {
+BatchBox postProcess(vector<BindingView> inputs,vector<size_t >sizes, vector<nvinfer1::Dims> dims, int batch_size, int mModel_H, int mModel_W, int NumClass, float postThres, float nmsThres) {
     assert(inputs.size() == sizes.size());
     assert(inputs.size() == dims.size());
 	std::vector<Bbox> bboxes_nms;  // outputs
@@ -22,7 +23,6 @@ BatchBox postProcess(vector <float*> inputs,vector<size_t >sizes, vector<nvinfer
 
 #define CPU
 #ifdef CPU
-    int batch_size = dims[0].d[0];
 	vector<vector<array<float, 5>>> batch_boxes;
 //	batch_boxes.resize(batch_size);
 
@@ -47,9 +47,9 @@ BatchBox postProcess(vector <float*> inputs,vector<size_t >sizes, vector<nvinfer
 			float* cen_f = (float*)malloc(cen_size);
 			float* reg_f = (float*)malloc(reg_size);
 
-			CUDA_CHECK(cudaMemcpy(cls_f, (const float*)inputs[i] + cls_offset * b, cls_size, cudaMemcpyDeviceToHost));
-			CUDA_CHECK(cudaMemcpy(cen_f, (const float*)inputs[i + 1] + cen_offset * b, cen_size, cudaMemcpyDeviceToHost));
-			CUDA_CHECK(cudaMemcpy(reg_f, (const float*)inputs[i + 2] + reg_offset * b , reg_size, cudaMemcpyDeviceToHost));
+			copyBindingToHost(cls_f, inputs[i], cls_offset * b, cls_offset);
+			copyBindingToHost(cen_f, inputs[i + 1], cen_offset * b, cen_offset);
+			copyBindingToHost(reg_f, inputs[i + 2], reg_offset * b, reg_offset);
 //            cout << "* cls_f" << * cls_f << * (cls_f + 1) << * (cls_f + 2) <<endl;
 //		    cout << "* reg_f" << * reg_f << * (reg_f + 1) << * (reg_f + 2) <<endl;
 //		    cout << "* cen_f" << * cen_f << * (cen_f + 1) << * (cen_f + 2) <<endl;
@@ -127,12 +127,12 @@ BatchBox postProcess(vector <float*> inputs,vector<size_t >sizes, vector<nvinfer
 		int H = dims[i].d[2];
 		int W = dims[i].d[3];
 		int length = H * W;
-		float* cls_f = (float*)inputs[i];
+		float* cls_f = (float*)inputs[i].ptr;
 		float* cls_f_sigmod = (float*)malloc(sizes[i]);
 		sigmoid_gpu2cpu(cls_f, cls_f_sigmod, sizes[i], 0);  //todo  multi gpu
-		float* reg_f = (float*)inputs[i + 2];
+		float* reg_f = (float*)inputs[i + 2].ptr;
 
-		float* cen_f = (float*)inputs[i + 1];
+		float* cen_f = (float*)inputs[i + 1].ptr;
 		float* cen_f_sigmod = (float*)malloc(sizes[i + 1]);
 		sigmoid_gpu2cpu(cen_f, cen_f_sigmod, sizes[i + 1], 0);  //todo  multi gpu
 		for(int pos = 0; pos < length; ++pos) {
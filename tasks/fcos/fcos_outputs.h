@@ -11,8 +11,9 @@
 
 #include <NvInfer.h>
 
+#include "binding_convert.h"
 #include "structs.h"
 
-BatchBox postProcess(std::vector <float*> inputs, std::vector<size_t> sizes, std::vector<nvinfer1::Dims> dims, int mModel_H, int mModel_W, int NumClass, float postThres, float nmsThres);
+BatchBox postProcess(std::vector<BindingView> inputs, std::vector<size_t> sizes, std::vector<nvinfer1::Dims> dims, int batch_size, int mModel_H, int mModel_W, int NumClass, float postThres, float nmsThres);
 
 #endif  // FCOSOUTPUTS_H
@@ -1,16 +1,18 @@
 #include "semseg.h"
 #include "semseg_outputs.h"
 
+#include <cassert>
+
 SEMSEG::SEMSEG(const YAML::Node& cfg) : SegmentationTask(cfg) {
     mNumClasses = cfg["params"]["num_classes"].as<int>();
 }
 
-bool SEMSEG::prepareInputs(const vector<Mat>& imgs) {
-    return SegmentationTask::prepareInputs(imgs);
+bool SEMSEG::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return SegmentationTask::prepareInputs(state, imgs);
 }
 
-vector<Mat> SEMSEG::processOutputs() {
-    vector<Mat> semseg_results(mBatchSize);
+vector<Mat> SEMSEG::processOutputs(ExecState& state) {
+    vector<Mat> semseg_results;
     // process outputs in semseg_outputs.cu, for result tensor
     // vector<int> idx_list = cfg["params"]["output_index"].as<vector<int>>();
     // vector<float*> outputs;
@@ -24,38 +26,48 @@ vector<Mat> SEMSEG::processOutputs() {
     // postProcess(outputs, semseg_results, dims);
     // copy to mat directly, for tensor is after argmax function.
     int output_idx = 1;
-    int stride = mModel_W * mModel_H;
+    int stride = state.inputW * state.inputH;
     vector<float> semseg_outputs(mBatchSize * mNumClasses * stride);
-    mNet->CopyFromDeviceToHost(semseg_outputs, output_idx, mStream);
-    for (int b = 0; b < mBatchSize; ++b) {
+    size_t count = state.net->GetBindingSize(output_idx) / getElementSize(state.net->GetBindingDataType(output_idx));
+    copyBindingToHost(semseg_outputs.data(), outputBinding(state.net, output_idx), 0, std::min(count, semseg_outputs.size()));
+    for (int b = 0; b < state.net->GetBatchSize(); ++b) {
         auto output = vector<float>(semseg_outputs.begin() + stride * b, semseg_outputs.begin() + stride * (b + 1));
         Mat temp = Mat(output);
-        Mat semseg = temp.reshape(1, mModel_H).clone();
+        Mat semseg = temp.reshape(1, state.inputH).clone();
+        // back to source image: drop letterbox borders and resize labels by nearest
+        if (b < static_cast<int>(state.transforms.size()) && !state.transforms[b].identity()) {
+            const ImageTransform& t = state.transforms[b];
+            Rect content(t.pad_x, t.pad_y, t.dst_w - 2 * t.pad_x, t.dst_h - 2 * t.pad_y);
+            cv::resize(semseg(content), semseg, cv::Size(t.src_w, t.src_h), 0, 0, cv::INTER_NEAREST);
+        }
         semseg_results.emplace_back(semseg);
     }
     return semseg_results;
 }
 
 vector<Mat> SEMSEG::run(const vector<Mat>& imgs) {
-    mTimer->dataStart();
-    if (!prepareInputs(imgs)) {
+    ExecPool::Lease state = acquireState(imgs);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareInputs(*state, imgs)) {
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
         assert(false);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("Semseg Data  time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Semseg Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("Semseg Post  time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("Semseg Data  time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Semseg Data  stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+        mLogger.logger("Semseg Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("Semseg Post  time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
     return results;
@@ -23,11 +23,12 @@ public:
     SEMSEG(const YAML::Node& cfg);
     ~SEMSEG() = default;
 
+    using SegmentationTask::run;  // views of caller buffers
     vector<Mat> run(const vector<Mat>& imgs) override;
 
 private:
-    bool prepareInputs(const vector<Mat>& imgs) override;
-    vector<Mat> processOutputs() override;
+    bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    vector<Mat> processOutputs(ExecState& state) override;
 
 private:
     int mNumClasses;
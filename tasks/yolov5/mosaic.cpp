@@ -0,0 +1,75 @@
+#include "mosaic.h"
+
+#include <algorithm>
+#include <numeric>
+
+std::vector<std::vector<MosaicTile>> packMosaic(const std::vector<ImageView>& views, int width, int height, int gap) {
+    std::vector<int> order(views.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return views[a].rows() != views[b].rows() ? views[a].rows() > views[b].rows() : views[a].cols() > views[b].cols();
+    });
+    std::vector<std::vector<MosaicTile>> canvases;
+    int x = 0, y = 0, shelf = 0;  // next tile at x of shelf at y, shelf is height of its first(tallest) tile
+    for (int i : order) {
+        int w = views[i].cols();
+        int h = views[i].rows();
+        if (!canvases.empty() && x + w > width) {
+            x = 0;
+            y += shelf + gap;
+            shelf = 0;
+        }
+        if (canvases.empty() || y + h > height) {
+            canvases.emplace_back();
+            x = y = shelf = 0;
+        }
+        MosaicTile tile;
+        tile.image = i;
+        ImageTransform& t = tile.transform;
+        t.src_w = t.resized_w = w;
+        t.src_h = t.resized_h = h;
+        t.dst_w = width;
+        t.dst_h = height;
+        t.pad_x = x;
+        t.pad_y = y;
+        t.offset_x = views[i].roi_x;
+        t.offset_y = views[i].roi_y;
+        canvases.back().push_back(tile);
+        x += w + gap;
+        shelf = std::max(shelf, h);
+    }
+    return canvases;
+}
+
+static bool overlaps(const Bbox& box, const ImageTransform& t) {
+    return box.xmin < t.pad_x + t.resized_w && box.xmax > t.pad_x && box.ymin < t.pad_y + t.resized_h &&
+           box.ymax > t.pad_y;
+}
+
+std::vector<std::vector<Bbox>> splitMosaic(const std::vector<Bbox>& boxes, const std::vector<MosaicTile>& tiles) {
+    std::vector<std::vector<Bbox>> split(tiles.size());
+    for (const Bbox& box : boxes) {
+        float cx = (box.xmin + box.xmax) / 2;
+        float cy = (box.ymin + box.ymax) / 2;
+        int owner = -1;
+        bool crosses = false;
+        for (int i = 0; i < static_cast<int>(tiles.size()); ++i) {
+            const ImageTransform& t = tiles[i].transform;
+            if (cx >= t.pad_x && cx < t.pad_x + t.resized_w && cy >= t.pad_y && cy < t.pad_y + t.resized_h) {
+                owner = i;
+            } else if (overlaps(box, t)) {
+                crosses = true;
+            }
+        }
+        if (owner < 0 || crosses) continue;
+        // tiles are at scale 1, only origin changes
+        const ImageTransform& t = tiles[owner].transform;
+        Bbox mapped = box;
+        mapped.xmin = t.offset_x + std::min(std::max(box.xmin - t.pad_x, 0.f), static_cast<float>(t.src_w));
+        mapped.ymin = t.offset_y + std::min(std::max(box.ymin - t.pad_y, 0.f), static_cast<float>(t.src_h));
+        mapped.xmax = t.offset_x + std::min(std::max(box.xmax - t.pad_x, 0.f), static_cast<float>(t.src_w));
+        mapped.ymax = t.offset_y + std::min(std::max(box.ymax - t.pad_y, 0.f), static_cast<float>(t.src_h));
+        split[owner].push_back(mapped);
+    }
+    return split;
+}
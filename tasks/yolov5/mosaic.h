@@ -0,0 +1,41 @@
+/**
+ * Mosaic packing of small images: several images at their own size share one
+ * model input(canvas), each a tile of it, detections of a canvas are split back
+ * to images by tile. Used by YOLOV5 with `params: mosaic`.
+ * 2021/07/19
+ */
+
+#ifndef MOSAIC_H
+#define MOSAIC_H
+
+#include <vector>
+
+#include "structs.h"
+
+struct MosaicTile {
+    int image = 0;             // index of image in views packed
+    ImageTransform transform;  // scale 1, tile at pad_x, pad_y of canvas, resized_w x resized_h
+};
+
+/**
+ * Pack views into canvases of width x height, tallest first onto shelves(next
+ * fit decreasing height), gap pixels between tiles and shelves. Every view must
+ * fit a canvas. Transforms map tile back to roi of its view, as letterbox
+ * transforms do.
+ */
+std::vector<std::vector<MosaicTile>> packMosaic(
+        const std::vector<ImageView>& views,
+        int width,
+        int height,
+        int gap);
+
+/**
+ * Boxes in canvas coordinates to boxes of every tile in coordinates of its
+ * image. A box belongs to tile holding its center and is clipped to it, boxes
+ * with center outside all tiles or reaching into another tile are dropped.
+ */
+std::vector<std::vector<Bbox>> splitMosaic(
+        const std::vector<Bbox>& boxes,
+        const std::vector<MosaicTile>& tiles);
+
+#endif  // MOSAIC_H
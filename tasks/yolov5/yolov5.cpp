@@ -6,6 +6,7 @@
 
 YOLOV5::YOLOV5(const YAML::Node& cfg) : DetectionTask(cfg) {
     initParams();
+    initOutputIndex(3);
 }
 
 void YOLOV5::initParams() {
@@ -28,92 +29,170 @@ void YOLOV5::initParams() {
     mYoloParams.nms_thresh  = cfg["params"]["nms_thresh"].as<float>();
     mYoloParams.post_thresh = cfg["params"]["post_thresh"].as<float>();
     mYoloParams.padding     = cfg["params"]["padding"].as<bool>();
+    mYoloParams.mosaic      = cfg["params"]["mosaic"] && cfg["params"]["mosaic"].as<bool>();
+    mYoloParams.mosaic_max_tile = cfg["params"]["mosaic_max_tile"] ? cfg["params"]["mosaic_max_tile"].as<int>() : mModel_W / 2;
+    mYoloParams.mosaic_gap  = cfg["params"]["mosaic_gap"] ? cfg["params"]["mosaic_gap"].as<int>() : 8;
 }
 
-bool YOLOV5::prepareInputs(const vector<Mat>& imgs) {
-    vector<Mat> processed_ims;
-    for (auto im : imgs) {
-        cv::Mat processed_im(mYoloParams.height, mYoloParams.width, CV_8UC3);
-        int dh = 0;
-        int dw = 0;
-        if (mYoloParams.padding) {
-            int ih = im.rows;
-            int iw = im.cols;
-            float scale = std::min(static_cast<float>(mYoloParams.width) / static_cast<float>(iw), static_cast<float>(mYoloParams.height) / static_cast<float>(ih));
-            int nh = static_cast<int>(scale * static_cast<float>(ih));
-            int nw = static_cast<int>(scale * static_cast<float>(iw));
-            dh = (mYoloParams.height - nh) / 2;
-            dw = (mYoloParams.width - nw) / 2;
-            cv::resize(im, processed_im, cv::Size(nw, nh));
-            cv::copyMakeBorder(processed_im, processed_im, dh, mYoloParams.height-nh-dh, dw, mYoloParams.width-nw-dw, cv::BORDER_CONSTANT, cv::Scalar(114, 114, 114));
-        } else {
-            cv::resize(im, processed_im, cv::Size(mYoloParams.width, mYoloParams.height));
-        }
-        processed_ims.emplace_back(processed_im);
-    }
+bool YOLOV5::prepareInputs(ExecState& state, const vector<Mat>& imgs) {
+    return DetectionTask::prepareInputs(state, imgs);
+}
 
-    int img_stride = 3 * mModel_W * mModel_H;
-    for (int i = 0; i < mBatchSize; ++i) {
-        cudaMemcpy(
-                mInputDataNHWC + i * img_stride,
-                processed_ims[i].data,
-                img_stride * sizeof(uint8_t),
-                cudaMemcpyHostToDevice);
-    }
-//    cout << "imgs[i].data " << (float)processed_ims[0].data[0] << " "<< (float)processed_ims[0].data[1] << " "<< (float)processed_ims[0].data[2]<<endl;
-    vector<float> means = cfg["params"]["means"].as<vector<float>>();
-    vector<float> stds  = cfg["params"]["stds"].as<vector<float>>();
-
-    NHWC2NCHW(
-            mInputDataNHWC,
-            (float*)mNet->GetBindingPtr(0),
-            mBatchSize,
-            mModel_H,
-            mModel_W,
-            means[0], means[1], means[2],
-            stds[0], stds[1], stds[2],
-            mImageFormat);
-//    float* test_im = (float*)malloc(640*640*3*sizeof(float));
-//    cudaMemcpy(test_im, (float*)mNet->GetBindingPtr(0), 640*640*3*sizeof(float), cudaMemcpyDeviceToHost);
-//    cout << "imgsL : " << test_im[0] << " " << test_im[1] << " " << test_im[2] << endl;
-    return true;
+bool YOLOV5::prepareViews(ExecState& state, const vector<ImageView>& views) {
+    // letterbox, border, normalization in one pass to input of engine of state
+    return prepareFused(state, views);
 }
 
-BatchBox YOLOV5::processOutputs() {
-    vector <float*> inputs;
+BatchBox YOLOV5::processOutputs(ExecState& state) {
+    vector<BindingView> inputs;
     vector<size_t >sizes;
     vector<nvinfer1::Dims> dims;
-    vector<int> idx_list = cfg["params"]["output_index"].as<vector<int>>();
-    for (int i = 0; i < 3; ++i) {
-        inputs.push_back((float*)mNet->GetBindingPtr(idx_list[i]));
-        sizes.push_back((size_t)mNet->GetBindingSize(idx_list[i]));
-        dims.push_back(mNet->GetBindingDims(idx_list[i]));
+    for (int idx : mOutputIndex) {
+        inputs.push_back(outputBinding(state.net, idx));
+        sizes.push_back((size_t)state.net->GetBindingSize(idx));
+        dims.push_back(state.net->GetBindingDims(idx));
     }
-    BatchBox results = postProcess(inputs, sizes, dims, mYoloParams, mInputImgs);
+    YOLOParams params = mYoloParams;
+    params.width  = state.inputW;
+    params.height = state.inputH;
+    BatchBox results = postProcess(inputs, sizes, dims, params, state.transforms);
     return results;
 }
 
 BatchBox YOLOV5::run(const vector<Mat>& imgs) {
-    mInputImgs = imgs;  // for decode in post process
-    mTimer->dataStart();
-    if (!prepareInputs(imgs)) {
+    if (mYoloParams.mosaic) {
+        for (const auto& img : imgs) {
+            if (img.empty() || img.type() != CV_8UC3) {
+                mLogger.logger("Images should be 8 bit bgr.", logger::LEVEL::ERROR);
+                return BatchBox(imgs.size());
+            }
+        }
+        return runMosaic(imageViews(imgs));
+    }
+    ExecPool::Lease state = acquireState(imgs);
+    Timer* timer = state->timer;
+    timer->dataStart();
+    if (!prepareInputs(*state, imgs)) {
         mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
     }
-    mTimer->dataEnd();
+    timer->dataEnd();
 
-    mTimer->inferStart();
-    mNet->ForwardAsync(mStream);
-    mTimer->inferEnd();
+    timer->inferStart();
+    state->net->ForwardAsync(state->stream);
+    timer->inferEnd();
 
-    mTimer->postStart();
-    auto results = processOutputs();
-    mTimer->postEnd();
+    timer->postStart();
+    auto results = processOutputs(*state);
+    timer->postEnd();
 
-    if (mTimer->showTime()) {
-        mLogger.logger("YOLO Data  time: ", mTimer->getDataTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("YOLO Infer time: ", mTimer->getInferTime(), "ms", logger::LEVEL::INFO);
-        mLogger.logger("YOLO Post  time: ", mTimer->getPostTime(), "ms", logger::LEVEL::INFO);
+    if (timer->showTime()) {
+        mLogger.logger("YOLO Data  time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("YOLO Data  stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+        mLogger.logger("YOLO Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+        mLogger.logger("YOLO Post  time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
     }
 
     return results;
 }
+
+BatchBox YOLOV5::run(const vector<ImageView>& views) {
+    return mYoloParams.mosaic ? runMosaic(views) : DetectionTask::run(views);
+}
+
+BatchBox YOLOV5::runMosaic(const vector<ImageView>& views) {
+    BatchBox results(views.size());
+    std::shared_ptr<ExecGeneration> generation = currentGeneration();
+    int width = generation->InputW();
+    int height = generation->InputH();
+    int max_tile = mYoloParams.mosaic_max_tile;
+    vector<ImageView> tiles, singles;
+    vector<int> tile_index, single_index;
+    for (int i = 0; i < static_cast<int>(views.size()); ++i) {
+        const ImageView& view = views[i];
+        if (!view.valid()) {
+            mLogger.logger("Image view is empty or roi is out of image, stride: ", view.stride, logger::LEVEL::ERROR);
+            return results;
+        }
+        bool small = view.cols() <= std::min(max_tile, width) && view.rows() <= std::min(max_tile, height);
+        (small ? tiles : singles).push_back(view);
+        (small ? tile_index : single_index).push_back(i);
+    }
+    // large images letterboxed one per input as without mosaic, before leasing a state for canvases
+    for (size_t first = 0; first < singles.size(); first += mBatchSize) {
+        size_t last = std::min(first + mBatchSize, singles.size());
+        BatchBox boxes = DetectionTask::run(vector<ImageView>(singles.begin() + first, singles.begin() + last));
+        for (size_t k = first; k < last; ++k) {
+            results[single_index[k]] = std::move(boxes[k - first]);
+        }
+    }
+    if (tiles.empty()) return results;
+
+    vector<vector<MosaicTile>> canvases = packMosaic(tiles, width, height, mYoloParams.mosaic_gap);
+    // state of generation tiles were packed for, engine may swap meanwhile
+    ExecPool::Lease state = generation->Acquire();
+    if (state->net->IsDeviceMemory() && !mNX_ON) CUDA_CHECK(cudaSetDevice(mGPU_ID));
+    Timer* timer = state->timer;
+    for (size_t first = 0; first < canvases.size(); first += mBatchSize) {
+        size_t last = std::min(first + mBatchSize, canvases.size());
+        vector<vector<MosaicTile>> batch(canvases.begin() + first, canvases.begin() + last);
+        timer->dataStart();
+        if (!prepareMosaic(*state, tiles, batch)) {
+            mLogger.logger("Prepare Input Data Failed!", logger::LEVEL::ERROR);
+        }
+        timer->dataEnd();
+
+        timer->inferStart();
+        state->net->ForwardAsync(state->stream);
+        timer->inferEnd();
+
+        timer->postStart();
+        BatchBox boxes = processMosaic(*state, batch, static_cast<int>(tiles.size()));
+        timer->postEnd();
+
+        for (const auto& canvas : batch) {
+            for (const auto& tile : canvas) {
+                results[tile_index[tile.image]] = std::move(boxes[tile.image]);
+            }
+        }
+
+        if (timer->showTime()) {
+            mLogger.logger("YOLO Mosaic canvases: ", batch.size(), logger::LEVEL::INFO);
+            mLogger.logger("YOLO Data  time: ", timer->getDataTime(), "ms", logger::LEVEL::INFO);
+            mLogger.logger("YOLO Data  stages: ", timer->getDataStages(), logger::LEVEL::INFO);
+            mLogger.logger("YOLO Infer time: ", timer->getInferTime(), "ms", logger::LEVEL::INFO);
+            mLogger.logger("YOLO Post  time: ", timer->getPostTime(), "ms", logger::LEVEL::INFO);
+        }
+    }
+    return results;
+}
+
+bool YOLOV5::prepareMosaic(ExecState& state, const vector<ImageView>& views, const vector<vector<MosaicTile>>& canvases) {
+    int batch = static_cast<int>(canvases.size());
+    // boxes of canvases stay in canvas coordinates, tiles map them back
+    state.transforms.assign(batch, letterboxTransform(state.inputW, state.inputH, state.inputW, state.inputH, false));
+    return stageInputs(state, batch, [&](int i, Mat& canvas, uint8_t*) {
+        // gaps and rest of canvas are gray as letterbox border
+        canvas.setTo(cv::Scalar(114, 114, 114));
+        for (const auto& tile : canvases[i]) {
+            const ImageTransform& t = tile.transform;
+            Mat region(canvas, cv::Rect(t.pad_x, t.pad_y, t.resized_w, t.resized_h));
+            resizeView(views[tile.image], region, false);
+        }
+        return true;
+    });
+}
+
+BatchBox YOLOV5::processMosaic(ExecState& state, const vector<vector<MosaicTile>>& canvases, int count) {
+    vector<BindingView> inputs;
+    vector<size_t> sizes;
+    vector<nvinfer1::Dims> dims;
+    for (int idx : mOutputIndex) {
+        inputs.push_back(outputBinding(state.net, idx));
+        sizes.push_back((size_t)state.net->GetBindingSize(idx));
+        dims.push_back(state.net->GetBindingDims(idx));
+    }
+    YOLOParams params = mYoloParams;
+    params.width  = state.inputW;
+    params.height = state.inputH;
+    return postProcessMosaic(inputs, sizes, dims, params, canvases, count);
+}
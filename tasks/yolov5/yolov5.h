@@ -15,6 +15,7 @@
 #include "timer.h"
 #include "utils.h"
 #include "tasks.h"
+#include "mosaic.h"
 
 using namespace std;
 using namespace cv;
@@ -31,23 +32,37 @@ struct YOLOParams{
     float nms_thresh;
     float post_thresh;
     bool padding;
+    bool mosaic;          // pack images up to mosaic_max_tile on both sides into shared inputs, see mosaic.h
+    int mosaic_max_tile;
+    int mosaic_gap;       // pixels between tiles
 	std::string color_mode;
     std::vector<std::vector<Anchor>> anchors;
 };
 
-class YOLOV5 : DetectionTask {
+class YOLOV5 : public DetectionTask {
 public:
     YOLOV5(const YAML::Node& cfg);
     BatchBox run(const vector<Mat>& imgs) override;
+    BatchBox run(const vector<ImageView>& views) override;  // views of caller buffers
 
 private:
     void initParams();
-    bool prepareInputs(const vector<Mat>& imgs) override;
-    BatchBox processOutputs() override;
+    bool prepareInputs(ExecState& state, const vector<Mat>& imgs) override;
+    bool prepareViews(ExecState& state, const vector<ImageView>& views) override;
+    BatchBox processOutputs(ExecState& state) override;
+
+    /**
+    ! Mosaic mode: any count of images, small ones packed into canvases of input
+    ! size, max batch of canvases per forward, larger ones run as without it.
+    ! prepareMosaic: tiles at their own size onto gray canvases, staged as prepareViews.
+    ! processMosaic: detections of every image of canvases, count images packed.
+    */
+    BatchBox runMosaic(const vector<ImageView>& views);
+    bool prepareMosaic(ExecState& state, const vector<ImageView>& views, const vector<vector<MosaicTile>>& canvases);
+    BatchBox processMosaic(ExecState& state, const vector<vector<MosaicTile>>& canvases, int count);
 
 private:
     YOLOParams mYoloParams;
-    vector<Mat> mInputImgs;
 };
 
 #endif  // YOLOV5_H
@@ -14,11 +14,19 @@
 
 #include <NvInfer.h>
 
+#include "binding_convert.h"
+#include "mosaic.h"
 #include "structs.h"
 #include "yolov5.h"
 
 using namespace std;
 
-BatchBox postProcess(vector<float*> inputs, vector<size_t> sizes, vector<nvinfer1::Dims> dims, YOLOParams yolo_params, const vector<cv::Mat>& imgs);
+BatchBox postProcess(vector<BindingView> inputs, vector<size_t> sizes, vector<nvinfer1::Dims> dims, YOLOParams yolo_params, const vector<ImageTransform>& transforms);
+
+/**
+ * Detections of count images packed into canvases by packMosaic, canvas b is
+ * batch index b of outputs. Boxes crossing tiles are dropped, see splitMosaic.
+ */
+BatchBox postProcessMosaic(vector<BindingView> inputs, vector<size_t> sizes, vector<nvinfer1::Dims> dims, YOLOParams yolo_params, const vector<vector<MosaicTile>>& canvases, int count);
 
 #endif  // YOLOV5_OUTPUTS_H
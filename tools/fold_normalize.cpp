@@ -0,0 +1,744 @@
+/**
+ * Fold input normalization of task yaml(means, stds, image_format) into first
+ * convolution of onnx model, offline. Folded model takes raw image of OpenCV
+ * (bgr, 0~255) as input, so preprocessing is a layout copy only:
+ *   raw uint8/float input -> [Transpose if nhwc] -> Cast -> [Sub] -> ... -> Conv(W', b')
+ * Scale(1/255 and 1/std) and channel order are folded into weights of conv,
+ * mean is folded into bias if conv has no padding, otherwise it's kept as one
+ * per channel Sub on input, since zero padding of normalized input is not zero
+ * of raw input. Input may reach conv through Slice/Concat(e.g. Focus of YOLOv5),
+ * which only move pixels. Folded conv is checked against original one on
+ * random data before saving.
+ * Usage: ./fold_normalize <task yaml> <output onnx> [nchw/nhwc] [uint8/float]
+ * 2021/04/05
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "yaml-cpp/yaml.h"
+
+using namespace std;
+
+/* -==================Protobuf================*/
+// protobuf message kept as list of fields, sub messages are parsed on demand
+struct ProtoField {
+    uint32_t number;
+    uint32_t wire;       // 0: varint, 1: fixed64, 2: bytes, 5: fixed32
+    uint64_t value = 0;  // varint and fixed
+    string bytes;        // length delimited
+};
+
+struct ProtoMessage {
+    vector<ProtoField> fields;
+
+    bool Parse(const string& data) {
+        fields.clear();
+        size_t pos = 0;
+        while (pos < data.size()) {
+            uint64_t key;
+            if (!readVarint(data, pos, key)) return false;
+            ProtoField field;
+            field.number = static_cast<uint32_t>(key >> 3);
+            field.wire   = static_cast<uint32_t>(key & 7);
+            if (field.wire == 0) {
+                if (!readVarint(data, pos, field.value)) return false;
+            } else if (field.wire == 1 || field.wire == 5) {
+                size_t size = field.wire == 1 ? 8 : 4;
+                if (pos + size > data.size()) return false;
+                memcpy(&field.value, data.data() + pos, size);
+                pos += size;
+            } else if (field.wire == 2) {
+                uint64_t length;
+                if (!readVarint(data, pos, length) || length > data.size() - pos) return false;
+                field.bytes = data.substr(pos, length);
+                pos += length;
+            } else {
+                return false;
+            }
+            fields.emplace_back(field);
+        }
+        return true;
+    }
+
+    string Serialize() const {
+        string out;
+        for (const auto& field : fields) {
+            writeVarint(out, (static_cast<uint64_t>(field.number) << 3) | field.wire);
+            if (field.wire == 0) {
+                writeVarint(out, field.value);
+            } else if (field.wire == 1 || field.wire == 5) {
+                out.append(reinterpret_cast<const char*>(&field.value), field.wire == 1 ? 8 : 4);
+            } else {
+                writeVarint(out, field.bytes.size());
+                out += field.bytes;
+            }
+        }
+        return out;
+    }
+
+    const ProtoField* Find(uint32_t number) const {
+        for (const auto& field : fields) {
+            if (field.number == number) return &field;
+        }
+        return nullptr;
+    }
+
+    string String(uint32_t number) const {
+        const ProtoField* field = Find(number);
+        return field ? field->bytes : "";
+    }
+
+    int64_t Int(uint32_t number, int64_t fallback = 0) const {
+        const ProtoField* field = Find(number);
+        return field ? static_cast<int64_t>(field->value) : fallback;
+    }
+
+    vector<string> Strings(uint32_t number) const {
+        vector<string> out;
+        for (const auto& field : fields) {
+            if (field.number == number) out.emplace_back(field.bytes);
+        }
+        return out;
+    }
+
+    // repeated int64, packed or not
+    vector<int64_t> Ints(uint32_t number) const {
+        vector<int64_t> out;
+        for (const auto& field : fields) {
+            if (field.number != number) continue;
+            if (field.wire == 0) {
+                out.emplace_back(static_cast<int64_t>(field.value));
+                continue;
+            }
+            size_t pos = 0;
+            uint64_t value;
+            while (pos < field.bytes.size() && readVarint(field.bytes, pos, value)) {
+                out.emplace_back(static_cast<int64_t>(value));
+            }
+        }
+        return out;
+    }
+
+    void AddVarint(uint32_t number, uint64_t value) {
+        ProtoField field;
+        field.number = number;
+        field.wire   = 0;
+        field.value  = value;
+        fields.emplace_back(field);
+    }
+
+    void AddBytes(uint32_t number, const string& bytes) {
+        ProtoField field;
+        field.number = number;
+        field.wire   = 2;
+        field.bytes  = bytes;
+        fields.emplace_back(field);
+    }
+
+    void Remove(uint32_t number) {
+        vector<ProtoField> kept;
+        for (auto& field : fields) {
+            if (field.number != number) kept.emplace_back(field);
+        }
+        fields.swap(kept);
+    }
+
+private:
+    static bool readVarint(const string& data, size_t& pos, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(data[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    static void writeVarint(string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+};
+
+// field numbers of onnx.proto
+enum : uint32_t {
+    kModelGraph = 7,
+    kGraphNode = 1, kGraphInit = 5, kGraphInput = 11,
+    kNodeInput = 1, kNodeOutput = 2, kNodeName = 3, kNodeOpType = 4, kNodeAttr = 5,
+    kAttrName = 1, kAttrI = 3, kAttrT = 5, kAttrInts = 8, kAttrType = 20,
+    kTensorDims = 1, kTensorType = 2, kTensorFloat = 4, kTensorInt64 = 7, kTensorName = 8, kTensorRaw = 9,
+    kValueName = 1, kValueType = 2, kTypeTensor = 1, kTensorElem = 1, kTensorShape = 2, kShapeDim = 1, kDimValue = 1
+};
+
+enum : int64_t { kOnnxFloat = 1, kOnnxUint8 = 2, kOnnxInt64 = 7 };
+enum : int64_t { kAttrTypeInt = 2, kAttrTypeInts = 7 };
+
+static string readFile(const string& file) {
+    FILE* fp = fopen(file.c_str(), "rb");
+    if (fp == nullptr) return "";
+    string data;
+    char buf[1 << 16];
+    size_t count;
+    while ((count = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        data.append(buf, count);
+    }
+    fclose(fp);
+    return data;
+}
+
+/* -==================Tensors================*/
+struct Tensor {
+    vector<int64_t> dims;
+    vector<float> data;
+};
+
+static bool decodeFloats(const ProtoMessage& tensor, Tensor& out) {
+    if (tensor.Int(kTensorType) != kOnnxFloat) return false;
+    out.dims = tensor.Ints(kTensorDims);
+    int64_t volume = 1;
+    for (int64_t d : out.dims) volume *= d;
+    out.data.resize(volume);
+    const ProtoField* raw = tensor.Find(kTensorRaw);
+    if (raw != nullptr) {
+        if (raw->bytes.size() != volume * sizeof(float)) return false;
+        memcpy(out.data.data(), raw->bytes.data(), raw->bytes.size());
+        return true;
+    }
+    // float_data is packed fixed32
+    size_t offset = 0;
+    for (const auto& field : tensor.fields) {
+        if (field.number != kTensorFloat) continue;
+        if (field.wire == 5) {
+            if (offset >= out.data.size()) return false;
+            memcpy(&out.data[offset++], &field.value, sizeof(float));
+            continue;
+        }
+        size_t count = field.bytes.size() / sizeof(float);
+        if (offset + count > out.data.size()) return false;
+        memcpy(&out.data[offset], field.bytes.data(), count * sizeof(float));
+        offset += count;
+    }
+    return offset == out.data.size();
+}
+
+static bool decodeInts(const ProtoMessage& tensor, vector<int64_t>& out) {
+    if (tensor.Int(kTensorType) != kOnnxInt64) return false;
+    const ProtoField* raw = tensor.Find(kTensorRaw);
+    if (raw != nullptr) {
+        out.resize(raw->bytes.size() / sizeof(int64_t));
+        memcpy(out.data(), raw->bytes.data(), out.size() * sizeof(int64_t));
+        return true;
+    }
+    out = tensor.Ints(kTensorInt64);
+    return true;
+}
+
+static string encodeFloats(const string& name, const Tensor& tensor) {
+    ProtoMessage msg;
+    for (int64_t d : tensor.dims) {
+        msg.AddVarint(kTensorDims, static_cast<uint64_t>(d));
+    }
+    msg.AddVarint(kTensorType, kOnnxFloat);
+    msg.AddBytes(kTensorName, name);
+    msg.AddBytes(kTensorRaw, string(reinterpret_cast<const char*>(tensor.data.data()), tensor.data.size() * sizeof(float)));
+    return msg.Serialize();
+}
+
+static string makeAttrInts(const string& name, const vector<int64_t>& values) {
+    ProtoMessage attr;
+    attr.AddBytes(kAttrName, name);
+    for (int64_t v : values) {
+        attr.AddVarint(kAttrInts, static_cast<uint64_t>(v));
+    }
+    attr.AddVarint(kAttrType, kAttrTypeInts);
+    return attr.Serialize();
+}
+
+static string makeAttrInt(const string& name, int64_t value) {
+    ProtoMessage attr;
+    attr.AddBytes(kAttrName, name);
+    attr.AddVarint(kAttrI, static_cast<uint64_t>(value));
+    attr.AddVarint(kAttrType, kAttrTypeInt);
+    return attr.Serialize();
+}
+
+static string makeNode(const string& op, const vector<string>& inputs, const string& output, const vector<string>& attrs) {
+    ProtoMessage node;
+    for (const auto& input : inputs) {
+        node.AddBytes(kNodeInput, input);
+    }
+    node.AddBytes(kNodeOutput, output);
+    node.AddBytes(kNodeName, output);
+    node.AddBytes(kNodeOpType, op);
+    for (const auto& attr : attrs) {
+        node.AddBytes(kNodeAttr, attr);
+    }
+    return node.Serialize();
+}
+
+/* -==================Folding================*/
+struct ConvAttrs {
+    vector<int64_t> pads {0, 0, 0, 0};
+    vector<int64_t> strides {1, 1};
+    vector<int64_t> dilations {1, 1};
+    int64_t group = 1;
+};
+
+class Folder {
+public:
+    Folder(const vector<float>& means, const vector<float>& stds, int format)
+        : mMeans(means), mStds(stds) {
+        // format: 0 rgb, 1 rgb255, 2 bgr, 3 bgr255, input image is bgr of opencv
+        bool bgr = format == 2 || format == 3;
+        float scale = format == 0 || format == 2 ? 1.f / 255.f : 1.f;
+        for (int c = 0; c < 3; ++c) {
+            mPerm[c]  = bgr ? c : 2 - c;       // model channel c takes raw channel mPerm[c]
+            mScale[c] = scale / mStds[c];      // x_c = mScale[c] * (raw - mShift[c])
+            mShift[c] = mMeans[c] / scale;
+        }
+    }
+
+    bool Run(const string& onnx, const string& output, bool nhwc, bool uint8_input);
+
+private:
+    bool loadGraph();
+    bool traceInput(string& conv_node, int& conv_index);
+    bool lookupInts(const string& name, vector<int64_t>& values) const;
+    bool check(const Tensor& weight, const vector<float>& bias, const Tensor& folded_weight,
+               const vector<float>& folded_bias, bool with_sub, const ConvAttrs& attrs) const;
+    void conv(const vector<float>& input, int channels, int h, int w, const Tensor& weight,
+              const vector<float>& bias, const ConvAttrs& attrs, vector<float>& output) const;
+
+private:
+    vector<float> mMeans;
+    vector<float> mStds;
+    int mPerm[3];
+    float mScale[3];
+    float mShift[3];
+
+    ProtoMessage mModel;
+    ProtoMessage mGraph;
+    vector<ProtoMessage> mNodes;
+    map<string, int> mInitializers;  // name -> index of field in graph
+    string mInput;
+    vector<int> mChannelMap;  // model channel(0~2) of every input channel of conv
+};
+
+bool Folder::loadGraph() {
+    const ProtoField* graph = mModel.Find(kModelGraph);
+    if (graph == nullptr || !mGraph.Parse(graph->bytes)) return false;
+    for (size_t i = 0; i < mGraph.fields.size(); ++i) {
+        const ProtoField& field = mGraph.fields[i];
+        if (field.number == kGraphNode) {
+            ProtoMessage node;
+            if (!node.Parse(field.bytes)) return false;
+            mNodes.emplace_back(node);
+        } else if (field.number == kGraphInit) {
+            ProtoMessage tensor;
+            if (!tensor.Parse(field.bytes)) return false;
+            mInitializers[tensor.String(kTensorName)] = static_cast<int>(i);
+        }
+    }
+    for (const auto& field : mGraph.fields) {
+        if (field.number != kGraphInput) continue;
+        ProtoMessage value;
+        if (!value.Parse(field.bytes)) return false;
+        string name = value.String(kValueName);
+        if (mInitializers.count(name) == 0) {
+            mInput = name;
+            break;
+        }
+    }
+    return !mInput.empty();
+}
+
+bool Folder::lookupInts(const string& name, vector<int64_t>& values) const {
+    auto it = mInitializers.find(name);
+    if (it != mInitializers.end()) {
+        ProtoMessage tensor;
+        return tensor.Parse(mGraph.fields[it->second].bytes) && decodeInts(tensor, values);
+    }
+    // old exporters put constants in Constant nodes
+    for (const auto& node : mNodes) {
+        if (node.String(kNodeOpType) != "Constant" || node.String(kNodeOutput) != name) continue;
+        for (const auto& attr_bytes : node.Strings(kNodeAttr)) {
+            ProtoMessage attr, tensor;
+            if (attr.Parse(attr_bytes) && attr.String(kAttrName) == "value"
+                && tensor.Parse(attr.String(kAttrT))) {
+                return decodeInts(tensor, values);
+            }
+        }
+    }
+    return false;
+}
+
+static bool findAttr(const ProtoMessage& node, const string& name, ProtoMessage& attr) {
+    for (const auto& bytes : node.Strings(kNodeAttr)) {
+        if (attr.Parse(bytes) && attr.String(kAttrName) == name) return true;
+    }
+    return false;
+}
+
+bool Folder::traceInput(string& conv_node, int& conv_index) {
+    // channel map of tensors on the way from input to conv
+    map<string, vector<int>> channels;
+    channels[mInput] = {0, 1, 2};
+    conv_index = -1;
+    // nodes are topologically sorted
+    for (size_t n = 0; n < mNodes.size(); ++n) {
+        const ProtoMessage& node = mNodes[n];
+        vector<string> inputs = node.Strings(kNodeInput);
+        bool touched = false;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            touched = touched || channels.count(inputs[i]) > 0;
+        }
+        if (!touched) continue;
+
+        string op = node.String(kNodeOpType);
+        string out = node.String(kNodeOutput);
+        if (op == "Conv" && channels.count(inputs[0]) && inputs.size() > 1 && mInitializers.count(inputs[1])) {
+            if (conv_index >= 0) {
+                cerr << "Input reaches more than one conv: " << node.String(kNodeName) << endl;
+                return false;
+            }
+            conv_index = static_cast<int>(n);
+            conv_node = out;
+            mChannelMap = channels[inputs[0]];
+        } else if (op == "Identity") {
+            channels[out] = channels[inputs[0]];
+        } else if (op == "Slice" && channels.count(inputs[0])) {
+            vector<int64_t> axes;
+            ProtoMessage attr;
+            bool ok = inputs.size() > 3 ? lookupInts(inputs[3], axes) : findAttr(node, "axes", attr);
+            if (inputs.size() <= 3) axes = attr.Ints(kAttrInts);
+            for (int64_t axis : axes) {
+                ok = ok && axis != 1 && axis != -3;
+            }
+            if (!ok) {
+                cerr << "Slice on channels or with unknown axes can't be folded: " << node.String(kNodeName) << endl;
+                return false;
+            }
+            channels[out] = channels[inputs[0]];
+        } else if (op == "Concat") {
+            ProtoMessage attr;
+            int64_t axis = findAttr(node, "axis", attr) ? attr.Int(kAttrI) : 0;
+            vector<int> merged;
+            for (const auto& input : inputs) {
+                if (channels.count(input) == 0) {
+                    cerr << "Concat of input with other tensor can't be folded: " << node.String(kNodeName) << endl;
+                    return false;
+                }
+                const vector<int>& map_in = channels[input];
+                if (axis == 1) {
+                    merged.insert(merged.end(), map_in.begin(), map_in.end());
+                } else {
+                    if (!merged.empty() && merged != map_in) return false;
+                    merged = map_in;
+                }
+            }
+            channels[out] = merged;
+        } else {
+            cerr << "Input is used by " << op << " before conv, can't fold: " << node.String(kNodeName) << endl;
+            return false;
+        }
+    }
+    if (conv_index < 0) {
+        cerr << "No conv takes input of model" << endl;
+        return false;
+    }
+    // channel order is folded by swapping weights in every group of 3 channels
+    for (size_t j = 0; j < mChannelMap.size(); ++j) {
+        size_t base = j - mChannelMap[j];
+        if (base + 2 >= mChannelMap.size() || mChannelMap[base] != 0 || mChannelMap[base + 1] != 1 || mChannelMap[base + 2] != 2) {
+            cerr << "Channels of input are reordered before conv, can't fold" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void Folder::conv(const vector<float>& input, int channels, int h, int w, const Tensor& weight,
+                  const vector<float>& bias, const ConvAttrs& attrs, vector<float>& output) const {
+    int oc = static_cast<int>(weight.dims[0]);
+    int kh = static_cast<int>(weight.dims[2]);
+    int kw = static_cast<int>(weight.dims[3]);
+    int oh = static_cast<int>((h + attrs.pads[0] + attrs.pads[2] - attrs.dilations[0] * (kh - 1) - 1) / attrs.strides[0] + 1);
+    int ow = static_cast<int>((w + attrs.pads[1] + attrs.pads[3] - attrs.dilations[1] * (kw - 1) - 1) / attrs.strides[1] + 1);
+    output.assign(static_cast<size_t>(oc) * oh * ow, 0.f);
+    for (int o = 0; o < oc; ++o) {
+        for (int y = 0; y < oh; ++y) {
+            for (int x = 0; x < ow; ++x) {
+                double sum = bias.empty() ? 0. : bias[o];
+                for (int c = 0; c < channels; ++c) {
+                    for (int i = 0; i < kh; ++i) {
+                        for (int j = 0; j < kw; ++j) {
+                            int iy = static_cast<int>(y * attrs.strides[0] - attrs.pads[0] + i * attrs.dilations[0]);
+                            int ix = static_cast<int>(x * attrs.strides[1] - attrs.pads[1] + j * attrs.dilations[1]);
+                            if (iy < 0 || iy >= h || ix < 0 || ix >= w) continue;
+                            sum += weight.data[((o * channels + c) * kh + i) * kw + j] * input[(c * h + iy) * w + ix];
+                        }
+                    }
+                }
+                output[(o * oh + y) * ow + x] = static_cast<float>(sum);
+            }
+        }
+    }
+}
+
+bool Folder::check(const Tensor& weight, const vector<float>& bias, const Tensor& folded_weight,
+                   const vector<float>& folded_bias, bool with_sub, const ConvAttrs& attrs) const {
+    // raw pixels after slices as folded model sees them, and normalized ones as original model sees them
+    int channels = static_cast<int>(mChannelMap.size());
+    int h = 13, w = 11;
+    mt19937 rng(0);
+    uniform_int_distribution<int> pixel(0, 255);
+    vector<float> raw(channels * h * w), original(channels * h * w), folded(channels * h * w);
+    for (auto& v : raw) {
+        v = static_cast<float>(pixel(rng));
+    }
+    for (int j = 0; j < channels; ++j) {
+        int c = mChannelMap[j];
+        int base = j - c;
+        for (int p = 0; p < h * w; ++p) {
+            original[j * h * w + p] = mScale[c] * (raw[(base + mPerm[c]) * h * w + p] - mShift[c]);
+            // raw channel c of group is raw[j], shifted by mean of model channel taking it
+            float shift = 0.f;
+            for (int k = 0; k < 3; ++k) {
+                if (with_sub && mPerm[k] == c) shift = mShift[k];
+            }
+            folded[j * h * w + p] = raw[j * h * w + p] - shift;
+        }
+    }
+    vector<float> expected, actual;
+    conv(original, channels, h, w, weight, bias, attrs, expected);
+    conv(folded, channels, h, w, folded_weight, folded_bias, attrs, actual);
+    double max_diff = 0., max_value = 1e-6;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        max_diff  = max(max_diff, static_cast<double>(fabs(expected[i] - actual[i])));
+        max_value = max(max_value, static_cast<double>(fabs(expected[i])));
+    }
+    cout << "Check folded conv on random input, max diff: " << max_diff << ", max output: " << max_value << endl;
+    return max_diff <= 1e-4 * max_value;
+}
+
+bool Folder::Run(const string& onnx, const string& output, bool nhwc, bool uint8_input) {
+    if (!mModel.Parse(readFile(onnx)) || !loadGraph()) {
+        cerr << "Read onnx failed: " << onnx << endl;
+        return false;
+    }
+    string conv_out;
+    int conv_index;
+    if (!traceInput(conv_out, conv_index)) return false;
+
+    ProtoMessage& conv_node = mNodes[conv_index];
+    vector<string> conv_inputs = conv_node.Strings(kNodeInput);
+    ConvAttrs attrs;
+    ProtoMessage attr;
+    if (findAttr(conv_node, "pads", attr)) attrs.pads = attr.Ints(kAttrInts);
+    if (findAttr(conv_node, "strides", attr)) attrs.strides = attr.Ints(kAttrInts);
+    if (findAttr(conv_node, "dilations", attr)) attrs.dilations = attr.Ints(kAttrInts);
+    if (findAttr(conv_node, "group", attr)) attrs.group = attr.Int(kAttrI);
+    if (findAttr(conv_node, "auto_pad", attr) && attr.String(4) != "NOTSET" && !attr.String(4).empty()) {
+        cerr << "Conv with auto_pad is not supported, export with explicit pads" << endl;
+        return false;
+    }
+    if (attrs.group != 1) {
+        cerr << "First conv is grouped, can't fold" << endl;
+        return false;
+    }
+
+    ProtoMessage weight_msg;
+    Tensor weight;
+    if (!weight_msg.Parse(mGraph.fields[mInitializers[conv_inputs[1]]].bytes) || !decodeFloats(weight_msg, weight)
+        || weight.dims.size() != 4 || weight.dims[1] != static_cast<int64_t>(mChannelMap.size())) {
+        cerr << "Weight of first conv is not float oihw: " << conv_inputs[1] << endl;
+        return false;
+    }
+    int users = 0;
+    for (const auto& node : mNodes) {
+        for (const auto& input : node.Strings(kNodeInput)) {
+            users += input == conv_inputs[1];
+        }
+    }
+    if (users != 1) {
+        cerr << "Weight of first conv is shared, can't fold: " << conv_inputs[1] << endl;
+        return false;
+    }
+    int oc = static_cast<int>(weight.dims[0]);
+    int ic = static_cast<int>(weight.dims[1]);
+    int ksize = static_cast<int>(weight.dims[2] * weight.dims[3]);
+    vector<float> bias(oc, 0.f);
+    bool has_bias = conv_inputs.size() > 2 && !conv_inputs[2].empty();
+    if (has_bias) {
+        ProtoMessage bias_msg;
+        Tensor bias_tensor;
+        if (!mInitializers.count(conv_inputs[2]) || !bias_msg.Parse(mGraph.fields[mInitializers[conv_inputs[2]]].bytes)
+            || !decodeFloats(bias_msg, bias_tensor) || static_cast<int>(bias_tensor.data.size()) != oc) {
+            cerr << "Bias of first conv is not a float initializer" << endl;
+            return false;
+        }
+        bias = bias_tensor.data;
+    }
+
+    // scale and channel order into weights
+    Tensor folded_weight = weight;
+    for (int o = 0; o < oc; ++o) {
+        for (int j = 0; j < ic; ++j) {
+            int c = mChannelMap[j];
+            int target = j - c + mPerm[c];
+            for (int k = 0; k < ksize; ++k) {
+                folded_weight.data[(o * ic + target) * ksize + k] = weight.data[(o * ic + j) * ksize + k] * mScale[c];
+            }
+        }
+    }
+    // mean into bias, exact only if padding never reads outside of image
+    bool padded = false;
+    for (int64_t p : attrs.pads) {
+        padded = padded || p != 0;
+    }
+    bool has_mean = mShift[0] != 0.f || mShift[1] != 0.f || mShift[2] != 0.f;
+    bool with_sub = padded && has_mean;
+    float raw_shift[3];
+    for (int c = 0; c < 3; ++c) {
+        raw_shift[mPerm[c]] = mShift[c];
+    }
+    vector<float> folded_bias = bias;
+    if (!with_sub) {
+        for (int o = 0; o < oc; ++o) {
+            double sum = 0.;
+            for (int j = 0; j < ic; ++j) {
+                for (int k = 0; k < ksize; ++k) {
+                    sum += folded_weight.data[(o * ic + j) * ksize + k] * raw_shift[mChannelMap[j]];
+                }
+            }
+            folded_bias[o] -= static_cast<float>(sum);
+        }
+    }
+    if (!check(weight, bias, folded_weight, folded_bias, with_sub, attrs)) {
+        cerr << "Folded conv mismatch original one!" << endl;
+        return false;
+    }
+
+    // rewrite graph: weights, bias and input nodes
+    mGraph.fields[mInitializers[conv_inputs[1]]].bytes = encodeFloats(conv_inputs[1], folded_weight);
+    Tensor bias_tensor;
+    bias_tensor.dims = {oc};
+    bias_tensor.data = folded_bias;
+    string bias_name = has_bias ? conv_inputs[2] : conv_inputs[1] + "_folded_bias";
+    if (has_bias) {
+        mGraph.fields[mInitializers[bias_name]].bytes = encodeFloats(bias_name, bias_tensor);
+    } else {
+        mGraph.AddBytes(kGraphInit, encodeFloats(bias_name, bias_tensor));
+        conv_node.AddBytes(kNodeInput, bias_name);
+    }
+
+    vector<string> new_nodes;
+    string tensor = mInput;
+    if (nhwc) {
+        new_nodes.emplace_back(makeNode("Transpose", {tensor}, mInput + "_nchw", {makeAttrInts("perm", {0, 3, 1, 2})}));
+        tensor = mInput + "_nchw";
+    }
+    if (uint8_input) {
+        new_nodes.emplace_back(makeNode("Cast", {tensor}, mInput + "_float", {makeAttrInt("to", kOnnxFloat)}));
+        tensor = mInput + "_float";
+    }
+    if (with_sub) {
+        Tensor shift;
+        shift.dims = {1, 3, 1, 1};
+        shift.data = {raw_shift[0], raw_shift[1], raw_shift[2]};
+        mGraph.AddBytes(kGraphInit, encodeFloats(mInput + "_mean", shift));
+        new_nodes.emplace_back(makeNode("Sub", {tensor, mInput + "_mean"}, mInput + "_centered", {}));
+        tensor = mInput + "_centered";
+    }
+    // consumers of input take the last new tensor
+    for (auto& node : mNodes) {
+        for (auto& field : node.fields) {
+            if (field.number == kNodeInput && field.bytes == mInput) field.bytes = tensor;
+        }
+    }
+
+    // input binding: raw type and layout
+    vector<ProtoField> fields;
+    bool nodes_written = false;
+    size_t node_index = 0;
+    for (auto& field : mGraph.fields) {
+        if (field.number == kGraphNode) {
+            if (!nodes_written) {
+                for (const auto& bytes : new_nodes) {
+                    ProtoField node;
+                    node.number = kGraphNode;
+                    node.wire   = 2;
+                    node.bytes  = bytes;
+                    fields.emplace_back(node);
+                }
+                nodes_written = true;
+            }
+            field.bytes = mNodes[node_index++].Serialize();
+        } else if (field.number == kGraphInput) {
+            ProtoMessage value, type, tensor_type, shape;
+            if (value.Parse(field.bytes) && value.String(kValueName) == mInput
+                && type.Parse(value.String(kValueType)) && tensor_type.Parse(type.String(kTypeTensor))
+                && shape.Parse(tensor_type.String(kTensorShape))) {
+                vector<string> dims = shape.Strings(kShapeDim);
+                if (nhwc && dims.size() == 4) {
+                    shape.Remove(kShapeDim);
+                    for (int d : {0, 2, 3, 1}) {
+                        shape.AddBytes(kShapeDim, dims[d]);
+                    }
+                }
+                ProtoMessage new_tensor_type;
+                new_tensor_type.AddVarint(kTensorElem, uint8_input ? kOnnxUint8 : kOnnxFloat);
+                new_tensor_type.AddBytes(kTensorShape, shape.Serialize());
+                ProtoMessage new_type;
+                new_type.AddBytes(kTypeTensor, new_tensor_type.Serialize());
+                ProtoMessage new_value;
+                new_value.AddBytes(kValueName, mInput);
+                new_value.AddBytes(kValueType, new_type.Serialize());
+                field.bytes = new_value.Serialize();
+            }
+        }
+        fields.emplace_back(field);
+    }
+    mGraph.fields.swap(fields);
+    for (auto& field : mModel.fields) {
+        if (field.number == kModelGraph) field.bytes = mGraph.Serialize();
+    }
+
+    string data = mModel.Serialize();
+    FILE* fp = fopen(output.c_str(), "wb");
+    if (fp == nullptr || fwrite(data.data(), 1, data.size(), fp) != data.size()) {
+        cerr << "Write onnx failed: " << output << endl;
+        if (fp) fclose(fp);
+        return false;
+    }
+    fclose(fp);
+    cout << "Folded into conv " << conv_out << (with_sub ? ", mean is kept as Sub since conv pads input" : "") << endl;
+    cout << "Saved: " << output << ", input " << mInput << " is raw bgr " << (uint8_input ? "uint8 " : "float ")
+         << (nhwc ? "nhwc" : "nchw") << endl;
+    cout << "Set in task yaml: onnx_file: \"" << output << "\", means: [0, 0, 0], stds: [1, 1, 1], image_format: 3" << endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <task yaml> <output onnx> [nchw/nhwc] [uint8/float]" << endl;
+        return -1;
+    }
+    YAML::Node cfg = YAML::LoadFile(argv[1]);
+    bool nhwc = argc > 3 && string(argv[3]) == "nhwc";
+    bool uint8_input = argc <= 4 || string(argv[4]) != "float";
+    Folder folder(cfg["params"]["means"].as<vector<float>>(),
+                  cfg["params"]["stds"].as<vector<float>>(),
+                  cfg["params"]["image_format"].as<int>());
+    bool ok = folder.Run(cfg["engine"]["onnx_file"].as<string>(), argv[2], nhwc, uint8_input);
+    return ok ? 0 : 1;
+}